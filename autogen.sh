@@ -28,6 +28,7 @@ if [ -f "/usr/bin/yum" ]; then
 		cp /usr/bin/cmake3 /usr/bin/cmake
 	fi
 	yum install -y dos2unix wget which
+	yum install -y libzstd-devel
 
 	#yum install -y boost169-devel boost169-static
 	#export BOOST_LIBRARYDIR=/usr/lib64/boost169
@@ -49,7 +50,7 @@ elif [ -f "/usr/bin/apt" ]; then
 	#Ubuntu
 	export DEBIAN_FRONTEND=noninteractive
 	apt-get update
-	apt install -y dos2unix g++ git make zlib1g-dev cmake alien
+	apt install -y dos2unix g++ git make zlib1g-dev libzstd-dev cmake alien
 	#apt install -y libboost-all-dev libace-dev
 	#apt install -y libcpprest-dev liblog4cpp5-dev
 	apt install -y ruby ruby-dev rubygems
@@ -30,6 +30,7 @@ ldd ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc | grep cpprest | awk '{cmd="cp "$3" $
 ldd ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc | grep ssl     | awk '{cmd="cp "$3" ${CMAKE_CURRENT_BINARY_DIR}/bin/opt/appmesh/lib64";print(cmd);system(cmd)}'
 ldd ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc | grep crypto  | awk '{cmd="cp "$3" ${CMAKE_CURRENT_BINARY_DIR}/bin/opt/appmesh/lib64";print(cmd);system(cmd)}'
 ldd ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc | grep log4cpp | awk '{cmd="cp "$3" ${CMAKE_CURRENT_BINARY_DIR}/bin/opt/appmesh/lib64";print(cmd);system(cmd)}'
+ldd ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc | grep zstd    | awk '{cmd="cp "$3" ${CMAKE_CURRENT_BINARY_DIR}/bin/opt/appmesh/lib64";print(cmd);system(cmd)}'
 rm ${CMAKE_CURRENT_BINARY_DIR}/bin/appc
 rm ${CMAKE_CURRENT_BINARY_DIR}/bin/appsvc
 
@@ -1,19 +1,25 @@
 #ifdef WIN32
 #include <windows.h>
 #else
+#include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
 #include <ace/Signal.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <functional>
+#include <mutex>
 #include <boost/io/ios_state.hpp>
 #include <boost/program_options.hpp>
 #include <cpprest/filestream.h>
 #include <cpprest/json.h>
 #include "ArgumentParser.h"
+#include "../common/Compression.h"
 #include "../common/DurationParse.h"
 #include "../common/jwt-cpp/jwt.h"
 #include "../common/Utility.h"
@@ -41,6 +47,9 @@
 	if (m_commandLineVariables.count("port"))                      \
 		m_listenPort = m_commandLineVariables["port"].as<int>();
 
+// retry times of broken download transfer and upload chunk
+#define DOWNLOAD_RESUME_RETRY 3
+
 // Each user should have its own token path
 const static std::string m_tokenFilePrefix = std::string(getenv("HOME") ? getenv("HOME") : ".") + "/._appmesh_";
 static std::string m_jwtToken;
@@ -51,8 +60,8 @@ static bool SIGINIT_BREAKING = false;
 static std::string APPC_EXEC_APP_NAME;
 static ArgumentParser *WORK_PARSE = nullptr;
 
-ArgumentParser::ArgumentParser(int argc, const char *argv[], int listenPort, bool sslEnabled)
-	: m_argc(argc), m_argv(argv), m_listenPort(listenPort), m_sslEnabled(sslEnabled), m_tokenTimeoutSeconds(0)
+ArgumentParser::ArgumentParser(int argc, const char *argv[], int listenPort, bool sslEnabled, const std::string &socketPath)
+	: m_argc(argc), m_argv(argv), m_listenPort(listenPort), m_sslEnabled(sslEnabled), m_socketPath(socketPath), m_tokenTimeoutSeconds(0)
 {
 	WORK_PARSE = this;
 	po::options_description global("Global options");
@@ -339,6 +348,11 @@ void ArgumentParser::processReg()
 		("stdout_cache_size,O", po::value<int>(), "stdout file cache number")
 		("virtual_memory,v", po::value<int>(), "virtual memory limit in MByte")
 		("cpu_shares,r", po::value<int>(), "CPU shares (relative weight)")
+		("cpu_quota", po::value<int>(), "CPU hard limit in microseconds for each period (e.g., 50000 is half core for default period)")
+		("cpu_period", po::value<int>(), "CPU quota period in microseconds (default 100000)")
+		("cpu_set", po::value<std::string>(), "pin to CPU list (e.g., '0-3,8')")
+		("exclusive_cpus", po::value<int>(), "pin to auto allocated exclusive CPU cores number")
+		("memory_nodes", po::value<std::string>(), "NUMA memory node list (e.g., '0'), default is the nodes of pinned CPU")
 		("env,e", po::value<std::vector<std::string>>(), "environment variables (e.g., -e env1=value1 -e env2=value2, APP_DOCKER_OPTS is used to input docker parameters)")
 		("interval,i", po::value<std::string>(), "start interval seconds for short running app, support ISO 8601 durations (e.g., 'P1Y2M3DT4H5M6S' 'P5W')")
 		("extra_time,q", po::value<std::string>(), "extra timeout for short running app,the value must less than interval  (default 0), support ISO 8601 durations (e.g., 'P1Y2M3DT4H5M6S' 'P5W')")
@@ -421,7 +435,9 @@ void ArgumentParser::processReg()
 	}
 
 	if (m_commandLineVariables.count("memory") || m_commandLineVariables.count("virtual_memory") ||
-		m_commandLineVariables.count("cpu_shares"))
+		m_commandLineVariables.count("cpu_shares") || m_commandLineVariables.count("cpu_quota") ||
+		m_commandLineVariables.count("cpu_set") || m_commandLineVariables.count("exclusive_cpus") ||
+		m_commandLineVariables.count("memory_nodes"))
 	{
 		web::json::value objResourceLimitation = web::json::value::object();
 		if (m_commandLineVariables.count("memory"))
@@ -430,6 +446,16 @@ void ArgumentParser::processReg()
 			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb] = web::json::value::number(m_commandLineVariables["virtual_memory"].as<int>());
 		if (m_commandLineVariables.count("cpu_shares"))
 			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_shares] = web::json::value::number(m_commandLineVariables["cpu_shares"].as<int>());
+		if (m_commandLineVariables.count("cpu_quota"))
+			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_quota_us] = web::json::value::number(m_commandLineVariables["cpu_quota"].as<int>());
+		if (m_commandLineVariables.count("cpu_period"))
+			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_period_us] = web::json::value::number(m_commandLineVariables["cpu_period"].as<int>());
+		if (m_commandLineVariables.count("cpu_set"))
+			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_set] = web::json::value::string(m_commandLineVariables["cpu_set"].as<std::string>());
+		if (m_commandLineVariables.count("exclusive_cpus"))
+			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_exclusive_cpus] = web::json::value::number(m_commandLineVariables["exclusive_cpus"].as<int>());
+		if (m_commandLineVariables.count("memory_nodes"))
+			objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_memory_nodes] = web::json::value::string(m_commandLineVariables["memory_nodes"].as<std::string>());
 		jsobObj[JSON_KEY_APP_resource_limit] = objResourceLimitation;
 	}
 
@@ -869,6 +895,7 @@ void ArgumentParser::processDownload()
 		COMMON_OPTIONS
 		("remote,r", po::value<std::string>(), "remote file path")
 		("local,l", po::value<std::string>(), "save to local file path")
+		("continue,c", "resume download to existing partial local file")
 		("help,h", "Prints command usage to stdout and exits");
 	shiftCommandLineArgs(desc);
 	HELP_ARG_CHECK_WITH_RETURN;
@@ -884,12 +911,71 @@ void ArgumentParser::processDownload()
 	auto local = m_commandLineVariables["local"].as<std::string>();
 	std::map<std::string, std::string> query, headers;
 	headers[HTTP_HEADER_KEY_file_path] = file;
-	auto response = requestHttp(true, methods::GET, restPath, query, nullptr, &headers);
 
-	auto stream = concurrency::streams::file_stream<uint8_t>::open_ostream(local, std::ios_base::trunc | std::ios_base::binary).get();
-	response.body().read_to_end(stream.streambuf()).wait();
+	// body is written to file as received, broken transfer is resumed from received size
+	uint64_t received = 0;
+	struct stat localStat;
+	if (m_commandLineVariables.count("continue") && ::stat(local.c_str(), &localStat) == 0)
+	{
+		received = localStat.st_size;
+	}
+	std::string etag;
+	std::ofstream output;
+	http_response response;
+	for (int retry = 0;; retry++)
+	{
+		if (received)
+		{
+			headers[header_names::range] = "bytes=" + std::to_string(received) + "-";
+			// server reply whole file when file changed during resume
+			if (etag.length())
+				headers[header_names::if_range] = etag;
+		}
+		auto request = createRequest(methods::GET, restPath, query, &headers);
+		try
+		{
+			response = sendRequest(request, 65, [&](const http_response &resp, const char *data, std::size_t size) {
+				if (!output.is_open())
+				{
+					const bool append = resp.status_code() == status_codes::PartialContent;
+					if (!append)
+						received = 0;
+					output.open(local, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+					if (!output)
+						throw std::invalid_argument(Utility::stringFormat("Failed to open local file <%s>", local.c_str()));
+					if (resp.headers().has(header_names::etag))
+						etag = resp.headers().find(header_names::etag)->second;
+				}
+				output.write(data, size);
+				received += size;
+			});
+			break;
+		}
+		catch (const std::runtime_error &e)
+		{
+			if (!output.is_open() || retry >= DOWNLOAD_RESUME_RETRY)
+				throw;
+			output.close();
+			std::cout << e.what() << ", resume from <" << received << ">" << std::endl;
+		}
+	}
+
+	// requested range start at file end: local file is complete
+	std::string contentRange;
+	const bool complete = response.status_code() == status_codes::RangeNotSatisfiable && response.headers().match(header_names::content_range, contentRange) &&
+						  contentRange == "bytes */" + std::to_string(received);
+	if (response.status_code() != status_codes::OK && response.status_code() != status_codes::PartialContent && !complete)
+	{
+		throw std::invalid_argument(response.extract_utf8string(true).get());
+	}
+	if (!output.is_open() && response.status_code() == status_codes::OK)
+	{
+		// empty file
+		output.open(local, std::ios::binary | std::ios::trunc);
+	}
+	output.close();
 
-	std::cout << "Download file <" << local << "> size <" << Utility::humanReadableSize(stream.streambuf().size()) << ">" << std::endl;
+	std::cout << "Download file <" << local << "> size <" << Utility::humanReadableSize(received) << ">" << std::endl;
 
 	if (response.headers().has(HTTP_HEADER_KEY_file_mode))
 		os::fileChmod(local, std::stoi(response.headers().find(HTTP_HEADER_KEY_file_mode)->second));
@@ -904,6 +990,8 @@ void ArgumentParser::processUpload()
 		COMMON_OPTIONS
 		("remote,r", po::value<std::string>(), "save to remote file path")
 		("local,l", po::value<std::string>(), "local file path")
+		("parallel,p", po::value<int>()->default_value(FILE_UPLOAD_PARALLEL), "parallel connections to upload large file by chunks")
+		("continue,c", po::value<std::string>(), "resume interrupted upload by upload id")
 		("help,h", "Prints command usage to stdout and exits");
 	shiftCommandLineArgs(desc);
 	HELP_ARG_CHECK_WITH_RETURN;
@@ -922,36 +1010,163 @@ void ArgumentParser::processUpload()
 		std::cout << "local file not exist" << std::endl;
 		return;
 	}
+	struct stat localStat;
+	if (::stat(local.c_str(), &localStat) != 0)
+	{
+		throw std::invalid_argument(Utility::stringFormat("Failed to stat local file <%s>", local.c_str()));
+	}
+	const uint64_t length = localStat.st_size;
+	if (length > FILE_UPLOAD_CHUNK_BYTES || m_commandLineVariables.count("continue"))
+	{
+		processUploadChunks(file, local, length);
+		return;
+	}
 	// https://msdn.microsoft.com/en-us/magazine/dn342869.aspx
 
 	auto fileStream = concurrency::streams::file_stream<uint8_t>::open_istream(local, std::ios_base::binary).get();
-	// Get the content length, which is used to set the
-	// Content-Length property
-	fileStream.seek(0, std::ios::end);
-	auto length = static_cast<std::size_t>(fileStream.tell());
-	fileStream.seek(0, std::ios::beg);
 
 	std::map<std::string, std::string> query, header;
 	header[HTTP_HEADER_KEY_file_path] = file;
 
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	// Create http_client to send the request.
-	http_client_config config;
-	config.set_timeout(std::chrono::seconds(200));
-	config.set_validate_certificates(false);
-	http_client client(restURL, config);
 	std::string restPath = "/appmesh/file/upload";
 	http_request request = createRequest(methods::POST, restPath, query, &header);
 
 	request.set_body(fileStream, length);
 	request.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(local));
 	request.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(local));
-	http_response response = client.request(request).get();
+	http_response response = sendRequest(request, 200);
 	fileStream.close();
 	std::cout << GET_STD_STRING(response.extract_utf8string(true).get()) << std::endl;
 }
 
+void ArgumentParser::processUploadChunks(const std::string &file, const std::string &local, uint64_t length)
+{
+	// 1. create upload or get received ranges of interrupted upload
+	std::string uploadId;
+	std::string authorization;
+	std::vector<std::pair<uint64_t, uint64_t>> received;
+	std::map<std::string, std::string> query, headers;
+	if (m_commandLineVariables.count("continue"))
+	{
+		uploadId = m_commandLineVariables["continue"].as<std::string>();
+		auto request = createRequest(methods::GET, "/appmesh/file/upload/session/" + uploadId, query, nullptr);
+		auto response = sendRequest(request, 65);
+		// token is added by sendRequest() when local socket is not connected
+		request.headers().match(HTTP_HEADER_JWT_Authorization, authorization);
+		if (response.status_code() != status_codes::OK)
+			throw std::invalid_argument(response.extract_utf8string(true).get());
+		auto json = response.extract_json(true).get();
+		if (GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_file_path) != file || json.at(JSON_KEY_UPLOAD_file_size).as_number().to_uint64() != length)
+			throw std::invalid_argument(Utility::stringFormat("Upload <%s> is not for file <%s>", uploadId.c_str(), file.c_str()));
+		for (const auto &range : json.at(JSON_KEY_UPLOAD_ranges).as_array())
+			received.emplace_back(range.at(0).as_number().to_uint64(), range.at(1).as_number().to_uint64());
+	}
+	else
+	{
+		headers[HTTP_HEADER_KEY_file_path] = file;
+		headers[HTTP_HEADER_KEY_file_size] = std::to_string(length);
+		headers[HTTP_HEADER_KEY_file_mode] = std::to_string(os::fileStat(local));
+		headers[HTTP_HEADER_KEY_file_user] = os::fileUser(local);
+		auto request = createRequest(methods::POST, "/appmesh/file/upload/session", query, &headers);
+		auto response = sendRequest(request, 65);
+		request.headers().match(HTTP_HEADER_JWT_Authorization, authorization);
+		if (response.status_code() != status_codes::OK)
+			throw std::invalid_argument(response.extract_utf8string(true).get());
+		auto json = response.extract_json(true).get();
+		uploadId = GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_id);
+	}
+
+	// 2. send chunks not received yet
+	std::vector<uint64_t> offsets;
+	for (uint64_t offset = 0; offset < length; offset += FILE_UPLOAD_CHUNK_BYTES)
+	{
+		const auto end = std::min<uint64_t>(offset + FILE_UPLOAD_CHUNK_BYTES, length);
+		const auto covered = std::any_of(received.begin(), received.end(), [&](const std::pair<uint64_t, uint64_t> &range) {
+			return range.first <= offset && range.second >= end;
+		});
+		if (!covered)
+			offsets.push_back(offset);
+	}
+	auto parallel = std::max(m_commandLineVariables["parallel"].as<int>(), 1);
+	uploadChunks(local, uploadId, length, offsets, std::min<std::size_t>(parallel, offsets.size()), authorization);
+
+	// 3. rename to remote file
+	auto response = requestHttp(false, methods::POST, "/appmesh/file/upload/session/" + uploadId + "/commit");
+	if (response.status_code() != status_codes::OK)
+	{
+		throw std::invalid_argument(Utility::stringFormat("%s, resume by --continue %s", response.extract_utf8string(true).get().c_str(), uploadId.c_str()));
+	}
+	std::cout << "Upload file <" << file << "> size <" << Utility::humanReadableSize(length) << ">" << std::endl;
+}
+
+void ArgumentParser::uploadChunks(const std::string &local, const std::string &uploadId, uint64_t length, const std::vector<uint64_t> &offsets, std::size_t parallel, const std::string &authorization)
+{
+	// each thread send chunks by its own connection, token is got by main thread
+	std::atomic<std::size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::string error;
+	std::mutex errorMutex;
+	const bool localSocket = useLocalSocket();
+	auto worker = [&]() {
+		try
+		{
+			auto client = createClient(localSocket);
+			std::ifstream input(local, std::ios::binary);
+			std::string chunk;
+			for (auto index = next++; index < offsets.size() && !failed; index = next++)
+			{
+				const auto offset = offsets[index];
+				chunk.resize(std::min<uint64_t>(FILE_UPLOAD_CHUNK_BYTES, length - offset));
+				if (!input.seekg(offset) || !input.read(&chunk[0], chunk.size()))
+					throw std::invalid_argument(Utility::stringFormat("Failed to read local file <%s>", local.c_str()));
+				const auto crc32 = Utility::stringFormat("%08x", Compression::crc32(chunk.data(), chunk.size()));
+				uri_builder builder(GET_STRING_T("/appmesh/file/upload/session/" + uploadId));
+				builder.append_query(U(HTTP_QUERY_KEY_offset), std::to_string(offset));
+				for (int retry = 0;; retry++)
+				{
+					http_request request(methods::PUT);
+					request.set_request_uri(builder.to_uri());
+					if (authorization.length())
+						request.headers().add(HTTP_HEADER_JWT_Authorization, authorization);
+					request.headers().add(HTTP_HEADER_KEY_chunk_crc32, crc32);
+					request.set_body(chunk, "application/octet-stream");
+					try
+					{
+						auto response = client->request(request, 65);
+						if (response.status_code() == status_codes::OK)
+							break;
+						// retry chunk corrupted on the way, other error will not change
+						if (response.status_code() != status_codes::BadRequest || retry >= DOWNLOAD_RESUME_RETRY)
+							throw std::invalid_argument(response.extract_utf8string(true).get());
+					}
+					catch (const std::runtime_error &)
+					{
+						if (retry >= DOWNLOAD_RESUME_RETRY)
+							throw;
+						client->close();
+					}
+				}
+			}
+		}
+		catch (const std::exception &e)
+		{
+			std::lock_guard<std::mutex> guard(errorMutex);
+			if (!failed.exchange(true))
+				error = e.what();
+		}
+	};
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < parallel; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto &thread : threads)
+		thread.join();
+	if (failed)
+	{
+		throw std::invalid_argument(Utility::stringFormat("%s, resume by --continue %s", error.c_str(), uploadId.c_str()));
+	}
+}
+
 void ArgumentParser::processTags()
 {
 	po::options_description desc("Manage labels:");
@@ -1166,19 +1381,14 @@ http_response ArgumentParser::requestHttp(bool throwAble, const method &mtd, con
 
 http_response ArgumentParser::requestHttp(bool throwAble, const method &mtd, const std::string &path, std::map<std::string, std::string> &query, web::json::value *body, std::map<std::string, std::string> *header)
 {
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	// Create http_client to send the request.
-	web::http::client::http_client_config config;
-	config.set_timeout(std::chrono::seconds(65));
-	config.set_validate_certificates(false);
-	web::http::client::http_client client(restURL, config);
 	http_request request = createRequest(mtd, path, query, header);
 	if (body != nullptr)
 	{
 		request.set_body(*body);
 	}
-	http_response response = client.request(request).get();
+	// large json and output reply is compressed by server, decoded by RestClient
+	request.headers().add(HTTP_HEADER_KEY_accept_encoding, Compression::supportedEncodings());
+	http_response response = sendRequest(request, 65);
 	if (throwAble && response.status_code() != status_codes::OK)
 	{
 		throw std::invalid_argument(response.extract_utf8string(true).get());
@@ -1202,12 +1412,67 @@ http_request ArgumentParser::createRequest(const method &mtd, const std::string
 			request.headers().add(h.first, h.second);
 		}
 	}
-	auto jwtToken = getAuthenToken();
-	request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + jwtToken);
+	// local socket peer is authorized by its OS user, token is only for specified or logged on user
+	if (!useLocalSocket() || m_username.length() || readAuthenToken().length())
+	{
+		auto jwtToken = getAuthenToken();
+		request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + jwtToken);
+	}
 	request.set_request_uri(builder.to_uri());
 	return request;
 }
 
+http_response ArgumentParser::sendRequest(http_request &request, int timeoutSeconds, const RestClient::BodyWriter &writer)
+{
+	// request from signal handler while other request in progress use a new connection
+	if (useLocalSocket())
+	{
+		if (!m_localClient)
+			m_localClient = createClient(true);
+		auto tempClient = m_localClient->busy() ? createClient(true) : nullptr;
+		auto &client = tempClient ? *tempClient : *m_localClient;
+		if (client.connect(timeoutSeconds))
+		{
+			const bool peerAuth = !request.headers().has(HTTP_HEADER_JWT_Authorization) && request.request_uri().path() != U("/appmesh/login");
+			auto response = client.request(request, timeoutSeconds, writer);
+			// peer user is not mapped by server, send again with stored or default token
+			auto body = request.body();
+			if (!peerAuth || response.status_code() != status_codes::Unauthorized || (body.is_valid() && !body.can_seek()))
+				return response;
+			if (body.is_valid())
+				body.seek(0);
+			request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + getAuthenToken());
+			return client.request(request, timeoutSeconds, writer);
+		}
+	}
+	// TCP need token when local socket is not connected
+	if (!request.headers().has(HTTP_HEADER_JWT_Authorization) && request.request_uri().path() != U("/appmesh/login"))
+	{
+		request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + getAuthenToken());
+	}
+	if (!m_tcpClient)
+		m_tcpClient = createClient(false);
+	auto tempClient = m_tcpClient->busy() ? createClient(false) : nullptr;
+	auto &client = tempClient ? *tempClient : *m_tcpClient;
+	return client.request(request, timeoutSeconds, writer);
+}
+
+bool ArgumentParser::useLocalSocket() const
+{
+	return m_socketPath.length() && (m_hostname == "localhost" || m_hostname == "127.0.0.1") && Utility::isFileExist(m_socketPath);
+}
+
+std::unique_ptr<RestClient> ArgumentParser::createClient(bool local) const
+{
+	if (local)
+	{
+		return std::unique_ptr<RestClient>(new RestClient(m_socketPath));
+	}
+	// TLS session is resumed by next command to the same server
+	auto sessionFile = Utility::stringFormat("%s%s_%d.session", m_tokenFilePrefix.c_str(), m_hostname.c_str(), m_listenPort);
+	return std::unique_ptr<RestClient>(new RestClient(m_hostname, m_listenPort, m_sslEnabled, sessionFile));
+}
+
 bool ArgumentParser::isAppExist(const std::string &appName)
 {
 	static auto apps = getAppList();
@@ -1312,11 +1577,6 @@ std::string ArgumentParser::readAuthenToken()
 
 std::string ArgumentParser::requestToken(const std::string &user, const std::string &passwd)
 {
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	http_client_config config;
-	config.set_validate_certificates(false);
-	http_client client(restURL, config);
 	http_request requestLogin(web::http::methods::POST);
 	uri_builder builder(GET_STRING_T("/appmesh/login"));
 	requestLogin.set_request_uri(builder.to_uri());
@@ -1324,7 +1584,7 @@ std::string ArgumentParser::requestToken(const std::string &user, const std::str
 	requestLogin.headers().add(HTTP_HEADER_JWT_password, Utility::encode64(passwd));
 	if (m_tokenTimeoutSeconds)
 		requestLogin.headers().add(HTTP_HEADER_JWT_expire_seconds, std::to_string(m_tokenTimeoutSeconds));
-	http_response response = client.request(requestLogin).get();
+	http_response response = sendRequest(requestLogin, 30);
 	if (response.status_code() != status_codes::OK)
 	{
 		throw std::invalid_argument(Utility::stringFormat("Login failed: %s", response.extract_utf8string(true).get().c_str()));
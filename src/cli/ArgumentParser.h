@@ -5,6 +5,7 @@
 #include <cpprest/json.h>
 #include <cpprest/http_client.h>
 #include <boost/program_options.hpp>
+#include "RestClient.h"
 
 using namespace web;				  // Common features like URIs.
 using namespace web::http;			  // Common HTTP functionality
@@ -20,7 +21,7 @@ class ACE_Sig_Action;
 class ArgumentParser
 {
 public:
-	explicit ArgumentParser(int argc, const char *argv[], int listenPort, bool sslEnabled);
+	explicit ArgumentParser(int argc, const char *argv[], int listenPort, bool sslEnabled, const std::string &socketPath);
 	virtual ~ArgumentParser() noexcept;
 
 	void parse();
@@ -39,6 +40,8 @@ private:
 	void processExec();
 	void processDownload();
 	void processUpload();
+	void processUploadChunks(const std::string &file, const std::string &local, uint64_t length);
+	void uploadChunks(const std::string &local, const std::string &uploadId, uint64_t length, const std::vector<uint64_t> &offsets, std::size_t parallel, const std::string &authorization);
 	void processTags();
 	void processLoglevel();
 	void processConfigView();
@@ -51,6 +54,12 @@ public:
 	http_response requestHttp(bool throwAble, const method &mtd, const std::string &path, web::json::value &body);
 	http_response requestHttp(bool throwAble, const method &mtd, const std::string &path, std::map<std::string, std::string> &query, web::json::value *body = nullptr, std::map<std::string, std::string> *header = nullptr);
 	http_request createRequest(const method &mtd, const std::string &path, std::map<std::string, std::string> &query, std::map<std::string, std::string> *header);
+	/// Send by local socket when available, otherwise by TCP
+	http_response sendRequest(http_request &request, int timeoutSeconds, const RestClient::BodyWriter &writer = RestClient::BodyWriter());
+
+private:
+	bool useLocalSocket() const;
+	std::unique_ptr<RestClient> createClient(bool local) const;
 
 private:
 	std::string getAuthenToken();
@@ -77,9 +86,14 @@ private:
 	const char **m_argv;
 	int m_listenPort;
 	bool m_sslEnabled;
+	// daemon Unix domain socket, used for local host when exist
+	std::string m_socketPath;
 	int m_tokenTimeoutSeconds;
 	std::string m_hostname;
 	std::string m_username;
 	std::string m_userpwd;
 	std::shared_ptr<ACE_Sig_Action> m_sigAction;
+	// connections kept for sequential requests of one command
+	std::unique_ptr<RestClient> m_localClient;
+	std::unique_ptr<RestClient> m_tcpClient;
 };
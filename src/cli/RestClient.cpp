@@ -0,0 +1,501 @@
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
+#include <cpprest/containerstream.h>
+#include <openssl/pem.h>
+
+#include "RestClient.h"
+#include "../common/Compression.h"
+#include "../common/Utility.h"
+
+// request body larger than this is streamed instead of buffered, streamed request is not retried
+#define MAX_BUFFERED_REQUEST_BODY (1024 * 1024)
+#define MAX_RESPONSE_HEADER_SIZE (64 * 1024)
+
+RestClient::RestClient(const std::string &host, int port, bool ssl, const std::string &sessionFile)
+	: m_host(host), m_port(port), m_sessionFile(sessionFile), m_timeout(std::chrono::seconds(30)), m_received(false), m_sessionSaved(false), m_busy(false)
+{
+	if (ssl)
+	{
+		// same as http_client_config::set_validate_certificates(false)
+		m_sslContext.reset(new boost::asio::ssl::context(boost::asio::ssl::context::sslv23_client));
+		m_sslContext->set_verify_mode(boost::asio::ssl::verify_none);
+	}
+}
+
+RestClient::RestClient(const std::string &socketPath)
+	: m_port(0), m_socketPath(socketPath), m_timeout(std::chrono::seconds(30)), m_received(false), m_sessionSaved(false), m_busy(false)
+{
+}
+
+RestClient::~RestClient()
+{
+	close();
+}
+
+bool RestClient::connect(int timeoutSeconds)
+{
+	if (isOpen())
+		return true;
+	try
+	{
+		m_timeout = std::chrono::seconds(timeoutSeconds);
+		open();
+		return true;
+	}
+	catch (const std::exception &)
+	{
+		close();
+	}
+	return false;
+}
+
+bool RestClient::busy() const
+{
+	return m_busy;
+}
+
+void RestClient::close()
+{
+	boost::system::error_code ec;
+	if (m_sslStream)
+		m_sslStream->lowest_layer().close(ec);
+	if (m_tcpSocket)
+		m_tcpSocket->close(ec);
+	if (m_localSocket)
+		m_localSocket->close(ec);
+	// complete canceled operations before release streams
+	m_io.restart();
+	m_io.run();
+	m_sslStream.reset();
+	m_tcpSocket.reset();
+	m_localSocket.reset();
+	m_buffer.clear();
+}
+
+bool RestClient::isOpen() const
+{
+	return m_sslStream || m_tcpSocket || m_localSocket;
+}
+
+std::string RestClient::url() const
+{
+	if (m_socketPath.length())
+		return "unix://" + m_socketPath;
+	return Utility::stringFormat("%s://%s:%d", m_sslContext ? "https" : "http", m_host.c_str(), m_port);
+}
+
+void RestClient::open()
+{
+	m_sessionSaved = false;
+	try
+	{
+		if (m_socketPath.length())
+		{
+			m_localSocket.reset(new boost::asio::local::stream_protocol::socket(m_io));
+			run([this](IoHandler handler) {
+				m_localSocket->async_connect(boost::asio::local::stream_protocol::endpoint(m_socketPath),
+											 [handler](const boost::system::error_code &ec) { handler(ec, 0); });
+			});
+			return;
+		}
+
+		boost::asio::ip::tcp::resolver resolver(m_io);
+		const auto endpoints = resolver.resolve(m_host, std::to_string(m_port));
+		boost::asio::ip::tcp::socket *socket = nullptr;
+		if (m_sslContext)
+		{
+			m_sslStream.reset(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(m_io, *m_sslContext));
+			socket = &m_sslStream->next_layer();
+		}
+		else
+		{
+			m_tcpSocket.reset(new boost::asio::ip::tcp::socket(m_io));
+			socket = m_tcpSocket.get();
+		}
+		run([socket, &endpoints](IoHandler handler) {
+			boost::asio::async_connect(*socket, endpoints,
+									   [handler](const boost::system::error_code &ec, const boost::asio::ip::tcp::endpoint &) { handler(ec, 0); });
+		});
+		socket->set_option(boost::asio::ip::tcp::no_delay(true));
+
+		if (m_sslStream)
+		{
+			boost::system::error_code ec;
+			boost::asio::ip::make_address(m_host, ec);
+			if (ec)
+			{
+				// SNI for host name
+				SSL_set_tlsext_host_name(m_sslStream->native_handle(), m_host.c_str());
+			}
+			loadSession();
+			run([this](IoHandler handler) {
+				m_sslStream->async_handshake(boost::asio::ssl::stream_base::client,
+											 [handler](const boost::system::error_code &ec) { handler(ec, 0); });
+			});
+		}
+	}
+	catch (const boost::system::system_error &e)
+	{
+		close();
+		throw std::runtime_error(Utility::stringFormat("Failed to connect to <%s>: %s", url().c_str(), e.code().message().c_str()));
+	}
+}
+
+void RestClient::wait(const bool &done)
+{
+	// timeout is for each I/O operation, long transfer with progress is not interrupted
+	const auto deadline = std::chrono::steady_clock::now() + m_timeout;
+	m_io.restart();
+	while (!done && m_io.run_one_until(deadline))
+	{
+	}
+	if (!done)
+	{
+		close();
+		throw std::runtime_error(Utility::stringFormat("Request to <%s> timeout", url().c_str()));
+	}
+}
+
+std::size_t RestClient::run(const std::function<void(IoHandler)> &operation)
+{
+	bool done = false;
+	boost::system::error_code ec;
+	std::size_t bytes = 0;
+	operation([&done, &ec, &bytes](const boost::system::error_code &error, std::size_t size) {
+		ec = error;
+		bytes = size;
+		done = true;
+	});
+	wait(done);
+	if (ec)
+		throw boost::system::system_error(ec);
+	return bytes;
+}
+
+void RestClient::write(const boost::asio::const_buffer &buffer)
+{
+	run([this, &buffer](IoHandler handler) {
+		if (m_sslStream)
+			boost::asio::async_write(*m_sslStream, buffer, handler);
+		else if (m_tcpSocket)
+			boost::asio::async_write(*m_tcpSocket, buffer, handler);
+		else
+			boost::asio::async_write(*m_localSocket, buffer, handler);
+	});
+}
+
+void RestClient::readSome()
+{
+	const auto size = run([this](IoHandler handler) {
+		auto buffer = boost::asio::buffer(m_readBuffer);
+		if (m_sslStream)
+			m_sslStream->async_read_some(buffer, handler);
+		else if (m_tcpSocket)
+			m_tcpSocket->async_read_some(buffer, handler);
+		else
+			m_localSocket->async_read_some(buffer, handler);
+	});
+	m_buffer.append(m_readBuffer.data(), size);
+	m_received = true;
+}
+
+std::size_t RestClient::readUntil(const char *delimiter, std::size_t pos)
+{
+	std::size_t found;
+	while ((found = m_buffer.find(delimiter, pos)) == std::string::npos)
+	{
+		if (m_buffer.length() > MAX_RESPONSE_HEADER_SIZE)
+		{
+			throw std::runtime_error(Utility::stringFormat("Invalid response from <%s>", url().c_str()));
+		}
+		readSome();
+	}
+	return found;
+}
+
+web::http::http_response RestClient::request(web::http::http_request &request, int timeoutSeconds, const BodyWriter &writer)
+{
+	m_busy = true;
+	std::shared_ptr<bool> busyGuard(&m_busy, [](bool *busy) { *busy = false; });
+	m_timeout = std::chrono::seconds(timeoutSeconds);
+
+	// small body is buffered so it can be sent again on new connection
+	auto body = request.body();
+	std::string bodyText;
+	const bool streamBody = body.is_valid() && request.headers().content_length() > MAX_BUFFERED_REQUEST_BODY;
+	if (body.is_valid() && !streamBody)
+	{
+		concurrency::streams::container_buffer<std::string> buffer;
+		body.read_to_end(buffer).wait();
+		bodyText = std::move(buffer.collection());
+		request.headers().set_content_length(bodyText.length());
+	}
+	std::string head = GET_STD_STRING(request.method()) + " " + GET_STD_STRING(request.request_uri().to_string()) + " HTTP/1.1\r\n";
+	head.append("Host: ").append(m_socketPath.length() ? "localhost" : m_host + ":" + std::to_string(m_port)).append("\r\n");
+	for (const auto &h : request.headers())
+	{
+		head.append(GET_STD_STRING(h.first)).append(": ").append(GET_STD_STRING(h.second)).append("\r\n");
+	}
+	head.append("\r\n");
+
+	for (int attempt = 0;; attempt++)
+	{
+		const bool reused = isOpen();
+		if (!reused)
+		{
+			open();
+		}
+		m_received = false;
+		try
+		{
+			write(boost::asio::buffer(head));
+			if (bodyText.length())
+			{
+				write(boost::asio::buffer(bodyText));
+			}
+			else if (streamBody)
+			{
+				// stream file body
+				std::vector<uint8_t> buffer(64 * 1024);
+				while (true)
+				{
+					auto size = body.streambuf().getn(buffer.data(), buffer.size()).get();
+					if (size == 0)
+						break;
+					write(boost::asio::buffer(buffer.data(), size));
+				}
+			}
+			return receive(request.method() == web::http::methods::HEAD, writer);
+		}
+		catch (const boost::system::system_error &e)
+		{
+			close();
+			// connection closed by server keep-alive timeout before this request
+			if (!reused || attempt > 0 || m_received || streamBody)
+			{
+				throw std::runtime_error(Utility::stringFormat("Failed to request <%s>: %s", url().c_str(), e.code().message().c_str()));
+			}
+		}
+		catch (...)
+		{
+			// connection state is unknown after invalid response
+			close();
+			throw;
+		}
+	}
+}
+
+web::http::http_response RestClient::receive(bool headRequest, const BodyWriter &writer)
+{
+	// status line and headers, interim 1xx response is skipped
+	std::size_t headEnd = 0;
+	int status = 0;
+	while (true)
+	{
+		headEnd = readUntil("\r\n\r\n", 0);
+		// HTTP/1.1 200 OK
+		if (headEnd < 12 || m_buffer.compare(0, 7, "HTTP/1.") != 0)
+		{
+			throw std::runtime_error(Utility::stringFormat("Invalid response from <%s>", url().c_str()));
+		}
+		status = std::atoi(m_buffer.substr(9, 3).c_str());
+		if (status >= 200 || status < 100)
+			break;
+		m_buffer.erase(0, headEnd + 4);
+	}
+	const auto head = m_buffer.substr(0, headEnd);
+	m_buffer.erase(0, headEnd + 4);
+
+	std::vector<std::pair<std::string, std::string>> headers;
+	bool keepAlive = head.compare(0, 8, "HTTP/1.1") == 0;
+	bool chunked = false;
+	long long contentLength = -1;
+	auto lineEnd = head.find("\r\n");
+	const auto reason = head.length() > 13 ? head.substr(13, lineEnd == std::string::npos ? std::string::npos : lineEnd - 13) : std::string();
+	while (lineEnd != std::string::npos)
+	{
+		const auto lineStart = lineEnd + 2;
+		lineEnd = head.find("\r\n", lineStart);
+		const auto line = head.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+		const auto colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+		const auto name = line.substr(0, colon);
+		const auto value = Utility::stdStringTrim(line.substr(colon + 1));
+		if (boost::iequals(name, web::http::header_names::content_length))
+			contentLength = std::atoll(value.c_str());
+		else if (boost::iequals(name, web::http::header_names::transfer_encoding))
+			chunked = boost::icontains(value, "chunked");
+		else if (boost::iequals(name, web::http::header_names::connection))
+			keepAlive = boost::iequals(value, "keep-alive") || (keepAlive && !boost::iequals(value, "close"));
+		headers.emplace_back(name, value);
+	}
+
+	web::http::http_response response(status);
+	if (reason.length())
+	{
+		response.set_reason_phrase(reason);
+	}
+	for (const auto &header : headers)
+	{
+		if (!boost::iequals(header.first, web::http::header_names::transfer_encoding))
+			response.headers().add(header.first, header.second);
+	}
+	// large body is passed to writer as received, error body is always kept in response
+	std::string body;
+	const bool toWriter = writer && status >= 200 && status < 300;
+	const auto consume = [&](const char *data, std::size_t size) {
+		if (size == 0)
+			return;
+		if (toWriter)
+			writer(response, data, size);
+		else
+			body.append(data, size);
+	};
+
+	if (headRequest || status == web::http::status_codes::NoContent || status == web::http::status_codes::NotModified)
+	{
+	}
+	else if (chunked)
+	{
+		std::size_t pos = 0;
+		while (true)
+		{
+			auto sizeEnd = readUntil("\r\n", pos);
+			const auto size = std::stoul(m_buffer.substr(pos, sizeEnd - pos), nullptr, 16);
+			pos = sizeEnd + 2;
+			if (size == 0)
+			{
+				// trailer lines end with empty line
+				while ((sizeEnd = readUntil("\r\n", pos)) != pos)
+					pos = sizeEnd + 2;
+				m_buffer.erase(0, pos + 2);
+				break;
+			}
+			while (m_buffer.length() < pos + size + 2)
+				readSome();
+			consume(m_buffer.data() + pos, size);
+			m_buffer.erase(0, pos + size + 2);
+			pos = 0;
+		}
+	}
+	else if (contentLength >= 0)
+	{
+		auto remain = (std::size_t)contentLength;
+		while (remain > 0)
+		{
+			if (m_buffer.empty())
+				readSome();
+			const auto size = std::min(remain, m_buffer.length());
+			consume(m_buffer.data(), size);
+			m_buffer.erase(0, size);
+			remain -= size;
+		}
+	}
+	else
+	{
+		// body is delimited by connection close
+		try
+		{
+			while (true)
+			{
+				consume(m_buffer.data(), m_buffer.length());
+				m_buffer.clear();
+				readSome();
+			}
+		}
+		catch (const boost::system::system_error &e)
+		{
+			if (e.code() != boost::asio::error::eof && e.code() != boost::asio::ssl::error::stream_truncated)
+				throw;
+		}
+		keepAlive = false;
+	}
+
+	// new session ticket is received after handshake, save when first response is read
+	if (m_sslStream && !m_sessionSaved)
+	{
+		saveSession();
+	}
+	if (!keepAlive)
+	{
+		close();
+	}
+
+	std::string contentEncoding;
+	const bool decode = !toWriter && response.headers().match(HTTP_HEADER_KEY_content_encoding, contentEncoding) && !boost::iequals(contentEncoding, "identity");
+	if (decode)
+	{
+		body = Compression::decompress(body, contentEncoding);
+	}
+	const auto bodyLength = body.length();
+	if (!toWriter)
+	{
+		response.set_body(std::move(body));
+		// set_body() add Content-Type, replace by response headers
+		response.headers().clear();
+		for (const auto &header : headers)
+		{
+			// decoded body length is set by set_body()
+			if (decode && (boost::iequals(header.first, HTTP_HEADER_KEY_content_encoding) || boost::iequals(header.first, web::http::header_names::content_length)))
+				continue;
+			if (!boost::iequals(header.first, web::http::header_names::transfer_encoding))
+				response.headers().add(header.first, header.second);
+		}
+		if (decode)
+			response.headers().set_content_length(bodyLength);
+	}
+	// extract_json() and extract_string() wait for body complete
+	response._get_impl()->_complete(bodyLength);
+	return response;
+}
+
+void RestClient::loadSession()
+{
+	if (m_sessionFile.empty())
+		return;
+	auto bio = BIO_new_file(m_sessionFile.c_str(), "r");
+	if (bio == nullptr)
+		return;
+	auto session = PEM_read_bio_SSL_SESSION(bio, nullptr, nullptr, nullptr);
+	BIO_free(bio);
+	if (session)
+	{
+		// expired or rejected session fall back to full handshake
+		SSL_set_session(m_sslStream->native_handle(), session);
+		SSL_SESSION_free(session);
+	}
+}
+
+void RestClient::saveSession()
+{
+	m_sessionSaved = true;
+	if (m_sessionFile.empty())
+		return;
+	auto session = SSL_get1_session(m_sslStream->native_handle());
+	if (session == nullptr)
+		return;
+	if (SSL_SESSION_is_resumable(session))
+	{
+		// session contains master secret, mkstemp() create unique file only readable by current user,
+		// parallel clients of one process do not write the same file
+		std::string tmpFile = m_sessionFile + ".XXXXXX";
+		const int fd = ::mkstemp(&tmpFile[0]);
+		auto fp = fd >= 0 ? ::fdopen(fd, "w") : nullptr;
+		if (fp)
+		{
+			const bool written = PEM_write_SSL_SESSION(fp, session);
+			::fclose(fp);
+			if (!written || ::rename(tmpFile.c_str(), m_sessionFile.c_str()) != 0)
+				::unlink(tmpFile.c_str());
+		}
+		else if (fd >= 0)
+		{
+			::close(fd);
+			::unlink(tmpFile.c_str());
+		}
+	}
+	SSL_SESSION_free(session);
+}
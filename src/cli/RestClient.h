@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <cpprest/http_msg.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// HTTP/1.1 client keep one connection for sequential requests, TLS
+/// session is saved to session file and resumed by next process
+//////////////////////////////////////////////////////////////////////////
+class RestClient
+{
+public:
+	/// Receive body of 2xx response instead of response body, response has status and headers only
+	typedef std::function<void(const web::http::http_response &response, const char *data, std::size_t size)> BodyWriter;
+
+	/// TCP connection, TLS session is not saved when sessionFile is empty
+	RestClient(const std::string &host, int port, bool ssl, const std::string &sessionFile);
+	/// Unix domain socket connection
+	explicit RestClient(const std::string &socketPath);
+	virtual ~RestClient();
+
+	/// Connect when not connected, return false when failed
+	bool connect(int timeoutSeconds);
+	/// Send request and read response, connection is kept for next request
+	/// unless server close it, stale connection is re-connected once.
+	/// Timeout is for each connect, read and write operation
+	web::http::http_response request(web::http::http_request &request, int timeoutSeconds, const BodyWriter &writer = BodyWriter());
+	/// Request is in progress, used to avoid re-entry from signal handler
+	bool busy() const;
+	void close();
+
+private:
+	typedef std::function<void(const boost::system::error_code &, std::size_t)> IoHandler;
+
+	bool isOpen() const;
+	std::string url() const;
+	void open();
+	/// Run io_context until operation done, close connection and throw when timeout
+	void wait(const bool &done);
+	std::size_t run(const std::function<void(IoHandler)> &operation);
+	void write(const boost::asio::const_buffer &buffer);
+	/// Append received data to m_buffer
+	void readSome();
+	/// Read until data contains delimiter from pos, return position of delimiter
+	std::size_t readUntil(const char *delimiter, std::size_t pos);
+	web::http::http_response receive(bool headRequest, const BodyWriter &writer);
+	void loadSession();
+	void saveSession();
+
+	const std::string m_host;
+	const int m_port;
+	const std::string m_socketPath;
+	const std::string m_sessionFile;
+	std::chrono::seconds m_timeout;
+	boost::asio::io_context m_io;
+	std::unique_ptr<boost::asio::ssl::context> m_sslContext;
+	std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> m_sslStream;
+	std::unique_ptr<boost::asio::ip::tcp::socket> m_tcpSocket;
+	std::unique_ptr<boost::asio::local::stream_protocol::socket> m_localSocket;
+	std::array<char, 16 * 1024> m_readBuffer;
+	// received but not consumed data
+	std::string m_buffer;
+	bool m_received;
+	bool m_sessionSaved;
+	bool m_busy;
+};
@@ -11,7 +11,7 @@
 #include "../common/Utility.h"
 
 namespace po = boost::program_options;
-void getListenPort(int &port, bool &sslEnabled);
+void getListenPort(int &port, bool &sslEnabled, std::string &socketPath);
 
 int main(int argc, const char *argv[])
 {
@@ -20,9 +20,10 @@ int main(int argc, const char *argv[])
 	{
 		int port = DEFAULT_REST_LISTEN_PORT;
 		bool ssl = false;
+		std::string socketPath;
 		crossplat::threadpool::initialize_with_threads(1);
-		getListenPort(port, ssl);
-		ArgumentParser parser(argc, argv, port, ssl);
+		getListenPort(port, ssl, socketPath);
+		ArgumentParser parser(argc, argv, port, ssl, socketPath);
 		parser.parse();
 	}
 	catch (const std::exception &e)
@@ -33,7 +34,7 @@ int main(int argc, const char *argv[])
 	return 0;
 }
 
-void getListenPort(int &port, bool &sslEnabled)
+void getListenPort(int &port, bool &sslEnabled, std::string &socketPath)
 {
 	// Get listen port
 	web::json::value jsonValue;
@@ -63,6 +64,7 @@ void getListenPort(int &port, bool &sslEnabled)
 			{
 				sslEnabled = GET_JSON_BOOL_VALUE(rest.at(JSON_KEY_SSL), JSON_KEY_SSLEnabled);
 			}
+			socketPath = GET_JSON_STR_VALUE(rest, JSON_KEY_RestListenSocket);
 		}
 	}
 }
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include "AsyncLogAppender.h"
+#include "Utility.h"
+
+std::atomic<uint64_t> AsyncLogAppender::m_dropped(0);
+std::atomic<uint64_t> AsyncLogAppender::m_generations(0);
+
+LogRing::LogRing(std::size_t capacity)
+	: m_closed(false), m_slots(capacity), m_head(0), m_tail(0)
+{
+}
+
+LogRing::~LogRing()
+{
+	drain([](log4cpp::LoggingEvent &) {});
+}
+
+bool LogRing::push(const log4cpp::LoggingEvent &event)
+{
+	const auto tail = m_tail.load(std::memory_order_relaxed);
+	if (tail - m_head.load(std::memory_order_acquire) >= m_slots.size())
+		return false;
+	new (&m_slots[tail % m_slots.size()]) log4cpp::LoggingEvent(event);
+	m_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+template <typename Consumer>
+std::size_t LogRing::drain(Consumer consumer)
+{
+	auto head = m_head.load(std::memory_order_relaxed);
+	const auto tail = m_tail.load(std::memory_order_acquire);
+	const auto count = tail - head;
+	for (; head != tail; ++head)
+	{
+		auto event = reinterpret_cast<log4cpp::LoggingEvent *>(&m_slots[head % m_slots.size()]);
+		consumer(*event);
+		event->~LoggingEvent();
+		// release slot one by one, producer can continue when consumer is writing
+		m_head.store(head + 1, std::memory_order_release);
+	}
+	return count;
+}
+
+bool LogRing::empty() const
+{
+	return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string &name, std::size_t ringCapacity, log4cpp::Priority::Value blockPriority)
+	: log4cpp::AppenderSkeleton(name), m_generation(++m_generations), m_ringCapacity(ringCapacity), m_blockPriority(blockPriority),
+	  m_ringsChanged(false), m_running(true), m_sleeping(false), m_flushRequest(0), m_flushDone(0), m_droppedReported(0)
+{
+	m_thread = std::make_unique<std::thread>(&AsyncLogAppender::run, this);
+}
+
+AsyncLogAppender::~AsyncLogAppender()
+{
+	close();
+}
+
+void AsyncLogAppender::addAppender(log4cpp::Appender *appender)
+{
+	std::lock_guard<std::mutex> guard(m_appendersMutex);
+	m_appenders.push_back(std::unique_ptr<log4cpp::Appender>(appender));
+}
+
+bool AsyncLogAppender::setAppenderLayout(const std::string &appenderName, log4cpp::Layout *layout)
+{
+	// layout is used by consumer thread when writing
+	std::lock_guard<std::mutex> guard(m_appendersMutex);
+	for (auto &appender : m_appenders)
+	{
+		if (appender->getName() == appenderName)
+		{
+			appender->setLayout(layout);
+			return true;
+		}
+	}
+	delete layout;
+	return false;
+}
+
+void AsyncLogAppender::flush()
+{
+	std::unique_lock<std::mutex> lock(m_wakeMutex);
+	const auto request = ++m_flushRequest;
+	m_wakeCondition.notify_one();
+	m_flushCondition.wait(lock, [this, request] { return m_flushDone >= request || !m_thread; });
+}
+
+void AsyncLogAppender::close()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_wakeMutex);
+		if (!m_thread)
+			return;
+		m_running = false;
+		m_wakeCondition.notify_one();
+	}
+	m_thread->join();
+	{
+		std::lock_guard<std::mutex> guard(m_wakeMutex);
+		m_thread = nullptr;
+		m_flushCondition.notify_all();
+	}
+	std::lock_guard<std::mutex> guard(m_appendersMutex);
+	for (auto &appender : m_appenders)
+	{
+		appender->close();
+	}
+}
+
+bool AsyncLogAppender::reopen()
+{
+	flush();
+	std::lock_guard<std::mutex> guard(m_appendersMutex);
+	bool result = true;
+	for (auto &appender : m_appenders)
+	{
+		result = appender->reopen() && result;
+	}
+	return result;
+}
+
+bool AsyncLogAppender::requiresLayout() const
+{
+	// downstream appenders format event
+	return false;
+}
+
+void AsyncLogAppender::setLayout(log4cpp::Layout *layout)
+{
+}
+
+uint64_t AsyncLogAppender::droppedLines()
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+void AsyncLogAppender::_append(const log4cpp::LoggingEvent &event)
+{
+	auto ring = threadRing();
+	if (ring->push(event))
+	{
+		if (m_sleeping.load(std::memory_order_relaxed))
+		{
+			// consumer is idle, lock is not taken when consumer is busy
+			std::lock_guard<std::mutex> guard(m_wakeMutex);
+			m_wakeCondition.notify_one();
+		}
+		return;
+	}
+	if (event.priority > m_blockPriority)
+	{
+		// less severe event is dropped instead of blocking caller
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// backpressure: wait for consumer to release slot
+	while (m_running.load(std::memory_order_relaxed) && !ring->push(event))
+	{
+		m_wakeCondition.notify_one();
+		std::this_thread::yield();
+	}
+}
+
+std::shared_ptr<LogRing> AsyncLogAppender::threadRing()
+{
+	// ring is owned by appender and logging thread, released by consumer after thread exit and ring drained
+	struct ThreadRing
+	{
+		// generation of owner appender, 0 for none
+		uint64_t m_owner = 0;
+		std::shared_ptr<LogRing> m_ring;
+		~ThreadRing()
+		{
+			if (m_ring)
+				m_ring->m_closed = true;
+		}
+	};
+	static thread_local ThreadRing local;
+	if (local.m_owner != m_generation || local.m_ring == nullptr)
+	{
+		if (local.m_ring)
+			local.m_ring->m_closed = true;
+		local.m_ring = std::make_shared<LogRing>(m_ringCapacity);
+		local.m_owner = m_generation;
+		std::lock_guard<std::mutex> guard(m_ringsMutex);
+		m_rings.push_back(local.m_ring);
+		m_ringsChanged = true;
+	}
+	return local.m_ring;
+}
+
+void AsyncLogAppender::run()
+{
+	while (true)
+	{
+		const auto request = m_flushRequest.load();
+		const bool running = m_running.load();
+		const auto count = drainRings();
+
+		// report dropped events from consumer thread directly to downstream appenders
+		const auto dropped = m_dropped.load(std::memory_order_relaxed);
+		if (dropped != m_droppedReported)
+		{
+			write(log4cpp::LoggingEvent("", std::to_string(dropped - m_droppedReported) + " log lines dropped, log ring is full", "", log4cpp::Priority::WARN));
+			m_droppedReported = dropped;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		if (request != m_flushDone)
+		{
+			m_flushDone = request;
+			m_flushCondition.notify_all();
+		}
+		// all events queued before stop are written
+		if (!running)
+			break;
+		if (count == 0 && m_running && m_flushRequest == m_flushDone)
+		{
+			// woken by producer, flush or stop; a wakeup missed by producer is bounded by idle timeout
+			m_sleeping = true;
+			m_wakeCondition.wait_for(lock, std::chrono::milliseconds(LOG_CONSUMER_IDLE_MILLISECONDS));
+			m_sleeping = false;
+		}
+	}
+}
+
+std::size_t AsyncLogAppender::drainRings()
+{
+	if (m_ringsChanged.exchange(false))
+	{
+		std::lock_guard<std::mutex> guard(m_ringsMutex);
+		m_consumerRings = m_rings;
+	}
+	std::size_t count = 0;
+	bool closed = false;
+	for (const auto &ring : m_consumerRings)
+	{
+		count += ring->drain([this](const log4cpp::LoggingEvent &event) { write(event); });
+		closed = closed || (ring->m_closed && ring->empty());
+	}
+	if (closed)
+	{
+		// release rings of exited threads
+		std::lock_guard<std::mutex> guard(m_ringsMutex);
+		m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<LogRing> &ring) { return ring->m_closed && ring->empty(); }), m_rings.end());
+		m_consumerRings = m_rings;
+	}
+	return count;
+}
+
+void AsyncLogAppender::write(const log4cpp::LoggingEvent &event)
+{
+	std::lock_guard<std::mutex> guard(m_appendersMutex);
+	for (auto &appender : m_appenders)
+	{
+		appender->doAppend(event);
+	}
+}
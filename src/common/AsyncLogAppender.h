@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <log4cpp/AppenderSkeleton.hh>
+#include <log4cpp/LoggingEvent.hh>
+
+//////////////////////////////////////////////////////////////////////////
+/// Single producer single consumer ring of logging events, one for each
+/// logging thread, producer and consumer only touch atomic indexes
+//////////////////////////////////////////////////////////////////////////
+class LogRing
+{
+public:
+	explicit LogRing(std::size_t capacity);
+	virtual ~LogRing();
+
+	/// Copy event into ring, return false when ring is full
+	bool push(const log4cpp::LoggingEvent &event);
+	/// Move out all events currently in ring, return event count
+	template <typename Consumer>
+	std::size_t drain(Consumer consumer);
+	bool empty() const;
+
+	// set when owner thread exit, ring is released after drained
+	std::atomic<bool> m_closed;
+
+private:
+	typedef std::aligned_storage<sizeof(log4cpp::LoggingEvent), alignof(log4cpp::LoggingEvent)>::type Slot;
+	std::vector<Slot> m_slots;
+	// keep producer and consumer index in different cache line
+	alignas(64) std::atomic<std::size_t> m_head;
+	alignas(64) std::atomic<std::size_t> m_tail;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Appender queue events to per-thread ring and write them to downstream
+/// appenders (format & IO) in background thread.
+/// Full ring drop events less severe than block priority, others wait.
+//////////////////////////////////////////////////////////////////////////
+class AsyncLogAppender : public log4cpp::AppenderSkeleton
+{
+public:
+	AsyncLogAppender(const std::string &name, std::size_t ringCapacity, log4cpp::Priority::Value blockPriority);
+	virtual ~AsyncLogAppender();
+
+	/// Take ownership of downstream appender, should be called before logging
+	void addAppender(log4cpp::Appender *appender);
+	/// Replace layout of downstream appender, return false when not found
+	bool setAppenderLayout(const std::string &appenderName, log4cpp::Layout *layout);
+	/// Wait until events queued before this call are written
+	void flush();
+	virtual void close() override;
+	virtual bool reopen() override;
+	virtual bool requiresLayout() const override;
+	virtual void setLayout(log4cpp::Layout *layout) override;
+
+	/// Number of events dropped since process start
+	static uint64_t droppedLines();
+
+protected:
+	virtual void _append(const log4cpp::LoggingEvent &event) override;
+
+private:
+	std::shared_ptr<LogRing> threadRing();
+	void run();
+	std::size_t drainRings();
+	void write(const log4cpp::LoggingEvent &event);
+
+	// identify appender in thread local ring cache, address of a deleted appender may be reused
+	const uint64_t m_generation;
+	const std::size_t m_ringCapacity;
+	const log4cpp::Priority::Value m_blockPriority;
+	std::vector<std::unique_ptr<log4cpp::Appender>> m_appenders;
+	std::mutex m_appendersMutex;
+
+	// rings registered by logging threads, mutex only used when thread register and consumer refresh
+	std::vector<std::shared_ptr<LogRing>> m_rings;
+	std::mutex m_ringsMutex;
+	std::atomic<bool> m_ringsChanged;
+	// consumer thread copy of m_rings
+	std::vector<std::shared_ptr<LogRing>> m_consumerRings;
+
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_sleeping;
+	std::atomic<uint64_t> m_flushRequest;
+	uint64_t m_flushDone;
+	uint64_t m_droppedReported;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_flushCondition;
+	std::unique_ptr<std::thread> m_thread;
+
+	static std::atomic<uint64_t> m_dropped;
+	static std::atomic<uint64_t> m_generations;
+};
+
+#define DEFAULT_LOG_RING_CAPACITY 1024
+#define LOG_CONSUMER_IDLE_MILLISECONDS 100
+#define LOG_APPENDER_NAME_async "async"
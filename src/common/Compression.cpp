@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <zlib.h>
+#ifdef APPMESH_WITH_ZSTD
+#include <zstd.h>
+#endif
+#include <boost/algorithm/string.hpp>
+#include "Compression.h"
+#include "Utility.h"
+
+#define ENCODING_GZIP "gzip"
+#define ENCODING_ZSTD "zstd"
+// fast level for compress on reply, ratio of text body is close to higher levels
+#define ZSTD_REPLY_LEVEL 3
+
+std::string Compression::gzip(const std::string &data, int level)
+{
+	z_stream stream{};
+	// 15 window bits + 16 for gzip header and trailer
+	if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw std::runtime_error("failed to init gzip stream");
+	}
+	std::string result;
+	result.resize(deflateBound(&stream, data.size()));
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	stream.avail_in = static_cast<uInt>(data.size());
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = static_cast<uInt>(result.size());
+	auto ret = deflate(&stream, Z_FINISH);
+	result.resize(stream.total_out);
+	deflateEnd(&stream);
+	if (ret != Z_STREAM_END)
+	{
+		throw std::runtime_error(Utility::stringFormat("gzip failed with error <%d>", ret));
+	}
+	return result;
+}
+
+std::string Compression::gunzip(const std::string &data)
+{
+	z_stream stream{};
+	if (inflateInit2(&stream, 15 + 16) != Z_OK)
+	{
+		throw std::runtime_error("failed to init gunzip stream");
+	}
+	std::string result;
+	char buffer[64 * 1024];
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	stream.avail_in = static_cast<uInt>(data.size());
+	int ret = Z_OK;
+	while (ret == Z_OK)
+	{
+		stream.next_out = reinterpret_cast<Bytef *>(buffer);
+		stream.avail_out = sizeof(buffer);
+		ret = inflate(&stream, Z_NO_FLUSH);
+		result.append(buffer, sizeof(buffer) - stream.avail_out);
+	}
+	inflateEnd(&stream);
+	if (ret != Z_STREAM_END)
+	{
+		throw std::runtime_error(Utility::stringFormat("gunzip failed with error <%d>", ret));
+	}
+	return result;
+}
+
+std::string Compression::compress(const std::string &data, const std::string &encoding)
+{
+	if (encoding == ENCODING_GZIP)
+	{
+		return gzip(data);
+	}
+#ifdef APPMESH_WITH_ZSTD
+	if (encoding == ENCODING_ZSTD)
+	{
+		std::string result;
+		result.resize(ZSTD_compressBound(data.size()));
+		const auto size = ZSTD_compress(&result[0], result.size(), data.data(), data.size(), ZSTD_REPLY_LEVEL);
+		if (ZSTD_isError(size))
+		{
+			throw std::runtime_error(Utility::stringFormat("zstd failed with error <%s>", ZSTD_getErrorName(size)));
+		}
+		result.resize(size);
+		return result;
+	}
+#endif
+	throw std::invalid_argument(Utility::stringFormat("encoding <%s> not supported", encoding.c_str()));
+}
+
+std::string Compression::decompress(const std::string &data, const std::string &encoding)
+{
+	if (boost::iequals(encoding, ENCODING_GZIP))
+	{
+		return gunzip(data);
+	}
+#ifdef APPMESH_WITH_ZSTD
+	if (boost::iequals(encoding, ENCODING_ZSTD))
+	{
+		// frame content size is optional, decompress by stream
+		std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream(ZSTD_createDStream(), &ZSTD_freeDStream);
+		if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream.get())))
+		{
+			throw std::runtime_error("failed to init zstd stream");
+		}
+		std::string result;
+		std::string buffer(ZSTD_DStreamOutSize(), '\0');
+		ZSTD_inBuffer input = {data.data(), data.size(), 0};
+		std::size_t ret = 0;
+		while (true)
+		{
+			ZSTD_outBuffer output = {&buffer[0], buffer.size(), 0};
+			ret = ZSTD_decompressStream(stream.get(), &output, &input);
+			if (ZSTD_isError(ret))
+			{
+				throw std::runtime_error(Utility::stringFormat("zstd decompress failed with error <%s>", ZSTD_getErrorName(ret)));
+			}
+			result.append(buffer.data(), output.pos);
+			// full output buffer may have more data to flush
+			if (input.pos == input.size && output.pos < output.size)
+				break;
+		}
+		// not 0 means frame is not complete
+		if (ret != 0)
+		{
+			throw std::runtime_error("zstd data is truncated");
+		}
+		return result;
+	}
+#endif
+	throw std::invalid_argument(Utility::stringFormat("encoding <%s> not supported", encoding.c_str()));
+}
+
+bool Compression::acceptEncoding(const std::string &acceptEncodingHeader, const std::string &encoding)
+{
+	// Accept-Encoding: gzip;q=1.0, identity; q=0.5, *;q=0
+	for (const auto &item : Utility::splitString(acceptEncodingHeader, ","))
+	{
+		auto parameters = Utility::splitString(item, ";");
+		if (parameters.empty() || !boost::iequals(Utility::stdStringTrim(parameters[0]), encoding))
+			continue;
+		for (std::size_t i = 1; i < parameters.size(); i++)
+		{
+			auto quality = Utility::stdStringTrim(parameters[i]);
+			if (Utility::startWith(quality, "q=") && std::atof(quality.substr(2).c_str()) <= 0)
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+std::string Compression::negotiate(const std::string &acceptEncodingHeader)
+{
+#ifdef APPMESH_WITH_ZSTD
+	if (acceptEncoding(acceptEncodingHeader, ENCODING_ZSTD))
+	{
+		return ENCODING_ZSTD;
+	}
+#endif
+	if (acceptEncoding(acceptEncodingHeader, ENCODING_GZIP))
+	{
+		return ENCODING_GZIP;
+	}
+	return std::string();
+}
+
+std::string Compression::supportedEncodings()
+{
+#ifdef APPMESH_WITH_ZSTD
+	return ENCODING_ZSTD ", " ENCODING_GZIP;
+#else
+	return ENCODING_GZIP;
+#endif
+}
+
+uint32_t Compression::crc32(const char *data, std::size_t size, uint32_t crc)
+{
+	// zlib crc32() length is uInt, large buffer is calculated by blocks
+	const std::size_t block = 1024 * 1024 * 1024;
+	while (size > 0)
+	{
+		const auto length = std::min(size, block);
+		crc = static_cast<uint32_t>(::crc32(crc, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(length)));
+		data += length;
+		size -= length;
+	}
+	return crc;
+}
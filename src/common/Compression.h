@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+/// HTTP body compression and checksum helpers
+//////////////////////////////////////////////////////////////////////////
+class Compression
+{
+public:
+	/// gzip format (RFC 1952) for Content-Encoding: gzip
+	static std::string gzip(const std::string &data, int level = -1) noexcept(false);
+	static std::string gunzip(const std::string &data) noexcept(false);
+	/// Compress or decompress by Content-Encoding name, gzip or zstd
+	static std::string compress(const std::string &data, const std::string &encoding) noexcept(false);
+	static std::string decompress(const std::string &data, const std::string &encoding) noexcept(false);
+	/// Whether Accept-Encoding header value accept the encoding (q=0 means not acceptable)
+	static bool acceptEncoding(const std::string &acceptEncodingHeader, const std::string &encoding);
+	/// Supported encoding accepted by client, zstd is preferred, empty for identity
+	static std::string negotiate(const std::string &acceptEncodingHeader);
+	/// Accept-Encoding header value of supported encodings
+	static std::string supportedEncodings();
+	/// CRC-32 (same as gzip trailer), crc is the value of previous data for incremental update
+	static uint32_t crc32(const char *data, std::size_t size, uint32_t crc = 0);
+};
@@ -1,8 +1,23 @@
+#include <atomic>
+#include <mutex>
+#include <boost/algorithm/string.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <cpprest/containerstream.h>
+#include "Compression.h"
 #include "HttpRequest.h"
+#include "Utility.h"
 #include "../daemon/application/Application.h"
 
+namespace
+{
+	std::atomic<std::size_t> compressMinBytes(0);
+	// reply body is compressed here instead of handler and I/O threads
+	std::unique_ptr<boost::asio::thread_pool> compressPool;
+} // namespace
+
 HttpRequest::HttpRequest(const web::http::http_request& message)
-	:http_request(message)
+	:http_request(message), m_replyStatus(0), m_sendFileSupported(false)
 {
 }
 
@@ -15,7 +30,83 @@ pplx::task<void> HttpRequest::reply(http_response& response) const
 	response.headers().add("Access-Control-Allow-Origin", "*");
 	response.headers().add("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
 	response.headers().add("Access-Control-Allow-Headers", "*");
-	return http_request::reply(response);
+	m_replyStatus = response.status_code();
+
+	const auto encoding = replyEncoding(response);
+	if (encoding.empty())
+	{
+		return http_request::reply(response);
+	}
+	pplx::task_completion_event<void> replied;
+	http_request request = *this;
+	auto compress = [request, response, encoding, replied]() mutable {
+		const static char fname[] = "HttpRequest::reply() ";
+		try
+		{
+			concurrency::streams::container_buffer<std::string> buffer;
+			response.body().read_to_end(buffer).get();
+			try
+			{
+				// set_body() keep Content-Type and update Content-Length
+				response.set_body(Compression::compress(buffer.collection(), encoding), response.headers().content_type());
+				response.headers().add(HTTP_HEADER_KEY_content_encoding, encoding);
+			}
+			catch (const std::exception& e)
+			{
+				LOG_WAR << fname << "reply without compression: " << e.what();
+				response.set_body(std::move(buffer.collection()), response.headers().content_type());
+			}
+			request.reply(response).then([replied](pplx::task<void> t) {
+				try
+				{
+					t.get();
+				}
+				catch (const std::exception& e)
+				{
+					LOG_WAR << fname << "reply failed: " << e.what();
+				}
+				replied.set();
+			});
+		}
+		catch (const std::exception& e)
+		{
+			// returned task is not always observed, error is logged instead of set to task
+			LOG_WAR << fname << "reply failed: " << e.what();
+			replied.set();
+		}
+	};
+	if (compressPool)
+		boost::asio::post(*compressPool, compress);
+	else
+		compress();
+	return pplx::create_task(replied);
+}
+
+std::string HttpRequest::replyEncoding(http_response& response) const
+{
+	const auto minBytes = compressMinBytes.load();
+	auto& headers = response.headers();
+	if (minBytes == 0 || method() == methods::HEAD || headers.has(HTTP_HEADER_KEY_content_encoding) ||
+		headers.content_length() < minBytes || !response.body().is_valid())
+	{
+		return std::string();
+	}
+	// text and json only, file and binary body are not compressed
+	const auto contentType = headers.content_type();
+	if (!boost::istarts_with(contentType, "text/") && !boost::icontains(contentType, "json"))
+	{
+		return std::string();
+	}
+	if (!headers.has(HTTP_HEADER_KEY_vary))
+	{
+		headers.add(HTTP_HEADER_KEY_vary, HTTP_HEADER_KEY_accept_encoding);
+	}
+	std::string acceptEncoding;
+	if (!this->headers().match(HTTP_HEADER_KEY_accept_encoding, acceptEncoding))
+	{
+		return std::string();
+	}
+	return Compression::negotiate(acceptEncoding);
 }
 
 pplx::task<void> HttpRequest::reply(http::status_code status) const
@@ -66,6 +157,41 @@ pplx::task<void> HttpRequest::reply(status_code status, const concurrency::strea
 	return reply(response);
 }
 
+http::status_code HttpRequest::replyStatus() const
+{
+	return m_replyStatus;
+}
+
+bool HttpRequest::sendFileSupported() const
+{
+	return m_sendFileSupported;
+}
+
+void HttpRequest::setSendFileSupported(bool supported)
+{
+	m_sendFileSupported = supported;
+}
+
+const HttpRequest::BodyReader &HttpRequest::bodyReader() const
+{
+	return m_bodyReader;
+}
+
+void HttpRequest::setBodyReader(const BodyReader &reader)
+{
+	m_bodyReader = reader;
+}
+
+void HttpRequest::setCompression(std::size_t minBytes, std::size_t threads)
+{
+	static std::once_flag poolCreated;
+	std::call_once(poolCreated, [threads]() {
+		if (threads)
+			compressPool.reset(new boost::asio::thread_pool(threads));
+	});
+	compressMinBytes = minBytes;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // HttpRequestWithCallback
 ////////////////////////////////////////////////////////////////////////////////
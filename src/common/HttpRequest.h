@@ -108,6 +108,42 @@ public:
 		const concurrency::streams::istream& body,
 		utility::size64_t content_length,
 		const utility::string_t& content_type = _XPLATSTR("application/octet-stream")) const;
+
+	/// <summary>
+	/// Status code replied through this object, 0 before reply.
+	/// </summary>
+	http::status_code replyStatus() const;
+
+	/// <summary>
+	/// Transport send file reply by sendfile(), set by transport only, handler reply
+	/// file path in X-Send-File response header instead of file stream when true.
+	/// </summary>
+	bool sendFileSupported() const;
+	void setSendFileSupported(bool supported);
+
+	/// <summary>
+	/// Request body streamed by transport, read until return 0, set by transport only;
+	/// empty when body is received in http_request body.
+	/// </summary>
+	typedef std::function<std::size_t(char *buffer, std::size_t size)> BodyReader;
+	const BodyReader &bodyReader() const;
+	void setBodyReader(const BodyReader &reader);
+
+	/// <summary>
+	/// Compress text reply body not smaller than minBytes when client accept gzip or zstd,
+	/// 0 disable compression. Compression run on a thread pool created by first call.
+	/// </summary>
+	static void setCompression(std::size_t minBytes, std::size_t threads);
+
+private:
+	/// <summary>
+	/// Content-Encoding negotiated for the reply, empty when reply is not compressed.
+	/// </summary>
+	std::string replyEncoding(http_response& response) const;
+
+	mutable http::status_code m_replyStatus;
+	bool m_sendFileSupported;
+	BodyReader m_bodyReader;
 };
 
 class HttpRequestWithCallback : public HttpRequest
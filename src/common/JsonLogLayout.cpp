@@ -0,0 +1,114 @@
+#include <cstring>
+#include <log4cpp/Priority.hh>
+#include "JsonLogLayout.h"
+
+JsonLogLayout::JsonLogLayout()
+	: m_second(-1)
+{
+	m_buffer.reserve(JSON_LOG_LINE_RESERVE);
+	m_secondText[0] = '\0';
+}
+
+JsonLogLayout::~JsonLogLayout()
+{
+}
+
+std::string JsonLogLayout::format(const log4cpp::LoggingEvent &event)
+{
+	// keep buffer capacity between lines
+	m_buffer.clear();
+	m_buffer.push_back('{');
+	appendTimestamp(event);
+
+	const auto &level = log4cpp::Priority::getPriorityName(event.priority);
+	appendField("level", level.c_str(), level.length());
+	appendField("thread", event.threadName.c_str(), event.threadName.length());
+
+	// message start with fname "Class::method() "
+	const char *message = event.message.c_str();
+	std::size_t messageLength = event.message.length();
+	const char *space = std::strchr(message, ' ');
+	if (space != nullptr && space - message > 2 && space[-1] == ')' && space[-2] == '(')
+	{
+		appendField("component", message, space - 2 - message);
+		messageLength -= (space + 1 - message);
+		message = space + 1;
+	}
+	else
+	{
+		appendField("component", "", 0);
+	}
+	appendField("app", event.ndc.c_str(), event.ndc.length());
+	appendField("message", message, messageLength);
+	m_buffer.append("}\n");
+	return m_buffer;
+}
+
+void JsonLogLayout::appendTimestamp(const log4cpp::LoggingEvent &event)
+{
+	const std::time_t second = event.timeStamp.getSeconds();
+	if (second != m_second)
+	{
+		struct tm utc;
+		::gmtime_r(&second, &utc);
+		std::strftime(m_secondText, sizeof(m_secondText), "%Y-%m-%dT%H:%M:%S", &utc);
+		m_second = second;
+	}
+	const int milliseconds = event.timeStamp.getMilliSeconds();
+	m_buffer.append("\"timestamp\":\"");
+	m_buffer.append(m_secondText);
+	m_buffer.push_back('.');
+	m_buffer.push_back('0' + milliseconds / 100 % 10);
+	m_buffer.push_back('0' + milliseconds / 10 % 10);
+	m_buffer.push_back('0' + milliseconds % 10);
+	m_buffer.append("Z\"");
+}
+
+void JsonLogLayout::appendField(const char *key, const char *value, std::size_t length)
+{
+	m_buffer.append(",\"");
+	m_buffer.append(key);
+	m_buffer.append("\":\"");
+	appendEscaped(value, length);
+	m_buffer.push_back('"');
+}
+
+void JsonLogLayout::appendEscaped(const char *value, std::size_t length)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char *plain = value;
+	const char *end = value + length;
+	for (const char *pos = value; pos != end; ++pos)
+	{
+		const auto c = static_cast<unsigned char>(*pos);
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		// copy unescaped run at once
+		m_buffer.append(plain, pos - plain);
+		plain = pos + 1;
+		switch (c)
+		{
+		case '"':
+			m_buffer.append("\\\"");
+			break;
+		case '\\':
+			m_buffer.append("\\\\");
+			break;
+		case '\n':
+			m_buffer.append("\\n");
+			break;
+		case '\r':
+			m_buffer.append("\\r");
+			break;
+		case '\t':
+			m_buffer.append("\\t");
+			break;
+		default:
+			m_buffer.append("\\u00");
+			m_buffer.push_back(hex[c >> 4]);
+			m_buffer.push_back(hex[c & 0x0f]);
+			break;
+		}
+	}
+	m_buffer.append(plain, end - plain);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <log4cpp/Layout.hh>
+#include <log4cpp/LoggingEvent.hh>
+
+//////////////////////////////////////////////////////////////////////////
+/// Format event as one JSON object per line for log shippers:
+/// {"timestamp":"2021-01-01T00:00:00.000Z","level":"INFO","thread":"123",
+///  "component":"Application::invoke","app":"myapp","message":"..."}
+/// component is the leading "Class::method() " of message, app is NDC.
+/// Line is written into a reused buffer, layout is not thread safe and is
+/// called under appender lock.
+//////////////////////////////////////////////////////////////////////////
+class JsonLogLayout : public log4cpp::Layout
+{
+public:
+	JsonLogLayout();
+	virtual ~JsonLogLayout();
+
+	virtual std::string format(const log4cpp::LoggingEvent &event) override;
+
+private:
+	void appendTimestamp(const log4cpp::LoggingEvent &event);
+	void appendField(const char *key, const char *value, std::size_t length);
+	void appendEscaped(const char *value, std::size_t length);
+
+	std::string m_buffer;
+	// "YYYY-MM-DDTHH:MM:SS" of m_second, reformatted when second changes
+	std::time_t m_second;
+	char m_secondText[32];
+};
+
+#define JSON_LOG_LINE_RESERVE 512
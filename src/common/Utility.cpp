@@ -15,6 +15,7 @@
 #include <log4cpp/Category.hh>
 #include <log4cpp/Appender.hh>
 #include <log4cpp/FileAppender.hh>
+#include <log4cpp/NDC.hh>
 #include <log4cpp/Priority.hh>
 #include <log4cpp/PatternLayout.hh>
 #include <log4cpp/RollingFileAppender.hh>
@@ -22,6 +23,8 @@
 #include <ace/OS.h>
 #include <ace/UUID.h>
 
+#include "AsyncLogAppender.h"
+#include "JsonLogLayout.h"
 #include "Utility.h"
 
 const char *GET_STATUS_STR(unsigned int status)
@@ -37,6 +40,9 @@ const char *GET_STATUS_STR(unsigned int status)
 	return STATUS_STR[status];
 };
 
+// all levels are passed to log4cpp before setLogLevel()
+std::atomic<int> Utility::m_logPriority(log4cpp::Priority::NOTSET);
+
 Utility::Utility()
 {
 }
@@ -232,7 +238,7 @@ void Utility::initLogging()
 	auto logDir = Utility::stringFormat("%s/%s", Utility::getSelfDir().c_str(), "log");
 	createDirectory(logDir, 00655);
 	auto consoleLayout = new PatternLayout();
-	consoleLayout->setConversionPattern("%d [%t] %p %c: %m%n");
+	consoleLayout->setConversionPattern(LOG_TEXT_PATTERN);
 	auto consoleAppender = new OstreamAppender("console", &std::cout);
 	consoleAppender->setLayout(consoleLayout);
 
@@ -240,7 +246,7 @@ void Utility::initLogging()
 	//	std::size_tmaxFileSize = 10 * 1024 * 1024, unsigned intmaxBackupIndex = 1,
 	//	boolappend = true, mode_t mode = 00644);
 	auto rollingFileAppender = new RollingFileAppender(
-		"rollingFileAppender",
+		LOG_APPENDER_NAME_file,
 		logDir.append("/appsvc.log"),
 		20 * 1024 * 1024,
 		5,
@@ -248,12 +254,16 @@ void Utility::initLogging()
 		00664);
 
 	auto pLayout = new PatternLayout();
-	pLayout->setConversionPattern("%d [%t] %p %c: %m%n");
+	pLayout->setConversionPattern(LOG_TEXT_PATTERN);
 	rollingFileAppender->setLayout(pLayout);
 
+	// format and write in background thread, WARN and above wait when ring is full, others are dropped
+	auto asyncAppender = new AsyncLogAppender(LOG_APPENDER_NAME_async, DEFAULT_LOG_RING_CAPACITY, Priority::WARN);
+	asyncAppender->addAppender(rollingFileAppender);
+	asyncAppender->addAppender(consoleAppender);
+
 	Category &root = Category::getRoot();
-	root.addAppender(rollingFileAppender);
-	root.addAppender(consoleAppender);
+	root.addAppender(asyncAppender);
 
 	// Log level
 	std::string levelEnv = "DEBUG";
@@ -262,9 +272,51 @@ void Utility::initLogging()
 		levelEnv = env;
 	setLogLevel(levelEnv);
 
+	// Log file format
+	env = getenv(ENV_LOG_FORMAT);
+	if (env != nullptr)
+		setLogFormat(env);
+
 	LOG_INF << "Logging process ID:" << getpid();
 }
 
+bool Utility::setLogFormat(const std::string &format)
+{
+	log4cpp::Layout *layout = nullptr;
+	if (format == LOG_FORMAT_TEXT)
+	{
+		auto pattern = new log4cpp::PatternLayout();
+		pattern->setConversionPattern(LOG_TEXT_PATTERN);
+		layout = pattern;
+	}
+	else if (format == LOG_FORMAT_JSON)
+	{
+		layout = new JsonLogLayout();
+	}
+	else
+	{
+		LOG_ERR << "No such log format " << format;
+		return false;
+	}
+	auto appender = dynamic_cast<AsyncLogAppender *>(log4cpp::Category::getRoot().getAppender(LOG_APPENDER_NAME_async));
+	if (appender == nullptr || !appender->setAppenderLayout(LOG_APPENDER_NAME_file, layout))
+	{
+		if (appender == nullptr)
+			delete layout;
+		LOG_ERR << "Log file appender not initialized";
+		return false;
+	}
+	LOG_INF << "Setting log file format to " << format;
+	return true;
+}
+
+void Utility::flushLogging()
+{
+	auto appender = dynamic_cast<AsyncLogAppender *>(log4cpp::Category::getRoot().getAppender(LOG_APPENDER_NAME_async));
+	if (appender)
+		appender->flush();
+}
+
 bool Utility::setLogLevel(const std::string &level)
 {
 	std::map<std::string, log4cpp::Priority::PriorityLevel> levelMap = {
@@ -283,6 +335,7 @@ bool Utility::setLogLevel(const std::string &level)
 	{
 		LOG_INF << "Setting log level to " << level;
 		log4cpp::Category::getRoot().setPriority(levelMap[level]);
+		m_logPriority = levelMap[level];
 		return true;
 	}
 	else
@@ -665,3 +718,16 @@ std::string Utility::stringFormat(const std::string fmt_str, ...)
 	}
 	return std::string(formatted.get());
 }
+
+LogAppScope::LogAppScope(const std::string &appName)
+	: m_pushed(log4cpp::NDC::getDepth() == 0)
+{
+	if (m_pushed)
+		log4cpp::NDC::push(appName);
+}
+
+LogAppScope::~LogAppScope()
+{
+	if (m_pushed)
+		log4cpp::NDC::pop();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <cstring>
 #include <iostream>
@@ -12,10 +13,30 @@
 
 #define ARRAY_LEN(T) (sizeof(T) / sizeof(T[0]))
 
-#define LOG_DBG log4cpp::Category::getRoot() << log4cpp::Priority::DEBUG
-#define LOG_INF log4cpp::Category::getRoot() << log4cpp::Priority::INFO
-#define LOG_WAR log4cpp::Category::getRoot() << log4cpp::Priority::WARN
-#define LOG_ERR log4cpp::Category::getRoot() << log4cpp::Priority::ERROR
+// Turn log stream expression to void, operator& bind looser than << and tighter than ?:
+struct LogVoidify
+{
+	void operator&(const log4cpp::CategoryStream &) {}
+};
+
+// Compile-time minimum log priority, less severe lines are removed from build
+#ifndef LOG_MIN_PRIORITY
+#define LOG_MIN_PRIORITY log4cpp::Priority::NOTSET
+#endif
+// Disabled level cost one branch, stream operands are not evaluated
+#define LOG_ENABLED(priority) ((priority) <= LOG_MIN_PRIORITY && (priority) <= Utility::logPriority())
+// Expression instead of if-else, safe as body of an unbraced if
+#define LOG_PRIORITY(priority) \
+	!(LOG_ENABLED(priority)) ? (void)0 : LogVoidify() & log4cpp::Category::getRoot() << (priority)
+#define LOG_DBG LOG_PRIORITY(log4cpp::Priority::DEBUG)
+#define LOG_INF LOG_PRIORITY(log4cpp::Priority::INFO)
+#define LOG_WAR LOG_PRIORITY(log4cpp::Priority::WARN)
+#define LOG_ERR LOG_PRIORITY(log4cpp::Priority::ERROR)
+#define LOG_TEXT_PATTERN "%d [%t] %p %c: %m%n"
+#define LOG_FORMAT_TEXT "text"
+#define LOG_FORMAT_JSON "json"
+#define ENV_LOG_FORMAT "LOG_FORMAT" // take precedence over LogFormat of appsvc.json
+#define LOG_APPENDER_NAME_file "rollingFileAppender"
 
 // Expand micro variable (microkey=microvalue)
 #define __MICRO_KEY__(str) #str				  // No expand micro
@@ -83,9 +104,24 @@ namespace std
 	}
 
 #define DEFAULT_PROM_LISTEN_PORT 0
+#define DEFAULT_PROM_SCRAPE_CACHE_MILLISECONDS 0
 #define DEFAULT_REST_LISTEN_PORT 6060
 #define DEFAULT_SCHEDULE_INTERVAL 2
 #define DEFAULT_HTTP_THREAD_POOL_SIZE 6
+#define DEFAULT_HTTP_IO_THREADS 2
+#define DEFAULT_HTTP_MAX_CONCURRENT_REQUESTS 256
+#define DEFAULT_HTTP_REQUEST_QUEUE_DEPTH 128
+#define DEFAULT_HTTP_KEEP_ALIVE_SECONDS 60
+#define DEFAULT_HTTP_KEEP_ALIVE_MAX_REQUESTS 1000
+#define DEFAULT_HTTP_MAX_BODY_BYTES (4 * 1024 * 1024)
+#define DEFAULT_HTTP_COMPRESSION_MIN_BYTES 1024
+#define DEFAULT_HTTP_COMPRESSION_THREADS 2
+#define DEFAULT_SSL_SESSION_CACHE_SIZE 20480
+#define DEFAULT_SSL_SESSION_TIMEOUT_SECONDS 300
+#define DEFAULT_SSL_SESSION_TICKET_ROTATE_SECONDS 3600
+#define HTTP_TRANSPORT_CPPREST "cpprest"
+#define HTTP_TRANSPORT_ASIO "asio"
+#define PEER_TOKEN_EXPIRE_SECONDS 60
 
 #define JWT_USER_KEY "User123"
 #define JWT_USER_NAME "user"
@@ -93,10 +129,12 @@ namespace std
 #define APPMESH_PASSWD_MIN_LENGTH 3
 #define DEFAULT_RUN_APP_RETENTION_DURATION 10
 #define DEFAULT_HEALTH_CHECK_INTERVAL 10
+#define DEFAULT_CGROUP_CPU_PERIOD_US 100000
 #define MAX_COMMAND_LINE_LENGTH 2048
 
 #define DEFAULT_LABEL_HOST_NAME "HOST_NAME"
 #define SNAPSHOT_FILE_NAME ".snapshot"
+#define FILE_UPLOAD_STATE_FILE_NAME ".upload"
 #define DEFAULT_WORKING_DIR "/opt/appmesh/work"
 
 const char *GET_STATUS_STR(unsigned int status);
@@ -134,7 +172,13 @@ public:
 	static std::string stringFormat(const std::string fmt_str, ...);
 
 	static void initLogging();
+	/// Wait until queued log lines are written
+	static void flushLogging();
 	static bool setLogLevel(const std::string &level);
+	/// Log file format: text or json (JSON lines)
+	static bool setLogFormat(const std::string &format);
+	/// Cached root category priority, updated by setLogLevel()
+	static int logPriority() { return m_logPriority.load(std::memory_order_relaxed); }
 
 	// OS related
 	static unsigned long long getThreadId();
@@ -151,6 +195,23 @@ public:
 
 	static std::string createUUID();
 	static std::string runShellCommand(std::string cmd);
+
+private:
+	static std::atomic<int> m_logPriority;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Attach application name to log lines of current thread in this scope,
+/// written as "app" field of JSON log (log4cpp NDC), nested scope is ignored
+//////////////////////////////////////////////////////////////////////////
+class LogAppScope
+{
+public:
+	explicit LogAppScope(const std::string &appName);
+	virtual ~LogAppScope();
+
+private:
+	bool m_pushed;
 };
 
 #define ENV_APP_MANAGER_LISTEN_PORT "APPMESH_OVERRIDE_LISTEN_PORT"
@@ -165,6 +226,21 @@ public:
 #define MAX_APP_CACHED_LINES 1024
 #define SECURIRE_USER_KEY "******"
 #define CONSUL_SESSION_DEFAULT_TTL 30
+#define CONSUL_REQUEST_TIMEOUT_SECONDS 10 // default timeout for Consul non-blocking request
+#define CONSUL_WATCH_WAIT_SECONDS 30	  // Consul blocking query wait time
+#define CONSUL_TXN_MAX_OPERATIONS 64	  // Consul limit operations of one transaction
+#define CONSUL_REPORT_MEM_STEP_BYTES (256ULL * 1024 * 1024) // report free memory in steps to avoid frequent node update
+#define SCHEDULE_MAX_PREEMPTIONS_PER_PASS 16 // replicas evicted by higher priority tasks in one schedule pass
+#define FILE_UPLOAD_MAX_SESSIONS 64				   // concurrent chunked uploads, each hold a temporary file
+#define FILE_UPLOAD_IDLE_TIMEOUT_SECONDS 3600	   // chunked upload is removed when no chunk received
+#define FILE_UPLOAD_EXPIRE_CHECK_SECONDS 60		   // interval to remove idle chunked uploads
+#define FILE_UPLOAD_MAX_CHUNK_BYTES (64ULL * 1024 * 1024) // chunk body bytes read by one request
+#define FILE_UPLOAD_PIECE_BYTES (1024ULL * 1024)	   // request body is read and written by pieces
+#define FILE_UPLOAD_CHUNK_BYTES (8ULL * 1024 * 1024)	   // client chunk size, file not larger than one chunk is uploaded by one request
+#define FILE_UPLOAD_PARALLEL 4					   // client connections for chunked upload
+#define SCHEDULE_STRATEGY_SPREAD "spread"
+#define SCHEDULE_STRATEGY_BINPACK "binpack"
+#define SCHEDULE_STRATEGY_LEAST_REQUESTED "least_requested"
 #define DEFAULT_EXEC_USER "appmesh"
 
 #define JSON_KEY_Description "Description"
@@ -175,21 +251,39 @@ public:
 #define JSON_KEY_RestEnabled "RestEnabled"
 #define JSON_KEY_RestListenPort "RestListenPort"
 #define JSON_KEY_RestListenAddress "RestListenAddress"
+#define JSON_KEY_RestListenSocket "RestListenSocket"
+#define JSON_KEY_RestListenSocketGroup "RestListenSocketGroup"
+#define JSON_KEY_RestListenSocketUsers "RestListenSocketUsers"
 #define JSON_KEY_PrometheusExporterListenPort "PrometheusExporterListenPort"
+#define JSON_KEY_PrometheusScrapeCacheMilliseconds "PrometheusScrapeCacheMilliseconds"
 
 #define JSON_KEY_ScheduleIntervalSeconds "ScheduleIntervalSeconds"
 #define JSON_KEY_LogLevel "LogLevel"
+#define JSON_KEY_LogFormat "LogFormat"
 #define JSON_KEY_TimeFormatPosixZone "TimeFormatPosixZone"
 
 #define JSON_KEY_SSL "SSL"
 #define JSON_KEY_SSLEnabled "SSLEnabled"
 #define JSON_KEY_SSLCertificateFile "SSLCertificateFile"
 #define JSON_KEY_SSLCertificateKeyFile "SSLCertificateKeyFile"
+#define JSON_KEY_SSLSessionCacheSize "SSLSessionCacheSize"
+#define JSON_KEY_SSLSessionTimeoutSeconds "SSLSessionTimeoutSeconds"
+#define JSON_KEY_SSLSessionTicketEnabled "SSLSessionTicketEnabled"
+#define JSON_KEY_SSLSessionTicketRotateSeconds "SSLSessionTicketRotateSeconds"
 
 #define JSON_KEY_Security "Security"
 
 #define JSON_KEY_JWTEnabled "JWTEnabled"
 #define JSON_KEY_HttpThreadPoolSize "HttpThreadPoolSize"
+#define JSON_KEY_HttpTransport "HttpTransport"
+#define JSON_KEY_HttpIoThreads "HttpIoThreads"
+#define JSON_KEY_HttpMaxConcurrentRequests "HttpMaxConcurrentRequests"
+#define JSON_KEY_HttpRequestQueueDepth "HttpRequestQueueDepth"
+#define JSON_KEY_HttpKeepAliveSeconds "HttpKeepAliveSeconds"
+#define JSON_KEY_HttpKeepAliveMaxRequests "HttpKeepAliveMaxRequests"
+#define JSON_KEY_HttpMaxBodyBytes "HttpMaxBodyBytes"
+#define JSON_KEY_HttpCompressionMinBytes "HttpCompressionMinBytes"
+#define JSON_KEY_HttpCompressionThreads "HttpCompressionThreads"
 #define JSON_KEY_Roles "Roles"
 #define JSON_KEY_Applications "Applications"
 #define JSON_KEY_Labels "Labels"
@@ -205,6 +299,7 @@ public:
 #define JSON_KEY_CONSUL_SESSION_TTL "session_TTL"
 #define JSON_KEY_CONSUL_SECURITY "enable_consul_security"
 #define JSON_KEY_CONSUL_APPMESH_PROXY_URL "appmesh_proxy_url"
+#define JSON_KEY_CONSUL_SCHEDULE_STRATEGY "schedule_strategy"
 #define JSON_KEY_JWT_Users "Users"
 #define JSON_KEY_APP_name "name"
 #define JSON_KEY_APP_owner "owner"
@@ -232,6 +327,13 @@ public:
 #define JSON_KEY_APP_return "return"
 #define JSON_KEY_APP_id "id"
 #define JSON_KEY_APP_memory "memory"
+#define JSON_KEY_APP_cpu "cpu"
+#define JSON_KEY_APP_io_read_bytes "io_read_bytes"
+#define JSON_KEY_APP_io_write_bytes "io_write_bytes"
+#define JSON_KEY_APP_pressure "pressure"
+#define JSON_KEY_APP_pressure_cpu "cpu"
+#define JSON_KEY_APP_pressure_memory "memory"
+#define JSON_KEY_APP_pressure_io "io"
 #define JSON_KEY_APP_last_start "last_start_time"
 #define JSON_KEY_APP_container_id "container_id"
 #define JSON_KEY_APP_health "health"
@@ -253,6 +355,11 @@ public:
 #define JSON_KEY_RESOURCE_LIMITATION_memory_mb "memory_mb"
 #define JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb "memory_virt_mb"
 #define JSON_KEY_RESOURCE_LIMITATION_cpu_shares "cpu_shares"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_quota_us "cpu_quota_us"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_period_us "cpu_period_us"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_set "cpu_set"
+#define JSON_KEY_RESOURCE_LIMITATION_exclusive_cpus "exclusive_cpus"
+#define JSON_KEY_RESOURCE_LIMITATION_memory_nodes "memory_nodes"
 
 #define JSON_KEY_USER_key "key"
 #define JSON_KEY_USER_group "group"
@@ -261,6 +368,15 @@ public:
 #define JSON_KEY_USER_metadata "metadata"
 #define JSON_KEY_USER_exec_user "exec_user"
 
+#define JSON_KEY_UPLOAD_id "upload_id"
+#define JSON_KEY_UPLOAD_file_path "file_path"
+#define JSON_KEY_UPLOAD_file_size "file_size"
+#define JSON_KEY_UPLOAD_received "received"
+#define JSON_KEY_UPLOAD_ranges "ranges"
+#define JSON_KEY_UPLOAD_user "user"
+#define JSON_KEY_UPLOAD_file_mode "file_mode"
+#define JSON_KEY_UPLOAD_file_user "file_user"
+
 #define HTTP_HEADER_JWT "JWT"
 #define HTTP_HEADER_JWT_ISSUER "appmesh-auth0"
 #define HTTP_HEADER_JWT_name "name"
@@ -277,6 +393,13 @@ public:
 #define HTTP_HEADER_KEY_file_path "FilePath"
 #define HTTP_HEADER_KEY_file_mode "FileMode"
 #define HTTP_HEADER_KEY_file_user "FileUser"
+#define HTTP_HEADER_KEY_file_size "FileSize"
+#define HTTP_HEADER_KEY_chunk_crc32 "ChunkCRC32"
+// internal: response header carry file path sent by asio transport, see HttpRequest::sendFileSupported()
+#define HTTP_HEADER_KEY_send_file "X-Send-File"
+#define HTTP_HEADER_KEY_accept_encoding "Accept-Encoding"
+#define HTTP_HEADER_KEY_content_encoding "Content-Encoding"
+#define HTTP_HEADER_KEY_vary "Vary"
 
 #define HTTP_QUERY_KEY_keep_history "keep_history"
 #define HTTP_QUERY_KEY_stdout_index "stdout_index"
@@ -287,6 +410,7 @@ public:
 #define HTTP_QUERY_KEY_loglevel "level"
 #define HTTP_QUERY_KEY_label_value "value"
 #define HTTP_QUERY_KEY_retention "retention" // for async run, the output hold timeout in sever side
+#define HTTP_QUERY_KEY_offset "offset"		  // for chunked upload, the file offset of chunk
 
 #define PERMISSION_KEY_view_app "app-view"
 #define PERMISSION_KEY_view_app_output "app-output-view"
@@ -9,12 +9,14 @@
 #include "Configuration.h"
 #include "rest/ConsulConnection.h"
 #include "Label.h"
+#include "PlacementStrategy.h"
 #include "ResourceCollection.h"
 #include "rest/PrometheusRest.h"
 #include "rest/RestHandler.h"
 #include "security/User.h"
 
 #include "../common/DurationParse.h"
+#include "../common/HttpRequest.h"
 #include "../common/Utility.h"
 #include "../common/DateTime.h"
 
@@ -72,6 +74,11 @@ std::shared_ptr<Configuration> Configuration::FromJson(const std::string &str)
 	config->m_defaultWorkDir = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_WorkingDirectory);
 	config->m_scheduleInterval = GET_JSON_INT_VALUE(jsonValue, JSON_KEY_ScheduleIntervalSeconds);
 	config->m_logLevel = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_LogLevel);
+	config->m_logFormat = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_LogFormat);
+	if (config->m_logFormat.empty())
+		config->m_logFormat = LOG_FORMAT_TEXT;
+	if (config->m_logFormat != LOG_FORMAT_TEXT && config->m_logFormat != LOG_FORMAT_JSON)
+		throw std::invalid_argument(Utility::stringFormat("invalid LogFormat <%s>, support text and json", config->m_logFormat.c_str()));
 	config->m_formatPosixZone = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_TimeFormatPosixZone);
 	DateTime::setTimeFormatPosixZone(config->m_formatPosixZone);
 	if (config->m_defaultExecUser.empty())
@@ -176,6 +183,7 @@ web::json::value Configuration::AsJson(bool returnRuntimeInfo, const std::string
 	result[JSON_KEY_WorkingDirectory] = web::json::value::string(m_defaultWorkDir);
 	result[JSON_KEY_ScheduleIntervalSeconds] = web::json::value::number(m_scheduleInterval);
 	result[JSON_KEY_LogLevel] = web::json::value::string(m_logLevel);
+	result[JSON_KEY_LogFormat] = web::json::value::string(m_logFormat);
 	result[JSON_KEY_TimeFormatPosixZone] = web::json::value::string(m_formatPosixZone);
 
 	// REST
@@ -256,12 +264,37 @@ int Configuration::getPromListenPort()
 	return m_rest->m_promListenPort;
 }
 
+int Configuration::getPromScrapeCacheMilliseconds()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	return m_rest->m_promScrapeCacheMs;
+}
+
 std::string Configuration::getRestListenAddress()
 {
 	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
 	return m_rest->m_restListenAddress;
 }
 
+std::string Configuration::getRestListenSocket()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	return m_rest->m_restListenSocket;
+}
+
+std::string Configuration::getRestListenSocketGroup()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	return m_rest->m_restListenSocketGroup;
+}
+
+std::string Configuration::getRestListenSocketUser(int uid)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	auto iter = m_rest->m_restListenSocketUsers.find(uid);
+	return iter != m_rest->m_restListenSocketUsers.end() ? iter->second : std::string();
+}
+
 const web::json::value Configuration::getSecureConfigJson()
 {
 	auto json = this->AsJson(false, "");
@@ -331,6 +364,12 @@ const std::string Configuration::getLogLevel() const
 	return m_logLevel;
 }
 
+const std::string Configuration::getLogFormat() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	return m_logFormat;
+}
+
 const std::string Configuration::getDefaultExecUser() const
 {
 	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
@@ -441,6 +480,12 @@ const std::shared_ptr<Configuration::JsonConsul> Configuration::getConsul() cons
 	return m_consul;
 }
 
+const std::shared_ptr<Configuration::JsonRest> Configuration::getRest() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
+	return m_rest;
+}
+
 const std::shared_ptr<Configuration::JsonSecurity> Configuration::getSecurity() const
 {
 	std::lock_guard<std::recursive_mutex> guard(m_hotupdateMutex);
@@ -521,6 +566,7 @@ std::shared_ptr<Application> Configuration::addApp(const web::json::value &jsonA
 		{
 			// Stop existing app and replace
 			mapApp->disable();
+			mapApp->initMetrics(nullptr);
 			mapApp = app;
 			update = true;
 			return;
@@ -581,6 +627,7 @@ void Configuration::removeApp(const std::string &appName)
 void Configuration::saveConfigToDisk()
 {
 	const static char fname[] = "Configuration::saveConfigToDisk() ";
+	HistogramTimer timer(PrometheusRest::configSaveHistogram());
 
 	auto content = GET_STD_STRING(this->AsJson(false, "").serialize());
 	if (content.length())
@@ -633,6 +680,15 @@ void Configuration::hotUpdate(const web::json::value &jsonValue)
 				SET_COMPARE(this->m_logLevel, newConfig->m_logLevel);
 			}
 		}
+		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_LogFormat))
+		{
+			if (this->m_logFormat != newConfig->m_logFormat)
+			{
+				if (::getenv(ENV_LOG_FORMAT) == nullptr)
+					Utility::setLogFormat(newConfig->m_logFormat);
+				SET_COMPARE(this->m_logFormat, newConfig->m_logFormat);
+			}
+		}
 		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_TimeFormatPosixZone))
 		{
 			if (this->m_formatPosixZone != newConfig->m_formatPosixZone)
@@ -657,8 +713,39 @@ void Configuration::hotUpdate(const web::json::value &jsonValue)
 				SET_COMPARE(this->m_rest->m_restListenPort, newConfig->m_rest->m_restListenPort);
 			if (HAS_JSON_FIELD(rest, JSON_KEY_RestListenAddress))
 				SET_COMPARE(this->m_rest->m_restListenAddress, newConfig->m_rest->m_restListenAddress);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_RestListenSocket))
+				SET_COMPARE(this->m_rest->m_restListenSocket, newConfig->m_rest->m_restListenSocket);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_RestListenSocketGroup))
+				SET_COMPARE(this->m_rest->m_restListenSocketGroup, newConfig->m_rest->m_restListenSocketGroup);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_RestListenSocketUsers))
+				SET_COMPARE(this->m_rest->m_restListenSocketUsers, newConfig->m_rest->m_restListenSocketUsers);
 			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpThreadPoolSize))
 				SET_COMPARE(this->m_rest->m_httpThreadPoolSize, newConfig->m_rest->m_httpThreadPoolSize);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_PrometheusScrapeCacheMilliseconds))
+				SET_COMPARE(this->m_rest->m_promScrapeCacheMs, newConfig->m_rest->m_promScrapeCacheMs);
+			// transport options take effect after restart
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpTransport))
+				SET_COMPARE(this->m_rest->m_httpTransport, newConfig->m_rest->m_httpTransport);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpIoThreads))
+				SET_COMPARE(this->m_rest->m_httpIoThreads, newConfig->m_rest->m_httpIoThreads);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpMaxConcurrentRequests))
+				SET_COMPARE(this->m_rest->m_httpMaxConcurrentRequests, newConfig->m_rest->m_httpMaxConcurrentRequests);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpRequestQueueDepth))
+				SET_COMPARE(this->m_rest->m_httpRequestQueueDepth, newConfig->m_rest->m_httpRequestQueueDepth);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpKeepAliveSeconds))
+				SET_COMPARE(this->m_rest->m_httpKeepAliveSeconds, newConfig->m_rest->m_httpKeepAliveSeconds);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpKeepAliveMaxRequests))
+				SET_COMPARE(this->m_rest->m_httpKeepAliveMaxRequests, newConfig->m_rest->m_httpKeepAliveMaxRequests);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpMaxBodyBytes))
+				SET_COMPARE(this->m_rest->m_httpMaxBodyBytes, newConfig->m_rest->m_httpMaxBodyBytes);
+			// compression threads take effect after restart
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpCompressionThreads))
+				SET_COMPARE(this->m_rest->m_httpCompressionThreads, newConfig->m_rest->m_httpCompressionThreads);
+			if (HAS_JSON_FIELD(rest, JSON_KEY_HttpCompressionMinBytes))
+			{
+				SET_COMPARE(this->m_rest->m_httpCompressionMinBytes, newConfig->m_rest->m_httpCompressionMinBytes);
+				HttpRequest::setCompression(this->m_rest->m_httpCompressionMinBytes, this->m_rest->m_httpCompressionThreads);
+			}
 			if (HAS_JSON_FIELD(rest, JSON_KEY_PrometheusExporterListenPort) && (this->m_rest->m_promListenPort != newConfig->m_rest->m_promListenPort))
 			{
 				SET_COMPARE(this->m_rest->m_promListenPort, newConfig->m_rest->m_promListenPort);
@@ -676,6 +763,15 @@ void Configuration::hotUpdate(const web::json::value &jsonValue)
 					SET_COMPARE(this->m_rest->m_ssl->m_certKeyFile, newConfig->m_rest->m_ssl->m_certKeyFile);
 				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLEnabled))
 					SET_COMPARE(this->m_rest->m_ssl->m_sslEnabled, newConfig->m_rest->m_ssl->m_sslEnabled);
+				// session options take effect after restart
+				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLSessionCacheSize))
+					SET_COMPARE(this->m_rest->m_ssl->m_sessionCacheSize, newConfig->m_rest->m_ssl->m_sessionCacheSize);
+				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLSessionTimeoutSeconds))
+					SET_COMPARE(this->m_rest->m_ssl->m_sessionTimeoutSeconds, newConfig->m_rest->m_ssl->m_sessionTimeoutSeconds);
+				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLSessionTicketEnabled))
+					SET_COMPARE(this->m_rest->m_ssl->m_sessionTicketEnabled, newConfig->m_rest->m_ssl->m_sessionTicketEnabled);
+				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLSessionTicketRotateSeconds))
+					SET_COMPARE(this->m_rest->m_ssl->m_sessionTicketRotateSeconds, newConfig->m_rest->m_ssl->m_sessionTicketRotateSeconds);
 			}
 		}
 
@@ -802,13 +898,55 @@ std::shared_ptr<Configuration::JsonRest> Configuration::JsonRest::FromJson(const
 	auto rest = std::make_shared<JsonRest>();
 	rest->m_restListenPort = GET_JSON_INT_VALUE(jsonValue, JSON_KEY_RestListenPort);
 	rest->m_restListenAddress = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_RestListenAddress);
+	rest->m_restListenSocket = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_RestListenSocket);
+	rest->m_restListenSocketGroup = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_RestListenSocketGroup);
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_RestListenSocketUsers))
+	{
+		for (const auto &user : jsonValue.at(JSON_KEY_RestListenSocketUsers).as_object())
+		{
+			const auto uid = GET_STD_STRING(user.first);
+			if (!Utility::isNumber(uid) || !user.second.is_string())
+			{
+				throw std::invalid_argument("RestListenSocketUsers should map OS uid to App Mesh user name");
+			}
+			rest->m_restListenSocketUsers[std::stoi(uid)] = GET_STD_STRING(user.second.as_string());
+		}
+	}
 	SET_JSON_BOOL_VALUE(jsonValue, JSON_KEY_RestEnabled, rest->m_restEnabled);
 	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_PrometheusExporterListenPort, rest->m_promListenPort);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_PrometheusScrapeCacheMilliseconds, rest->m_promScrapeCacheMs);
+	if (rest->m_promScrapeCacheMs < 0)
+	{
+		throw std::invalid_argument("PrometheusScrapeCacheMilliseconds should not be negative");
+	}
 	auto threadpool = GET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpThreadPoolSize);
 	if (threadpool > 0 && threadpool < 40)
 	{
 		rest->m_httpThreadPoolSize = threadpool;
 	}
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_HttpTransport))
+		rest->m_httpTransport = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_HttpTransport);
+	if (rest->m_httpTransport != HTTP_TRANSPORT_CPPREST && rest->m_httpTransport != HTTP_TRANSPORT_ASIO)
+	{
+		throw std::invalid_argument(Utility::stringFormat("HttpTransport <%s> is not supported", rest->m_httpTransport.c_str()));
+	}
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpIoThreads, rest->m_httpIoThreads);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpMaxConcurrentRequests, rest->m_httpMaxConcurrentRequests);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpRequestQueueDepth, rest->m_httpRequestQueueDepth);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpKeepAliveSeconds, rest->m_httpKeepAliveSeconds);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpKeepAliveMaxRequests, rest->m_httpKeepAliveMaxRequests);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpMaxBodyBytes, rest->m_httpMaxBodyBytes);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpCompressionMinBytes, rest->m_httpCompressionMinBytes);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_HttpCompressionThreads, rest->m_httpCompressionThreads);
+	if (rest->m_httpIoThreads < 1 || rest->m_httpMaxConcurrentRequests < 1 || rest->m_httpRequestQueueDepth < 1 ||
+		rest->m_httpKeepAliveSeconds < 1 || rest->m_httpKeepAliveMaxRequests < 1 || rest->m_httpMaxBodyBytes < 1)
+	{
+		throw std::invalid_argument("HttpIoThreads, HttpMaxConcurrentRequests, HttpRequestQueueDepth, HttpKeepAliveSeconds, HttpKeepAliveMaxRequests and HttpMaxBodyBytes should be positive");
+	}
+	if (rest->m_httpCompressionMinBytes < 0 || rest->m_httpCompressionThreads < 0)
+	{
+		throw std::invalid_argument("HttpCompressionMinBytes and HttpCompressionThreads should not be negative");
+	}
 	if (rest->m_restListenPort < 1000 || rest->m_restListenPort > 65534)
 	{
 		rest->m_restListenPort = DEFAULT_REST_LISTEN_PORT;
@@ -829,7 +967,25 @@ web::json::value Configuration::JsonRest::AsJson() const
 	result[JSON_KEY_HttpThreadPoolSize] = web::json::value::number((uint32_t)m_httpThreadPoolSize);
 	result[JSON_KEY_RestListenPort] = web::json::value::number(m_restListenPort);
 	result[JSON_KEY_PrometheusExporterListenPort] = web::json::value::number(m_promListenPort);
+	result[JSON_KEY_PrometheusScrapeCacheMilliseconds] = web::json::value::number(m_promScrapeCacheMs);
 	result[JSON_KEY_RestListenAddress] = web::json::value::string(m_restListenAddress);
+	result[JSON_KEY_RestListenSocket] = web::json::value::string(m_restListenSocket);
+	result[JSON_KEY_RestListenSocketGroup] = web::json::value::string(m_restListenSocketGroup);
+	auto socketUsers = web::json::value::object();
+	for (const auto &user : m_restListenSocketUsers)
+	{
+		socketUsers[std::to_string(user.first)] = web::json::value::string(user.second);
+	}
+	result[JSON_KEY_RestListenSocketUsers] = socketUsers;
+	result[JSON_KEY_HttpTransport] = web::json::value::string(m_httpTransport);
+	result[JSON_KEY_HttpIoThreads] = web::json::value::number(m_httpIoThreads);
+	result[JSON_KEY_HttpMaxConcurrentRequests] = web::json::value::number(m_httpMaxConcurrentRequests);
+	result[JSON_KEY_HttpRequestQueueDepth] = web::json::value::number(m_httpRequestQueueDepth);
+	result[JSON_KEY_HttpKeepAliveSeconds] = web::json::value::number(m_httpKeepAliveSeconds);
+	result[JSON_KEY_HttpKeepAliveMaxRequests] = web::json::value::number(m_httpKeepAliveMaxRequests);
+	result[JSON_KEY_HttpMaxBodyBytes] = web::json::value::number(m_httpMaxBodyBytes);
+	result[JSON_KEY_HttpCompressionMinBytes] = web::json::value::number(m_httpCompressionMinBytes);
+	result[JSON_KEY_HttpCompressionThreads] = web::json::value::number(m_httpCompressionThreads);
 	// SSL
 	result[JSON_KEY_SSL] = m_ssl->AsJson();
 	return result;
@@ -837,7 +993,13 @@ web::json::value Configuration::JsonRest::AsJson() const
 
 Configuration::JsonRest::JsonRest()
 	: m_restEnabled(false), m_httpThreadPoolSize(DEFAULT_HTTP_THREAD_POOL_SIZE),
-	  m_restListenPort(DEFAULT_REST_LISTEN_PORT), m_promListenPort(DEFAULT_PROM_LISTEN_PORT)
+	  m_restListenPort(DEFAULT_REST_LISTEN_PORT), m_promListenPort(DEFAULT_PROM_LISTEN_PORT),
+	  m_promScrapeCacheMs(DEFAULT_PROM_SCRAPE_CACHE_MILLISECONDS), m_httpTransport(HTTP_TRANSPORT_CPPREST),
+	  m_httpIoThreads(DEFAULT_HTTP_IO_THREADS), m_httpMaxConcurrentRequests(DEFAULT_HTTP_MAX_CONCURRENT_REQUESTS),
+	  m_httpRequestQueueDepth(DEFAULT_HTTP_REQUEST_QUEUE_DEPTH), m_httpKeepAliveSeconds(DEFAULT_HTTP_KEEP_ALIVE_SECONDS),
+	  m_httpKeepAliveMaxRequests(DEFAULT_HTTP_KEEP_ALIVE_MAX_REQUESTS), m_httpMaxBodyBytes(DEFAULT_HTTP_MAX_BODY_BYTES),
+	  m_httpCompressionMinBytes(DEFAULT_HTTP_COMPRESSION_MIN_BYTES),
+	  m_httpCompressionThreads(DEFAULT_HTTP_COMPRESSION_THREADS)
 {
 	m_ssl = std::make_shared<JsonSsl>();
 }
@@ -856,6 +1018,18 @@ std::shared_ptr<Configuration::JsonSsl> Configuration::JsonSsl::FromJson(const w
 	{
 		throw std::invalid_argument(Utility::stringFormat("SSLCertificateKeyFile <%s> not exist", ssl->m_certKeyFile.c_str()));
 	}
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_SSLSessionCacheSize, ssl->m_sessionCacheSize);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_SSLSessionTimeoutSeconds, ssl->m_sessionTimeoutSeconds);
+	SET_JSON_BOOL_VALUE(jsonValue, JSON_KEY_SSLSessionTicketEnabled, ssl->m_sessionTicketEnabled);
+	SET_JSON_INT_VALUE(jsonValue, JSON_KEY_SSLSessionTicketRotateSeconds, ssl->m_sessionTicketRotateSeconds);
+	if (ssl->m_sessionCacheSize < 0)
+	{
+		throw std::invalid_argument("SSLSessionCacheSize should not be negative");
+	}
+	if (ssl->m_sessionTimeoutSeconds < 1 || ssl->m_sessionTicketRotateSeconds < 1)
+	{
+		throw std::invalid_argument("SSLSessionTimeoutSeconds and SSLSessionTicketRotateSeconds should be positive");
+	}
 	return ssl;
 }
 
@@ -865,11 +1039,17 @@ web::json::value Configuration::JsonSsl::AsJson() const
 	result[JSON_KEY_SSLEnabled] = web::json::value::boolean(m_sslEnabled);
 	result[JSON_KEY_SSLCertificateFile] = web::json::value::string(m_certFile);
 	result[JSON_KEY_SSLCertificateKeyFile] = web::json::value::string(m_certKeyFile);
+	result[JSON_KEY_SSLSessionCacheSize] = web::json::value::number(m_sessionCacheSize);
+	result[JSON_KEY_SSLSessionTimeoutSeconds] = web::json::value::number(m_sessionTimeoutSeconds);
+	result[JSON_KEY_SSLSessionTicketEnabled] = web::json::value::boolean(m_sessionTicketEnabled);
+	result[JSON_KEY_SSLSessionTicketRotateSeconds] = web::json::value::number(m_sessionTicketRotateSeconds);
 	return result;
 }
 
 Configuration::JsonSsl::JsonSsl()
-	: m_sslEnabled(false)
+	: m_sslEnabled(false), m_sessionCacheSize(DEFAULT_SSL_SESSION_CACHE_SIZE),
+	  m_sessionTimeoutSeconds(DEFAULT_SSL_SESSION_TIMEOUT_SECONDS), m_sessionTicketEnabled(true),
+	  m_sessionTicketRotateSeconds(DEFAULT_SSL_SESSION_TICKET_ROTATE_SECONDS)
 {
 }
 
@@ -917,6 +1097,8 @@ std::shared_ptr<Configuration::JsonConsul> Configuration::JsonConsul::FromJson(c
 	consul->m_isNode = GET_JSON_BOOL_VALUE(jsonObj, JSON_KEY_CONSUL_IS_NODE);
 	SET_JSON_INT_VALUE(jsonObj, JSON_KEY_CONSUL_SESSION_TTL, consul->m_ttl);
 	SET_JSON_BOOL_VALUE(jsonObj, JSON_KEY_CONSUL_SECURITY, consul->m_securitySync);
+	if (HAS_JSON_FIELD(jsonObj, JSON_KEY_CONSUL_SCHEDULE_STRATEGY))
+		consul->m_scheduleStrategy = GET_JSON_STR_VALUE(jsonObj, JSON_KEY_CONSUL_SCHEDULE_STRATEGY);
 	const static boost::regex urlExrp("(http|https)://((\\w+\\.)*\\w+)(\\:[0-9]+)?");
 	if (consul->m_consulUrl.length() && !boost::regex_match(consul->m_consulUrl, urlExrp))
 	{
@@ -924,6 +1106,8 @@ std::shared_ptr<Configuration::JsonConsul> Configuration::JsonConsul::FromJson(c
 	}
 	if (consul->m_ttl < 5)
 		throw std::invalid_argument("session TTL should not less than 5s");
+	// validate strategy name
+	PlacementStrategy::create(consul->m_scheduleStrategy);
 
 	{
 		auto hostname = ResourceCollection::instance()->getHostName();
@@ -943,6 +1127,7 @@ web::json::value Configuration::JsonConsul::AsJson() const
 	result[JSON_KEY_CONSUL_SESSION_TTL] = web::json::value::number(m_ttl);
 	result[JSON_KEY_CONSUL_SECURITY] = web::json::value::boolean(m_securitySync);
 	result[JSON_KEY_CONSUL_APPMESH_PROXY_URL] = web::json::value::string(m_proxyUrl);
+	result[JSON_KEY_CONSUL_SCHEDULE_STRATEGY] = web::json::value::string(m_scheduleStrategy);
 	return result;
 }
 
@@ -965,6 +1150,6 @@ const std::string Configuration::JsonConsul::appmeshUrl() const
 }
 
 Configuration::JsonConsul::JsonConsul()
-	: m_isMaster(false), m_isNode(false), m_ttl(CONSUL_SESSION_DEFAULT_TTL), m_securitySync(false)
+	: m_isMaster(false), m_isNode(false), m_ttl(CONSUL_SESSION_DEFAULT_TTL), m_securitySync(false), m_scheduleStrategy(SCHEDULE_STRATEGY_SPREAD)
 {
 }
@@ -5,6 +5,7 @@
 #include <vector>
 #include <mutex>
 #include <set>
+#include <map>
 #include <cpprest/json.h>
 
 class RestHandler;
@@ -26,6 +27,12 @@ class Configuration
 		bool m_sslEnabled;
 		std::string m_certFile;
 		std::string m_certKeyFile;
+		// server side session cache entries, disabled when 0
+		int m_sessionCacheSize;
+		int m_sessionTimeoutSeconds;
+		// stateless resumption, ticket key is replaced every rotate period
+		bool m_sessionTicketEnabled;
+		int m_sessionTicketRotateSeconds;
 		JsonSsl();
 	};
 	struct JsonRest
@@ -37,7 +44,26 @@ class Configuration
 		int m_httpThreadPoolSize;
 		int m_restListenPort;
 		int m_promListenPort;
+		int m_promScrapeCacheMs;
 		std::string m_restListenAddress;
+		// Unix domain socket file for local clients, disabled when empty
+		std::string m_restListenSocket;
+		// OS group allowed to connect the socket (mode 0660), empty for the daemon user only
+		std::string m_restListenSocketGroup;
+		// OS uid to App Mesh user authorized by peer credential, root is always admin
+		std::map<int, std::string> m_restListenSocketUsers;
+		// REST transport: cpprest or asio, below options are used by asio transport
+		std::string m_httpTransport;
+		int m_httpIoThreads;
+		int m_httpMaxConcurrentRequests;
+		int m_httpRequestQueueDepth;
+		int m_httpKeepAliveSeconds;
+		int m_httpKeepAliveMaxRequests;
+		// request body buffered in memory, file upload body is streamed and not limited by this
+		int m_httpMaxBodyBytes;
+		// text reply not smaller than this is compressed when client accept, 0 disable compression
+		int m_httpCompressionMinBytes;
+		int m_httpCompressionThreads;
 		std::shared_ptr<JsonSsl> m_ssl;
 		JsonRest();
 	};
@@ -62,6 +88,8 @@ class Configuration
 		// TTL (string: "") - Specifies the number of seconds (between 10s and 86400s).
 		int m_ttl;
 		bool m_securitySync;
+		// task placement strategy: spread, binpack, least_requested
+		std::string m_scheduleStrategy;
 	};
 
 public:
@@ -99,7 +127,11 @@ public:
 	int getScheduleInterval();
 	int getRestListenPort();
 	int getPromListenPort();
+	int getPromScrapeCacheMilliseconds();
 	std::string getRestListenAddress();
+	std::string getRestListenSocket();
+	std::string getRestListenSocketGroup();
+	std::string getRestListenSocketUser(int uid);
 	const web::json::value getSecureConfigJson();
 	web::json::value serializeApplication(bool returnRuntimeInfo, const std::string &user) const;
 	std::shared_ptr<Application> getApp(const std::string &appName) const noexcept(false);
@@ -110,6 +142,7 @@ public:
 	std::shared_ptr<Label> getLabel() { return m_label; }
 
 	const std::string getLogLevel() const;
+	const std::string getLogFormat() const;
 	const std::string getDefaultExecUser() const;
 	const std::string getDefaultWorkDir() const;
 	bool getSslEnabled() const;
@@ -127,6 +160,7 @@ public:
 	const std::shared_ptr<Users> getUsers();
 	const std::shared_ptr<Roles> getRoles();
 	const std::shared_ptr<Configuration::JsonConsul> getConsul() const;
+	const std::shared_ptr<Configuration::JsonRest> getRest() const;
 	const std::shared_ptr<Configuration::JsonSecurity> getSecurity() const;
 	void updateSecurity(std::shared_ptr<Configuration::JsonSecurity> security);
 	bool checkOwnerPermission(const std::string &user, const std::shared_ptr<User> &appOwner, int appPermission, bool requestWrite) const;
@@ -147,6 +181,7 @@ private:
 	std::shared_ptr<JsonConsul> m_consul;
 
 	std::string m_logLevel;
+	std::string m_logFormat;
 	std::string m_formatPosixZone;
 
 	mutable std::recursive_mutex m_appMutex;
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include "HostMetrics.h"
+#include "../common/Utility.h"
+#include "../prom_exporter/client_metric.h"
+#include "../prom_exporter/detail/utils.h"
+
+HostMetrics::ProcFile::ProcFile(const char *path)
+	: m_path(path), m_fd(-1)
+{
+}
+
+HostMetrics::HostMetrics(const std::string &hostName)
+	: m_hostName(hostName), m_stat("/proc/stat"), m_loadavg("/proc/loadavg"), m_meminfo("/proc/meminfo"), m_netDev("/proc/net/dev"), m_mounts("/proc/self/mounts")
+{
+}
+
+HostMetrics::~HostMetrics()
+{
+	for (auto file : {&m_stat, &m_loadavg, &m_meminfo, &m_netDev, &m_mounts})
+	{
+		if (file->m_fd >= 0)
+			::close(file->m_fd);
+	}
+}
+
+bool HostMetrics::read(ProcFile &file)
+{
+	const static char fname[] = "HostMetrics::read() ";
+
+	if (file.m_fd < 0)
+	{
+		file.m_fd = ::open(file.m_path, O_RDONLY | O_CLOEXEC);
+		if (file.m_fd < 0)
+		{
+			LOG_WAR << fname << "Failed to open <" << file.m_path << ">, error :" << std::strerror(errno);
+			return false;
+		}
+	}
+	// keep buffer capacity between reads, procfs regenerate content when read from offset 0
+	if (file.m_content.size() < 4096)
+		file.m_content.resize(4096);
+	std::size_t total = 0;
+	while (true)
+	{
+		auto size = ::pread(file.m_fd, &file.m_content[total], file.m_content.size() - total, total);
+		if (size < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			LOG_WAR << fname << "Failed to read <" << file.m_path << ">, error :" << std::strerror(errno);
+			::close(file.m_fd);
+			file.m_fd = -1;
+			return false;
+		}
+		total += size;
+		if (size == 0 || total < file.m_content.size())
+			break;
+		file.m_content.resize(file.m_content.size() * 2);
+	}
+	file.m_content.resize(total);
+	return true;
+}
+
+namespace
+{
+	// build MetricFamily for Collect()
+	class FamilyWriter : public HostMetrics::Writer
+	{
+	public:
+		explicit FamilyWriter(const std::string &hostName) : m_hostName(hostName) {}
+
+		void family(const char *name, const char *help, prometheus::MetricType type) override
+		{
+			m_families.emplace_back();
+			m_families.back().name = name;
+			m_families.back().help = help;
+			m_families.back().type = type;
+		}
+		void sample(double value, std::initializer_list<std::pair<const char *, const char *>> labels) override
+		{
+			auto &family = m_families.back();
+			family.metric.emplace_back();
+			auto &metric = family.metric.back();
+			metric.label.push_back({"host", m_hostName});
+			for (const auto &label : labels)
+			{
+				metric.label.push_back({label.first, label.second});
+			}
+			if (family.type == prometheus::MetricType::Counter)
+				metric.counter.value = value;
+			else
+				metric.gauge.value = value;
+		}
+		std::vector<prometheus::MetricFamily> &families() { return m_families; }
+
+	private:
+		const std::string &m_hostName;
+		std::vector<prometheus::MetricFamily> m_families;
+	};
+
+	// render labels into reused buffer and stream each series to visitor
+	class StreamWriter : public HostMetrics::Writer
+	{
+	public:
+		StreamWriter(prometheus::CollectVisitor &visitor, const std::string &hostName)
+			: m_visitor(visitor), m_type(prometheus::MetricType::Gauge)
+		{
+			m_hostLabel = "host=\"";
+			prometheus::detail::append_escaped(m_hostLabel, hostName);
+			m_hostLabel.push_back('"');
+		}
+
+		void family(const char *name, const char *help, prometheus::MetricType type) override
+		{
+			// visitor keep reference of family name until next family
+			m_type = type;
+			m_name.assign(name);
+			m_help.assign(help);
+			m_visitor.BeginFamily(m_name, m_help, type);
+		}
+		void sample(double value, std::initializer_list<std::pair<const char *, const char *>> labels) override
+		{
+			m_labels.assign(m_hostLabel);
+			for (const auto &label : labels)
+			{
+				m_labels.append(",").append(label.first).append("=\"");
+				prometheus::detail::append_escaped(m_labels, label.second);
+				m_labels.push_back('"');
+			}
+			if (m_type == prometheus::MetricType::Counter)
+				m_metric.counter.value = value;
+			else
+				m_metric.gauge.value = value;
+			m_visitor.Visit(m_labels, m_metric);
+		}
+
+	private:
+		prometheus::CollectVisitor &m_visitor;
+		prometheus::MetricType m_type;
+		prometheus::ClientMetric m_metric;
+		std::string m_name;
+		std::string m_help;
+		std::string m_hostLabel;
+		std::string m_labels;
+	};
+} // namespace
+
+std::vector<prometheus::MetricFamily> HostMetrics::Collect()
+{
+	FamilyWriter writer(m_hostName);
+	collect(writer);
+	return std::move(writer.families());
+}
+
+void HostMetrics::Accept(prometheus::CollectVisitor &visitor)
+{
+	StreamWriter writer(visitor, m_hostName);
+	collect(writer);
+}
+
+void HostMetrics::collect(Writer &writer)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	collectCpu(writer);
+	collectLoad(writer);
+	collectMemory(writer);
+	collectFilesystem(writer);
+	collectNetwork(writer);
+}
+
+std::vector<std::pair<const char *, double>> HostMetrics::parseCpu(const std::string &text, long ticks)
+{
+	// cpu  user nice system idle iowait irq softirq steal guest guest_nice
+	std::vector<std::pair<const char *, double>> result;
+	if (ticks <= 0 || text.compare(0, 4, "cpu ") != 0)
+		return result;
+	static const char *modes[] = {"user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal"};
+	const char *pos = text.c_str() + 4;
+	for (auto mode : modes)
+	{
+		char *end = nullptr;
+		auto value = std::strtoull(pos, &end, 10);
+		if (end == pos)
+			break;
+		pos = end;
+		result.emplace_back(mode, double(value) / ticks);
+	}
+	return result;
+}
+
+std::vector<double> HostMetrics::parseLoad(const std::string &text)
+{
+	// 0.20 0.18 0.12 1/80 11206
+	std::vector<double> result;
+	const char *pos = text.c_str();
+	while (result.size() < 3)
+	{
+		char *end = nullptr;
+		auto value = std::strtod(pos, &end);
+		if (end == pos)
+			break;
+		pos = end;
+		result.push_back(value);
+	}
+	return result;
+}
+
+std::map<std::string, unsigned long long> HostMetrics::parseMemory(const std::string &text)
+{
+	// MemTotal:       16318412 kB
+	std::map<std::string, unsigned long long> result;
+	const char *line = text.c_str();
+	while (*line)
+	{
+		auto colon = std::strchr(line, ':');
+		auto lineEnd = std::strchr(line, '\n');
+		if (colon == nullptr || lineEnd == nullptr)
+			break;
+		if (colon < lineEnd)
+		{
+			result[std::string(line, colon)] = std::strtoull(colon + 1, nullptr, 10) * 1024;
+		}
+		line = lineEnd + 1;
+	}
+	return result;
+}
+
+std::vector<HostMetrics::NetDevice> HostMetrics::parseNetwork(const std::string &text)
+{
+	// Inter-|   Receive                                                |  Transmit
+	//  face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets ...
+	//   eth0: 1234 5 0 0 0 0 0 0 6789 10 0 0 0 0 0 0
+	std::vector<NetDevice> result;
+	const char *line = text.c_str();
+	while (*line)
+	{
+		auto lineEnd = std::strchr(line, '\n');
+		if (lineEnd == nullptr)
+			break;
+		auto colon = std::strchr(line, ':');
+		if (colon != nullptr && colon < lineEnd)
+		{
+			auto nameStart = line;
+			while (*nameStart == ' ')
+				++nameStart;
+			unsigned long long fields[10] = {0};
+			const char *pos = colon + 1;
+			bool valid = true;
+			for (auto &field : fields)
+			{
+				char *end = nullptr;
+				field = std::strtoull(pos, &end, 10);
+				valid = valid && end != pos && end <= lineEnd;
+				pos = end;
+			}
+			if (valid)
+			{
+				result.push_back({std::string(nameStart, colon), fields[0], fields[1], fields[8], fields[9]});
+			}
+		}
+		line = lineEnd + 1;
+	}
+	return result;
+}
+
+std::vector<HostMetrics::MountPoint> HostMetrics::parseMounts(const std::string &text)
+{
+	// /dev/sda1 / ext4 rw,relatime 0 0
+	// server:/export /mnt/nfs nfs4 rw,relatime,vers=4.2 0 0
+	static const std::set<std::string> ignoreFsList = {
+		"tmpfs", "romfs", "ramfs", "devtmpfs", "overlay", "squashfs",
+		// network filesystems, statvfs() block scrape when server is not reachable
+		"nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "afs", "ceph", "glusterfs", "lustre", "gpfs", "9p", "davfs", "fuse.sshfs", "fuse.s3fs", "fuse.glusterfs"};
+	std::vector<MountPoint> result;
+	std::set<std::string> paths;
+	std::istringstream stream(text);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		std::string device, path, type;
+		if (!(fields >> device >> path >> type))
+			continue;
+		// local block device only, "//server/share" is remote
+		if (device.length() < 2 || device[0] != '/' || device[1] == '/' || ignoreFsList.count(type))
+			continue;
+		// space in mount point is escaped as \040
+		std::string::size_type pos;
+		while ((pos = path.find("\\040")) != std::string::npos)
+			path.replace(pos, 4, " ");
+		// bind mount of same path is reported once
+		if (paths.insert(path).second)
+			result.push_back({path, device});
+	}
+	return result;
+}
+
+void HostMetrics::collectCpu(Writer &writer)
+{
+	static const long ticks = ::sysconf(_SC_CLK_TCK);
+	if (!read(m_stat))
+		return;
+	const auto modes = parseCpu(m_stat.m_content, ticks);
+	if (modes.empty())
+		return;
+	writer.family(PROM_METRIC_NAME_appmesh_host_cpu_seconds_total, PROM_METRIC_HELP_appmesh_host_cpu_seconds_total, prometheus::MetricType::Counter);
+	for (const auto &mode : modes)
+	{
+		writer.sample(mode.second, {{"mode", mode.first}});
+	}
+}
+
+void HostMetrics::collectLoad(Writer &writer)
+{
+	if (!read(m_loadavg))
+		return;
+	const char *names[] = {PROM_METRIC_NAME_appmesh_host_load1, PROM_METRIC_NAME_appmesh_host_load5, PROM_METRIC_NAME_appmesh_host_load15};
+	const auto loads = parseLoad(m_loadavg.m_content);
+	for (std::size_t i = 0; i < loads.size(); i++)
+	{
+		writer.family(names[i], PROM_METRIC_HELP_appmesh_host_load, prometheus::MetricType::Gauge);
+		writer.sample(loads[i], {});
+	}
+}
+
+void HostMetrics::collectMemory(Writer &writer)
+{
+	if (!read(m_meminfo))
+		return;
+	const auto values = parseMemory(m_meminfo.m_content);
+	const std::pair<const char *, const char *> memoryKeys[] = {{"MemTotal", "total"}, {"MemFree", "free"}, {"MemAvailable", "available"}, {"Buffers", "buffers"}, {"Cached", "cached"}};
+	const std::pair<const char *, const char *> swapKeys[] = {{"SwapTotal", "total"}, {"SwapFree", "free"}};
+	writer.family(PROM_METRIC_NAME_appmesh_host_memory_bytes, PROM_METRIC_HELP_appmesh_host_memory_bytes, prometheus::MetricType::Gauge);
+	for (const auto &key : memoryKeys)
+	{
+		auto value = values.find(key.first);
+		if (value != values.end())
+			writer.sample(double(value->second), {{"type", key.second}});
+	}
+	writer.family(PROM_METRIC_NAME_appmesh_host_swap_bytes, PROM_METRIC_HELP_appmesh_host_swap_bytes, prometheus::MetricType::Gauge);
+	for (const auto &key : swapKeys)
+	{
+		auto value = values.find(key.first);
+		if (value != values.end())
+			writer.sample(double(value->second), {{"type", key.second}});
+	}
+}
+
+void HostMetrics::collectFilesystem(Writer &writer)
+{
+	// mount table change rarely, statvfs on each scrape is cheap for local filesystems
+	const auto now = std::chrono::steady_clock::now();
+	if (m_mountPoints.empty() || now - m_mountRefreshTime > std::chrono::seconds(HOST_METRICS_MOUNT_REFRESH_SECONDS))
+	{
+		if (read(m_mounts))
+			m_mountPoints = parseMounts(m_mounts.m_content);
+		m_mountRefreshTime = now;
+	}
+
+	struct Usage
+	{
+		double m_size;
+		double m_used;
+		double m_avail;
+	};
+	std::vector<std::pair<const MountPoint *, Usage>> usages;
+	usages.reserve(m_mountPoints.size());
+	for (const auto &point : m_mountPoints)
+	{
+		struct statvfs buf;
+		if (::statvfs(point.m_path.c_str(), &buf) != 0 || buf.f_blocks == 0)
+			continue;
+		usages.push_back({&point, {double(buf.f_frsize) * buf.f_blocks, double(buf.f_frsize) * (buf.f_blocks - buf.f_bfree), double(buf.f_frsize) * buf.f_bavail}});
+	}
+	writer.family(PROM_METRIC_NAME_appmesh_host_filesystem_size_bytes, PROM_METRIC_HELP_appmesh_host_filesystem_size_bytes, prometheus::MetricType::Gauge);
+	for (const auto &usage : usages)
+	{
+		writer.sample(usage.second.m_size, {{"device", usage.first->m_device.c_str()}, {"mountpoint", usage.first->m_path.c_str()}});
+	}
+	writer.family(PROM_METRIC_NAME_appmesh_host_filesystem_used_bytes, PROM_METRIC_HELP_appmesh_host_filesystem_used_bytes, prometheus::MetricType::Gauge);
+	for (const auto &usage : usages)
+	{
+		writer.sample(usage.second.m_used, {{"device", usage.first->m_device.c_str()}, {"mountpoint", usage.first->m_path.c_str()}});
+	}
+	writer.family(PROM_METRIC_NAME_appmesh_host_filesystem_avail_bytes, PROM_METRIC_HELP_appmesh_host_filesystem_avail_bytes, prometheus::MetricType::Gauge);
+	for (const auto &usage : usages)
+	{
+		writer.sample(usage.second.m_avail, {{"device", usage.first->m_device.c_str()}, {"mountpoint", usage.first->m_path.c_str()}});
+	}
+}
+
+void HostMetrics::collectNetwork(Writer &writer)
+{
+	if (!read(m_netDev))
+		return;
+	const auto devices = parseNetwork(m_netDev.m_content);
+	writer.family(PROM_METRIC_NAME_appmesh_host_network_receive_bytes_total, PROM_METRIC_HELP_appmesh_host_network_receive_bytes_total, prometheus::MetricType::Counter);
+	for (const auto &device : devices)
+		writer.sample(double(device.m_receiveBytes), {{"interface", device.m_name.c_str()}});
+	writer.family(PROM_METRIC_NAME_appmesh_host_network_receive_packets_total, PROM_METRIC_HELP_appmesh_host_network_receive_packets_total, prometheus::MetricType::Counter);
+	for (const auto &device : devices)
+		writer.sample(double(device.m_receivePackets), {{"interface", device.m_name.c_str()}});
+	writer.family(PROM_METRIC_NAME_appmesh_host_network_transmit_bytes_total, PROM_METRIC_HELP_appmesh_host_network_transmit_bytes_total, prometheus::MetricType::Counter);
+	for (const auto &device : devices)
+		writer.sample(double(device.m_transmitBytes), {{"interface", device.m_name.c_str()}});
+	writer.family(PROM_METRIC_NAME_appmesh_host_network_transmit_packets_total, PROM_METRIC_HELP_appmesh_host_network_transmit_packets_total, prometheus::MetricType::Counter);
+	for (const auto &device : devices)
+		writer.sample(double(device.m_transmitPackets), {{"interface", device.m_name.c_str()}});
+}
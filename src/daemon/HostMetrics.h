@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../prom_exporter/collectable.h"
+#include "../prom_exporter/metric_family.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// Host CPU, load, memory, filesystem and network metrics read on scrape.
+/// /proc files are kept open and read by pread() from offset 0, series are
+/// streamed to the serializer by Accept() without building MetricFamily.
+//////////////////////////////////////////////////////////////////////////
+class HostMetrics : public prometheus::Collectable
+{
+public:
+	explicit HostMetrics(const std::string &hostName);
+	virtual ~HostMetrics();
+
+	std::vector<prometheus::MetricFamily> Collect() override;
+	void Accept(prometheus::CollectVisitor &visitor) override;
+
+	struct NetDevice
+	{
+		std::string m_name;
+		unsigned long long m_receiveBytes;
+		unsigned long long m_receivePackets;
+		unsigned long long m_transmitBytes;
+		unsigned long long m_transmitPackets;
+	};
+	struct MountPoint
+	{
+		std::string m_path;
+		std::string m_device;
+	};
+	/// Parsers of /proc content, skip malformed lines
+	/// /proc/stat "cpu" line: mode -> seconds
+	static std::vector<std::pair<const char *, double>> parseCpu(const std::string &text, long ticks);
+	/// /proc/loadavg: load1, load5, load15
+	static std::vector<double> parseLoad(const std::string &text);
+	/// /proc/meminfo: key -> bytes
+	static std::map<std::string, unsigned long long> parseMemory(const std::string &text);
+	/// /proc/net/dev
+	static std::vector<NetDevice> parseNetwork(const std::string &text);
+	/// /proc/self/mounts, only local block device filesystems, network filesystems may block statvfs()
+	static std::vector<MountPoint> parseMounts(const std::string &text);
+
+	/// Output of parsed values, implemented by MetricFamily builder and visitor stream
+	class Writer
+	{
+	public:
+		virtual ~Writer() = default;
+		virtual void family(const char *name, const char *help, prometheus::MetricType type) = 0;
+		virtual void sample(double value, std::initializer_list<std::pair<const char *, const char *>> labels) = 0;
+	};
+
+private:
+	struct ProcFile
+	{
+		explicit ProcFile(const char *path);
+		const char *m_path;
+		int m_fd;
+		std::string m_content;
+	};
+	/// Read whole file into m_content, open once and keep fd
+	static bool read(ProcFile &file);
+
+	void collect(Writer &writer);
+	void collectCpu(Writer &writer);
+	void collectLoad(Writer &writer);
+	void collectMemory(Writer &writer);
+	void collectFilesystem(Writer &writer);
+	void collectNetwork(Writer &writer);
+
+	const std::string m_hostName;
+	ProcFile m_stat;
+	ProcFile m_loadavg;
+	ProcFile m_meminfo;
+	ProcFile m_netDev;
+	ProcFile m_mounts;
+	// refreshed by HOST_METRICS_MOUNT_REFRESH_SECONDS
+	std::vector<MountPoint> m_mountPoints;
+	std::chrono::steady_clock::time_point m_mountRefreshTime;
+	std::mutex m_mutex;
+};
+
+#define HOST_METRICS_MOUNT_REFRESH_SECONDS 60
+#define PROM_METRIC_NAME_appmesh_host_cpu_seconds_total "appmesh_host_cpu_seconds_total"
+#define PROM_METRIC_HELP_appmesh_host_cpu_seconds_total "host cpu seconds spent in each mode"
+#define PROM_METRIC_NAME_appmesh_host_load1 "appmesh_host_load1"
+#define PROM_METRIC_NAME_appmesh_host_load5 "appmesh_host_load5"
+#define PROM_METRIC_NAME_appmesh_host_load15 "appmesh_host_load15"
+#define PROM_METRIC_HELP_appmesh_host_load "host load average"
+#define PROM_METRIC_NAME_appmesh_host_memory_bytes "appmesh_host_memory_bytes"
+#define PROM_METRIC_HELP_appmesh_host_memory_bytes "host memory bytes"
+#define PROM_METRIC_NAME_appmesh_host_swap_bytes "appmesh_host_swap_bytes"
+#define PROM_METRIC_HELP_appmesh_host_swap_bytes "host swap bytes"
+#define PROM_METRIC_NAME_appmesh_host_filesystem_size_bytes "appmesh_host_filesystem_size_bytes"
+#define PROM_METRIC_HELP_appmesh_host_filesystem_size_bytes "filesystem size bytes"
+#define PROM_METRIC_NAME_appmesh_host_filesystem_used_bytes "appmesh_host_filesystem_used_bytes"
+#define PROM_METRIC_HELP_appmesh_host_filesystem_used_bytes "filesystem used bytes"
+#define PROM_METRIC_NAME_appmesh_host_filesystem_avail_bytes "appmesh_host_filesystem_avail_bytes"
+#define PROM_METRIC_HELP_appmesh_host_filesystem_avail_bytes "filesystem bytes available to non-root users"
+#define PROM_METRIC_NAME_appmesh_host_network_receive_bytes_total "appmesh_host_network_receive_bytes_total"
+#define PROM_METRIC_HELP_appmesh_host_network_receive_bytes_total "network interface received bytes"
+#define PROM_METRIC_NAME_appmesh_host_network_receive_packets_total "appmesh_host_network_receive_packets_total"
+#define PROM_METRIC_HELP_appmesh_host_network_receive_packets_total "network interface received packets"
+#define PROM_METRIC_NAME_appmesh_host_network_transmit_bytes_total "appmesh_host_network_transmit_bytes_total"
+#define PROM_METRIC_HELP_appmesh_host_network_transmit_bytes_total "network interface transmitted bytes"
+#define PROM_METRIC_NAME_appmesh_host_network_transmit_packets_total "appmesh_host_network_transmit_packets_total"
+#define PROM_METRIC_HELP_appmesh_host_network_transmit_packets_total "network interface transmitted packets"
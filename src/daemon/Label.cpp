@@ -1,4 +1,5 @@
 #include "Label.h"
+#include "LabelSelector.h"
 #include "../common/Utility.h"
 #ifdef __GNUC__
 #include <features.h>
@@ -84,3 +85,15 @@ bool Label::match(const std::shared_ptr<Label> &condition) const
 	}
 	return true;
 }
+
+bool Label::match(const LabelSelector &selector) const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return selector.match(m_labels);
+}
+
+const std::map<std::string, std::string> Label::getLabels() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_labels;
+}
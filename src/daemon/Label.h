@@ -6,6 +6,8 @@
 #include <mutex>
 #include <cpprest/json.h>
 
+class LabelSelector;
+
 //////////////////////////////////////////////////////////////////////////
 /// Label
 //////////////////////////////////////////////////////////////////////////
@@ -23,6 +25,9 @@ public:
 	void delLabel(const std::string &name);
 
 	bool match(const std::shared_ptr<Label> &condition) const;
+	/// Match with pre-compiled condition, used for frequent match
+	bool match(const LabelSelector &selector) const;
+	const std::map<std::string, std::string> getLabels() const;
 
 private:
 	std::map<std::string, std::string> m_labels;
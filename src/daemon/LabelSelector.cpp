@@ -0,0 +1,169 @@
+#include "LabelSelector.h"
+#include "Label.h"
+#ifdef __GNUC__
+#include <features.h>
+#if __GNUC_PREREQ(5, 4)
+#include "../common/wildcards/wildcards.hpp"
+#endif
+#endif
+
+LabelSelector::LabelSelector(const std::shared_ptr<Label> &condition)
+	: m_matchNothing(condition == nullptr)
+{
+	if (!condition)
+		return;
+	for (const auto &la : condition->getLabels())
+	{
+		const auto &key = la.first;
+		const auto &val = la.second;
+#if __GNUC_PREREQ(5, 4)
+		// value without wildcard character only match itself
+		if (val.find_first_of("*?\\[]()|") != std::string::npos)
+		{
+			// matcher keep iterators of pattern, hold pattern in heap
+			auto pattern = std::make_shared<const std::string>(val);
+			auto matcher = wildcards::make_matcher(*pattern);
+			m_patterns[key] = [pattern, matcher](const std::string &value) {
+				return value == *pattern || matcher.matches(value);
+			};
+			continue;
+		}
+#endif
+		m_exact[key] = val;
+	}
+}
+
+LabelSelector::~LabelSelector()
+{
+}
+
+bool LabelSelector::match(const std::map<std::string, std::string> &labels) const
+{
+	if (m_matchNothing)
+		return false;
+	for (const auto &exact : m_exact)
+	{
+		auto label = labels.find(exact.first);
+		if (label == labels.end() || label->second != exact.second)
+			return false;
+	}
+	for (const auto &pattern : m_patterns)
+	{
+		auto label = labels.find(pattern.first);
+		if (label == labels.end() || !pattern.second(label->second))
+			return false;
+	}
+	return true;
+}
+
+bool LabelSelector::matchValue(const std::string &key, const std::string &value) const
+{
+	auto exact = m_exact.find(key);
+	if (exact != m_exact.end())
+		return exact->second == value;
+	auto pattern = m_patterns.find(key);
+	if (pattern != m_patterns.end())
+		return pattern->second(value);
+	return true;
+}
+
+void LabelIndex::add(std::size_t id, const std::shared_ptr<Label> &label)
+{
+	remove(id);
+	auto &labels = m_labels[id];
+	labels = label->getLabels();
+	for (const auto &la : labels)
+	{
+		m_index[la.first][la.second].insert(id);
+	}
+}
+
+void LabelIndex::remove(std::size_t id)
+{
+	auto exist = m_labels.find(id);
+	if (exist == m_labels.end())
+		return;
+	for (const auto &la : exist->second)
+	{
+		auto &values = m_index[la.first];
+		auto &ids = values[la.second];
+		ids.erase(id);
+		if (ids.empty())
+			values.erase(la.second);
+		if (values.empty())
+			m_index.erase(la.first);
+	}
+	m_labels.erase(exist);
+}
+
+void LabelIndex::clear()
+{
+	m_index.clear();
+	m_labels.clear();
+}
+
+std::vector<bool> LabelIndex::candidates(const LabelSelector &selector, std::size_t &count) const
+{
+	count = 0;
+	std::vector<bool> result(m_labels.empty() ? 0 : m_labels.rbegin()->first + 1, false);
+	if (selector.m_matchNothing)
+		return result;
+
+	// smallest node set of exact conditions
+	const std::set<std::size_t> *candidateIds = nullptr;
+	for (const auto &exact : selector.m_exact)
+	{
+		auto ids = lookup(exact.first, exact.second);
+		if (ids == nullptr)
+			return result;
+		if (candidateIds == nullptr || ids->size() < candidateIds->size())
+			candidateIds = ids;
+	}
+
+	// no exact condition, union nodes of label values match the first wildcard, each value is matched once
+	std::set<std::size_t> patternIds;
+	if (candidateIds == nullptr && selector.m_patterns.size())
+	{
+		const auto &pattern = *selector.m_patterns.begin();
+		auto values = m_index.find(pattern.first);
+		if (values == m_index.end())
+			return result;
+		for (const auto &value : values->second)
+		{
+			if (pattern.second(value.first))
+				patternIds.insert(value.second.begin(), value.second.end());
+		}
+		candidateIds = &patternIds;
+	}
+
+	if (candidateIds == nullptr)
+	{
+		// empty condition match all nodes
+		for (const auto &node : m_labels)
+		{
+			result[node.first] = true;
+		}
+		count = m_labels.size();
+		return result;
+	}
+	for (const auto &id : *candidateIds)
+	{
+		if (selector.match(m_labels.at(id)))
+		{
+			result[id] = true;
+			++count;
+		}
+	}
+	return result;
+}
+
+const std::set<std::size_t> *LabelIndex::lookup(const std::string &key, const std::string &value) const
+{
+	auto values = m_index.find(key);
+	if (values == m_index.end())
+		return nullptr;
+	auto ids = values->second.find(value);
+	if (ids == values->second.end())
+		return nullptr;
+	return &(ids->second);
+}
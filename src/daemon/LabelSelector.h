@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Label;
+
+//////////////////////////////////////////////////////////////////////////
+/// Label condition compiled once: exact values in hash map and wildcard
+/// values as compiled matchers
+//////////////////////////////////////////////////////////////////////////
+class LabelSelector
+{
+public:
+	explicit LabelSelector(const std::shared_ptr<Label> &condition);
+	virtual ~LabelSelector();
+
+	/// Same result with Label::match(condition)
+	bool match(const std::map<std::string, std::string> &labels) const;
+	bool matchValue(const std::string &key, const std::string &value) const;
+
+private:
+	friend class LabelIndex;
+	// null condition match nothing
+	bool m_matchNothing;
+	// label key -> value
+	std::unordered_map<std::string, std::string> m_exact;
+	// label key -> compiled wildcard matcher
+	std::unordered_map<std::string, std::function<bool(const std::string &)>> m_patterns;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Index node labels by key and value, node is identified by id
+//////////////////////////////////////////////////////////////////////////
+class LabelIndex
+{
+public:
+	void add(std::size_t id, const std::shared_ptr<Label> &label);
+	void remove(std::size_t id);
+	void clear();
+
+	/// Bitmap of matched node id, candidates come from index intersection
+	std::vector<bool> candidates(const LabelSelector &selector, std::size_t &count) const;
+
+private:
+	const std::set<std::size_t> *lookup(const std::string &key, const std::string &value) const;
+
+	// label key -> label value -> node ids
+	std::unordered_map<std::string, std::unordered_map<std::string, std::set<std::size_t>>> m_index;
+	// node id -> labels
+	std::map<std::size_t, std::map<std::string, std::string>> m_labels;
+};
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <stdexcept>
+#include "PlacementStrategy.h"
+#include "ResourceLimitation.h"
+#include "process/CpuSetAllocator.h"
+#include "../common/Utility.h"
+
+ResourceRequest::ResourceRequest()
+	: m_cpu(0), m_memoryBytes(0)
+{
+}
+
+ResourceRequest ResourceRequest::FromLimitation(const std::shared_ptr<ResourceLimitation> &limit)
+{
+	ResourceRequest request;
+	if (limit)
+	{
+		request.m_memoryBytes = static_cast<uint64_t>(std::max(limit->m_memoryMb, 0)) * 1024 * 1024;
+		if (limit->m_exclusiveCpus > 0)
+		{
+			request.m_cpu = limit->m_exclusiveCpus;
+		}
+		else if (limit->m_cpuSet.length())
+		{
+			request.m_cpu = CpuSetAllocator::parseCpuList(limit->m_cpuSet).size();
+		}
+		else if (limit->m_cpuQuotaUs > 0)
+		{
+			auto period = limit->m_cpuPeriodUs > 0 ? limit->m_cpuPeriodUs : DEFAULT_CGROUP_CPU_PERIOD_US;
+			request.m_cpu = double(limit->m_cpuQuotaUs) / period;
+		}
+		else if (limit->m_cpuShares > 0)
+		{
+			request.m_cpu = double(limit->m_cpuShares) / 1024;
+		}
+	}
+	return request;
+}
+
+bool ResourceRequest::operator<(const ResourceRequest &other) const
+{
+	if (m_memoryBytes != other.m_memoryBytes)
+		return m_memoryBytes < other.m_memoryBytes;
+	return m_cpu < other.m_cpu;
+}
+
+NodeUsage::NodeUsage()
+	: m_cpuCapacity(0), m_memoryCapacity(0), m_memoryFree(0), m_cpuRequested(0), m_memoryRequested(0), m_replicas(0)
+{
+}
+
+bool NodeUsage::fit(const ResourceRequest &request) const
+{
+	if (m_cpuCapacity > 0 && m_cpuRequested + request.m_cpu > m_cpuCapacity)
+		return false;
+	if (m_memoryCapacity > 0 && m_memoryRequested + request.m_memoryBytes > m_memoryCapacity)
+		return false;
+	// node is already saturated by processes not requested here
+	if (m_memoryFree > 0 && request.m_memoryBytes > m_memoryFree)
+		return false;
+	return true;
+}
+
+void NodeUsage::add(const ResourceRequest &request)
+{
+	m_cpuRequested += request.m_cpu;
+	m_memoryRequested += request.m_memoryBytes;
+	++m_replicas;
+}
+
+void NodeUsage::remove(const ResourceRequest &request)
+{
+	m_cpuRequested = std::max(m_cpuRequested - request.m_cpu, 0.0);
+	m_memoryRequested -= std::min(m_memoryRequested, request.m_memoryBytes);
+	if (m_replicas)
+		--m_replicas;
+}
+
+double NodeUsage::utilization(const ResourceRequest &request) const
+{
+	double total = 0;
+	int dimensions = 0;
+	if (m_cpuCapacity > 0)
+	{
+		total += std::min((m_cpuRequested + request.m_cpu) / m_cpuCapacity, 1.0);
+		++dimensions;
+	}
+	if (m_memoryCapacity > 0)
+	{
+		total += std::min(double(m_memoryRequested + request.m_memoryBytes) / m_memoryCapacity, 1.0);
+		++dimensions;
+	}
+	return dimensions ? total / dimensions : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Spread replicas, node with fewest replicas first
+//////////////////////////////////////////////////////////////////////////
+class SpreadStrategy : public PlacementStrategy
+{
+public:
+	const std::string name() const override { return SCHEDULE_STRATEGY_SPREAD; }
+	double score(const NodeUsage &node, const ResourceRequest &request) const override
+	{
+		return -double(node.m_replicas);
+	}
+	bool replicaOrdered() const override { return true; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Best-fit decreasing, larger task first and the fullest node which still fit
+//////////////////////////////////////////////////////////////////////////
+class BinPackStrategy : public PlacementStrategy
+{
+public:
+	const std::string name() const override { return SCHEDULE_STRATEGY_BINPACK; }
+	double score(const NodeUsage &node, const ResourceRequest &request) const override
+	{
+		return node.utilization(request);
+	}
+	bool largestFirst() const override { return true; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Node with the most unrequested CPU and memory first
+//////////////////////////////////////////////////////////////////////////
+class LeastRequestedStrategy : public PlacementStrategy
+{
+public:
+	const std::string name() const override { return SCHEDULE_STRATEGY_LEAST_REQUESTED; }
+	double score(const NodeUsage &node, const ResourceRequest &request) const override
+	{
+		return 1 - node.utilization(request);
+	}
+};
+
+std::shared_ptr<PlacementStrategy> PlacementStrategy::create(const std::string &name)
+{
+	if (name.empty() || name == SCHEDULE_STRATEGY_SPREAD)
+		return std::make_shared<SpreadStrategy>();
+	if (name == SCHEDULE_STRATEGY_BINPACK)
+		return std::make_shared<BinPackStrategy>();
+	if (name == SCHEDULE_STRATEGY_LEAST_REQUESTED)
+		return std::make_shared<LeastRequestedStrategy>();
+	throw std::invalid_argument(Utility::stringFormat("unsupported schedule strategy <%s>", name.c_str()));
+}
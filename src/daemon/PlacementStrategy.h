@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class ResourceLimitation;
+
+//////////////////////////////////////////////////////////////////////////
+/// CPU and memory requested by one task replica
+//////////////////////////////////////////////////////////////////////////
+struct ResourceRequest
+{
+	ResourceRequest();
+	/// exclusive cores > cpu set > cpu quota > cpu shares (1024 shares as one core)
+	static ResourceRequest FromLimitation(const std::shared_ptr<ResourceLimitation> &limit);
+	bool operator<(const ResourceRequest &other) const;
+
+	double m_cpu; // cores
+	uint64_t m_memoryBytes;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Node capacity and resource requested by placed replicas
+//////////////////////////////////////////////////////////////////////////
+struct NodeUsage
+{
+	NodeUsage();
+	/// unknown (zero) capacity is regarded as unlimited
+	bool fit(const ResourceRequest &request) const;
+	void add(const ResourceRequest &request);
+	void remove(const ResourceRequest &request);
+	/// requested percentage of capacity after place request, average of known dimensions, 0~1
+	double utilization(const ResourceRequest &request) const;
+
+	double m_cpuCapacity;
+	uint64_t m_memoryCapacity;
+	// free memory reported by node, 0 means not reported
+	uint64_t m_memoryFree;
+	double m_cpuRequested;
+	uint64_t m_memoryRequested;
+	std::size_t m_replicas;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Choose node for task replica among nodes which fit the request
+//////////////////////////////////////////////////////////////////////////
+class PlacementStrategy
+{
+public:
+	virtual ~PlacementStrategy(){};
+	virtual const std::string name() const = 0;
+	/// Higher score node is preferred
+	virtual double score(const NodeUsage &node, const ResourceRequest &request) const = 0;
+	/// Place tasks with larger request first (best-fit decreasing)
+	virtual bool largestFirst() const { return false; }
+	/// Score only depends on replica count, scheduler can walk nodes by load order directly
+	virtual bool replicaOrdered() const { return false; }
+
+	/// Create strategy by name: spread, binpack, least_requested
+	static std::shared_ptr<PlacementStrategy> create(const std::string &name) noexcept(false);
+};
@@ -1,8 +1,9 @@
 #include "ResourceLimitation.h"
+#include "process/CpuSetAllocator.h"
 #include "../common/Utility.h"
 
 ResourceLimitation::ResourceLimitation()
-	: m_memoryMb(0), m_memoryVirtMb(0), m_cpuShares(0), m_index(0)
+	: m_memoryMb(0), m_memoryVirtMb(0), m_cpuShares(0), m_cpuQuotaUs(0), m_cpuPeriodUs(0), m_exclusiveCpus(0)
 {
 }
 
@@ -17,6 +18,11 @@ bool ResourceLimitation::operator==(const std::shared_ptr<ResourceLimitation> &o
 	return (m_cpuShares == obj->m_cpuShares &&
 			m_memoryMb == obj->m_memoryMb &&
 			m_memoryVirtMb == obj->m_memoryVirtMb &&
+			m_cpuQuotaUs == obj->m_cpuQuotaUs &&
+			m_cpuPeriodUs == obj->m_cpuPeriodUs &&
+			m_cpuSet == obj->m_cpuSet &&
+			m_exclusiveCpus == obj->m_exclusiveCpus &&
+			m_memoryNodes == obj->m_memoryNodes &&
 			m_name == obj->m_name);
 }
 
@@ -27,6 +33,11 @@ void ResourceLimitation::dump()
 	LOG_DBG << fname << "m_memoryMb:" << m_memoryMb;
 	LOG_DBG << fname << "m_memoryVirtMb:" << m_memoryVirtMb;
 	LOG_DBG << fname << "m_cpuShares:" << m_cpuShares;
+	LOG_DBG << fname << "m_cpuQuotaUs:" << m_cpuQuotaUs;
+	LOG_DBG << fname << "m_cpuPeriodUs:" << m_cpuPeriodUs;
+	LOG_DBG << fname << "m_cpuSet:" << m_cpuSet;
+	LOG_DBG << fname << "m_exclusiveCpus:" << m_exclusiveCpus;
+	LOG_DBG << fname << "m_memoryNodes:" << m_memoryNodes;
 }
 
 web::json::value ResourceLimitation::AsJson()
@@ -36,6 +47,16 @@ web::json::value ResourceLimitation::AsJson()
 	result[JSON_KEY_RESOURCE_LIMITATION_memory_mb] = web::json::value::number(m_memoryMb);
 	result[JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb] = web::json::value::number(m_memoryVirtMb);
 	result[JSON_KEY_RESOURCE_LIMITATION_cpu_shares] = web::json::value::number(m_cpuShares);
+	if (m_cpuQuotaUs)
+		result[JSON_KEY_RESOURCE_LIMITATION_cpu_quota_us] = web::json::value::number(m_cpuQuotaUs);
+	if (m_cpuPeriodUs)
+		result[JSON_KEY_RESOURCE_LIMITATION_cpu_period_us] = web::json::value::number(m_cpuPeriodUs);
+	if (m_cpuSet.length())
+		result[JSON_KEY_RESOURCE_LIMITATION_cpu_set] = web::json::value::string(m_cpuSet);
+	if (m_exclusiveCpus)
+		result[JSON_KEY_RESOURCE_LIMITATION_exclusive_cpus] = web::json::value::number(m_exclusiveCpus);
+	if (m_memoryNodes.length())
+		result[JSON_KEY_RESOURCE_LIMITATION_memory_nodes] = web::json::value::string(m_memoryNodes);
 	return result;
 }
 
@@ -48,13 +69,43 @@ std::shared_ptr<ResourceLimitation> ResourceLimitation::FromJson(const web::json
 		result->m_memoryMb = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_memory_mb);
 		result->m_memoryVirtMb = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb);
 		result->m_cpuShares = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_cpu_shares);
+		result->m_cpuQuotaUs = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_cpu_quota_us);
+		result->m_cpuPeriodUs = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_cpu_period_us);
+		result->m_cpuSet = GET_JSON_STR_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_cpu_set);
+		result->m_exclusiveCpus = GET_JSON_INT_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_exclusive_cpus);
+		result->m_memoryNodes = GET_JSON_STR_VALUE(jsonObj, JSON_KEY_RESOURCE_LIMITATION_memory_nodes);
 		result->m_name = appName;
 		if (0 == result->m_memoryMb &&
 			0 == result->m_memoryVirtMb &&
-			0 == result->m_cpuShares)
+			0 == result->m_cpuShares &&
+			0 == result->m_cpuQuotaUs &&
+			result->m_cpuSet.empty() &&
+			0 == result->m_exclusiveCpus &&
+			result->m_memoryNodes.empty())
 		{
 			return nullptr;
 		}
+
+		// cgroup reject quota less than 1ms and period out of [1ms, 1s]
+		if (result->m_cpuQuotaUs < 0 || (result->m_cpuQuotaUs > 0 && result->m_cpuQuotaUs < 1000))
+		{
+			throw std::invalid_argument("cpu_quota_us should not less than 1000");
+		}
+		if (result->m_cpuPeriodUs != 0 && (result->m_cpuPeriodUs < 1000 || result->m_cpuPeriodUs > 1000000))
+		{
+			throw std::invalid_argument("cpu_period_us should between 1000 and 1000000");
+		}
+		if (result->m_cpuSet.length() && result->m_exclusiveCpus > 0)
+		{
+			throw std::invalid_argument("cpu_set and exclusive_cpus can not be set together");
+		}
+		if (result->m_exclusiveCpus < 0)
+		{
+			throw std::invalid_argument("exclusive_cpus should not be negative");
+		}
+		// throw for invalid cpu list format
+		CpuSetAllocator::parseCpuList(result->m_cpuSet);
+		CpuSetAllocator::parseCpuList(result->m_memoryNodes);
 	}
 	return result;
 }
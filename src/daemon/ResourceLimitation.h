@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cpprest/json.h>
+#include <memory>
 #include <string>
 
+class LinuxCgroup;
 //////////////////////////////////////////////////////////////////////////
 /// Define the application resource usage limitation
 //////////////////////////////////////////////////////////////////////////
@@ -20,8 +22,16 @@ public:
 	int m_memoryMb;
 	int m_memoryVirtMb;
 	int m_cpuShares;
+	// hard cpu limit: m_cpuQuotaUs of CPU time in each m_cpuPeriodUs
+	int m_cpuQuotaUs;
+	int m_cpuPeriodUs;
+	// cpu pinning: explicit cpu list or count of auto allocated exclusive cores
+	std::string m_cpuSet;
+	int m_exclusiveCpus;
+	// NUMA memory nodes, empty means the nodes of pinned cores
+	std::string m_memoryNodes;
 
 	// runtime info
 	std::string m_name;
-	int m_index;
+	std::shared_ptr<LinuxCgroup> m_cgroup;
 };
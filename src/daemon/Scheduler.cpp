@@ -1,127 +1,553 @@
 #include <algorithm>
+#include <limits>
+#include <vector>
 #include "Scheduler.h"
+#include "Label.h"
+#include "application/Application.h"
 #include "../common/Utility.h"
 #include "rest/ConsulEntity.h"
 
-std::map<std::string, std::shared_ptr<ConsulTopology>> Scheduler::scheduleTask(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskMap, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology)
+Scheduler::Scheduler()
+	: m_strategy(PlacementStrategy::create(SCHEDULE_STRATEGY_SPREAD))
 {
-	const static char fname[] = "Scheduler::scheduleTask() ";
-	LOG_DBG << fname;
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+Scheduler::TaskState::TaskState()
+	: m_matchedCount(0)
+{
+}
+
+bool Scheduler::TaskState::matched(std::size_t nodeId) const
+{
+	return nodeId < m_matchedHosts.size() && m_matchedHosts[nodeId];
+}
+
+void Scheduler::TaskState::setMatched(std::size_t nodeId, bool matched)
+{
+	if (this->matched(nodeId) == matched)
+		return;
+	if (nodeId >= m_matchedHosts.size())
+		m_matchedHosts.resize(nodeId + 1, false);
+	m_matchedHosts[nodeId] = matched;
+	matched ? ++m_matchedCount : --m_matchedCount;
+}
+
+// refresh node capacity, return true if capacity changed
+static bool updateCapacity(NodeUsage &usage, const std::shared_ptr<ConsulNode> &node)
+{
+	bool changed = (usage.m_cpuCapacity != node->m_cores || usage.m_memoryCapacity != node->m_total_bytes || usage.m_memoryFree != node->m_free_bytes);
+	usage.m_cpuCapacity = node->m_cores;
+	usage.m_memoryCapacity = node->m_total_bytes;
+	usage.m_memoryFree = node->m_free_bytes;
+	return changed;
+}
+
+std::map<std::string, std::shared_ptr<ConsulTopology>> Scheduler::schedule(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskMap, const std::map<std::string, std::shared_ptr<ConsulNode>> &nodes, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology)
+{
+	const static char fname[] = "Scheduler::schedule() ";
 
-	// key: hostname, value: task list
-	std::map<std::string, std::shared_ptr<ConsulTopology>> newTopology;
+	if (!sameTopology(oldTopology))
+	{
+		// first schedule or topology was written by other leader
+		LOG_INF << fname << "topology changed outside, rebuild schedule state";
+		reset();
+		seed(oldTopology);
+	}
 
-	// ignore old schedule
+	// removed tasks
+	std::vector<std::string> removed;
+	for (const auto &task : m_tasks)
+	{
+		if (taskMap.count(task.first) == 0)
+			removed.push_back(task.first);
+	}
+	for (const auto &taskName : removed)
+	{
+		removeTask(taskName);
+	}
+
+	// departed nodes
+	removed.clear();
+	for (const auto &node : m_nodes)
+	{
+		if (nodes.count(node.first) == 0)
+			removed.push_back(node.first);
+	}
+	for (const auto &host : removed)
+	{
+		removeNode(host);
+	}
+
+	// joined or changed nodes and tasks, unchanged ones return immediately
+	for (const auto &node : nodes)
+	{
+		addNode(node.second);
+	}
 	for (const auto &task : taskMap)
 	{
-		const auto &taskName = task.first;
-		auto &taskDedicateHosts = task.second->m_matchedHosts;
-		auto &taskReplication = task.second->m_replication;
-		auto &taskIndexDic = task.second->m_taskIndexDic;
-		if (taskReplication <= 0)
-			continue;
+		addTask(task.first, task.second);
+	}
+	m_seeds.clear();
+
+	placePendingTasks();
+	return topology();
+}
 
-		for (const auto &oldHost : oldTopology)
+void Scheduler::addNode(const std::shared_ptr<ConsulNode> &node)
+{
+	const static char fname[] = "Scheduler::addNode() ";
+
+	auto exist = m_nodes.find(node->m_hostName);
+	if (exist != m_nodes.end())
+	{
+		if (exist->second.m_node == node)
+			return;
+		if (exist->second.m_node->m_label->operator==(node->m_label))
 		{
-			auto &oldHostName = oldHost.first;
-			auto &oldTaskSet = oldHost.second->m_scheduleApps;
-			if (taskDedicateHosts.count(oldHostName) && oldTaskSet.count(taskName))
+			// label not changed, match result is the same, capacity change may fit more replicas
+			exist->second.m_node = node;
+			if (updateCapacity(exist->second.m_usage, node))
 			{
-				auto oldTaskIndex = oldTaskSet[taskName];
-				auto consulNode = taskDedicateHosts[oldHostName];
-				// found app running on old host still match
-				if (taskReplication <= 0)
+				for (const auto &task : m_tasks)
 				{
-					LOG_DBG << fname << " task <" << taskName << "> over running";
-					break;
+					if (task.second.matched(exist->second.m_id) && task.second.m_placements.size() < task.second.m_task->m_replication)
+						m_pendingTasks.insert(task.first);
 				}
-				taskDedicateHosts.erase(oldHostName);
-				if (taskIndexDic.count(oldTaskIndex))
-					taskIndexDic.erase(oldTaskIndex);
-				--taskReplication;
+			}
+			return;
+		}
+		removeNode(node->m_hostName);
+	}
+
+	LOG_DBG << fname << "node <" << node->m_hostName << "> joined";
+	auto &state = m_nodes[node->m_hostName];
+	state.m_node = node;
+	updateCapacity(state.m_usage, node);
+	if (m_freeNodeIds.size())
+	{
+		state.m_id = m_freeNodeIds.back();
+		m_freeNodeIds.pop_back();
+		m_nodeNames[state.m_id] = node->m_hostName;
+	}
+	else
+	{
+		state.m_id = m_nodeNames.size();
+		m_nodeNames.push_back(node->m_hostName);
+	}
+	m_nodeQueue.insert(std::make_pair(std::size_t(0), node->m_hostName));
+	m_labelIndex.add(state.m_id, node->m_label);
+	for (auto &task : m_tasks)
+	{
+		if (node->m_label->match(*task.second.m_selector))
+		{
+			task.second.setMatched(state.m_id, true);
+			if (task.second.m_placements.size() < task.second.m_task->m_replication)
+				m_pendingTasks.insert(task.first);
+		}
+	}
+}
 
-				LOG_DBG << fname << " task <" << taskName << "> already running on host <" << oldHostName << ">";
+void Scheduler::removeNode(const std::string &host)
+{
+	const static char fname[] = "Scheduler::removeNode() ";
 
-				{
-					// save to topology
-					if (!newTopology.count(oldHostName))
-						newTopology[oldHostName] = std::make_shared<ConsulTopology>();
-					newTopology[oldHostName]->m_scheduleApps[taskName] = oldTaskIndex;
-					consulNode->assignApp(task.second->m_app);
-				}
-			}
+	auto exist = m_nodes.find(host);
+	if (exist == m_nodes.end())
+		return;
+
+	LOG_DBG << fname << "node <" << host << "> departed";
+	auto placedTasks = exist->second.m_placedTasks;
+	for (const auto &placed : placedTasks)
+	{
+		auto &task = m_tasks[placed.first];
+		unassign(placed.first, task, host);
+		m_pendingTasks.insert(placed.first);
+	}
+	for (auto &task : m_tasks)
+	{
+		task.second.setMatched(exist->second.m_id, false);
+	}
+	m_nodeQueue.erase(std::make_pair(std::size_t(0), host));
+	m_labelIndex.remove(exist->second.m_id);
+	m_nodeNames[exist->second.m_id].clear();
+	m_freeNodeIds.push_back(exist->second.m_id);
+	m_nodes.erase(exist);
+}
+
+void Scheduler::addTask(const std::string &taskName, const std::shared_ptr<ConsulTask> &task)
+{
+	const static char fname[] = "Scheduler::addTask() ";
+
+	auto exist = m_tasks.find(taskName);
+	if (exist != m_tasks.end())
+	{
+		if (exist->second.m_task == task)
+			return;
+		if (exist->second.m_task->operator==(task))
+		{
+			exist->second.m_task = task;
+			return;
 		}
 	}
 
-	// do schedule
-	for (const auto &task : taskMap)
+	LOG_DBG << fname << "task <" << taskName << "> added or changed";
+	auto &state = m_tasks[taskName];
+	state.m_task = task;
+
+	// resource request changed, update usage of placed nodes
+	auto request = ResourceRequest::FromLimitation(task->m_app ? task->m_app->getResourceLimit() : nullptr);
+	for (const auto &placement : state.m_placements)
 	{
-		// get current task
-		const auto &taskDedicateHosts = task.second->m_matchedHosts;
-		auto &taskReplication = task.second->m_replication;
-		auto &taskIndexDic = task.second->m_taskIndexDic;
-		const auto &taskName = task.first;
-		std::vector<std::shared_ptr<ConsulNode>> taskDedicateHostsVec;
+		auto &usage = m_nodes[placement.first].m_usage;
+		usage.remove(state.m_request);
+		usage.add(request);
+	}
+	state.m_request = request;
 
-		LOG_DBG << fname << "schedule task <" << taskName << ">";
-		if (taskReplication <= 0)
-			continue;
+	// match nodes from label index, remove replicas from nodes no longer match
+	state.m_selector = std::make_shared<LabelSelector>(task->m_condition);
+	state.m_matchedHosts = m_labelIndex.candidates(*state.m_selector, state.m_matchedCount);
+	auto placed = state.m_placements;
+	for (const auto &placement : placed)
+	{
+		if (!state.matched(m_nodes[placement.first].m_id))
+			unassign(taskName, state, placement.first);
+	}
 
-		// copy to vector
-		std::transform(taskDedicateHosts.begin(), taskDedicateHosts.end(), std::back_inserter(taskDedicateHostsVec),
-					   [](const std::pair<std::string, std::shared_ptr<ConsulNode>> host) { return host.second; });
-		// sort hosts
-		// return left < right is Ascending
-		// return left > right is Descending
-		std::sort(taskDedicateHostsVec.begin(), taskDedicateHostsVec.end(),
-				  [](const std::shared_ptr<ConsulNode> &left, const std::shared_ptr<ConsulNode> &right) {
-					  if (left->m_assignedApps.size() < right->m_assignedApps.size())
-					  {
-						  return true;
-					  }
-					  else if (left->m_assignedApps.size() == right->m_assignedApps.size())
-					  {
-						  return (left->getAssignedAppMem() < right->getAssignedAppMem());
-					  }
-					  else
-					  {
-						  return false;
-					  }
-				  });
-
-		if (taskReplication > taskDedicateHostsVec.size())
+	// keep old placement from topology
+	auto seed = m_seeds.find(taskName);
+	if (seed != m_seeds.end())
+	{
+		std::set<int> usedIndex;
+		for (const auto &placement : state.m_placements)
 		{
-			LOG_WAR << fname << taskName << " : Replication <" << taskReplication << "> Dedicate Host < " << taskDedicateHostsVec.size() << ">";
+			usedIndex.insert(placement.second);
 		}
-		// assign host to task
-		for (std::size_t i = 0; i < taskReplication; i++)
+		for (const auto &placement : seed->second)
 		{
-			if (i < taskDedicateHostsVec.size())
+			auto node = m_nodes.find(placement.first);
+			if (state.m_placements.size() < task->m_replication && node != m_nodes.end() && state.matched(node->second.m_id) &&
+				state.m_placements.count(placement.first) == 0 && usedIndex.insert(placement.second).second)
 			{
-				const auto &hostname = taskDedicateHostsVec[i]->m_hostName;
-				const auto &consulNode = taskDedicateHostsVec[i];
-				// save to topology
-				{
-					if (!newTopology.count(hostname))
-						newTopology[hostname] = std::make_shared<ConsulTopology>();
-					int selectedIndex = -1;
-					if (taskIndexDic.size())
-					{
-						selectedIndex = *(taskIndexDic.begin());
-						taskIndexDic.erase(taskIndexDic.begin());
-					}
-					newTopology[hostname]->m_scheduleApps[taskName] = selectedIndex;
-					consulNode->assignApp(task.second->m_app);
-				}
-				LOG_DBG << fname << " task <" << taskName << "> assigned to host < " << hostname << ">";
-				task.second->dump();
+				assign(taskName, state, placement.first, placement.second);
+			}
+		}
+		m_seeds.erase(seed);
+	}
+
+	// replication decreased, release invalid index first, then replicas on most loaded nodes
+	auto placements = state.m_placements;
+	for (const auto &placement : placements)
+	{
+		if (placement.second < 1 || placement.second > static_cast<int>(task->m_replication))
+			unassign(taskName, state, placement.first);
+	}
+	while (state.m_placements.size() > task->m_replication)
+	{
+		auto busiest = std::max_element(state.m_placements.begin(), state.m_placements.end(),
+										[this](const std::pair<const std::string, int> &a, const std::pair<const std::string, int> &b) {
+											return m_nodes[a.first].m_placedTasks.size() < m_nodes[b.first].m_placedTasks.size();
+										});
+		unassign(taskName, state, busiest->first);
+	}
+
+	if (state.m_placements.size() < task->m_replication)
+		m_pendingTasks.insert(taskName);
+}
+
+void Scheduler::removeTask(const std::string &taskName)
+{
+	const static char fname[] = "Scheduler::removeTask() ";
+
+	auto exist = m_tasks.find(taskName);
+	if (exist == m_tasks.end())
+		return;
+
+	LOG_DBG << fname << "task <" << taskName << "> removed";
+	auto placements = exist->second.m_placements;
+	for (const auto &placement : placements)
+	{
+		unassign(taskName, exist->second, placement.first);
+	}
+	m_pendingTasks.erase(taskName);
+	m_tasks.erase(exist);
+}
+
+void Scheduler::placePendingTasks()
+{
+	const static char fname[] = "Scheduler::placePendingTasks() ";
+
+	// lower priority tasks can not preempt anyone
+	int lowestPriority = std::numeric_limits<int>::max();
+	for (const auto &task : m_tasks)
+	{
+		lowestPriority = std::min(lowestPriority, task.second.m_task->m_priority);
+	}
+
+	std::size_t preemptions = 0;
+	auto pendingTasks = orderTasks(m_pendingTasks);
+	while (pendingTasks.size())
+	{
+		// evicted replicas are re-placed in next round
+		std::set<std::string> evictedTasks;
+		for (const auto &taskName : pendingTasks)
+		{
+			auto &task = m_tasks[taskName];
+			placeTask(taskName, task);
+			while (task.m_placements.size() < task.m_task->m_replication && task.m_task->m_priority > lowestPriority &&
+				   preemptions < SCHEDULE_MAX_PREEMPTIONS_PER_PASS)
+			{
+				std::set<std::string> victims;
+				if (!preemptTask(taskName, task, SCHEDULE_MAX_PREEMPTIONS_PER_PASS - preemptions, victims))
+					break;
+				preemptions += victims.size();
+				evictedTasks.insert(victims.begin(), victims.end());
+			}
+			if (task.m_placements.size() >= task.m_task->m_replication)
+			{
+				m_pendingTasks.erase(taskName);
 			}
 			else
 			{
-				break;
+				LOG_WAR << fname << taskName << " : Replication <" << task.m_task->m_replication << "> Placed <" << task.m_placements.size() << "> Dedicate Host <" << task.m_matchedCount << ">";
 			}
 		}
+		pendingTasks = orderTasks(evictedTasks);
+	}
+}
+
+std::vector<std::string> Scheduler::orderTasks(const std::set<std::string> &taskNames)
+{
+	// higher priority first, then larger request first for best-fit strategy, then name
+	std::vector<std::string> result(taskNames.begin(), taskNames.end());
+	bool largestFirst = m_strategy->largestFirst();
+	std::stable_sort(result.begin(), result.end(),
+					 [this, largestFirst](const std::string &a, const std::string &b) {
+						 const auto &left = m_tasks[a];
+						 const auto &right = m_tasks[b];
+						 if (left.m_task->m_priority != right.m_task->m_priority)
+							 return left.m_task->m_priority > right.m_task->m_priority;
+						 return largestFirst && right.m_request < left.m_request;
+					 });
+	return result;
+}
+
+void Scheduler::placeTask(const std::string &taskName, TaskState &task)
+{
+	const static char fname[] = "Scheduler::placeTask() ";
+
+	if (task.m_placements.size() >= task.m_task->m_replication)
+		return;
+	auto needed = task.m_task->m_replication - task.m_placements.size();
+
+	// pick matched nodes which do not run this task yet and have enough resource
+	auto candidates = selectNodes(task, needed);
+	for (const auto &host : candidates)
+	{
+		auto index = freeIndex(task);
+		assign(taskName, task, host, index);
+		LOG_DBG << fname << " task <" << taskName << "> assigned to host <" << host << "> with index <" << index << ">";
+	}
+}
+
+bool Scheduler::preemptTask(const std::string &taskName, TaskState &task, std::size_t budget, std::set<std::string> &evictedTasks)
+{
+	const static char fname[] = "Scheduler::preemptTask() ";
+
+	// find matched node which fit after evicting fewest lower priority replicas
+	std::string selectedHost;
+	std::vector<std::string> selectedVictims;
+	for (std::size_t id = 0; id < task.m_matchedHosts.size(); id++)
+	{
+		if (!task.m_matchedHosts[id] || task.m_placements.count(m_nodeNames[id]))
+			continue;
+		const auto &node = m_nodes[m_nodeNames[id]];
+
+		// lowest priority first, then larger request first to evict less replicas
+		std::vector<std::string> victims;
+		for (const auto &placed : node.m_placedTasks)
+		{
+			if (m_tasks[placed.first].m_task->m_priority < task.m_task->m_priority)
+				victims.push_back(placed.first);
+		}
+		std::sort(victims.begin(), victims.end(), [this](const std::string &a, const std::string &b) {
+			const auto &left = m_tasks[a];
+			const auto &right = m_tasks[b];
+			if (left.m_task->m_priority != right.m_task->m_priority)
+				return left.m_task->m_priority < right.m_task->m_priority;
+			return right.m_request < left.m_request;
+		});
+
+		auto usage = node.m_usage;
+		std::size_t count = 0;
+		while (!usage.fit(task.m_request) && count < victims.size() && count < budget)
+		{
+			const auto &request = m_tasks[victims[count]].m_request;
+			usage.remove(request);
+			if (usage.m_memoryFree > 0)
+				usage.m_memoryFree += request.m_memoryBytes;
+			++count;
+		}
+		if (count && usage.fit(task.m_request) && (selectedHost.empty() || count < selectedVictims.size()))
+		{
+			selectedHost = m_nodeNames[id];
+			selectedVictims.assign(victims.begin(), victims.begin() + count);
+		}
+	}
+	if (selectedHost.empty())
+		return false;
+
+	for (const auto &victim : selectedVictims)
+	{
+		LOG_INF << fname << "task <" << taskName << "> evict task <" << victim << "> from host <" << selectedHost << ">";
+		unassign(victim, m_tasks[victim], selectedHost);
+		m_pendingTasks.insert(victim);
+		evictedTasks.insert(victim);
+	}
+	auto index = freeIndex(task);
+	assign(taskName, task, selectedHost, index);
+	LOG_DBG << fname << " task <" << taskName << "> assigned to host <" << selectedHost << "> with index <" << index << ">";
+	return true;
+}
+
+int Scheduler::freeIndex(const TaskState &task) const
+{
+	// free app index, index start from 1
+	std::set<int> usedIndex;
+	for (const auto &placement : task.m_placements)
+	{
+		usedIndex.insert(placement.second);
+	}
+	int index = 1;
+	while (usedIndex.count(index))
+		index++;
+	return index;
+}
+
+std::vector<std::string> Scheduler::selectNodes(const TaskState &task, std::size_t count)
+{
+	std::vector<std::string> candidates;
+	if (m_strategy->replicaOrdered() && task.m_matchedCount * 8 >= m_nodeQueue.size())
+	{
+		// many matched nodes, walk from the least loaded node
+		for (const auto &node : m_nodeQueue)
+		{
+			if (candidates.size() >= count)
+				break;
+			const auto &state = m_nodes[node.second];
+			if (task.matched(state.m_id) && task.m_placements.count(node.second) == 0 && state.m_usage.fit(task.m_request))
+				candidates.push_back(node.second);
+		}
+		return candidates;
+	}
+
+	// score matched nodes, negative score for ascending sort and host name to break tie
+	std::vector<std::pair<double, std::string>> scores;
+	for (std::size_t id = 0; id < task.m_matchedHosts.size(); id++)
+	{
+		if (!task.m_matchedHosts[id] || task.m_placements.count(m_nodeNames[id]))
+			continue;
+		const auto &usage = m_nodes[m_nodeNames[id]].m_usage;
+		if (usage.fit(task.m_request))
+			scores.push_back(std::make_pair(-m_strategy->score(usage, task.m_request), m_nodeNames[id]));
+	}
+	count = std::min(count, scores.size());
+	std::partial_sort(scores.begin(), scores.begin() + count, scores.end());
+	for (std::size_t i = 0; i < count; i++)
+	{
+		candidates.push_back(scores[i].second);
 	}
+	return candidates;
+}
+
+void Scheduler::assign(const std::string &taskName, TaskState &task, const std::string &host, int index)
+{
+	auto &node = m_nodes[host];
+	m_nodeQueue.erase(std::make_pair(node.m_placedTasks.size(), host));
+	node.m_placedTasks[taskName] = index;
+	node.m_usage.add(task.m_request);
+	m_nodeQueue.insert(std::make_pair(node.m_placedTasks.size(), host));
+	task.m_placements[host] = index;
+}
+
+void Scheduler::unassign(const std::string &taskName, TaskState &task, const std::string &host)
+{
+	auto &node = m_nodes[host];
+	m_nodeQueue.erase(std::make_pair(node.m_placedTasks.size(), host));
+	if (node.m_placedTasks.erase(taskName))
+		node.m_usage.remove(task.m_request);
+	m_nodeQueue.insert(std::make_pair(node.m_placedTasks.size(), host));
+	task.m_placements.erase(host);
+}
 
-	return newTopology;
+std::map<std::string, std::shared_ptr<ConsulTopology>> Scheduler::topology() const
+{
+	std::map<std::string, std::shared_ptr<ConsulTopology>> result;
+	for (const auto &node : m_nodes)
+	{
+		if (node.second.m_placedTasks.size())
+		{
+			auto topology = std::make_shared<ConsulTopology>();
+			topology->m_hostName = node.first;
+			topology->m_scheduleApps = node.second.m_placedTasks;
+			result[node.first] = topology;
+		}
+	}
+	return result;
+}
+
+void Scheduler::reset()
+{
+	m_nodes.clear();
+	m_nodeNames.clear();
+	m_freeNodeIds.clear();
+	m_labelIndex.clear();
+	m_tasks.clear();
+	m_nodeQueue.clear();
+	m_pendingTasks.clear();
+	m_seeds.clear();
+}
+
+void Scheduler::strategy(const std::string &name)
+{
+	const static char fname[] = "Scheduler::strategy() ";
+
+	auto strategy = PlacementStrategy::create(name);
+	if (strategy->name() != m_strategy->name())
+	{
+		LOG_INF << fname << "schedule strategy changed from <" << m_strategy->name() << "> to <" << strategy->name() << ">";
+		m_strategy = strategy;
+	}
+}
+
+bool Scheduler::sameTopology(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology) const
+{
+	std::size_t placedHosts = 0;
+	for (const auto &node : m_nodes)
+	{
+		if (node.second.m_placedTasks.empty())
+			continue;
+		++placedHosts;
+		auto old = oldTopology.find(node.first);
+		if (old == oldTopology.end() || old->second->m_scheduleApps != node.second.m_placedTasks)
+			return false;
+	}
+	std::size_t oldPlacedHosts = std::count_if(oldTopology.begin(), oldTopology.end(),
+											   [](const std::pair<const std::string, std::shared_ptr<ConsulTopology>> &host) { return host.second->m_scheduleApps.size() > 0; });
+	return placedHosts == oldPlacedHosts;
+}
+
+void Scheduler::seed(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology)
+{
+	for (const auto &host : oldTopology)
+	{
+		for (const auto &app : host.second->m_scheduleApps)
+		{
+			m_seeds[app.first][host.first] = app.second;
+		}
+	}
 }
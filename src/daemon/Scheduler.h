@@ -1,11 +1,92 @@
 #pragma once
-#include <memory>
 #include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "LabelSelector.h"
+#include "PlacementStrategy.h"
+
+struct ConsulNode;
+struct ConsulTask;
+struct ConsulTopology;
 
-class ConsulTopology;
-class ConsulTask;
+//////////////////////////////////////////////////////////////////////////
+/// Consul task scheduler
+/// Node load and task placement are kept between schedule passes, a pass
+/// only processes added/removed tasks and joined/departed nodes
+//////////////////////////////////////////////////////////////////////////
 class Scheduler
 {
 public:
-	static std::map<std::string, std::shared_ptr<ConsulTopology>> scheduleTask(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskMap, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology);
+	Scheduler();
+	virtual ~Scheduler();
+
+	/// Incremental schedule with current Consul tasks, nodes and topology,
+	/// state is rebuilt from oldTopology when topology was changed by others
+	std::map<std::string, std::shared_ptr<ConsulTopology>> schedule(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskMap, const std::map<std::string, std::shared_ptr<ConsulNode>> &nodes, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology);
+
+	/// Deltas, replicas are placed by placePendingTasks() in priority order,
+	/// higher priority task may evict lower priority replicas when no node fit
+	void addNode(const std::shared_ptr<ConsulNode> &node);
+	void removeNode(const std::string &host);
+	void addTask(const std::string &taskName, const std::shared_ptr<ConsulTask> &task);
+	void removeTask(const std::string &taskName);
+	void placePendingTasks();
+
+	std::map<std::string, std::shared_ptr<ConsulTopology>> topology() const;
+	void reset();
+	/// Switch placement strategy, existing placements are kept
+	void strategy(const std::string &name) noexcept(false);
+
+private:
+	struct NodeState
+	{
+		std::shared_ptr<ConsulNode> m_node;
+		// index of match bitmap
+		std::size_t m_id;
+		// task name -> app index
+		std::map<std::string, int> m_placedTasks;
+		NodeUsage m_usage;
+	};
+	struct TaskState
+	{
+		TaskState();
+		bool matched(std::size_t nodeId) const;
+		void setMatched(std::size_t nodeId, bool matched);
+
+		std::shared_ptr<ConsulTask> m_task;
+		std::shared_ptr<LabelSelector> m_selector;
+		// bitmap of matched node id
+		std::vector<bool> m_matchedHosts;
+		std::size_t m_matchedCount;
+		ResourceRequest m_request;
+		// host name -> app index
+		std::map<std::string, int> m_placements;
+	};
+
+	bool sameTopology(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology) const;
+	void seed(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology);
+	void placeTask(const std::string &taskName, TaskState &task);
+	bool preemptTask(const std::string &taskName, TaskState &task, std::size_t budget, std::set<std::string> &evictedTasks);
+	int freeIndex(const TaskState &task) const;
+	std::vector<std::string> orderTasks(const std::set<std::string> &taskNames);
+	std::vector<std::string> selectNodes(const TaskState &task, std::size_t count);
+	void assign(const std::string &taskName, TaskState &task, const std::string &host, int index);
+	void unassign(const std::string &taskName, TaskState &task, const std::string &host);
+
+private:
+	std::map<std::string, NodeState> m_nodes;
+	// node id -> host name, empty for released id
+	std::vector<std::string> m_nodeNames;
+	std::vector<std::size_t> m_freeNodeIds;
+	LabelIndex m_labelIndex;
+	std::map<std::string, TaskState> m_tasks;
+	// nodes ordered by load (placed replica count), lowest first
+	std::set<std::pair<std::size_t, std::string>> m_nodeQueue;
+	// tasks which have less replicas than required
+	std::set<std::string> m_pendingTasks;
+	// old placement of each task (task -> host -> index), consumed when task added
+	std::map<std::string, std::map<std::string, int>> m_seeds;
+	std::shared_ptr<PlacementStrategy> m_strategy;
 };
@@ -6,6 +6,7 @@
 #include "../Configuration.h"
 #include "../DailyLimitation.h"
 #include "../process/DockerProcess.h"
+#include "../process/LinuxCgroup.h"
 #include "../process/MonitoredProcess.h"
 #include "../rest/PrometheusRest.h"
 #include "../ResourceCollection.h"
@@ -181,8 +182,29 @@ void Application::refreshPid()
 		}
 		checkAndUpdateHealth();
 	}
+
+	// read cgroup accounting files, only walk /proc process tree for process without cgroup
+	auto stats = std::make_shared<CgroupStats>();
+	const bool collected = m_pid > 0 && m_process != nullptr && m_process->collectCgroupStats(*stats);
+	// published as a whole, AsJson() never see a partly updated sample
+	std::atomic_store(&m_cgroupStats, collected ? stats : std::shared_ptr<CgroupStats>());
 	if (m_metricMemory)
-		m_metricMemory->metric().Set(ResourceCollection::instance()->getRssMemory(m_pid));
+		m_metricMemory->metric().Set(collected ? stats->m_memoryBytes : ResourceCollection::instance()->getRssMemory(m_pid));
+	// failed collection keep last values, stopped process report zero
+	if (!collected && m_pid > 0)
+		return;
+	if (m_metricCpu)
+		m_metricCpu->metric().Set(stats->m_cpuPercent);
+	if (m_metricIoRead)
+		m_metricIoRead->metric().Set(stats->m_ioReadBytes);
+	if (m_metricIoWrite)
+		m_metricIoWrite->metric().Set(stats->m_ioWriteBytes);
+	if (m_metricCpuPressure)
+		m_metricCpuPressure->metric().Set(stats->m_cpuPressure);
+	if (m_metricMemoryPressure)
+		m_metricMemoryPressure->metric().Set(stats->m_memoryPressure);
+	if (m_metricIoPressure)
+		m_metricIoPressure->metric().Set(stats->m_ioPressure);
 }
 
 bool Application::attach(int pid)
@@ -212,7 +234,10 @@ void Application::invoke()
 				LOG_INF << fname << "Starting application <" << m_name << ">.";
 				m_process = allocProcess(0, m_dockerImage, m_name);
 				m_procStartTime = std::chrono::system_clock::now();
-				m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+				{
+					HistogramTimer timer(PrometheusRest::spawnHistogram());
+					m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+				}
 				if (m_metricStartCount)
 					m_metricStartCount->metric().Increment();
 			}
@@ -292,6 +317,7 @@ std::string Application::runSyncrize(int timeoutSeconds, void *asyncHttpRequest)
 std::string Application::runApp(int timeoutSeconds)
 {
 	const static char fname[] = "Application::runApp() ";
+	LogAppScope logScope(m_name);
 	LOG_DBG << fname << " Entered.";
 
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
@@ -303,7 +329,10 @@ std::string Application::runApp(int timeoutSeconds)
 
 	LOG_INF << fname << "Running application <" << m_name << ">.";
 	m_procStartTime = std::chrono::system_clock::now();
-	m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+	{
+		HistogramTimer timer(PrometheusRest::spawnHistogram());
+		m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+	}
 
 	if (m_metricStartCount)
 		m_metricStartCount->metric().Increment();
@@ -366,6 +395,11 @@ const std::string &Application::getCmdLine() const
 	return m_commandLine;
 }
 
+std::shared_ptr<ResourceLimitation> Application::getResourceLimit() const
+{
+	return m_resourceLimit;
+}
+
 std::string Application::getAsyncRunOutput(const std::string &processUuid, int &exitCode, bool &finished)
 {
 	const static char fname[] = "Application::getAsyncRunOutput() ";
@@ -432,6 +466,12 @@ void Application::initMetrics(std::shared_ptr<PrometheusRest> prom)
 	// clean
 	m_metricStartCount = nullptr;
 	m_metricMemory = nullptr;
+	m_metricCpu = nullptr;
+	m_metricIoRead = nullptr;
+	m_metricIoWrite = nullptr;
+	m_metricCpuPressure = nullptr;
+	m_metricMemoryPressure = nullptr;
+	m_metricIoPressure = nullptr;
 	// update
 	if (prom)
 	{
@@ -442,6 +482,24 @@ void Application::initMetrics(std::shared_ptr<PrometheusRest> prom)
 		m_metricMemory = prom->createPromGauge(
 			PROM_METRIC_NAME_appmesh_prom_process_memory_gauge, PROM_METRIC_HELP_appmesh_prom_process_memory_gauge,
 			{{"application", getName()}, {"id", m_appId}});
+		m_metricCpu = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_cpu_gauge, PROM_METRIC_HELP_appmesh_prom_process_cpu_gauge,
+			{{"application", getName()}, {"id", m_appId}});
+		m_metricIoRead = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_io_read_gauge, PROM_METRIC_HELP_appmesh_prom_process_io_read_gauge,
+			{{"application", getName()}, {"id", m_appId}});
+		m_metricIoWrite = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_io_write_gauge, PROM_METRIC_HELP_appmesh_prom_process_io_write_gauge,
+			{{"application", getName()}, {"id", m_appId}});
+		m_metricCpuPressure = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_pressure_gauge, PROM_METRIC_HELP_appmesh_prom_process_pressure_gauge,
+			{{"application", getName()}, {"id", m_appId}, {"resource", "cpu"}});
+		m_metricMemoryPressure = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_pressure_gauge, PROM_METRIC_HELP_appmesh_prom_process_pressure_gauge,
+			{{"application", getName()}, {"id", m_appId}, {"resource", "memory"}});
+		m_metricIoPressure = prom->createPromGauge(
+			PROM_METRIC_NAME_appmesh_prom_process_pressure_gauge, PROM_METRIC_HELP_appmesh_prom_process_pressure_gauge,
+			{{"application", getName()}, {"id", m_appId}, {"resource", "io"}});
 	}
 }
 
@@ -495,8 +553,23 @@ web::json::value Application::AsJson(bool returnRuntimeInfo)
 			result[JSON_KEY_APP_pid] = web::json::value::number(m_pid);
 		if (m_return != nullptr)
 			result[JSON_KEY_APP_return] = web::json::value::number(*m_return);
-		if (m_pid > 0)
+		const auto stats = std::atomic_load(&m_cgroupStats);
+		if (stats != nullptr)
+		{
+			result[JSON_KEY_APP_memory] = web::json::value::number(stats->m_memoryBytes);
+			result[JSON_KEY_APP_cpu] = web::json::value::number(stats->m_cpuPercent);
+			result[JSON_KEY_APP_io_read_bytes] = web::json::value::number(stats->m_ioReadBytes);
+			result[JSON_KEY_APP_io_write_bytes] = web::json::value::number(stats->m_ioWriteBytes);
+			auto pressure = web::json::value::object();
+			pressure[JSON_KEY_APP_pressure_cpu] = web::json::value::number(stats->m_cpuPressure);
+			pressure[JSON_KEY_APP_pressure_memory] = web::json::value::number(stats->m_memoryPressure);
+			pressure[JSON_KEY_APP_pressure_io] = web::json::value::number(stats->m_ioPressure);
+			result[JSON_KEY_APP_pressure] = pressure;
+		}
+		else if (m_pid > 0)
+		{
 			result[JSON_KEY_APP_memory] = web::json::value::number(ResourceCollection::instance()->getRssMemory(m_pid));
+		}
 		if (std::chrono::time_point_cast<std::chrono::hours>(m_procStartTime).time_since_epoch().count() > 24) // avoid print 1970-01-01 08:00:00
 			result[JSON_KEY_APP_last_start] = web::json::value::string(DateTime::formatISO8601Time(m_procStartTime));
 		if (!m_process->containerId().empty())
@@ -632,10 +705,13 @@ bool Application::available()
 
 void Application::destroy()
 {
+	LogAppScope logScope(m_name);
 	{
 		std::lock_guard<std::recursive_mutex> guard(m_mutex);
 		this->disable();
 		this->m_status = STATUS::NOTAVIALABLE;
+		// release metric series now, app object may still be referenced by timers
+		this->initMetrics(nullptr);
 		if (m_commandLineFini.length())
 		{
 			this->registerTimer(0, 0, std::bind(&Application::onFinishEvent, this, std::placeholders::_1), __FUNCTION__);
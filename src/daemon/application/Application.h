@@ -14,6 +14,7 @@ class CounterPtr;
 class GaugePtr;
 class PrometheusRest;
 class AppProcess;
+struct CgroupStats;
 class DailyLimitation;
 class ResourceLimitation;
 //////////////////////////////////////////////////////////////////////////
@@ -67,6 +68,7 @@ public:
 	const std::shared_ptr<User> &getOwner() const { return m_owner; }
 	int getOwnerPermission() const { return m_ownerPermission; }
 	bool isCloudApp() const;
+	std::shared_ptr<ResourceLimitation> getResourceLimit() const;
 
 protected:
 	// Invoke immediately
@@ -121,5 +123,14 @@ protected:
 	// Prometheus
 	std::shared_ptr<CounterPtr> m_metricStartCount;
 	std::shared_ptr<GaugePtr> m_metricMemory;
+	std::shared_ptr<GaugePtr> m_metricCpu;
+	std::shared_ptr<GaugePtr> m_metricIoRead;
+	std::shared_ptr<GaugePtr> m_metricIoWrite;
+	std::shared_ptr<GaugePtr> m_metricCpuPressure;
+	std::shared_ptr<GaugePtr> m_metricMemoryPressure;
+	std::shared_ptr<GaugePtr> m_metricIoPressure;
+	// cgroup resource usage of last refresh, nullptr for process without cgroup,
+	// replaced by refresh timer and read by REST thread through std::atomic_load/std::atomic_store
+	std::shared_ptr<CgroupStats> m_cgroupStats;
 	std::atomic<int> m_continueFails;
 };
@@ -1,6 +1,7 @@
 #include "ApplicationInitialize.h"
 #include "../process/AppProcess.h"
 #include "../Configuration.h"
+#include "../rest/PrometheusRest.h"
 #include "../../common/Utility.h"
 
 ApplicationInitialize::ApplicationInitialize()
@@ -94,7 +95,10 @@ void ApplicationInitialize::invoke()
 			LOG_INF << fname << "Starting initializing for application <" << m_name << ">.";
 			m_process = allocProcess(0, "", m_name);
 			m_procStartTime = std::chrono::system_clock::now();
-			m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			{
+				HistogramTimer timer(PrometheusRest::spawnHistogram());
+				m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			}
 		}
 		else
 		{
@@ -1,6 +1,7 @@
 #include "ApplicationShortRun.h"
 #include "../process/AppProcess.h"
 #include "../Configuration.h"
+#include "../rest/PrometheusRest.h"
 #include "../../common/DurationParse.h"
 #include "../../common/Utility.h"
 #include "../../common/DateTime.h"
@@ -91,6 +92,7 @@ void ApplicationShortRun::invoke()
 
 void ApplicationShortRun::invokeNow(int timerId)
 {
+	LogAppScope logScope(m_name);
 	// Check app existence
 	if (timerId > 0 && !this->isEnabled())
 	{
@@ -122,7 +124,10 @@ void ApplicationShortRun::invokeNow(int timerId)
 		// Spawn new process
 		m_process = allocProcess(0, m_dockerImage, m_name);
 		m_procStartTime = std::chrono::system_clock::now();
-		m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+		{
+			HistogramTimer timer(PrometheusRest::spawnHistogram());
+			m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+		}
 		m_nextLaunchTime = std::make_unique<std::chrono::system_clock::time_point>(std::chrono::system_clock::now() + std::chrono::seconds(this->getStartInterval()));
 	}
 }
@@ -1,6 +1,7 @@
 #include "ApplicationUnInitia.h"
 #include "../process/AppProcess.h"
 #include "../Configuration.h"
+#include "../rest/PrometheusRest.h"
 #include "../../common/Utility.h"
 
 ApplicationUnInitia::ApplicationUnInitia()
@@ -96,7 +97,10 @@ void ApplicationUnInitia::invoke()
 			LOG_INF << fname << "Starting un-initializing for application <" << m_name << ">.";
 			m_process = allocProcess(0, "", m_name);
 			m_procStartTime = std::chrono::system_clock::now();
-			m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			{
+				HistogramTimer timer(PrometheusRest::spawnHistogram());
+				m_pid = m_process->spawnProcess(getCmdLine(), getExecUser(), m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			}
 		}
 		else
 		{
@@ -13,8 +13,10 @@
 
 #include "application/Application.h"
 #include "process/AppProcess.h"
+#include "process/LinuxCgroup.h"
 #include "Configuration.h"
 #include "rest/ConsulConnection.h"
+#include "rest/FileUpload.h"
 #include "HealthCheckTask.h"
 #include "PersistManager.h"
 #include "rest/PrometheusRest.h"
@@ -22,6 +24,7 @@
 #include "rest/RestHandler.h"
 #include "TimerHandler.h"
 #include "../common/os/linux.hpp"
+#include "../common/HttpRequest.h"
 #include "../common/Utility.h"
 #include "../common/PerfLog.h"
 
@@ -63,6 +66,8 @@ int main(int argc, char *argv[])
 
 		// set log level
 		Utility::setLogLevel(config->getLogLevel());
+		if (::getenv(ENV_LOG_FORMAT) == nullptr)
+			Utility::setLogFormat(config->getLogFormat());
 		Configuration::instance()->dump();
 
 		std::shared_ptr<RestHandler> httpServerIp4;
@@ -72,6 +77,7 @@ int main(int argc, char *argv[])
 			// Thread pool: 6 threads
 			crossplat::threadpool::initialize_with_threads(config->getThreadPoolSize());
 			LOG_INF << fname << "initialize_with_threads:" << config->getThreadPoolSize();
+			HttpRequest::setCompression(config->getRest()->m_httpCompressionMinBytes, config->getRest()->m_httpCompressionThreads);
 
 			// Init Prometheus Exporter
 			PrometheusRest::instance(std::make_shared<PrometheusRest>(config->getRestListenAddress(), config->getPromListenPort()));
@@ -102,6 +108,20 @@ int main(int argc, char *argv[])
 					LOG_ERR << fname << "unknown exception";
 				}
 			}
+			// local CLI and agents
+			if (!config->getRestListenSocket().empty())
+			{
+				try
+				{
+					httpServerIp4->openLocalSocket(config->getRestListenSocket());
+				}
+				catch (const std::exception &e)
+				{
+					LOG_ERR << fname << e.what();
+				}
+			}
+			// chunked uploads of previous process are resumed, idle uploads are removed by timer
+			FileUploadManager::instance()->open();
 		}
 
 		// HA attach process to App
@@ -125,6 +145,10 @@ int main(int argc, char *argv[])
 					p->attach(appSnapshot.m_pid);
 			}
 		});
+		// remove cgroup dirs left by removed applications
+		std::set<std::string> appNames;
+		std::for_each(apps.begin(), apps.end(), [&appNames](std::vector<std::shared_ptr<Application>>::reference p) { appNames.insert(p->getName()); });
+		LinuxCgroup::cleanOrphanCgroups(appNames);
 		// reg prometheus
 		config->registerPrometheus();
 
@@ -147,6 +171,7 @@ int main(int argc, char *argv[])
 			auto allApp = Configuration::instance()->getApps();
 			for (const auto &app : allApp)
 			{
+				LogAppScope logScope(app->getName());
 				app->invoke();
 			}
 
@@ -164,6 +189,7 @@ int main(int argc, char *argv[])
 		LOG_ERR << fname << "unknown exception";
 	}
 	LOG_ERR << fname << "ERROR exited";
+	Utility::flushLogging();
 	ACE::fini();
 	_exit(0);
 	return 0;
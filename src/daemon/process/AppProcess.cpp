@@ -5,6 +5,7 @@
 #include "../../common/Utility.h"
 #include "../../common/DateTime.h"
 #include "../../common/os/pstree.hpp"
+#include "CpuSetAllocator.h"
 #include "LinuxCgroup.h"
 #include "../ResourceLimitation.h"
 
@@ -85,14 +86,37 @@ void AppProcess::killgroup(int timerId)
 	}
 }
 
-void AppProcess::setCgroup(std::shared_ptr<ResourceLimitation> &limit)
+bool AppProcess::allocateCpuSet(std::shared_ptr<ResourceLimitation> &limit)
+{
+	if (limit == nullptr)
+		return true;
+	// one cgroup for each application, reused for all spawns
+	if (limit->m_cgroup == nullptr)
+	{
+		limit->m_cgroup = std::make_shared<LinuxCgroup>(limit->m_memoryMb, limit->m_memoryVirtMb - limit->m_memoryMb, limit->m_cpuShares);
+		limit->m_cgroup->setCpuQuota(limit->m_cpuQuotaUs, limit->m_cpuPeriodUs);
+		limit->m_cgroup->setCpuSet(limit->m_cpuSet, limit->m_memoryNodes, limit->m_exclusiveCpus);
+	}
+	return limit->m_cgroup->allocateCpuSet(limit->m_name);
+}
+
+bool AppProcess::setCgroup(std::shared_ptr<ResourceLimitation> &limit)
 {
 	// https://blog.csdn.net/u011547375/article/details/9851455
-	if (limit != nullptr)
+	if (limit == nullptr)
 	{
-		m_cgroup = std::make_unique<LinuxCgroup>(limit->m_memoryMb, limit->m_memoryVirtMb - limit->m_memoryMb, limit->m_cpuShares);
-		m_cgroup->setCgroup(limit->m_name, getpid(), ++(limit->m_index));
+		// process without cgroup does not run on cores pinned by others
+		CpuSetAllocator::instance()->setSharedAffinity(getpid());
+		return true;
 	}
+	allocateCpuSet(limit);
+	m_cgroup = limit->m_cgroup;
+	return m_cgroup->setCgroup(limit->m_name, getpid());
+}
+
+bool AppProcess::collectCgroupStats(CgroupStats &stats)
+{
+	return m_cgroup != nullptr && m_cgroup->collectStats(stats);
 }
 
 const std::string AppProcess::getuuid() const
@@ -161,6 +185,13 @@ int AppProcess::spawnProcess(std::string cmd, std::string user, std::string work
 		return ACE_INVALID_PID;
 	}
 
+	// pinned cores are reserved before spawn, process is not started on cores owned by others
+	if (!this->allocateCpuSet(limit))
+	{
+		LOG_ERR << fname << "Process:<" << cmd << "> not started, CPU cores are not available";
+		return ACE_INVALID_PID;
+	}
+
 	envMap[ENV_APP_MANAGER_LAUNCH_TIME] = DateTime::formatLocalTime(std::chrono::system_clock::now(), DATE_TIME_FORMAT);
 	std::size_t cmdLength = cmd.length() + ACE_Process_Options::DEFAULT_COMMAND_LINE_BUF_LEN;
 	int totalEnvSize = 0;
@@ -228,7 +259,12 @@ int AppProcess::spawnProcess(std::string cmd, std::string user, std::string work
 	{
 		pid = this->getpid();
 		LOG_INF << fname << "Process <" << cmd << "> started with pid <" << pid << ">.";
-		this->setCgroup(limit);
+		if (!this->setCgroup(limit))
+		{
+			LOG_ERR << fname << "Process <" << cmd << "> killed, failed to apply CPU pinning";
+			this->killgroup();
+			pid = -1;
+		}
 	}
 	else
 	{
@@ -7,6 +7,7 @@
 #include "../TimerHandler.h"
 
 class LinuxCgroup;
+struct CgroupStats;
 class ResourceLimitation;
 //////////////////////////////////////////////////////////////////////////
 /// Process Object
@@ -21,7 +22,11 @@ public:
 	void detach();
 	virtual pid_t getpid(void) const;
 	virtual void killgroup(int timerId = 0);
-	virtual void setCgroup(std::shared_ptr<ResourceLimitation> &limit);
+	/// Reserve pinned cores before spawn, return false when cores are not available
+	bool allocateCpuSet(std::shared_ptr<ResourceLimitation> &limit);
+	/// Move process into cgroup, return false when CPU pinning is not applied
+	virtual bool setCgroup(std::shared_ptr<ResourceLimitation> &limit);
+	bool collectCgroupStats(CgroupStats &stats);
 	const std::string getuuid() const;
 	void regKillTimer(std::size_t timeoutSec, const std::string from);
 	virtual std::string containerId() { return std::string(); };
@@ -42,7 +47,7 @@ protected:
 	std::string m_stdoutFileName;
 
 private:
-	std::unique_ptr<LinuxCgroup> m_cgroup;
+	std::shared_ptr<LinuxCgroup> m_cgroup;
 	int m_killTimerId;
 	ACE_HANDLE m_stdoutHandler;
 	std::string m_uuid;
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sched.h>
+#include "CpuSetAllocator.h"
+#include "../../common/Utility.h"
+#include "../../common/os/linux.hpp"
+
+#define NUMA_NODE_SYS_DIR "/sys/devices/system/node"
+
+CpuSetAllocator::CpuSetAllocator()
+	: m_version(0)
+{
+	retrieveTopology();
+}
+
+CpuSetAllocator::~CpuSetAllocator()
+{
+}
+
+std::unique_ptr<CpuSetAllocator> &CpuSetAllocator::instance()
+{
+	static auto singleton = std::make_unique<CpuSetAllocator>();
+	return singleton;
+}
+
+bool CpuSetAllocator::allocate(const std::string &owner, std::size_t cpuCount, std::set<int> &cpus, std::set<int> &memNodes)
+{
+	const static char fname[] = "CpuSetAllocator::allocate() ";
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	release(owner);
+
+	// always leave one core for un-pinned processes
+	if (cpuCount == 0 || m_allocatedCpus.size() + cpuCount >= m_cpuNode.size())
+	{
+		LOG_ERR << fname << "No enough free cores for <" << owner << "> request <" << cpuCount << "> allocated <" << m_allocatedCpus.size() << "> total <" << m_cpuNode.size() << ">";
+		return false;
+	}
+
+	// free cores of each node
+	std::map<int, std::vector<int>> nodeFreeCpus;
+	for (const auto &node : m_nodeCpus)
+	{
+		for (const auto cpu : node.second)
+		{
+			if (m_allocatedCpus.count(cpu) == 0)
+				nodeFreeCpus[node.first].push_back(cpu);
+		}
+	}
+
+	// best fit: the node with the least free cores which still satisfy the request
+	std::vector<std::pair<int, std::vector<int>>> candidates(nodeFreeCpus.begin(), nodeFreeCpus.end());
+	std::sort(candidates.begin(), candidates.end(), [](const std::pair<int, std::vector<int>> &a, const std::pair<int, std::vector<int>> &b) {
+		return a.second.size() < b.second.size();
+	});
+	auto fit = std::find_if(candidates.begin(), candidates.end(), [cpuCount](const std::pair<int, std::vector<int>> &node) {
+		return node.second.size() >= cpuCount;
+	});
+
+	std::set<int> result;
+	if (fit != candidates.end())
+	{
+		result.insert(fit->second.begin(), fit->second.begin() + cpuCount);
+	}
+	else
+	{
+		// span NUMA nodes, start from the node with most free cores
+		LOG_WAR << fname << "No single NUMA node have <" << cpuCount << "> free cores for <" << owner << ">, allocate across nodes";
+		for (auto it = candidates.rbegin(); it != candidates.rend() && result.size() < cpuCount; ++it)
+		{
+			for (const auto cpu : it->second)
+			{
+				if (result.size() >= cpuCount)
+					break;
+				result.insert(cpu);
+			}
+		}
+	}
+
+	m_allocations[owner] = result;
+	m_allocatedCpus.insert(result.begin(), result.end());
+	m_version++;
+	cpus = result;
+	memNodes = nodesOfCpus(result);
+	LOG_INF << fname << "Allocated cores <" << formatCpuList(cpus) << "> memory nodes <" << formatCpuList(memNodes) << "> for <" << owner << ">";
+	return true;
+}
+
+bool CpuSetAllocator::reserve(const std::string &owner, const std::set<int> &cpus, std::set<int> &memNodes)
+{
+	const static char fname[] = "CpuSetAllocator::reserve() ";
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	release(owner);
+	for (const auto cpu : cpus)
+	{
+		if (m_cpuNode.count(cpu) == 0)
+		{
+			LOG_ERR << fname << "Core <" << cpu << "> requested by <" << owner << "> does not exist";
+			return false;
+		}
+		if (m_allocatedCpus.count(cpu))
+		{
+			LOG_ERR << fname << "Core <" << cpu << "> requested by <" << owner << "> is already pinned by other application";
+			return false;
+		}
+	}
+	m_allocations[owner] = cpus;
+	m_allocatedCpus.insert(cpus.begin(), cpus.end());
+	m_version++;
+	memNodes = nodesOfCpus(cpus);
+	return true;
+}
+
+void CpuSetAllocator::release(const std::string &owner)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto it = m_allocations.find(owner);
+	if (it != m_allocations.end())
+	{
+		for (const auto cpu : it->second)
+		{
+			m_allocatedCpus.erase(cpu);
+		}
+		m_allocations.erase(it);
+		m_version++;
+	}
+}
+
+std::string CpuSetAllocator::sharedCpuList()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_allocatedCpus.empty())
+		return std::string();
+	std::set<int> shared;
+	for (const auto &cpu : m_cpuNode)
+	{
+		if (m_allocatedCpus.count(cpu.first) == 0)
+			shared.insert(cpu.first);
+	}
+	return formatCpuList(shared);
+}
+
+std::size_t CpuSetAllocator::version()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_version;
+}
+
+void CpuSetAllocator::setSharedAffinity(int pid)
+{
+	const static char fname[] = "CpuSetAllocator::setSharedAffinity() ";
+
+	const auto shared = sharedCpuList();
+	if (shared.empty())
+		return;
+	// threads and child processes created later inherit the affinity
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	for (const auto cpu : parseCpuList(shared))
+	{
+		CPU_SET(cpu, &mask);
+	}
+	if (::sched_setaffinity(pid, sizeof(mask), &mask) != 0)
+	{
+		LOG_WAR << fname << "Bind process <" << pid << "> to shared cores <" << shared << "> failed with error :" << std::strerror(errno);
+	}
+}
+
+std::set<int> CpuSetAllocator::parseCpuList(const std::string &cpuList)
+{
+	std::set<int> result;
+	for (const auto &item : Utility::splitString(cpuList, ","))
+	{
+		auto range = Utility::stdStringTrim(item);
+		if (range.empty())
+			continue;
+		auto pos = range.find('-');
+		auto first = range.substr(0, pos);
+		auto last = (pos == std::string::npos) ? first : range.substr(pos + 1);
+		if (!Utility::isNumber(first) || !Utility::isNumber(last) || std::stoi(first) > std::stoi(last))
+		{
+			throw std::invalid_argument(Utility::stringFormat("invalid cpu list <%s>", cpuList.c_str()));
+		}
+		for (int cpu = std::stoi(first); cpu <= std::stoi(last); cpu++)
+		{
+			result.insert(cpu);
+		}
+	}
+	return result;
+}
+
+std::string CpuSetAllocator::formatCpuList(const std::set<int> &cpus)
+{
+	std::string result;
+	for (auto it = cpus.begin(); it != cpus.end();)
+	{
+		auto first = *it;
+		auto last = first;
+		while (++it != cpus.end() && *it == last + 1)
+		{
+			last = *it;
+		}
+		if (!result.empty())
+			result += ",";
+		result += (first == last) ? std::to_string(first) : (std::to_string(first) + "-" + std::to_string(last));
+	}
+	return result;
+}
+
+void CpuSetAllocator::retrieveTopology()
+{
+	const static char fname[] = "CpuSetAllocator::retrieveTopology() ";
+
+	// physical core id of each processor, used to keep hyper-thread siblings together
+	std::map<int, std::pair<int, int>> cpuCore;
+	for (const auto &cpu : os::cpus())
+	{
+		cpuCore[cpu.id] = std::make_pair(int(cpu.socket), int(cpu.core));
+	}
+
+	// /sys/devices/system/node/node0/cpulist
+	if (Utility::isDirExist(NUMA_NODE_SYS_DIR))
+	{
+		for (const auto &entry : os::ls(NUMA_NODE_SYS_DIR))
+		{
+			if (Utility::startWith(entry, "node") && Utility::isNumber(entry.substr(4)))
+			{
+				auto node = std::stoi(entry.substr(4));
+				auto cpuList = Utility::stdStringTrim(Utility::readFile(std::string(NUMA_NODE_SYS_DIR) + "/" + entry + "/cpulist"));
+				try
+				{
+					for (const auto cpu : parseCpuList(cpuList))
+					{
+						m_cpuNode[cpu] = node;
+					}
+				}
+				catch (const std::exception &ex)
+				{
+					LOG_WAR << fname << ex.what();
+				}
+			}
+		}
+	}
+	// no NUMA information, regard each socket as a node
+	if (m_cpuNode.empty())
+	{
+		for (const auto &cpu : cpuCore)
+		{
+			m_cpuNode[cpu.first] = cpu.second.first;
+		}
+	}
+
+	for (const auto &cpu : m_cpuNode)
+	{
+		m_nodeCpus[cpu.second].push_back(cpu.first);
+	}
+	for (auto &node : m_nodeCpus)
+	{
+		std::stable_sort(node.second.begin(), node.second.end(), [&cpuCore](int a, int b) {
+			return cpuCore[a] < cpuCore[b];
+		});
+		LOG_DBG << fname << "NUMA node <" << node.first << "> cores <" << formatCpuList(std::set<int>(node.second.begin(), node.second.end())) << ">";
+	}
+}
+
+std::set<int> CpuSetAllocator::nodesOfCpus(const std::set<int> &cpus) const
+{
+	std::set<int> nodes;
+	for (const auto cpu : cpus)
+	{
+		auto it = m_cpuNode.find(cpu);
+		if (it != m_cpuNode.end())
+			nodes.insert(it->second);
+	}
+	return nodes;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+/// Allocate exclusive CPU cores for pinned applications, keep allocations
+/// inside one NUMA node when possible and never overlap between owners
+//////////////////////////////////////////////////////////////////////////
+class CpuSetAllocator
+{
+public:
+	CpuSetAllocator();
+	virtual ~CpuSetAllocator();
+	// Internal Singleton.
+	static std::unique_ptr<CpuSetAllocator> &instance();
+
+	/// Auto allocate cpuCount exclusive cores, return false when not enough free cores
+	bool allocate(const std::string &owner, std::size_t cpuCount, std::set<int> &cpus, std::set<int> &memNodes);
+	/// Reserve explicit cores, return false when any core is already owned by others
+	bool reserve(const std::string &owner, const std::set<int> &cpus, std::set<int> &memNodes);
+	void release(const std::string &owner);
+	/// Cores not pinned by any owner, empty when nothing is pinned so that un-pinned processes use all cores
+	std::string sharedCpuList();
+	/// Increased when pinned cores change, used to refresh cpuset of un-pinned applications
+	std::size_t version();
+	/// Bind process without cpuset cgroup to shared cores
+	void setSharedAffinity(int pid);
+
+	/// Parse cpuset list format "0-3,8,10-11"
+	static std::set<int> parseCpuList(const std::string &cpuList) noexcept(false);
+	static std::string formatCpuList(const std::set<int> &cpus);
+
+private:
+	void retrieveTopology();
+	std::set<int> nodesOfCpus(const std::set<int> &cpus) const;
+
+private:
+	// NUMA node id -> cpu ids ordered by physical core so that hyper-thread siblings are adjacent
+	std::map<int, std::vector<int>> m_nodeCpus;
+	std::map<int, int> m_cpuNode;
+	// owner -> exclusive cpus
+	std::map<std::string, std::set<int>> m_allocations;
+	std::set<int> m_allocatedCpus;
+	std::size_t m_version;
+	std::recursive_mutex m_mutex;
+};
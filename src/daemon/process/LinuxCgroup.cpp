@@ -1,13 +1,29 @@
 #include "LinuxCgroup.h"
+#include <algorithm>
 #include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
 #include <mntent.h>
+#include <set>
+#include "CpuSetAllocator.h"
 #include "../../common/Utility.h"
+#include "../../common/os/linux.hpp"
+
+CgroupStats::CgroupStats()
+	: m_memoryBytes(0), m_cpuPercent(0), m_ioReadBytes(0), m_ioWriteBytes(0),
+	  m_cpuPressure(0), m_memoryPressure(0), m_ioPressure(0)
+{
+}
 
 std::string LinuxCgroup::cgroupMemRootName;
 std::string LinuxCgroup::cgroupCpuRootName;
+std::string LinuxCgroup::cgroupCpusetRootName;
+bool LinuxCgroup::cgroupUnified = false;
 const std::string LinuxCgroup::cgroupBaseDir = "/appmesh";
 LinuxCgroup::LinuxCgroup(long long memLimitBytes, long long memSwapBytes, long long cpuShares)
-	: m_memLimitMb(memLimitBytes), m_memSwapMb(memSwapBytes), m_cpuShares(cpuShares), m_pid(0), cgroupEnabled(false)
+	: m_memLimitMb(memLimitBytes), m_memSwapMb(memSwapBytes), m_cpuShares(cpuShares), m_cpuQuotaUs(0), m_cpuPeriodUs(0),
+	  m_exclusiveCpus(0), m_pid(0), cgroupEnabled(false), m_sharedCpuVersion(std::numeric_limits<std::size_t>::max()), m_lastCpuUsageUs(-1)
 {
 	const static char fname[] = "LinuxCgroup::LinuxCgroup() ";
 
@@ -23,86 +39,291 @@ LinuxCgroup::LinuxCgroup(long long memLimitBytes, long long memSwapBytes, long l
 		LOG_WAR << fname << "m_memLimitMb is setting to m_memSwapMb";
 	}
 	cgroupEnabled = (m_memLimitMb > 0 || m_memSwapMb > 0 || m_cpuShares > 0);
+}
 
-	// Only need retrieve once for all
-	static bool retrieved = false;
-	static bool swapLimitSupport = true;
-	if (cgroupEnabled && !retrieved)
+LinuxCgroup::~LinuxCgroup()
+{
+	if (cgroupEnabled)
 	{
-		retrieved = true;
-		retrieveCgroupHeirarchy();
-		// Check whether swap limit is enabled for OS, by default, Ubuntu does not enable swap limit
-		if (m_memSwapMb > 0 && !Utility::isFileExist(cgroupMemRootName + "/memory.memsw.limit_in_bytes"))
+		// cgroup is shared by all processes of one application, only remove when no process left
+		for (const auto &path : std::set<std::string>{cgroupMemoryPath, cgroupCpuPath, cgroupCpusetPath})
 		{
-			LOG_WAR << fname << "Your kernel does not support swap limit capabilities or the cgroup is not mounted.";
-			swapLimitSupport = false;
+			removeCgroupDir(path);
 		}
-		cgroupMemRootName += cgroupBaseDir;
-		cgroupCpuRootName += cgroupBaseDir;
-	}
-	if (!swapLimitSupport)
-	{
-		m_memSwapMb = 0;
+		CpuSetAllocator::instance()->release(allocationOwner());
 	}
 }
 
-LinuxCgroup::~LinuxCgroup()
+void LinuxCgroup::setCpuQuota(long long quotaUs, long long periodUs)
 {
-	if (cgroupEnabled)
+	m_cpuQuotaUs = quotaUs;
+	m_cpuPeriodUs = periodUs > 0 ? periodUs : DEFAULT_CGROUP_CPU_PERIOD_US;
+	cgroupEnabled = cgroupEnabled || (m_cpuQuotaUs > 0);
+}
+
+void LinuxCgroup::setCpuSet(const std::string &cpuSet, const std::string &memNodes, int exclusiveCpus)
+{
+	m_cpuSet = cpuSet;
+	m_memNodes = memNodes;
+	m_exclusiveCpus = exclusiveCpus;
+	cgroupEnabled = cgroupEnabled || (m_cpuSet.length() || m_memNodes.length() || m_exclusiveCpus > 0);
+}
+
+bool LinuxCgroup::allocateCpuSet(const std::string &appName)
+{
+	const static char fname[] = "LinuxCgroup::allocateCpuSet() ";
+
+	// keep cores allocated by previous spawn
+	if (m_allocatedCpus.length() || (m_cpuSet.empty() && m_exclusiveCpus <= 0))
+		return true;
+
+	cgroupName = appName;
+	std::set<int> cpus;
+	std::set<int> nodes;
+	if (m_exclusiveCpus > 0)
 	{
-		std::string force_empty_file = cgroupMemoryPath + "/" + "memory.force_empty";
-		if (Utility::isDirExist(cgroupMemoryPath))
+		if (!CpuSetAllocator::instance()->allocate(allocationOwner(), m_exclusiveCpus, cpus, nodes))
 		{
-			writeFile(force_empty_file, 0);
+			LOG_ERR << fname << "Failed to allocate <" << m_exclusiveCpus << "> exclusive cores for <" << appName << ">";
+			return false;
 		}
-
-		Utility::removeDir(cgroupMemoryPath);
-		Utility::removeDir(cgroupCpuPath);
 	}
+	else if (!CpuSetAllocator::instance()->reserve(allocationOwner(), CpuSetAllocator::parseCpuList(m_cpuSet), nodes))
+	{
+		LOG_ERR << fname << "Cores <" << m_cpuSet << "> for <" << appName << "> overlap with other pinned application";
+		return false;
+	}
+	else
+	{
+		cpus = CpuSetAllocator::parseCpuList(m_cpuSet);
+	}
+	m_allocatedCpus = CpuSetAllocator::formatCpuList(cpus);
+	m_allocatedNodes = CpuSetAllocator::formatCpuList(nodes);
+	return true;
 }
 
-void LinuxCgroup::setCgroup(const std::string &appName, int pid, int index)
+bool LinuxCgroup::setCgroup(const std::string &appName, int pid)
 {
+	const static char fname[] = "LinuxCgroup::setCgroup() ";
+
 	if (!cgroupEnabled)
-		return;
+	{
+		CpuSetAllocator::instance()->setSharedAffinity(pid);
+		return true;
+	}
+
+	const bool swapLimitSupport = retrieveCgroupHeirarchy();
+	if (!swapLimitSupport && m_memSwapMb > 0)
+	{
+		LOG_WAR << fname << "Your kernel does not support swap limit capabilities or the cgroup is not mounted.";
+		m_memSwapMb = 0;
+	}
 
 	m_pid = pid;
-	cgroupMemoryPath = cgroupMemRootName + "/" + appName + "/" + std::to_string(index);
-	cgroupCpuPath = cgroupCpuRootName + "/" + appName + "/" + std::to_string(index);
+	cgroupName = appName;
+	// keep path empty when the hierarchy is not mounted
+	cgroupMemoryPath = cgroupMemRootName.length() ? cgroupMemRootName + "/" + cgroupName : "";
+	cgroupCpuPath = cgroupCpuRootName.length() ? cgroupCpuRootName + "/" + cgroupName : "";
+	cgroupCpusetPath = cgroupCpusetRootName.length() ? cgroupCpusetRootName + "/" + cgroupName : "";
 
-	if (m_memLimitMb > 0 && Utility::createRecursiveDirectory(cgroupMemoryPath, 0711))
+	// the cgroup of one application is reused by all spawned processes, limits are only written when changed
+	std::set<std::string> attachPaths;
+	if (cgroupUnified && !Utility::isDirExist(cgroupMemoryPath))
 	{
-		this->setPhysicalMemory(cgroupMemoryPath, m_memLimitMb * 1024 * 1024);
+		// cgroup v2 only accept controller files after controllers are enabled on all ancestors
+		enableControllers();
 	}
 
-	if (m_memSwapMb > 0 && Utility::createRecursiveDirectory(cgroupMemoryPath, 0711))
+	const bool memoryLimited = (m_memLimitMb > 0 || m_memSwapMb > 0);
+	const bool cpuLimited = (m_cpuShares > 0 || m_cpuQuotaUs > 0);
+	if (cgroupMemoryPath.length() && memoryLimited && Utility::createRecursiveDirectory(cgroupMemoryPath, 0711))
 	{
-		this->setSwapMemory(cgroupMemoryPath, m_memSwapMb * 1024 * 1024);
+		attachPaths.insert(cgroupMemoryPath);
+	}
+	if (cgroupCpuPath.length() && cpuLimited && Utility::createRecursiveDirectory(cgroupCpuPath, 0711))
+	{
+		attachPaths.insert(cgroupCpuPath);
 	}
 
-	if (m_cpuShares > 0 && Utility::createRecursiveDirectory(cgroupCpuPath, 0711))
+	// a reused cgroup keeps limits of previous configuration, unset limit is reset to unlimited
+	if (cgroupMemoryPath.length() && Utility::isDirExist(cgroupMemoryPath))
+	{
+		// memory.limit_in_bytes should not exceed memory.memsw.limit_in_bytes, release swap limit before raise memory limit,
+		// unlimited is read as a page aligned value close to LLONG_MAX
+		long long swapLimitBytes = 0;
+		const long long memLimitBytes = m_memLimitMb > 0 ? m_memLimitMb * 1024 * 1024 : std::numeric_limits<long long>::max() / 2;
+		if (!cgroupUnified && swapLimitSupport && readValue(cgroupMemoryPath + "/memory.memsw.limit_in_bytes", swapLimitBytes) && swapLimitBytes < memLimitBytes)
+		{
+			this->setSwapMemory(cgroupMemoryPath, 0);
+		}
+		this->setPhysicalMemory(cgroupMemoryPath, m_memLimitMb * 1024 * 1024);
+		if (swapLimitSupport)
+		{
+			this->setSwapMemory(cgroupMemoryPath, m_memSwapMb * 1024 * 1024);
+		}
+	}
+	if (cgroupCpuPath.length() && Utility::isDirExist(cgroupCpuPath))
 	{
 		this->setCpuShares(cgroupCpuPath, m_cpuShares);
+		this->applyCpuQuota(cgroupCpuPath);
+	}
+
+	// process running on cores not pinned is killed by caller, pinned cores are never shared
+	bool result = true;
+	if (pinned())
+	{
+		if (!cgroupUnified && cgroupCpusetPath.length())
+		{
+			// cgroup v1 cpuset is empty when created, parent need inherit from root before child can be set
+			inheritCpuSet(cgroupCpusetRootName);
+		}
+		if (cgroupCpusetPath.length() && this->allocateCpuSet(appName) &&
+			Utility::createRecursiveDirectory(cgroupCpusetPath, 0711) && this->applyCpuSet(cgroupCpusetPath))
+		{
+			attachPaths.insert(cgroupCpusetPath);
+		}
+		else
+		{
+			LOG_ERR << fname << "Failed to apply cpuset for <" << appName << ">";
+			result = false;
+		}
+	}
+	else if (cgroupCpusetPath.length() && (!cgroupUnified || Utility::isDirExist(cgroupCpusetPath)))
+	{
+		// un-pinned application use shared cores and memory nodes of parent
+		applySharedCpuSet();
+		writeLimit(cgroupCpusetPath + "/" + "cpuset.mems", cgroupUnified ? "" : Utility::stdStringTrim(Utility::readFile(cgroupCpusetRootName + "/" + "cpuset.mems")));
+		if (!cgroupUnified)
+		{
+			attachPaths.insert(cgroupCpusetPath);
+		}
 	}
+
+	for (const auto &path : attachPaths)
+	{
+		attachProcess(path);
+	}
+	return result;
 }
 
-void LinuxCgroup::retrieveCgroupHeirarchy()
+void LinuxCgroup::cleanOrphanCgroups(const std::set<std::string> &appNames)
+{
+	const static char fname[] = "LinuxCgroup::cleanOrphanCgroups() ";
+
+	retrieveCgroupHeirarchy();
+	for (const auto &root : std::set<std::string>{cgroupMemRootName, cgroupCpuRootName, cgroupCpusetRootName})
+	{
+		if (root.empty() || !Utility::isDirExist(root))
+			continue;
+		for (const auto &appDir : os::ls(root))
+		{
+			const auto appPath = root + "/" + appDir;
+			if (!Utility::isDirExist(appPath))
+				continue;
+			// per spawn sub dir "<app>/<index>" created by previous version
+			bool hasSubDir = false;
+			for (const auto &subDir : os::ls(appPath))
+			{
+				if (Utility::isNumber(subDir) && Utility::isDirExist(appPath + "/" + subDir))
+				{
+					removeCgroupDir(appPath + "/" + subDir);
+					hasSubDir = true;
+				}
+			}
+			if (hasSubDir && cgroupUnified)
+			{
+				// application cgroup become leaf, cgroup v2 does not allow processes in cgroup with enabled controllers
+				writeFile(appPath + "/cgroup.subtree_control", "-memory -cpu -io -cpuset");
+			}
+			if (appNames.count(appDir) == 0 && removeCgroupDir(appPath))
+			{
+				LOG_INF << fname << "Removed orphan cgroup : " << appPath;
+			}
+		}
+	}
+}
+
+bool LinuxCgroup::collectStats(CgroupStats &stats)
+{
+	if (!cgroupEnabled)
+		return false;
+	// cores pinned or released by other applications after this application started
+	if (m_pid > 0 && m_allocatedCpus.empty() && cgroupCpusetPath.length() && Utility::isDirExist(cgroupCpusetPath) &&
+		m_sharedCpuVersion != CpuSetAllocator::instance()->version())
+	{
+		applySharedCpuSet();
+	}
+	if (cgroupMemoryPath.empty())
+		return false;
+
+	// CPU usage, cgroup v2 report usec in cpu.stat, cgroup v1 report nsec in cpuacct.usage
+	long long cpuUsageUs = -1;
+	if (cgroupUnified)
+	{
+		readKeyValue(cgroupCpuPath + "/cpu.stat", "usage_usec", cpuUsageUs);
+	}
+	else if (readValue(cgroupCpuPath + "/cpuacct.usage", cpuUsageUs))
+	{
+		cpuUsageUs /= 1000;
+	}
+	if (cpuUsageUs >= 0)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (m_lastCpuUsageUs >= 0 && cpuUsageUs >= m_lastCpuUsageUs)
+		{
+			const auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(now - m_lastCpuSampleTime).count();
+			if (elapsedUs > 0)
+			{
+				stats.m_cpuPercent = 100.0 * (cpuUsageUs - m_lastCpuUsageUs) / elapsedUs;
+			}
+		}
+		m_lastCpuUsageUs = cpuUsageUs;
+		m_lastCpuSampleTime = now;
+	}
+
+	// IO and PSI are only accounted per cgroup on the unified hierarchy
+	if (cgroupUnified)
+	{
+		readIoStat(cgroupMemoryPath + "/io.stat", stats.m_ioReadBytes, stats.m_ioWriteBytes);
+		readPressure(cgroupCpuPath + "/cpu.pressure", stats.m_cpuPressure);
+		readPressure(cgroupMemoryPath + "/memory.pressure", stats.m_memoryPressure);
+		readPressure(cgroupMemoryPath + "/io.pressure", stats.m_ioPressure);
+	}
+
+	return readValue(cgroupMemoryPath + (cgroupUnified ? "/memory.current" : "/memory.usage_in_bytes"), stats.m_memoryBytes);
+}
+
+bool LinuxCgroup::retrieveCgroupHeirarchy()
 {
 	const static char fname[] = "LinuxCgroup::retrieveCgroupHeirarchy() ";
 
+	// Only need retrieve once for all
+	static bool retrieved = false;
+	static bool swapLimitSupport = false;
+	if (retrieved)
+		return swapLimitSupport;
+	retrieved = true;
+
 	// mount -t cgroup
 	FILE *fp = fopen("/proc/mounts", "r");
 	if (nullptr == fp)
 	{
 		LOG_ERR << fname << "Get file stream failed with error : " << std::strerror(errno);
-		return;
+		return swapLimitSupport;
 	}
 
+	std::string unifiedRootName;
 	struct mntent *entPtr = nullptr;
 	struct mntent entObj;
 	char buffer[4094] = {0};
 	while (nullptr != (entPtr = getmntent_r(fp, &entObj, buffer, sizeof(buffer))))
 	{
+		if (std::string("cgroup2") == entObj.mnt_type)
+		{
+			// cgroup2 on /sys/fs/cgroup type cgroup2 (rw,nosuid,nodev,noexec,relatime)
+			unifiedRootName = entObj.mnt_dir;
+			continue;
+		}
 		if (std::string("cgroup") != entObj.mnt_type)
 		{
 			// Ignore none cgroup mount point
@@ -130,48 +351,220 @@ void LinuxCgroup::retrieveCgroupHeirarchy()
 			cgroupCpuRootName = cgroupCpuRootName.c_str();
 			LOG_DBG << fname << "Get cpu hierarchy dir : " << cgroupCpuRootName;
 		}
+
+		if (hasmntopt(&entObj, "cpuset") && hasmntopt(&entObj, "rw"))
+		{
+			// cgroup on /sys/fs/cgroup/cpuset type cgroup (rw,nosuid,nodev,noexec,relatime,cpuset)
+			cgroupCpusetRootName = entObj.mnt_dir;
+			LOG_DBG << fname << "Get cpuset hierarchy dir : " << cgroupCpusetRootName;
+		}
 	}
 	if (fp)
 		fclose(fp);
+
+	// hybrid mode mount an empty cgroup2 beside v1 controllers, only use unified hierarchy when no v1 controller
+	if (cgroupMemRootName.empty() && cgroupCpuRootName.empty() && !unifiedRootName.empty())
+	{
+		cgroupUnified = true;
+		cgroupMemRootName = cgroupCpuRootName = cgroupCpusetRootName = unifiedRootName;
+		LOG_DBG << fname << "Get unified hierarchy dir : " << unifiedRootName;
+	}
+
+	// Check whether swap limit is enabled for OS, by default, Ubuntu does not enable swap limit
+	swapLimitSupport = cgroupUnified || Utility::isFileExist(cgroupMemRootName + "/memory.memsw.limit_in_bytes");
+	for (auto root : {&cgroupMemRootName, &cgroupCpuRootName, &cgroupCpusetRootName})
+	{
+		if (root->length())
+			*root += cgroupBaseDir;
+	}
+	return swapLimitSupport;
 }
 
-void LinuxCgroup::setPhysicalMemory(const std::string &cgroupPath, long long memLimitBytes)
+void LinuxCgroup::enableControllers()
 {
-	std::string specifiedHeirarchy = cgroupPath + "/" + "memory.limit_in_bytes";
-	writeFile(specifiedHeirarchy, memLimitBytes);
+	// application cgroup is the leaf which hold processes, only enable controllers for ancestors
+	const std::string controllers = "+memory +cpu +io +cpuset";
+	const std::string rootDir = cgroupMemRootName.substr(0, cgroupMemRootName.length() - cgroupBaseDir.length());
+	if (Utility::createRecursiveDirectory(cgroupMemRootName, 0711))
+	{
+		writeFile(rootDir + "/cgroup.subtree_control", controllers);
+		writeFile(cgroupMemRootName + "/cgroup.subtree_control", controllers);
+	}
+}
 
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
-	writeFile(tasksHeirarchy, m_pid);
+void LinuxCgroup::setPhysicalMemory(const std::string &cgroupPath, long long memLimitBytes)
+{
+	std::string specifiedHeirarchy = cgroupPath + "/" + (cgroupUnified ? "memory.max" : "memory.limit_in_bytes");
+	writeLimit(specifiedHeirarchy, memLimitBytes > 0 ? std::to_string(memLimitBytes) : unlimitedValue());
 }
 
 void LinuxCgroup::setSwapMemory(const std::string &cgroupPath, long long memSwapBytes)
 {
-	std::string specifiedHeirarchy = cgroupPath + "/" + "memory.memsw.limit_in_bytes";
-	writeFile(specifiedHeirarchy, memSwapBytes);
-
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
-	writeFile(tasksHeirarchy, m_pid);
+	std::string specifiedHeirarchy = cgroupPath + "/" + (cgroupUnified ? "memory.swap.max" : "memory.memsw.limit_in_bytes");
+	writeLimit(specifiedHeirarchy, memSwapBytes > 0 ? std::to_string(memSwapBytes) : unlimitedValue());
 }
 
 void LinuxCgroup::setCpuShares(const std::string &cgroupPath, long long cpuShares)
 {
-	std::string specifiedHeirarchy = cgroupPath + "/" + "cpu.shares";
-	writeFile(specifiedHeirarchy, cpuShares);
+	if (cgroupUnified)
+	{
+		// convert cpu.shares [2, 262144] to cpu.weight [1, 10000], 100 is kernel default
+		long long weight = 1 + ((std::max(cpuShares, 2LL) - 2) * 9999) / 262142;
+		writeLimit(cgroupPath + "/" + "cpu.weight", cpuShares > 0 ? std::to_string(std::min(weight, 10000LL)) : "100");
+	}
+	else
+	{
+		// 1024 is kernel default
+		writeLimit(cgroupPath + "/" + "cpu.shares", cpuShares > 0 ? std::to_string(cpuShares) : "1024");
+	}
+}
+
+void LinuxCgroup::applyCpuQuota(const std::string &cgroupPath)
+{
+	const auto periodUs = m_cpuPeriodUs > 0 ? m_cpuPeriodUs : DEFAULT_CGROUP_CPU_PERIOD_US;
+	const auto quota = m_cpuQuotaUs > 0 ? std::to_string(m_cpuQuotaUs) : unlimitedValue();
+	if (cgroupUnified)
+	{
+		writeLimit(cgroupPath + "/" + "cpu.max", quota + " " + std::to_string(periodUs));
+	}
+	else
+	{
+		// set period first, quota larger than parent period is rejected
+		writeLimit(cgroupPath + "/" + "cpu.cfs_period_us", std::to_string(periodUs));
+		writeLimit(cgroupPath + "/" + "cpu.cfs_quota_us", quota);
+	}
+}
+
+const std::string LinuxCgroup::unlimitedValue()
+{
+	return cgroupUnified ? "max" : "-1";
+}
+
+bool LinuxCgroup::pinned() const
+{
+	return m_cpuSet.length() || m_memNodes.length() || m_exclusiveCpus > 0;
+}
+
+bool LinuxCgroup::applyCpuSet(const std::string &cgroupPath)
+{
+	bool result = true;
+	if (m_allocatedCpus.length())
+	{
+		result = writeLimit(cgroupPath + "/" + "cpuset.cpus", m_allocatedCpus);
+	}
+	else
+	{
+		// memory nodes only, cores are shared
+		applySharedCpuSet();
+	}
+	// explicit memory nodes take priority, otherwise bind to the NUMA nodes of pinned cores
+	const auto mems = m_memNodes.length() ? m_memNodes : m_allocatedNodes;
+	if (mems.length())
+	{
+		result = writeLimit(cgroupPath + "/" + "cpuset.mems", mems) && result;
+	}
+	return result;
+}
+
+void LinuxCgroup::applySharedCpuSet()
+{
+	// version is read before cores, a change in between is applied by next refresh
+	m_sharedCpuVersion = CpuSetAllocator::instance()->version();
+	auto cpus = CpuSetAllocator::instance()->sharedCpuList();
+	if (cgroupUnified)
+	{
+		// empty cpuset of cgroup v2 use cpus of parent
+		writeLimit(cgroupCpusetPath + "/" + "cpuset.cpus", cpus);
+		return;
+	}
+	// cgroup v1 cpuset can not be empty, use cpus of parent when nothing is pinned
+	inheritCpuSet(cgroupCpusetRootName);
+	inheritCpuSet(cgroupCpusetPath);
+	if (cpus.empty())
+	{
+		cpus = Utility::stdStringTrim(Utility::readFile(cgroupCpusetRootName + "/" + "cpuset.cpus"));
+	}
+	writeLimit(cgroupCpusetPath + "/" + "cpuset.cpus", cpus);
+}
+
+void LinuxCgroup::inheritCpuSet(const std::string &cgroupPath)
+{
+	const auto parentPath = cgroupPath.substr(0, cgroupPath.rfind('/'));
+	if (!Utility::createRecursiveDirectory(cgroupPath, 0711))
+		return;
+	for (const auto &file : {"cpuset.cpus", "cpuset.mems"})
+	{
+		const auto path = cgroupPath + "/" + file;
+		if (Utility::stdStringTrim(Utility::readFile(path)).empty())
+		{
+			writeFile(path, Utility::stdStringTrim(Utility::readFile(parentPath + "/" + file)));
+		}
+	}
+}
 
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
+void LinuxCgroup::attachProcess(const std::string &cgroupPath)
+{
+	std::string tasksHeirarchy = cgroupPath + "/" + (cgroupUnified ? "cgroup.procs" : "tasks");
 	writeFile(tasksHeirarchy, m_pid);
 }
 
-void LinuxCgroup::writeFile(const std::string &cgroupPath, long long value)
+const std::string LinuxCgroup::allocationOwner() const
+{
+	// old and new application object with same name may exist together during update, identify allocation by object
+	return Utility::stringFormat("%s@%p", cgroupName.c_str(), this);
+}
+
+bool LinuxCgroup::writeLimit(const std::string &cgroupPath, const std::string &value)
+{
+	// skip when the same value was written before or already in kernel (cgroup reused by a new instance)
+	auto written = m_writtenLimits.find(cgroupPath);
+	if (written != m_writtenLimits.end() && written->second == value && Utility::isFileExist(cgroupPath))
+		return true;
+	std::ifstream file(cgroupPath);
+	std::string current;
+	if (!(file.is_open() && std::getline(file, current) && Utility::stdStringTrim(current) == value) && !writeFile(cgroupPath, value))
+	{
+		// written again next time
+		m_writtenLimits.erase(cgroupPath);
+		return false;
+	}
+	m_writtenLimits[cgroupPath] = value;
+	return true;
+}
+
+bool LinuxCgroup::removeCgroupDir(const std::string &cgroupPath)
+{
+	if (cgroupPath.empty() || !Utility::isDirExist(cgroupPath))
+		return true;
+	// rmdir on cgroup fail with EBUSY when there are processes inside
+	std::ifstream procs(cgroupPath + "/" + (cgroupUnified ? "cgroup.procs" : "tasks"));
+	std::string pid;
+	if (procs.is_open() && std::getline(procs, pid) && pid.length())
+		return false;
+	if (!cgroupUnified && Utility::isFileExist(cgroupPath + "/memory.force_empty"))
+	{
+		std::ofstream(cgroupPath + "/memory.force_empty") << 0;
+	}
+	return Utility::removeDir(cgroupPath);
+}
+
+bool LinuxCgroup::writeFile(const std::string &cgroupPath, long long value)
+{
+	return writeFile(cgroupPath, std::to_string(value));
+}
+
+bool LinuxCgroup::writeFile(const std::string &cgroupPath, const std::string &value)
 {
 	const static char fname[] = "LinuxCgroup::writeFile() ";
 
+	bool result = false;
 	FILE *fp = fopen(cgroupPath.c_str(), "w+");
 	if (fp)
 	{
-		if (fprintf(fp, "%lld", value))
+		if (fprintf(fp, "%s", value.c_str()) >= 0 && fflush(fp) == 0)
 		{
 			LOG_DBG << fname << "Write <" << value << "> to file <" << cgroupPath << "> success.";
+			result = true;
 		}
 		else
 		{
@@ -183,4 +576,74 @@ void LinuxCgroup::writeFile(const std::string &cgroupPath, long long value)
 	{
 		LOG_ERR << fname << "Failed open file <" << cgroupPath << ">, error :" << std::strerror(errno);
 	}
+	return result;
+}
+
+bool LinuxCgroup::readValue(const std::string &path, long long &value)
+{
+	std::ifstream file(path);
+	return file.is_open() && (file >> value);
+}
+
+bool LinuxCgroup::readKeyValue(const std::string &path, const std::string &key, long long &value)
+{
+	// cpu.stat:
+	//   usage_usec 23456
+	//   user_usec 12345
+	std::ifstream file(path);
+	std::string name;
+	long long number = 0;
+	while (file >> name >> number)
+	{
+		if (name == key)
+		{
+			value = number;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool LinuxCgroup::readIoStat(const std::string &path, long long &readBytes, long long &writeBytes)
+{
+	// io.stat, one line for each device:
+	//   8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	readBytes = writeBytes = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string field;
+		while (fields >> field)
+		{
+			if (Utility::startWith(field, "rbytes="))
+				readBytes += std::atoll(field.c_str() + strlen("rbytes="));
+			else if (Utility::startWith(field, "wbytes="))
+				writeBytes += std::atoll(field.c_str() + strlen("wbytes="));
+		}
+	}
+	return true;
+}
+
+bool LinuxCgroup::readPressure(const std::string &path, double &someAvg10)
+{
+	// cpu.pressure / memory.pressure / io.pressure:
+	//   some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+	//   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+	std::ifstream file(path);
+	std::string line;
+	if (std::getline(file, line) && Utility::startWith(line, "some "))
+	{
+		auto pos = line.find("avg10=");
+		if (pos != std::string::npos)
+		{
+			someAvg10 = std::atof(line.c_str() + pos + strlen("avg10="));
+			return true;
+		}
+	}
+	return false;
 }
@@ -1,35 +1,105 @@
 #pragma once
 
+#include <chrono>
+#include <map>
+#include <set>
 #include <string>
 
+//////////////////////////////////////////////////////////////////////////
+/// Resource usage of one cgroup, read from cgroup accounting files
+//////////////////////////////////////////////////////////////////////////
+struct CgroupStats
+{
+	CgroupStats();
+
+	long long m_memoryBytes;  // memory.current / memory.usage_in_bytes
+	double m_cpuPercent;	  // CPU usage since last sample, 100 means one full core
+	long long m_ioReadBytes;  // io.stat rbytes
+	long long m_ioWriteBytes; // io.stat wbytes
+	double m_cpuPressure;	  // PSI "some avg10" stall percentage
+	double m_memoryPressure;
+	double m_ioPressure;
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// Linux Cgroup Management interface
+/// One cgroup for each application, reused by all spawned processes
 //////////////////////////////////////////////////////////////////////////
 class LinuxCgroup
 {
 public:
 	explicit LinuxCgroup(long long memLimitBytes, long long memSwapBytes, long long cpuShares);
 	virtual ~LinuxCgroup();
-	void setCgroup(const std::string &appName, int pid, int index);
+	/// Hard CPU limit, quotaUs of CPU time in each periodUs, should be called before setCgroup()
+	void setCpuQuota(long long quotaUs, long long periodUs);
+	/// Pin to explicit cpus or exclusiveCpus auto allocated cores, should be called before setCgroup()
+	void setCpuSet(const std::string &cpuSet, const std::string &memNodes, int exclusiveCpus);
+	/// Reserve pinned cores before spawn, return false when cores are not available
+	bool allocateCpuSet(const std::string &appName);
+	/// Create or reuse cgroup of the application and move pid into it, return false when CPU pinning is not applied
+	bool setCgroup(const std::string &appName, int pid);
+	/// Read resource usage from cgroup files, return false when memory usage is not available.
+	/// Cpuset of un-pinned application is refreshed here when pinned cores changed
+	bool collectStats(CgroupStats &stats);
+	/// Remove empty cgroup dirs which do not belong to any application, called once when startup
+	static void cleanOrphanCgroups(const std::set<std::string> &appNames);
 
 private:
-	void retrieveCgroupHeirarchy();
+	static bool retrieveCgroupHeirarchy();
+	static bool removeCgroupDir(const std::string &cgroupPath);
+	void enableControllers();
 	void setPhysicalMemory(const std::string &cgroupPath, long long memLimitBytes);
 	void setSwapMemory(const std::string &cgroupPath, long long memSwapBytes);
 	void setCpuShares(const std::string &cgroupPath, long long cpuShares);
-	void writeFile(const std::string &cgroupPath, long long value);
+	void applyCpuQuota(const std::string &cgroupPath);
+	/// Value of memory and CPU quota file to remove the limit
+	static const std::string unlimitedValue();
+	bool pinned() const;
+	bool applyCpuSet(const std::string &cgroupPath);
+	/// Exclude cores pinned by other applications from un-pinned application
+	void applySharedCpuSet();
+	void inheritCpuSet(const std::string &cgroupPath);
+	void attachProcess(const std::string &cgroupPath);
+	const std::string allocationOwner() const;
+	bool writeLimit(const std::string &cgroupPath, const std::string &value);
+	static bool writeFile(const std::string &cgroupPath, long long value);
+	static bool writeFile(const std::string &cgroupPath, const std::string &value);
+
+	static bool readValue(const std::string &path, long long &value);
+	static bool readKeyValue(const std::string &path, const std::string &key, long long &value);
+	static bool readIoStat(const std::string &path, long long &readBytes, long long &writeBytes);
+	static bool readPressure(const std::string &path, double &someAvg10);
 
 private:
 	long long m_memLimitMb;
 	long long m_memSwapMb;
 	long long m_cpuShares;
+	long long m_cpuQuotaUs;
+	long long m_cpuPeriodUs;
+	std::string m_cpuSet;
+	std::string m_memNodes;
+	int m_exclusiveCpus;
 
 	int m_pid;
+	std::string cgroupName;
 	std::string cgroupMemoryPath;
 	std::string cgroupCpuPath;
+	std::string cgroupCpusetPath;
 	bool cgroupEnabled;
+	// limit file path -> written value
+	std::map<std::string, std::string> m_writtenLimits;
+	std::string m_allocatedCpus;
+	std::string m_allocatedNodes;
+	// CpuSetAllocator version of shared cores written to cpuset
+	std::size_t m_sharedCpuVersion;
+
+	// CPU usage of last sample, used to calculate CPU rate
+	long long m_lastCpuUsageUs;
+	std::chrono::steady_clock::time_point m_lastCpuSampleTime;
 
 	static std::string cgroupMemRootName;
 	static std::string cgroupCpuRootName;
+	static std::string cgroupCpusetRootName;
+	static bool cgroupUnified;
 	static const std::string cgroupBaseDir;
 };
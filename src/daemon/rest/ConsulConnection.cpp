@@ -6,6 +6,7 @@
 #include "ConsulConnection.h"
 #include "../application/Application.h"
 #include "../Configuration.h"
+#include "PrometheusRest.h"
 #include "../ResourceCollection.h"
 #include "../Scheduler.h"
 #include "../security/User.h"
@@ -14,11 +15,13 @@
 #include "../../common/PerfLog.h"
 #include "../../common/os/linux.hpp"
 
-#define CONSUL_BASE_PATH "/v1/kv/appmesh/"
+// key prefix of all App Mesh keys, KV API path is used by HTTP API and key by transaction and watch
+#define CONSUL_BASE_KEY "appmesh/"
+#define CONSUL_BASE_PATH "/v1/kv/" CONSUL_BASE_KEY
 //extern ACE_Reactor* m_timerReactor;
 
 ConsulConnection::ConsulConnection()
-	: m_ssnRenewTimerId(0), m_leader(0)
+	: m_ssnRenewTimerId(0), m_leader(0), m_kvWatching(false), m_kvWatchReset(false), m_scheduler(std::make_shared<Scheduler>())
 {
 	// override default reactor here
 	// m_reactor = m_timerReactor;
@@ -66,11 +69,16 @@ void ConsulConnection::reportNode()
 		node.m_label = Configuration::instance()->getLabel();
 		node.m_total_bytes = mem->total_bytes;
 		node.m_cores = os::cpus().size();
+		{
+			// free memory is used by scheduler to avoid saturated node, round down to reduce node update
+			auto freeMem = os::memory();
+			if (freeMem)
+				node.m_free_bytes = std::max<uint64_t>(freeMem->free_bytes / CONSUL_REPORT_MEM_STEP_BYTES * CONSUL_REPORT_MEM_STEP_BYTES, 1);
+		}
 		web::json::value body = node.AsJson();
 		auto cloudBody = this->retrieveNode(MY_HOST_NAME);
 		if (cloudBody.serialize() == body.serialize())
 		{
-			// TODO: mem_free_bytes is always not the same here
 			LOG_DBG << fname << "host info " << MY_HOST_NAME << " is the same with server";
 			return;
 		}
@@ -136,23 +144,6 @@ void ConsulConnection::refreshSession(int timerId)
 	this->consulSessionId("");
 }
 
-long long ConsulConnection::getModifyIndex(const std::string &path, bool recurse)
-{
-	const static char fname[] = "ConsulConnection::getModifyIndex() ";
-
-	std::map<std::string, std::string> query;
-	if (recurse)
-		query["recurse"] = "true";
-	auto resp = requestHttp(web::http::methods::GET, path, query, {}, nullptr);
-	if (resp.headers().has("X-Consul-Index"))
-	{
-		auto index = std::atoll(resp.headers().find("X-Consul-Index")->second.c_str());
-		LOG_DBG << fname << path << " index : " << index;
-		return index;
-	}
-	return 0;
-}
-
 void ConsulConnection::syncSchedule()
 {
 	const static char fname[] = "ConsulConnection::syncSchedule() ";
@@ -172,7 +163,7 @@ void ConsulConnection::syncSchedule()
 		{
 			// Leader's job
 			std::lock_guard<std::recursive_mutex> guard(m_mutex);
-			doSchedule();
+			doSchedule(retrieveTask(), retrieveNode(), retrieveTopology(""));
 		}
 	}
 	catch (const std::exception &ex)
@@ -208,13 +199,7 @@ void ConsulConnection::syncSecurity()
 			if (!HAS_JSON_FIELD(securityJson, "ModifyIndex") || !HAS_JSON_FIELD(securityJson, "Value"))
 				return;
 
-			auto security = web::json::value::parse(Utility::decode64(GET_JSON_STR_VALUE(securityJson, "Value")));
-			auto securityObj = Configuration::JsonSecurity::FromJson(security);
-			if (securityObj->m_jwtUsers->getUsers().size())
-			{
-				Configuration::instance()->updateSecurity(securityObj);
-				LOG_DBG << fname << "Security info updated from Consul successfully";
-			}
+			applySecurity(Utility::decode64(GET_JSON_STR_VALUE(securityJson, "Value")));
 		}
 		else
 		{
@@ -231,6 +216,19 @@ void ConsulConnection::syncSecurity()
 	}
 }
 
+void ConsulConnection::applySecurity(const std::string &securityText)
+{
+	const static char fname[] = "ConsulConnection::applySecurity() ";
+
+	auto security = web::json::value::parse(securityText);
+	auto securityObj = Configuration::JsonSecurity::FromJson(security);
+	if (securityObj->m_jwtUsers->getUsers().size())
+	{
+		Configuration::instance()->updateSecurity(securityObj);
+		LOG_DBG << fname << "Security info updated from Consul successfully";
+	}
+}
+
 std::string ConsulConnection::requestSessionId()
 {
 	const static char fname[] = "ConsulConnection::requestSessionId() ";
@@ -307,7 +305,7 @@ void ConsulConnection::consulSessionId(const std::string &sessionId)
 	m_sessionId = sessionId;
 }
 
-void ConsulConnection::doSchedule()
+void ConsulConnection::doSchedule(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskList, const std::map<std::string, std::shared_ptr<ConsulNode>> &nodes, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology)
 {
 	const static char fname[] = "ConsulConnection::doSchedule() ";
 	LOG_DBG << fname;
@@ -317,16 +315,11 @@ void ConsulConnection::doSchedule()
 	{
 		LOG_DBG << fname << "leader now, do schedule";
 
-		auto taskList = retrieveTask();
-		auto oldTopology = retrieveTopology("");
-		auto nodes = retrieveNode();
 		if (nodes.size())
 		{
-			// find matched hosts for each task
-			findTaskAvailableHost(taskList, nodes);
-
-			// schedule task
-			auto newTopology = Scheduler::scheduleTask(taskList, oldTopology);
+			// schedule task, only changed tasks and nodes are processed
+			m_scheduler->strategy(Configuration::instance()->getConsul()->m_scheduleStrategy);
+			auto newTopology = m_scheduler->schedule(taskList, nodes, oldTopology);
 
 			// apply schedule result
 			compareTopologyAndDispatch(oldTopology, newTopology);
@@ -349,24 +342,29 @@ void ConsulConnection::doSchedule()
 
 void ConsulConnection::syncTopology()
 {
-	const static char fname[] = "ConsulConnection::syncTopology() ";
-
-	auto currentAllApps = Configuration::instance()->getApps();
 	std::shared_ptr<ConsulTopology> newTopology;
 	auto topology = retrieveTopology(MY_HOST_NAME);
 	auto hostTopologyIt = topology.find(MY_HOST_NAME);
 	if (hostTopologyIt != topology.end())
 		newTopology = hostTopologyIt->second;
 
+	applyTopology(newTopology, newTopology ? retrieveTask() : std::map<std::string, std::shared_ptr<ConsulTask>>());
+}
+
+void ConsulConnection::applyTopology(const std::shared_ptr<ConsulTopology> &newTopology, const std::map<std::string, std::shared_ptr<ConsulTask>> &task)
+{
+	const static char fname[] = "ConsulConnection::applyTopology() ";
+
+	auto currentAllApps = Configuration::instance()->getApps();
 	if (newTopology)
 	{
-		auto task = retrieveTask();
 		for (const auto &hostApp : newTopology->m_scheduleApps)
 		{
 			const auto &appName = hostApp.first;
-			if (task.count(appName))
+			auto taskIt = task.find(appName);
+			if (taskIt != task.end())
 			{
-				auto &consulTask = task[appName];
+				const auto &consulTask = taskIt->second;
 				std::shared_ptr<Application> topologyAppObj = consulTask->m_app;
 				auto it = std::find_if(currentAllApps.begin(), currentAllApps.end(), [&appName](std::shared_ptr<Application> const &obj) {
 					return obj->getName() == appName;
@@ -543,61 +541,22 @@ void ConsulConnection::saveSecurity(bool checkExistance)
 	}
 }
 
-void ConsulConnection::findTaskAvailableHost(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskMap, const std::map<std::string, std::shared_ptr<ConsulNode>> &hosts)
-{
-	const static char fname[] = "ConsulConnection::findTaskAvailableHost() ";
-
-	for (const auto &task : taskMap)
-	{
-		auto taskName = task.first;
-		task.second->m_matchedHosts.clear();
-		for (const auto &host : hosts)
-		{
-			auto &hostName = host.first;
-			auto &consulHost = host.second;
-			auto &taskCondition = task.second->m_condition;
-			if (consulHost->m_label->match(taskCondition))
-			{
-				task.second->m_matchedHosts[hostName] = consulHost;
-				LOG_DBG << fname << " task <" << taskName << "> match host <" << hostName << ">";
-			}
-		}
-	}
-}
-
 void ConsulConnection::compareTopologyAndDispatch(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldT, const std::map<std::string, std::shared_ptr<ConsulTopology>> &newT)
 {
+	// collect all changed hosts, write together
+	std::map<std::string, std::shared_ptr<ConsulTopology>> changes;
 	for (const auto &newHost : newT)
 	{
-		if (oldT.count(newHost.first))
+		auto oldHost = oldT.find(newHost.first);
+		if (oldHost == oldT.end())
 		{
-			auto equal = true;
-			if (newHost.second->m_scheduleApps.size() == oldT.find(newHost.first)->second->m_scheduleApps.size())
-			{
-				for (const auto &app : newHost.second->m_scheduleApps)
-				{
-					if (!oldT.find(newHost.first)->second->m_scheduleApps.count(app.first))
-					{
-						equal = false;
-						break;
-					}
-				}
-				// equal, do nothing here
-			}
-			else
-			{
-				equal = false;
-			}
-			if (!equal)
-			{
-				// update
-				writeTopology(newHost.first, newHost.second);
-			}
+			// add
+			changes[newHost.first] = newHost.second;
 		}
-		else
+		else if (!newHost.second->operator==(oldHost->second))
 		{
-			// add
-			writeTopology(newHost.first, newHost.second);
+			// update
+			changes[newHost.first] = newHost.second;
 		}
 	}
 
@@ -606,9 +565,14 @@ void ConsulConnection::compareTopologyAndDispatch(const std::map<std::string, st
 		if (!newT.count(oldHost.first))
 		{
 			// delete
-			writeTopology(oldHost.first, nullptr);
+			changes[oldHost.first] = nullptr;
 		}
 	}
+
+	if (changes.size())
+	{
+		writeTopology(changes);
+	}
 }
 
 web::json::value ConsulConnection::getAppJsonWithIndexEnv(std::shared_ptr<Application> app, int index)
@@ -628,32 +592,65 @@ web::json::value ConsulConnection::getAppJsonWithIndexEnv(std::shared_ptr<Applic
 	return appJson;
 }
 
-bool ConsulConnection::writeTopology(std::string hostName, const std::shared_ptr<ConsulTopology> topology)
+bool ConsulConnection::writeTopology(const std::map<std::string, std::shared_ptr<ConsulTopology>> &topology)
 {
 	const static char fname[] = "ConsulConnection::writeTopology() ";
 
-	//topology: /appmesh/topology/myhost
-	std::string path = std::string(CONSUL_BASE_PATH).append("topology/").append(hostName);
-	auto body = web::json::value::object();
-	auto timestamp = std::to_string(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
-	if (topology && topology->m_scheduleApps.size())
-		body = topology->AsJson();
-	web::http::http_response resp = requestHttp(web::http::methods::PUT, path, {{"flags", timestamp}}, {}, &body);
-	LOG_INF << fname << "write <" << body.serialize() << "> to <" << hostName << ">";
+	auto timestamp = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	std::vector<web::json::value> operations;
+	for (const auto &host : topology)
+	{
+		//topology: appmesh/topology/myhost
+		auto kv = web::json::value::object();
+		kv["Key"] = web::json::value::string(std::string(CONSUL_BASE_KEY).append("topology/").append(host.first));
+		if (host.second)
+		{
+			auto body = host.second->AsJson();
+			kv["Verb"] = web::json::value::string("set");
+			kv["Value"] = web::json::value::string(Utility::encode64(body.serialize()));
+			kv["Flags"] = web::json::value::number(static_cast<int64_t>(timestamp));
+			LOG_INF << fname << "write <" << body.serialize() << "> to <" << host.first << ">";
+		}
+		else
+		{
+			kv["Verb"] = web::json::value::string("delete");
+			LOG_INF << fname << "delete topology of <" << host.first << ">";
+		}
+		auto operation = web::json::value::object();
+		operation["KV"] = kv;
+		operations.push_back(operation);
+	}
+	return requestTxn(operations);
+}
 
-	if (resp.status_code() == web::http::status_codes::OK)
+bool ConsulConnection::requestTxn(const std::vector<web::json::value> &operations)
+{
+	const static char fname[] = "ConsulConnection::requestTxn() ";
+
+	// https://www.consul.io/api/txn.html
+	// one transaction is atomic, large change set is split into several transactions
+	bool success = true;
+	for (std::size_t offset = 0; offset < operations.size(); offset += CONSUL_TXN_MAX_OPERATIONS)
 	{
-		auto result = resp.extract_utf8string(true).get();
-		if (result == "true")
+		auto count = std::min(operations.size() - offset, static_cast<std::size_t>(CONSUL_TXN_MAX_OPERATIONS));
+		auto body = web::json::value::array(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			body[i] = operations[offset + i];
+		}
+		auto resp = requestHttp(web::http::methods::PUT, "/v1/txn", {}, {}, &body);
+		if (resp.status_code() == web::http::status_codes::OK)
 		{
-			return true;
+			LOG_DBG << fname << "transaction with <" << count << "> operations success";
 		}
 		else
 		{
-			LOG_WAR << fname << " PUT " << path << " failed with response : " << result;
+			// 409 means transaction rolled back, response contains Errors
+			success = false;
+			LOG_WAR << fname << "transaction with <" << count << "> operations failed with return code <" << resp.status_code() << "> : " << resp.extract_utf8string(true).get();
 		}
 	}
-	return false;
+	return success;
 }
 
 /*
@@ -692,21 +689,14 @@ std::map<std::string, std::shared_ptr<ConsulTopology>> ConsulConnection::retriev
 		{
 			for (const auto &section : json.as_array())
 			{
-				if (HAS_JSON_FIELD(section, "Value"))
+				auto consulKey = GET_JSON_STR_VALUE(section, "Key");
+				auto vec = Utility::splitString(consulKey, "/");
+				auto hostName = vec[vec.size() - 1];
+				auto hostTopology = parseTopology(section, hostName);
+				if (hostTopology)
 				{
-					// int consulIndex = GET_JSON_INT_VALUE(section, "ModifyIndex");
-					auto hostText = Utility::decode64(GET_JSON_STR_VALUE(section, "Value"));
-					if (hostText.empty())
-						continue;
-					auto consulKey = GET_JSON_STR_VALUE(section, "Key");
-					auto vec = Utility::splitString(consulKey, "/");
-					auto hostName = vec[vec.size() - 1];
-					auto appArrayJson = web::json::value::parse(hostText);
-					if (appArrayJson.is_array())
-					{
-						topology[hostName] = ConsulTopology::FromJson(appArrayJson, hostName);
-						LOG_DBG << fname << "get <" << appArrayJson.size() << "> task for <" << hostName << ">";
-					}
+					topology[hostName] = hostTopology;
+					LOG_DBG << fname << "get <" << hostTopology->m_scheduleApps.size() << "> task for <" << hostName << ">";
 				}
 			}
 		}
@@ -731,12 +721,10 @@ std::map<std::string, std::shared_ptr<ConsulTask>> ConsulConnection::retrieveTas
 		{
 			for (const auto &section : json.as_array())
 			{
-				if (HAS_JSON_FIELD(section, "Value") && GET_JSON_STR_VALUE(section, "Key") != "appmesh/cluster/tasks")
+				if (GET_JSON_STR_VALUE(section, "Key") != CONSUL_BASE_KEY "cluster/tasks")
 				{
-					auto appText = Utility::decode64(GET_JSON_STR_VALUE(section, "Value"));
-					auto appJson = web::json::value::parse(appText);
-					auto task = ConsulTask::FromJson(appJson);
-					if (task->m_app && task->m_app->getName().length() && task->m_replication)
+					auto task = parseTask(section);
+					if (task)
 					{
 						result[task->m_app->getName()] = task;
 						LOG_DBG << fname << "get task <" << task->m_app->getName() << ">";
@@ -769,15 +757,13 @@ std::map<std::string, std::shared_ptr<ConsulNode>> ConsulConnection::retrieveNod
 		{
 			for (const auto &section : json.as_array())
 			{
-				if (section.has_string_field("Key") && section.has_string_field("Value") && section.at("Value").as_string().length())
+				auto key = GET_JSON_STR_VALUE(section, "Key");
+				if (Utility::startWith(key, CONSUL_BASE_KEY "cluster/nodes/"))
 				{
-					auto key = GET_JSON_STR_VALUE(section, "Key");
-					if (Utility::startWith(key, "appmesh/cluster/nodes/"))
-					{
-						auto host = Utility::stringReplace(key, "appmesh/cluster/nodes/", "");
-						auto value = web::json::value::parse(Utility::decode64(section.at("Value").as_string()));
-						result[host] = ConsulNode::FromJson(value, host);
-					}
+					auto host = Utility::stringReplace(key, CONSUL_BASE_KEY "cluster/nodes/", "");
+					auto node = parseNode(section, host);
+					if (node)
+						result[host] = node;
 				}
 			}
 		}
@@ -807,6 +793,47 @@ web::json::value ConsulConnection::retrieveNode(const std::string &host)
 	return web::json::value();
 }
 
+std::shared_ptr<ConsulTask> ConsulConnection::parseTask(const web::json::value &section)
+{
+	if (HAS_JSON_FIELD(section, "Value"))
+	{
+		auto appJson = web::json::value::parse(Utility::decode64(GET_JSON_STR_VALUE(section, "Value")));
+		auto task = ConsulTask::FromJson(appJson);
+		if (task->m_app && task->m_app->getName().length() && task->m_replication)
+		{
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+std::shared_ptr<ConsulNode> ConsulConnection::parseNode(const web::json::value &section, const std::string &host)
+{
+	if (section.has_string_field("Value") && section.at("Value").as_string().length())
+	{
+		auto value = web::json::value::parse(Utility::decode64(section.at("Value").as_string()));
+		return ConsulNode::FromJson(value, host);
+	}
+	return nullptr;
+}
+
+std::shared_ptr<ConsulTopology> ConsulConnection::parseTopology(const web::json::value &section, const std::string &host)
+{
+	if (HAS_JSON_FIELD(section, "Value"))
+	{
+		auto hostText = Utility::decode64(GET_JSON_STR_VALUE(section, "Value"));
+		if (hostText.length())
+		{
+			auto appArrayJson = web::json::value::parse(hostText);
+			if (appArrayJson.is_array())
+			{
+				return ConsulTopology::FromJson(appArrayJson, host);
+			}
+		}
+	}
+	return nullptr;
+}
+
 void ConsulConnection::initTimer(std::string recoverSsnId)
 {
 	const static char fname[] = "ConsulConnection::initTimer() ";
@@ -837,37 +864,23 @@ void ConsulConnection::initTimer(std::string recoverSsnId)
 		this->consulSessionId("");
 	}
 
-	// security watch
-	if (Configuration::instance()->getConsul()->consulSecurityEnabled())
-	{
-		m_securityWatch = std::make_shared<std::thread>(std::bind(&ConsulConnection::watchSecurityThread, this));
-		m_securityWatch->detach();
-	}
-	// topology watch
-	if (Configuration::instance()->getConsul()->m_isNode)
-	{
-		m_topologyWatch = std::make_shared<std::thread>(std::bind(&ConsulConnection::watchTopologyThread, this));
-		m_topologyWatch->detach();
-	}
-	// schedule nodes watch
-	if (Configuration::instance()->getConsul()->m_isMaster)
+	// one watch for security, topology and schedule, the running watch re-process all keys for new configuration
+	m_kvWatchReset = true;
+	bool watching = false;
+	if (kvWatchEnabled() && m_kvWatching.compare_exchange_strong(watching, true))
 	{
-		m_scheduleWatch = std::make_shared<std::thread>(std::bind(&ConsulConnection::watchScheduleThread, this));
-		m_scheduleWatch->detach();
+		m_kvWatch = std::make_shared<std::thread>(std::bind(&ConsulConnection::watchKvThread, this));
+		m_kvWatch->detach();
 	}
 }
 
-web::http::http_response ConsulConnection::requestHttp(const web::http::method &mtd, const std::string &path, std::map<std::string, std::string> query, std::map<std::string, std::string> header, web::json::value *body)
+web::http::http_response ConsulConnection::requestHttp(const web::http::method &mtd, const std::string &path, std::map<std::string, std::string> query, std::map<std::string, std::string> header, web::json::value *body, int timeoutSeconds)
 {
 	const static char fname[] = "ConsulConnection::requestHttp() ";
+	HistogramTimer timer(PrometheusRest::consulHistogram(GET_STD_STRING(mtd)));
 
-	auto restURL = Configuration::instance()->getConsul()->m_consulUrl;
-
-	// Create http_client to send the request.
-	web::http::client::http_client_config config;
-	//config.set_timeout(std::chrono::seconds(5));
-	config.set_validate_certificates(false);
-	web::http::client::http_client client(restURL, config);
+	// Shared keep-alive client, request with different timeout use different client
+	auto client = getHttpClient("request", timeoutSeconds > 0 ? timeoutSeconds : CONSUL_REQUEST_TIMEOUT_SECONDS);
 
 	// Build request URI and start the request.
 	web::uri_builder builder(GET_STRING_T(path));
@@ -890,7 +903,7 @@ web::http::http_response ConsulConnection::requestHttp(const web::http::method &
 	{
 		// In case of REST server crash or block query timeout, will throw exception:
 		// "Failed to read HTTP status line"
-		web::http::http_response response = client.request(request).get();
+		web::http::http_response response = client->request(request).get();
 		LOG_DBG << fname << mtd << " " << path << " return " << response.status_code();
 		return response;
 	}
@@ -907,18 +920,45 @@ web::http::http_response ConsulConnection::requestHttp(const web::http::method &
 	return response;
 }
 
-std::tuple<bool, long long> ConsulConnection::blockWatchKv(const std::string &kvPath, long long lastIndex, bool recurse)
+std::shared_ptr<web::http::client::http_client> ConsulConnection::getHttpClient(const std::string &connectionName, int timeoutSeconds)
 {
-	const static char fname[] = "ConsulConnection::blockWatchKv() ";
+	const static char fname[] = "ConsulConnection::getHttpClient() ";
 
 	auto restURL = Configuration::instance()->getConsul()->m_consulUrl;
+	auto key = connectionName + ":" + std::to_string(timeoutSeconds);
+
+	std::lock_guard<std::mutex> guard(m_httpClientMutex);
+	if (m_httpClientUrl != restURL)
+	{
+		// Consul url changed, drop all connections to old endpoint,
+		// clients still in use are released after their last request finished
+		m_httpClients.clear();
+		m_httpClientUrl = restURL;
+	}
+	auto it = m_httpClients.find(key);
+	if (it != m_httpClients.end())
+	{
+		return it->second;
+	}
 
-	int waitTimeout = 30;
-	// Create http_client to send the request.
+	// http_client keep HTTP/1.1 connections alive and reuse them for following requests
 	web::http::client::http_client_config config;
-	config.set_timeout(std::chrono::seconds(waitTimeout)); // set block pull to 30s timeout
+	config.set_timeout(std::chrono::seconds(timeoutSeconds));
 	config.set_validate_certificates(false);
-	web::http::client::http_client client(restURL, config);
+	auto client = std::make_shared<web::http::client::http_client>(restURL, config);
+	m_httpClients[key] = client;
+	LOG_DBG << fname << "new connection <" << key << "> to " << restURL;
+	return client;
+}
+
+std::tuple<bool, long long> ConsulConnection::blockWatchKv(const std::string &connectionName, const std::string &kvPath, long long lastIndex, bool recurse, web::json::value *result)
+{
+	const static char fname[] = "ConsulConnection::blockWatchKv() ";
+
+	int waitTimeout = CONSUL_WATCH_WAIT_SECONDS;
+	// Dedicated connection for each watcher, so a pending block query never hold other requests,
+	// client timeout is a little longer than Consul wait time (Consul add up to wait/16 jitter)
+	auto client = getHttpClient(connectionName, waitTimeout + 5);
 
 	// Build request URI and start the request.
 	web::uri_builder builder(GET_STRING_T(kvPath));
@@ -936,13 +976,26 @@ std::tuple<bool, long long> ConsulConnection::blockWatchKv(const std::string &kv
 
 	try
 	{
-		web::http::http_response response = client.request(request).get();
+		web::http::http_response response = client->request(request).get();
 		long long index = 0;
 		if (response.headers().has("X-Consul-Index"))
 		{
 			index = std::atoll(response.headers().find("X-Consul-Index")->second.c_str());
 		}
 		bool success = (response.status_code() == web::http::status_codes::OK);
+		if (result != nullptr)
+		{
+			if (success)
+			{
+				*result = response.extract_json(true).get();
+			}
+			else if (response.status_code() == web::http::status_codes::NotFound)
+			{
+				// no key under the path
+				*result = web::json::value::array();
+				success = true;
+			}
+		}
 		return std::make_tuple(success, index);
 	}
 	catch (...)
@@ -955,77 +1008,202 @@ std::tuple<bool, long long> ConsulConnection::blockWatchKv(const std::string &kv
 	return std::make_tuple(false, 0);
 }
 
-void ConsulConnection::watchSecurityThread()
+bool ConsulConnection::kvWatchEnabled() const
+{
+	auto consul = Configuration::instance()->getConsul();
+	return consul->consulEnabled() && (consul->consulSecurityEnabled() || consul->m_isNode || consul->m_isMaster);
+}
+
+void ConsulConnection::watchKvThread()
 {
-	const static char fname[] = "ConsulConnection::watchSecurityThread() ";
+	const static char fname[] = "ConsulConnection::watchKvThread() ";
 	LOG_DBG << fname;
 
-	std::string path = std::string(CONSUL_BASE_PATH).append("security");
-	long long index = getModifyIndex(path);
-	this->syncSecurity();
-	while (Configuration::instance()->getConsul()->consulSecurityEnabled())
+	// /v1/kv/appmesh/?recurse, index 0 return current keys immediately
+	const std::string path = CONSUL_BASE_PATH;
+	long long index = 0;
+	bool watching = false;
+	do
 	{
-		auto result = blockWatchKv(path, index);
-		if (std::get<0>(result) || (std::get<1>(result) != index && std::get<1>(result) > 0))
-		{
-			// watch success
-			index = std::get<1>(result);
-			this->syncSecurity();
-		}
-		else
+		while (kvWatchEnabled())
 		{
-			std::this_thread::sleep_for(std::chrono::seconds(3));
+			if (m_kvWatchReset.exchange(false))
+			{
+				m_kvIndex.clear();
+				m_kvTasks.clear();
+				m_kvNodes.clear();
+				m_kvTopology.clear();
+				index = 0;
+			}
+
+			web::json::value kvs;
+			auto result = blockWatchKv("watch", path, index, true, &kvs);
+			if (std::get<0>(result))
+			{
+				// index go backwards means Consul state was reset, watch from 0 again
+				auto newIndex = std::get<1>(result);
+				index = (newIndex < index) ? 0 : newIndex;
+				try
+				{
+					handleKvChanges(kvs);
+				}
+				catch (const std::exception &ex)
+				{
+					LOG_WAR << fname << " got exception: " << ex.what();
+				}
+				catch (...)
+				{
+					LOG_WAR << fname << " exception";
+				}
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::seconds(3));
+			}
 		}
-	}
+		m_kvIndex.clear();
+		m_kvWatchReset = true;
+		m_kvWatching = false;
+		// watch enabled again before flag cleared was not started by initTimer(), continue in this thread
+		watching = false;
+	} while (kvWatchEnabled() && m_kvWatching.compare_exchange_strong(watching, true));
 	LOG_DBG << fname << "exit";
 }
 
-void ConsulConnection::watchTopologyThread()
+void ConsulConnection::handleKvChanges(const web::json::value &kvs)
 {
-	const static char fname[] = "ConsulConnection::watchTopologyThread() ";
-	LOG_DBG << fname;
+	const static char fname[] = "ConsulConnection::handleKvChanges() ";
+
+	const static std::string securityKey = CONSUL_BASE_KEY "security";
+	const static std::string leaderKey = CONSUL_BASE_KEY "leader";
+	const static std::string topologyPrefix = CONSUL_BASE_KEY "topology/";
+	const static std::string taskPrefix = CONSUL_BASE_KEY "cluster/tasks/";
+	const static std::string nodePrefix = CONSUL_BASE_KEY "cluster/nodes/";
+
+	bool securityChanged = false;
+	bool hostTopologyChanged = false;
+	bool clusterChanged = false;
+	std::string securityText;
+	std::set<std::string> changedApps;
+
+	// section is nullptr for removed key
+	auto dispatch = [&](const std::string &key, const web::json::value *section) {
+		if (key == securityKey)
+		{
+			securityChanged = (section != nullptr);
+			if (section)
+				securityText = Utility::decode64(GET_JSON_STR_VALUE((*section), "Value"));
+		}
+		else if (key == leaderKey)
+		{
+			// leader session released, other master can take over
+			// (leader refresh the key for each schedule, so only care deletion)
+			if (section == nullptr)
+				clusterChanged = true;
+		}
+		else if (Utility::startWith(key, topologyPrefix))
+		{
+			auto host = key.substr(topologyPrefix.length());
+			auto topology = section ? parseTopology(*section, host) : nullptr;
+			if (topology)
+				m_kvTopology[host] = topology;
+			else
+				m_kvTopology.erase(host);
+			if (host == MY_HOST_NAME)
+				hostTopologyChanged = true;
+		}
+		else if (Utility::startWith(key, taskPrefix))
+		{
+			auto oldTask = m_kvTasks.find(key);
+			if (oldTask != m_kvTasks.end())
+			{
+				changedApps.insert(oldTask->second->m_app->getName());
+				m_kvTasks.erase(oldTask);
+			}
+			auto task = section ? parseTask(*section) : nullptr;
+			if (task)
+			{
+				changedApps.insert(task->m_app->getName());
+				m_kvTasks[key] = task;
+			}
+			clusterChanged = true;
+		}
+		else if (Utility::startWith(key, nodePrefix))
+		{
+			auto host = key.substr(nodePrefix.length());
+			auto node = section ? parseNode(*section, host) : nullptr;
+			if (node)
+				m_kvNodes[host] = node;
+			else
+				m_kvNodes.erase(host);
+			clusterChanged = true;
+		}
+	};
 
-	auto path = std::string(CONSUL_BASE_PATH).append("topology/").append(MY_HOST_NAME);
-	long long index = getModifyIndex(path);
-	this->syncTopology();
-	while (Configuration::instance()->getConsul()->m_isNode)
+	// changed keys
+	std::map<std::string, long long> latestIndex;
+	if (kvs.is_array())
 	{
-		auto result = blockWatchKv(path, index);
-		if (std::get<0>(result) || (std::get<1>(result) != index && std::get<1>(result) > 0))
+		for (const auto &section : kvs.as_array())
 		{
-			// watch success
-			index = std::get<1>(result);
-			this->syncTopology();
+			auto key = GET_JSON_STR_VALUE(section, "Key");
+			auto modifyIndex = GET_JSON_NUMBER_VALUE(section, "ModifyIndex");
+			latestIndex[key] = modifyIndex;
+			auto oldIndex = m_kvIndex.find(key);
+			if (oldIndex == m_kvIndex.end() || oldIndex->second != modifyIndex)
+			{
+				LOG_DBG << fname << "key <" << key << "> changed with index <" << modifyIndex << ">";
+				dispatch(key, &section);
+			}
 		}
-		else
+	}
+	// removed keys
+	for (const auto &kv : m_kvIndex)
+	{
+		if (latestIndex.count(kv.first) == 0)
 		{
-			std::this_thread::sleep_for(std::chrono::seconds(3));
+			LOG_DBG << fname << "key <" << kv.first << "> removed";
+			dispatch(kv.first, nullptr);
 		}
 	}
-	LOG_DBG << fname << "exit";
-}
+	m_kvIndex.swap(latestIndex);
 
-void ConsulConnection::watchScheduleThread()
-{
-	const static char fname[] = "ConsulConnection::watchScheduleThread() ";
-	LOG_DBG << fname;
+	auto consul = Configuration::instance()->getConsul();
+	std::map<std::string, std::shared_ptr<ConsulTask>> tasks;
+	for (const auto &task : m_kvTasks)
+	{
+		tasks[task.second->m_app->getName()] = task.second;
+	}
 
-	auto path = std::string(CONSUL_BASE_PATH).append("cluster/");
-	long long index = getModifyIndex(path, true);
-	this->syncSchedule();
-	while (Configuration::instance()->getConsul()->m_isMaster)
+	// security
+	if (securityChanged && consul->consulSecurityEnabled())
 	{
-		auto result = blockWatchKv(path, index);
-		if (std::get<0>(result) || (std::get<1>(result) != index && std::get<1>(result) > 0))
-		{
-			// watch success
-			index = std::get<1>(result);
-			this->syncSchedule();
-		}
-		else
+		this->applySecurity(securityText);
+	}
+
+	// topology of this node, task content change also need update local application
+	auto hostTopology = m_kvTopology.count(MY_HOST_NAME) ? m_kvTopology[MY_HOST_NAME] : nullptr;
+	if (hostTopology && !hostTopologyChanged)
+	{
+		for (const auto &app : changedApps)
 		{
-			std::this_thread::sleep_for(std::chrono::seconds(3));
+			if (hostTopology->m_scheduleApps.count(app))
+				hostTopologyChanged = true;
 		}
 	}
-	LOG_DBG << fname << "exit";
+	if (hostTopologyChanged && consul->m_isNode)
+	{
+		this->applyTopology(hostTopology, tasks);
+	}
+
+	// schedule
+	if (clusterChanged && consul->m_isMaster)
+	{
+		if (consulSessionId().empty())
+			this->consulSessionId(requestSessionId());
+
+		// unchanged cache objects let scheduler skip unchanged tasks and nodes
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		doSchedule(tasks, m_kvNodes, m_kvTopology);
+	}
 }
@@ -1,10 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
+#include <cpprest/http_client.h>
 #include <cpprest/http_msg.h>
 #include <cpprest/json.h>
 #include "../Label.h"
@@ -12,6 +16,7 @@
 #include "ConsulEntity.h"
 #include "../process/AppProcess.h"
 
+class Scheduler;
 class ConsulConnection : public TimerHandler
 {
 public:
@@ -27,15 +32,24 @@ public:
 	void syncTopology();
 
 private:
+	// test_consul verify topology transactions against a fake Consul
+	friend class ConsulConnectionTest;
+
 	void reportNode();
-	long long getModifyIndex(const std::string &path, bool recurse = false);
 
-	web::http::http_response requestHttp(const web::http::method &mtd, const std::string &path, std::map<std::string, std::string> query, std::map<std::string, std::string> header, web::json::value *body);
+	web::http::http_response requestHttp(const web::http::method &mtd, const std::string &path, std::map<std::string, std::string> query, std::map<std::string, std::string> header, web::json::value *body, int timeoutSeconds = 0);
+	/// Long-lived client for Consul endpoint, keep-alive connections are reused by all requests of the same connection name
+	std::shared_ptr<web::http::client::http_client> getHttpClient(const std::string &connectionName, int timeoutSeconds);
 
-	std::tuple<bool, long long> blockWatchKv(const std::string &kvPath, long long lastIndex, bool recurse = false);
-	void watchSecurityThread();
-	void watchTopologyThread();
-	void watchScheduleThread();
+	// result: KV array of the blocking query response
+	std::tuple<bool, long long> blockWatchKv(const std::string &connectionName, const std::string &kvPath, long long lastIndex, bool recurse = false, web::json::value *result = nullptr);
+	// one recursive watch for all appmesh keys
+	void watchKvThread();
+	bool kvWatchEnabled() const;
+	// compare ModifyIndex of each key, decode changed keys and dispatch to handlers
+	void handleKvChanges(const web::json::value &kvs);
+	void applySecurity(const std::string &securityText);
+	void applyTopology(const std::shared_ptr<ConsulTopology> &hostTopology, const std::map<std::string, std::shared_ptr<ConsulTask>> &task);
 
 	void refreshSession(int timerId = 0);
 	std::string requestSessionId();
@@ -43,29 +57,53 @@ private:
 	void consulSessionId(const std::string &sessionId);
 	void releaseSessionId(const std::string &sessionId);
 
-	void doSchedule();
+	void doSchedule(const std::map<std::string, std::shared_ptr<ConsulTask>> &taskList, const std::map<std::string, std::shared_ptr<ConsulNode>> &nodes, const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldTopology);
 	bool electionLeader();
 	void offlineNode();
 
 	bool registerService(const std::string &appName, int port);
 	bool deregisterService(const std::string &appName);
 
-	void findTaskAvailableHost(const std::map<std::string, std::shared_ptr<ConsulTask>> &task, const std::map<std::string, std::shared_ptr<ConsulNode>> &hosts);
+	// apply schedule result, all changed hosts are written by Consul transactions
 	void compareTopologyAndDispatch(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldT, const std::map<std::string, std::shared_ptr<ConsulTopology>> &newT);
-	web::json::value getAppJsonWithIndexEnv(std::shared_ptr<Application> app, int index);
-	bool writeTopology(std::string hostName, const std::shared_ptr<ConsulTopology> topology);
 	// key: host name, value: topology
 	std::map<std::string, std::shared_ptr<ConsulTopology>> retrieveTopology(std::string host);
+
+	web::json::value getAppJsonWithIndexEnv(std::shared_ptr<Application> app, int index);
+	// key: host name, value: topology, nullptr value means delete host topology
+	bool writeTopology(const std::map<std::string, std::shared_ptr<ConsulTopology>> &topology);
+	// send KV operations by /v1/txn, split to CONSUL_TXN_MAX_OPERATIONS for each transaction
+	bool requestTxn(const std::vector<web::json::value> &operations);
 	std::map<std::string, std::shared_ptr<ConsulTask>> retrieveTask();
 	std::map<std::string, std::shared_ptr<ConsulNode>> retrieveNode();
 	web::json::value retrieveNode(const std::string &host);
+	// decode one KV item, return nullptr for empty or invalid value
+	static std::shared_ptr<ConsulTask> parseTask(const web::json::value &section);
+	static std::shared_ptr<ConsulNode> parseNode(const web::json::value &section, const std::string &host);
+	static std::shared_ptr<ConsulTopology> parseTopology(const web::json::value &section, const std::string &host);
 
 private:
 	std::string m_sessionId;
 	int m_ssnRenewTimerId;
 	bool m_leader;
 
-	std::shared_ptr<std::thread> m_securityWatch;
-	std::shared_ptr<std::thread> m_topologyWatch;
-	std::shared_ptr<std::thread> m_scheduleWatch;
+	std::shared_ptr<std::thread> m_kvWatch;
+	std::atomic<bool> m_kvWatching;
+	// set when configuration changed, next watch round process all keys
+	std::atomic<bool> m_kvWatchReset;
+	// below are only accessed by KV watch thread
+	// key: Consul key, value: ModifyIndex
+	std::map<std::string, long long> m_kvIndex;
+	// key: Consul key, value: task
+	std::map<std::string, std::shared_ptr<ConsulTask>> m_kvTasks;
+	// key: host name
+	std::map<std::string, std::shared_ptr<ConsulNode>> m_kvNodes;
+	std::map<std::string, std::shared_ptr<ConsulTopology>> m_kvTopology;
+	// keep node load and placement between schedule passes
+	std::shared_ptr<Scheduler> m_scheduler;
+
+	// connection name -> client, rebuilt when Consul url changed
+	std::map<std::string, std::shared_ptr<web::http::client::http_client>> m_httpClients;
+	std::string m_httpClientUrl;
+	std::mutex m_httpClientMutex;
 };
@@ -53,10 +53,6 @@ std::shared_ptr<ConsulTask> ConsulTask::FromJson(const web::json::value &jsonObj
 		{
 			consul->m_condition = Label::FromJson(jsonObj.at("condition"));
 		}
-		for (std::size_t i = 1; i <= consul->m_replication; i++)
-		{
-			consul->m_taskIndexDic.insert(i);
-		}
 	}
 	return consul;
 }
@@ -127,15 +123,8 @@ bool ConsulTopology::operator==(const std::shared_ptr<ConsulTopology> &topology)
 {
 	if (!topology)
 		return false;
-	if (m_scheduleApps.size() != topology->m_scheduleApps.size())
-		return false;
-
-	for (const auto &app : m_scheduleApps)
-	{
-		if (topology->m_scheduleApps.count(app.first) == 0)
-			return false;
-	}
-	return true;
+	// app index change is a topology change
+	return m_scheduleApps == topology->m_scheduleApps;
 }
 
 void ConsulTopology::dump()
@@ -197,12 +186,3 @@ web::json::value ConsulNode::AsJson() const
 	return result;
 }
 
-void ConsulNode::assignApp(const std::shared_ptr<Application> &app)
-{
-	m_assignedApps[app->getName()] = app;
-}
-
-uint64_t ConsulNode::getAssignedAppMem() const
-{
-	return uint64_t(0);
-}
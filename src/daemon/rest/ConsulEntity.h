@@ -2,7 +2,6 @@
 
 #include <memory>
 #include <map>
-#include <set>
 #include <string>
 #include <cpprest/json.h>
 
@@ -22,13 +21,6 @@ struct ConsulNode
 	static std::shared_ptr<ConsulNode> FromJson(const web::json::value &jsonObj, const std::string &hostName);
 	web::json::value AsJson() const;
 
-	/// @brief For schedule sort
-	/// @param app
-	void assignApp(const std::shared_ptr<Application> &app);
-	/// @brief For schedule sort
-	/// @return
-	uint64_t getAssignedAppMem() const;
-
 	std::shared_ptr<Label> m_label;
 	// CPU
 	std::size_t m_cores;
@@ -37,7 +29,6 @@ struct ConsulNode
 	uint64_t m_free_bytes;
 	std::string m_appmeshProxyUrl;
 	std::string m_hostName;
-	std::map<std::string, std::shared_ptr<Application>> m_assignedApps;
 };
 
 struct ConsulTask
@@ -57,11 +48,6 @@ struct ConsulTask
 
 	// consul service port
 	int m_consulServicePort;
-
-	// used for schedule fill
-	std::map<std::string, std::shared_ptr<ConsulNode>> m_matchedHosts;
-	/// @brief Used for schedule fill, store all index, index start from 1
-	std::set<int> m_taskIndexDic;
 };
 
 struct ConsulTopology
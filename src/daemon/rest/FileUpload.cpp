@@ -0,0 +1,571 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cpprest/json.h>
+
+#include "FileUpload.h"
+#include "../../common/Compression.h"
+#include "../../common/Utility.h"
+#include "../../common/os/linux.hpp"
+#include "../../common/os/chown.hpp"
+
+namespace
+{
+	// hidden file next to target, rename is atomic in the same file system
+	std::string uploadTempPath(const std::string &filePath, const std::string &id)
+	{
+		const auto pos = filePath.rfind('/');
+		const auto dir = (pos == std::string::npos) ? std::string() : filePath.substr(0, pos + 1);
+		const auto name = (pos == std::string::npos) ? filePath : filePath.substr(pos + 1);
+		return dir + "." + name + ".upload-" + id;
+	}
+} // namespace
+
+FileUpload::FileUpload(const std::string &id, const std::string &user, const std::string &filePath, uint64_t fileSize)
+	: m_id(id), m_user(user), m_filePath(filePath), m_fileSize(fileSize), m_tempPath(uploadTempPath(filePath, id)),
+	  m_fileMode(0), m_fd(-1), m_writing(0), m_lastActive(std::chrono::steady_clock::now())
+{
+}
+
+FileUpload::~FileUpload()
+{
+	const static char fname[] = "FileUpload::~FileUpload() ";
+
+	// file is closed after commit, otherwise remove incomplete temporary file
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		::unlink(m_tempPath.c_str());
+		LOG_INF << fname << "removed incomplete upload file <" << m_tempPath << ">";
+	}
+}
+
+void FileUpload::open(int fileMode, const std::string &fileUser)
+{
+	const static char fname[] = "FileUpload::open() ";
+
+	if (Utility::isFileExist(m_filePath))
+	{
+		throw std::invalid_argument("file already exist");
+	}
+	m_fd = ::open(m_tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (m_fd < 0)
+	{
+		throw std::invalid_argument(Utility::stringFormat("failed to create file <%s> with error: %s", m_tempPath.c_str(), std::strerror(errno)));
+	}
+	// reserve disk space to fail early, not all file systems support fallocate
+	if (m_fileSize > 0 && ::fallocate(m_fd, 0, 0, m_fileSize) != 0 && errno != EOPNOTSUPP)
+	{
+		throw std::invalid_argument(Utility::stringFormat("failed to allocate <%llu> bytes with error: %s", (unsigned long long)m_fileSize, std::strerror(errno)));
+	}
+	if (::ftruncate(m_fd, m_fileSize) != 0)
+	{
+		throw std::invalid_argument(Utility::stringFormat("failed to resize file with error: %s", std::strerror(errno)));
+	}
+	m_fileMode = fileMode;
+	m_fileUser = fileUser;
+	LOG_DBG << fname << "upload <" << m_id << "> file <" << m_filePath << "> size <" << m_fileSize << ">";
+}
+
+void FileUpload::reopen(int fileMode, const std::string &fileUser, const std::vector<std::pair<uint64_t, uint64_t>> &ranges)
+{
+	const static char fname[] = "FileUpload::reopen() ";
+
+	if (Utility::isFileExist(m_filePath))
+	{
+		throw std::invalid_argument("file already exist");
+	}
+	m_fd = ::open(m_tempPath.c_str(), O_WRONLY | O_CLOEXEC);
+	if (m_fd < 0)
+	{
+		throw std::invalid_argument(Utility::stringFormat("failed to open file <%s> with error: %s", m_tempPath.c_str(), std::strerror(errno)));
+	}
+	struct stat st;
+	if (::fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode) || static_cast<uint64_t>(st.st_size) != m_fileSize)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		throw std::invalid_argument(Utility::stringFormat("file <%s> is changed", m_tempPath.c_str()));
+	}
+	m_fileMode = fileMode;
+	m_fileUser = fileUser;
+	std::lock_guard<std::mutex> guard(m_mutex);
+	for (const auto &range : ranges)
+	{
+		if (range.first < range.second && range.second <= m_fileSize)
+			addRange(range.first, range.second);
+	}
+	LOG_INF << fname << "upload <" << m_id << "> file <" << m_filePath << "> resumed with <" << m_ranges.size() << "> ranges";
+}
+
+void FileUpload::write(uint64_t offset, const char *data, std::size_t size, uint32_t crc32)
+{
+	if (size == 0 || offset > m_fileSize || size > m_fileSize - offset)
+	{
+		throw std::invalid_argument(Utility::stringFormat("chunk offset <%llu> size <%llu> out of file size <%llu>",
+														  (unsigned long long)offset, (unsigned long long)size, (unsigned long long)m_fileSize));
+	}
+	if (Compression::crc32(data, size) != crc32)
+	{
+		throw std::invalid_argument("chunk checksum mismatch");
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_fd < 0)
+		{
+			throw std::invalid_argument("upload already committed");
+		}
+		m_writing++;
+		m_lastActive = std::chrono::steady_clock::now();
+	}
+
+	const int error = writeAt(offset, data, size);
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_writing--;
+	if (error)
+	{
+		throw std::runtime_error(Utility::stringFormat("failed to write file with error: %s", std::strerror(error)));
+	}
+	addRange(offset, offset + size);
+}
+
+uint64_t FileUpload::write(uint64_t offset, const Reader &reader, uint64_t maxSize, const uint32_t *crc32)
+{
+	if (offset > m_fileSize)
+	{
+		throw std::invalid_argument(Utility::stringFormat("chunk offset <%llu> out of file size <%llu>", (unsigned long long)offset, (unsigned long long)m_fileSize));
+	}
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_fd < 0)
+		{
+			throw std::invalid_argument("upload already committed");
+		}
+		m_writing++;
+		m_lastActive = std::chrono::steady_clock::now();
+	}
+	std::shared_ptr<int> writingGuard(&m_writing, [this](int *writing) {
+		std::lock_guard<std::mutex> guard(m_mutex);
+		(*writing)--;
+	});
+
+	// chunk is not hold in memory, only one piece is buffered
+	std::vector<char> buffer(std::min<uint64_t>(std::max<uint64_t>(maxSize, 1), FILE_UPLOAD_PIECE_BYTES));
+	uint64_t size = 0;
+	uint32_t crc = 0;
+	try
+	{
+		while (const auto length = reader(buffer.data(), buffer.size()))
+		{
+			if (length > maxSize - size)
+			{
+				throw std::length_error(Utility::stringFormat("chunk size exceed <%llu> bytes", (unsigned long long)maxSize));
+			}
+			if (length > m_fileSize - offset - size)
+			{
+				throw std::invalid_argument(Utility::stringFormat("chunk offset <%llu> size <%llu> out of file size <%llu>",
+																  (unsigned long long)offset, (unsigned long long)(size + length), (unsigned long long)m_fileSize));
+			}
+			crc = Compression::crc32(buffer.data(), length, crc);
+			size += length;
+			const int error = writeAt(offset + size - length, buffer.data(), length);
+			if (error)
+			{
+				throw std::runtime_error(Utility::stringFormat("failed to write file with error: %s", std::strerror(error)));
+			}
+		}
+		if (crc32 && crc != *crc32)
+		{
+			throw std::invalid_argument("chunk checksum mismatch");
+		}
+	}
+	catch (...)
+	{
+		// written pieces may overwrite received bytes, they need to be received again
+		std::lock_guard<std::mutex> guard(m_mutex);
+		removeRange(offset, offset + size);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (size)
+	{
+		addRange(offset, offset + size);
+	}
+	return size;
+}
+
+int FileUpload::writeAt(uint64_t offset, const char *data, std::size_t size)
+{
+	// chunks are written in parallel, pwrite does not share file offset
+	std::size_t written = 0;
+	while (written < size)
+	{
+		const auto result = ::pwrite(m_fd, data + written, size - written, offset + written);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result <= 0)
+		{
+			return result < 0 ? errno : EIO;
+		}
+		written += result;
+	}
+	return 0;
+}
+
+void FileUpload::addRange(uint64_t begin, uint64_t end)
+{
+	// merge with overlapped or adjacent ranges, re-sent chunk is merged to itself
+	auto iter = m_ranges.upper_bound(begin);
+	if (iter != m_ranges.begin())
+	{
+		auto previous = std::prev(iter);
+		if (previous->second >= begin)
+		{
+			begin = previous->first;
+			end = std::max(end, previous->second);
+			m_ranges.erase(previous);
+		}
+	}
+	while (iter != m_ranges.end() && iter->first <= end)
+	{
+		end = std::max(end, iter->second);
+		iter = m_ranges.erase(iter);
+	}
+	m_ranges[begin] = end;
+}
+
+void FileUpload::removeRange(uint64_t begin, uint64_t end)
+{
+	auto iter = m_ranges.upper_bound(begin);
+	if (iter != m_ranges.begin())
+		iter = std::prev(iter);
+	while (iter != m_ranges.end() && iter->first < end)
+	{
+		const auto rangeBegin = iter->first;
+		const auto rangeEnd = iter->second;
+		if (rangeEnd <= begin)
+		{
+			++iter;
+			continue;
+		}
+		// keep parts out of [begin, end)
+		iter = m_ranges.erase(iter);
+		if (rangeBegin < begin)
+			m_ranges[rangeBegin] = begin;
+		if (rangeEnd > end)
+			m_ranges[end] = rangeEnd;
+	}
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> FileUpload::receivedRanges() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	return std::vector<std::pair<uint64_t, uint64_t>>(m_ranges.begin(), m_ranges.end());
+}
+
+uint64_t FileUpload::receivedBytes() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	uint64_t received = 0;
+	for (const auto &range : m_ranges)
+		received += range.second - range.first;
+	return received;
+}
+
+void FileUpload::commit()
+{
+	const static char fname[] = "FileUpload::commit() ";
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (m_fd < 0)
+	{
+		throw std::invalid_argument("upload already committed");
+	}
+	if (m_writing)
+	{
+		throw std::invalid_argument("chunk write in progress");
+	}
+	uint64_t received = 0;
+	for (const auto &range : m_ranges)
+		received += range.second - range.first;
+	if (received != m_fileSize)
+	{
+		throw std::invalid_argument(Utility::stringFormat("upload incomplete, received <%llu> of <%llu> bytes", (unsigned long long)received, (unsigned long long)m_fileSize));
+	}
+	if (::fsync(m_fd) != 0)
+	{
+		throw std::runtime_error(Utility::stringFormat("failed to sync file with error: %s", std::strerror(errno)));
+	}
+	if (m_fileMode > 0)
+	{
+		os::fileChmod(m_tempPath, m_fileMode);
+	}
+	if (m_fileUser.length())
+	{
+		os::chown(m_tempPath, m_fileUser);
+	}
+	// link fail when target exist, rename would replace it
+	if (::link(m_tempPath.c_str(), m_filePath.c_str()) == 0)
+	{
+		::unlink(m_tempPath.c_str());
+	}
+	else if (errno == EEXIST)
+	{
+		throw std::invalid_argument("file already exist");
+	}
+	else if (Utility::isFileExist(m_filePath))
+	{
+		throw std::invalid_argument("file already exist");
+	}
+	else if (::rename(m_tempPath.c_str(), m_filePath.c_str()) != 0)
+	{
+		throw std::runtime_error(Utility::stringFormat("failed to rename file with error: %s", std::strerror(errno)));
+	}
+	::close(m_fd);
+	m_fd = -1;
+	LOG_INF << fname << "upload <" << m_id << "> saved file <" << m_filePath << "> size <" << m_fileSize << ">";
+}
+
+const std::string &FileUpload::id() const
+{
+	return m_id;
+}
+
+const std::string &FileUpload::user() const
+{
+	return m_user;
+}
+
+const std::string &FileUpload::filePath() const
+{
+	return m_filePath;
+}
+
+uint64_t FileUpload::fileSize() const
+{
+	return m_fileSize;
+}
+
+const std::string &FileUpload::tempPath() const
+{
+	return m_tempPath;
+}
+
+int FileUpload::fileMode() const
+{
+	return m_fileMode;
+}
+
+const std::string &FileUpload::fileUser() const
+{
+	return m_fileUser;
+}
+
+bool FileUpload::expired(const std::chrono::seconds &idleTimeout) const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	return m_writing == 0 && std::chrono::steady_clock::now() - m_lastActive > idleTimeout;
+}
+
+FileUploadManager::FileUploadManager(std::size_t maxUploads, int idleTimeoutSeconds, const std::string &stateFile)
+	: m_maxUploads(maxUploads), m_idleTimeout(idleTimeoutSeconds), m_stateFile(stateFile), m_expireTimerId(0)
+{
+}
+
+std::shared_ptr<FileUploadManager> &FileUploadManager::instance()
+{
+	static auto singleton = std::make_shared<FileUploadManager>(FILE_UPLOAD_MAX_SESSIONS, FILE_UPLOAD_IDLE_TIMEOUT_SECONDS, FILE_UPLOAD_STATE_FILE_NAME);
+	return singleton;
+}
+
+void FileUploadManager::open()
+{
+	recover();
+	// idle uploads are removed even when no more upload request
+	this->cancelTimer(m_expireTimerId);
+	m_expireTimerId = this->registerTimer(1000L * FILE_UPLOAD_EXPIRE_CHECK_SECONDS, FILE_UPLOAD_EXPIRE_CHECK_SECONDS,
+										  std::bind(&FileUploadManager::onExpireTimer, this, std::placeholders::_1), __FUNCTION__);
+}
+
+void FileUploadManager::recover()
+{
+	const static char fname[] = "FileUploadManager::recover() ";
+
+	if (m_stateFile.empty() || !Utility::isFileExist(m_stateFile))
+		return;
+	web::json::value state;
+	try
+	{
+		state = web::json::value::parse(Utility::readFileCpp(m_stateFile));
+	}
+	catch (const std::exception &e)
+	{
+		LOG_WAR << fname << "failed to parse <" << m_stateFile << ">: " << e.what();
+		return;
+	}
+	if (!state.is_object())
+		return;
+
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	for (const auto &item : state.as_object())
+	{
+		const auto id = GET_STD_STRING(item.first);
+		const auto &json = item.second;
+		const auto filePath = GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_file_path);
+		if (filePath.empty() || m_uploads.count(id))
+			continue;
+		auto upload = std::make_shared<FileUpload>(id, GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_user), filePath, GET_JSON_NUMBER_VALUE(json, JSON_KEY_UPLOAD_file_size));
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+		if (HAS_JSON_FIELD(json, JSON_KEY_UPLOAD_ranges))
+		{
+			for (const auto &range : json.at(JSON_KEY_UPLOAD_ranges).as_array())
+			{
+				ranges.emplace_back(range.at(0).as_number().to_uint64(), range.at(1).as_number().to_uint64());
+			}
+		}
+		try
+		{
+			upload->reopen(GET_JSON_INT_VALUE(json, JSON_KEY_UPLOAD_file_mode), GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_file_user), ranges);
+			m_uploads[id] = upload;
+		}
+		catch (const std::exception &e)
+		{
+			LOG_WAR << fname << "remove upload <" << id << "> of file <" << filePath << ">: " << e.what();
+			::unlink(upload->tempPath().c_str());
+		}
+	}
+	persist();
+}
+
+std::shared_ptr<FileUpload> FileUploadManager::create(const std::string &user, const std::string &filePath, uint64_t fileSize, int fileMode, const std::string &fileUser)
+{
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	removeExpired();
+	if (m_uploads.size() >= m_maxUploads)
+	{
+		throw std::invalid_argument(Utility::stringFormat("too many uploads in progress, max <%d>", (int)m_maxUploads));
+	}
+	for (const auto &upload : m_uploads)
+	{
+		if (upload.second->filePath() == filePath)
+		{
+			throw std::invalid_argument(Utility::stringFormat("file is being uploaded by <%s>", upload.first.c_str()));
+		}
+	}
+	auto upload = std::make_shared<FileUpload>(Utility::createUUID(), user, filePath, fileSize);
+	upload->open(fileMode, fileUser);
+	m_uploads[upload->id()] = upload;
+	persist();
+	return upload;
+}
+
+std::shared_ptr<FileUpload> FileUploadManager::get(const std::string &id, const std::string &user)
+{
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	if (removeExpired())
+		persist();
+	auto iter = m_uploads.find(id);
+	if (iter == m_uploads.end() || iter->second->user() != user)
+	{
+		return nullptr;
+	}
+	return iter->second;
+}
+
+bool FileUploadManager::remove(const std::string &id, const std::string &user)
+{
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	auto iter = m_uploads.find(id);
+	if (iter == m_uploads.end() || iter->second->user() != user)
+	{
+		return false;
+	}
+	// temporary file is removed when last reference released
+	m_uploads.erase(iter);
+	persist();
+	return true;
+}
+
+void FileUploadManager::expire()
+{
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	if (removeExpired())
+		persist();
+}
+
+void FileUploadManager::save()
+{
+	std::lock_guard<std::mutex> guard(m_uploadsMutex);
+	persist();
+}
+
+bool FileUploadManager::removeExpired()
+{
+	const static char fname[] = "FileUploadManager::removeExpired() ";
+
+	bool removed = false;
+	for (auto iter = m_uploads.begin(); iter != m_uploads.end();)
+	{
+		if (iter->second->expired(m_idleTimeout))
+		{
+			LOG_WAR << fname << "upload <" << iter->first << "> of file <" << iter->second->filePath() << "> expired";
+			iter = m_uploads.erase(iter);
+			removed = true;
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	return removed;
+}
+
+void FileUploadManager::persist()
+{
+	const static char fname[] = "FileUploadManager::persist() ";
+
+	if (m_stateFile.empty())
+		return;
+	auto state = web::json::value::object();
+	for (const auto &upload : m_uploads)
+	{
+		auto json = web::json::value::object();
+		json[JSON_KEY_UPLOAD_user] = web::json::value::string(upload.second->user());
+		json[JSON_KEY_UPLOAD_file_path] = web::json::value::string(upload.second->filePath());
+		json[JSON_KEY_UPLOAD_file_size] = web::json::value::number(upload.second->fileSize());
+		json[JSON_KEY_UPLOAD_file_mode] = web::json::value::number(upload.second->fileMode());
+		json[JSON_KEY_UPLOAD_file_user] = web::json::value::string(upload.second->fileUser());
+		const auto ranges = upload.second->receivedRanges();
+		auto rangesJson = web::json::value::array(ranges.size());
+		for (std::size_t i = 0; i < ranges.size(); i++)
+		{
+			auto range = web::json::value::array(2);
+			range[0] = web::json::value::number(ranges[i].first);
+			range[1] = web::json::value::number(ranges[i].second);
+			rangesJson[i] = range;
+		}
+		json[JSON_KEY_UPLOAD_ranges] = rangesJson;
+		state[upload.first] = json;
+	}
+	// replace by rename, state file is not half written when process exit
+	const auto tempFile = m_stateFile + ".tmp";
+	std::ofstream ofs(tempFile, std::ios::trunc);
+	ofs << state.serialize();
+	ofs.close();
+	if (!ofs || ::rename(tempFile.c_str(), m_stateFile.c_str()) != 0)
+	{
+		LOG_WAR << fname << "failed to write <" << m_stateFile << ">: " << std::strerror(errno);
+	}
+}
+
+void FileUploadManager::onExpireTimer(int timerId)
+{
+	expire();
+}
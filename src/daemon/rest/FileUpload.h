@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../TimerHandler.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// Chunked file upload, chunks are written at their offset to a temporary
+/// file in target directory and renamed to target when all bytes received.
+/// Chunks can be received in any order and from parallel connections.
+//////////////////////////////////////////////////////////////////////////
+class FileUpload
+{
+public:
+	/// Read next piece of chunk to buffer, return 0 at end of chunk
+	typedef std::function<std::size_t(char *buffer, std::size_t size)> Reader;
+
+	FileUpload(const std::string &id, const std::string &user, const std::string &filePath, uint64_t fileSize);
+	virtual ~FileUpload();
+
+	/// Create temporary file, throw when target exist or temporary file can not be created
+	void open(int fileMode, const std::string &fileUser);
+	/// Open temporary file created by previous process with its received ranges,
+	/// throw when target exist or temporary file is missing or resized
+	void reopen(int fileMode, const std::string &fileUser, const std::vector<std::pair<uint64_t, uint64_t>> &ranges);
+	/// Write chunk at offset, throw when chunk is out of file size or checksum mismatch
+	void write(uint64_t offset, const char *data, std::size_t size, uint32_t crc32);
+	/// Write chunk read by pieces at offset and return its size, checksum is updated by each piece and
+	/// verified when crc32 is not null, throw std::length_error when chunk exceed maxSize
+	uint64_t write(uint64_t offset, const Reader &reader, uint64_t maxSize, const uint32_t *crc32);
+	/// Received byte ranges, pair of offset and end
+	std::vector<std::pair<uint64_t, uint64_t>> receivedRanges() const;
+	uint64_t receivedBytes() const;
+	/// Rename temporary file to target, throw when not all bytes received or target exist
+	void commit();
+
+	const std::string &id() const;
+	const std::string &user() const;
+	const std::string &filePath() const;
+	uint64_t fileSize() const;
+	const std::string &tempPath() const;
+	int fileMode() const;
+	const std::string &fileUser() const;
+	bool expired(const std::chrono::seconds &idleTimeout) const;
+
+private:
+	/// Write all bytes at offset, return errno or 0
+	int writeAt(uint64_t offset, const char *data, std::size_t size);
+	/// Merge [begin, end) to received ranges, lock is hold by caller
+	void addRange(uint64_t begin, uint64_t end);
+	/// Remove [begin, end) from received ranges, lock is hold by caller
+	void removeRange(uint64_t begin, uint64_t end);
+
+	const std::string m_id;
+	const std::string m_user;
+	const std::string m_filePath;
+	const uint64_t m_fileSize;
+	const std::string m_tempPath;
+	int m_fileMode;
+	std::string m_fileUser;
+	int m_fd;
+	// chunks being written without lock, commit is refused until they finish
+	int m_writing;
+	// received ranges indexed by offset with value of end, adjacent ranges are merged
+	std::map<uint64_t, uint64_t> m_ranges;
+	std::chrono::steady_clock::time_point m_lastActive;
+	mutable std::mutex m_mutex;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Chunked uploads in progress, idle upload is removed with its temporary file
+/// by timer. Uploads are saved to state file and resumed after restart.
+//////////////////////////////////////////////////////////////////////////
+class FileUploadManager : public TimerHandler
+{
+public:
+	/// State file is not used when empty
+	FileUploadManager(std::size_t maxUploads, int idleTimeoutSeconds, const std::string &stateFile);
+	static std::shared_ptr<FileUploadManager> &instance();
+
+	/// Recover uploads of previous process and start expire timer
+	void open();
+	/// Recover uploads saved in state file, temporary file of not recoverable upload is removed
+	void recover();
+	std::shared_ptr<FileUpload> create(const std::string &user, const std::string &filePath, uint64_t fileSize, int fileMode, const std::string &fileUser);
+	/// Return nullptr when not found or created by other user
+	std::shared_ptr<FileUpload> get(const std::string &id, const std::string &user);
+	bool remove(const std::string &id, const std::string &user);
+	/// Remove idle uploads with their temporary files
+	void expire();
+	/// Save uploads with received ranges to state file
+	void save();
+
+private:
+	/// Remove idle uploads, return true when any removed, lock is hold by caller
+	bool removeExpired();
+	/// Write state file, lock is hold by caller
+	void persist();
+	void onExpireTimer(int timerId);
+
+	const std::size_t m_maxUploads;
+	const std::chrono::seconds m_idleTimeout;
+	const std::string m_stateFile;
+	int m_expireTimerId;
+	std::map<std::string, std::shared_ptr<FileUpload>> m_uploads;
+	std::mutex m_uploadsMutex;
+};
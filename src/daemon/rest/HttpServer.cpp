@@ -0,0 +1,1197 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <grp.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
+#include "HttpServer.h"
+#include "../../common/Utility.h"
+
+namespace asio = boost::asio;
+typedef asio::generic::stream_protocol::socket GenericSocket;
+
+namespace
+{
+	const char *reasonPhrase(int status)
+	{
+		switch (status)
+		{
+		case 100:
+			return "Continue";
+		case 200:
+			return "OK";
+		case 201:
+			return "Created";
+		case 202:
+			return "Accepted";
+		case 204:
+			return "No Content";
+		case 206:
+			return "Partial Content";
+		case 304:
+			return "Not Modified";
+		case 400:
+			return "Bad Request";
+		case 401:
+			return "Unauthorized";
+		case 403:
+			return "Forbidden";
+		case 404:
+			return "Not Found";
+		case 405:
+			return "Method Not Allowed";
+		case 409:
+			return "Conflict";
+		case 412:
+			return "Precondition Failed";
+		case 413:
+			return "Payload Too Large";
+		case 416:
+			return "Range Not Satisfiable";
+		case 431:
+			return "Request Header Fields Too Large";
+		case 500:
+			return "Internal Server Error";
+		case 501:
+			return "Not Implemented";
+		case 503:
+			return "Service Unavailable";
+		default:
+			return "";
+		}
+	}
+
+	std::string remoteAddress(const GenericSocket &socket)
+	{
+		boost::system::error_code ec;
+		const auto endpoint = socket.remote_endpoint(ec);
+		if (ec)
+			return std::string();
+		const auto family = endpoint.data()->sa_family;
+		if (family == AF_INET || family == AF_INET6)
+		{
+			asio::ip::tcp::endpoint tcpEndpoint;
+			std::memcpy(tcpEndpoint.data(), endpoint.data(), endpoint.size());
+			return tcpEndpoint.address().to_string();
+		}
+		return std::string();
+	}
+
+	int peerUid(GenericSocket &socket)
+	{
+		boost::system::error_code ec;
+		struct ucred credential;
+		socklen_t length = sizeof(credential);
+		if (socket.local_endpoint(ec).protocol().family() == AF_UNIX && !ec &&
+			::getsockopt(socket.native_handle(), SOL_SOCKET, SO_PEERCRED, &credential, &length) == 0)
+		{
+			return credential.uid;
+		}
+		return -1;
+	}
+} // namespace
+
+const std::string *HttpServerRequest::header(const std::string &name) const
+{
+	for (const auto &header : m_headers)
+	{
+		if (boost::iequals(header.first, name))
+			return &header.second;
+	}
+	return nullptr;
+}
+
+HttpServerFile::HttpServerFile(int fd, uint64_t offset, uint64_t length)
+	: m_fd(fd), m_offset(offset), m_length(length)
+{
+}
+
+HttpServerFile::~HttpServerFile()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+}
+
+HttpFileRange HttpFileRange::parse(const std::string *range, const std::string *ifRange, const std::string &etag, uint64_t fileSize)
+{
+	HttpFileRange result;
+	result.m_fileSize = fileSize;
+	result.m_length = fileSize;
+	// Last-Modified is not sent, If-Range with date never match
+	if (range == nullptr || (ifRange && boost::trim_copy(*ifRange) != etag))
+		return result;
+	const auto value = boost::trim_copy(*range);
+	if (value.compare(0, 6, "bytes=") != 0 || value.find(',') != std::string::npos)
+		return result;
+	const auto dash = value.find('-', 6);
+	if (dash == std::string::npos)
+		return result;
+	const auto first = boost::trim_copy(value.substr(6, dash - 6));
+	const auto last = boost::trim_copy(value.substr(dash + 1));
+	const auto isNumber = [](const std::string &str) {
+		return !str.empty() && str.length() < 20 && std::all_of(str.begin(), str.end(), ::isdigit);
+	};
+	uint64_t start = 0;
+	uint64_t end = 0;
+	if (first.empty())
+	{
+		// suffix range: last N bytes
+		if (!isNumber(last))
+			return result;
+		const auto suffix = std::stoull(last);
+		if (suffix == 0 || fileSize == 0)
+		{
+			result.m_status = 416;
+			result.m_length = 0;
+			return result;
+		}
+		start = fileSize - std::min<uint64_t>(suffix, fileSize);
+		end = fileSize - 1;
+	}
+	else
+	{
+		if (!isNumber(first) || (!last.empty() && !isNumber(last)))
+			return result;
+		start = std::stoull(first);
+		end = last.empty() ? fileSize - 1 : std::stoull(last);
+		if (!last.empty() && end < start)
+			return result;
+		if (start >= fileSize)
+		{
+			result.m_status = 416;
+			result.m_length = 0;
+			return result;
+		}
+		end = std::min<uint64_t>(end, fileSize - 1);
+	}
+	result.m_status = 206;
+	result.m_offset = start;
+	result.m_length = end - start + 1;
+	return result;
+}
+
+std::string HttpFileRange::contentRange() const
+{
+	if (m_status == 206)
+		return "bytes " + std::to_string(m_offset) + "-" + std::to_string(m_offset + m_length - 1) + "/" + std::to_string(m_fileSize);
+	return "bytes */" + std::to_string(m_fileSize);
+}
+
+std::string HttpFileRange::etag(const struct stat &st)
+{
+	const auto mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+	return Utility::stringFormat("\"%llx-%llx-%llx\"", (unsigned long long)st.st_ino, (unsigned long long)mtime, (unsigned long long)st.st_size);
+}
+
+HttpServerBody::HttpServerBody(std::size_t bufferBytes, int timeoutSeconds)
+	: m_readPos(0), m_bufferBytes(bufferBytes), m_timeout(timeoutSeconds), m_finished(false), m_failed(false), m_paused(false)
+{
+}
+
+std::size_t HttpServerBody::read(char *buffer, std::size_t size)
+{
+	std::function<void()> resume;
+	std::size_t bytes = 0;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_cv.wait_for(lock, m_timeout, [this]() { return m_readPos < m_buffer.size() || m_finished; }))
+			throw std::runtime_error("request body not received in time");
+		if (m_failed)
+			throw std::runtime_error("request body not complete");
+		bytes = std::min(size, m_buffer.size() - m_readPos);
+		if (bytes == 0)
+			return 0;
+		std::memcpy(buffer, m_buffer.data() + m_readPos, bytes);
+		m_readPos += bytes;
+		if (m_readPos == m_buffer.size())
+		{
+			m_buffer.clear();
+			m_readPos = 0;
+		}
+		// continue reading after half of buffer is drained, avoid resume for each read
+		if (m_paused && m_buffer.size() - m_readPos <= m_bufferBytes / 2)
+		{
+			m_paused = false;
+			resume = m_resume;
+		}
+	}
+	if (resume)
+		resume();
+	return bytes;
+}
+
+bool HttpServerBody::write(const char *data, std::size_t size)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (m_readPos > 0 && m_readPos >= m_buffer.size() / 2)
+	{
+		m_buffer.erase(0, m_readPos);
+		m_readPos = 0;
+	}
+	m_buffer.append(data, size);
+	m_cv.notify_all();
+	if (m_buffer.size() - m_readPos >= m_bufferBytes)
+		m_paused = true;
+	return !m_paused;
+}
+
+void HttpServerBody::finish(bool complete)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (m_finished)
+		return;
+	m_finished = true;
+	m_failed = !complete;
+	m_cv.notify_all();
+}
+
+bool HttpServerBody::paused()
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	return m_paused && !m_finished;
+}
+
+HttpExchange::HttpExchange()
+	: m_replied(false)
+{
+}
+
+HttpExchange::~HttpExchange()
+{
+	if (!m_replied)
+	{
+		HttpServerResponse response;
+		response.m_status = 500;
+		response.m_body = "no response";
+		reply(std::move(response));
+	}
+}
+
+void HttpExchange::reply(HttpServerResponse &&response)
+{
+	if (m_replied.exchange(true))
+		return;
+	if (m_replyHandler)
+		m_replyHandler(std::move(response));
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Connection is only accessed from its own io_context thread
+//////////////////////////////////////////////////////////////////////////
+class HttpConnection : public std::enable_shared_from_this<HttpConnection>
+{
+public:
+	HttpConnection(HttpServer &server, asio::io_context &io, GenericSocket &&socket);
+	void start();
+
+private:
+	struct PendingReply
+	{
+		std::string m_data;
+		std::shared_ptr<HttpServerFile> m_file;
+		bool m_ready = false;
+		bool m_close = false;
+	};
+
+	void read();
+	void onRead(const boost::system::error_code &ec, std::size_t bytes);
+	/// Parse complete requests in m_readBuffer, return false when connection should stop reading
+	bool parse();
+	/// Return parsed header length, 0 when header is not complete, -1 when bad request
+	long parseHeader(HttpServerRequest &request, bool &chunked, std::size_t &contentLength);
+	/// Decode chunks received after previous call, return consumed bytes and move decoded
+	/// body when complete, 0 when body is not complete, -1 when bad chunk
+	long parseChunkedBody(std::size_t offset, std::string &body);
+	/// Pass received body of streamed request to handler, return 1 when body is complete,
+	/// 0 when body is not complete, -1 when bad chunk
+	long streamBody();
+	/// Release streamed body, handler read() fail when not complete
+	void endStream(bool complete);
+	void sendContinue(const HttpServerRequest &request);
+	std::shared_ptr<PendingReply> enqueue(const std::shared_ptr<HttpExchange> &exchange, bool keepAlive);
+	void rejectAndClose(int status);
+	void onReply(const std::shared_ptr<PendingReply> &pending, HttpServerResponse &&response, bool keepAlive, bool head);
+	void write();
+	/// Send file region of front reply: sendfile() for plain socket, read and write for TLS
+	void writeFile(const std::shared_ptr<PendingReply> &pending);
+	void onWritten(const std::shared_ptr<PendingReply> &pending, const boost::system::error_code &ec);
+	void armIdleTimer();
+	void shutdown();
+
+	template <typename Buffers, typename Handler>
+	void asyncWrite(const Buffers &buffers, Handler handler);
+	template <typename Buffers, typename Handler>
+	void asyncReadSome(const Buffers &buffers, Handler handler);
+
+	HttpServer &m_server;
+	asio::io_context &m_io;
+	GenericSocket m_socket;
+	std::unique_ptr<asio::ssl::stream<GenericSocket &>> m_ssl;
+	asio::steady_timer m_idleTimer;
+	std::string m_readBuffer;
+	std::size_t m_readOffset;
+	// request header parsed, waiting for body
+	bool m_continueSent;
+	// chunked body of the request at m_readOffset, decoded incrementally between reads
+	std::string m_chunkedBody;
+	// decode position relative to body offset
+	std::size_t m_chunkedPos;
+	// data bytes of current chunk not received yet
+	std::size_t m_chunkRemaining;
+	// CRLF after data of current chunk not received yet
+	bool m_chunkCrlfPending;
+	// body of dispatched request streamed to handler, following requests are parsed after it
+	std::shared_ptr<HttpServerBody> m_streamBody;
+	std::shared_ptr<PendingReply> m_streamReply;
+	bool m_streamChunked;
+	uint64_t m_streamRemaining;
+	bool m_reading;
+	bool m_writing;
+	bool m_closing;
+	std::size_t m_served;
+	// peer credential is read once, peer of a connection does not change
+	const int m_peerUid;
+	std::deque<std::shared_ptr<PendingReply>> m_pending;
+};
+
+HttpConnection::HttpConnection(HttpServer &server, asio::io_context &io, GenericSocket &&socket)
+	: m_server(server), m_io(io), m_socket(std::move(socket)), m_idleTimer(io),
+	  m_readOffset(0), m_continueSent(false), m_chunkedPos(0), m_chunkRemaining(0), m_chunkCrlfPending(false),
+	  m_streamChunked(false), m_streamRemaining(0), m_reading(false), m_writing(false), m_closing(false), m_served(0),
+	  m_peerUid(peerUid(m_socket))
+{
+	if (m_server.m_options.m_sslContext && m_server.m_options.m_localSocketPath.empty())
+		m_ssl.reset(new asio::ssl::stream<GenericSocket &>(m_socket, *m_server.m_options.m_sslContext));
+	// sendfile() return EAGAIN instead of block io thread
+	boost::system::error_code ec;
+	m_socket.non_blocking(true, ec);
+}
+
+void HttpConnection::start()
+{
+	armIdleTimer();
+	if (m_ssl)
+	{
+		auto self = shared_from_this();
+		m_ssl->async_handshake(asio::ssl::stream_base::server, [self](const boost::system::error_code &ec) {
+			if (ec)
+				self->shutdown();
+			else
+				self->read();
+		});
+	}
+	else
+	{
+		read();
+	}
+}
+
+template <typename Buffers, typename Handler>
+void HttpConnection::asyncWrite(const Buffers &buffers, Handler handler)
+{
+	if (m_ssl)
+		asio::async_write(*m_ssl, buffers, handler);
+	else
+		asio::async_write(m_socket, buffers, handler);
+}
+
+template <typename Buffers, typename Handler>
+void HttpConnection::asyncReadSome(const Buffers &buffers, Handler handler)
+{
+	if (m_ssl)
+		m_ssl->async_read_some(buffers, handler);
+	else
+		m_socket.async_read_some(buffers, handler);
+}
+
+void HttpConnection::read()
+{
+	// body of streamed request is still read after "Connection: close"
+	if (m_reading || (m_closing && !m_streamBody))
+		return;
+	if (m_streamBody)
+	{
+		// pause reading until handler read buffered body
+		if (m_streamBody->paused())
+			return;
+	}
+	else if (m_pending.size() >= m_server.m_options.m_maxPipelinedRequests)
+	{
+		// pause reading when too many pipelined requests wait for reply
+		return;
+	}
+	m_reading = true;
+	const auto used = m_readBuffer.size();
+	m_readBuffer.resize(used + HTTP_SERVER_READ_BUFFER_BYTES);
+	auto self = shared_from_this();
+	asyncReadSome(asio::buffer(&m_readBuffer[used], HTTP_SERVER_READ_BUFFER_BYTES),
+				  [self, used](const boost::system::error_code &ec, std::size_t bytes) {
+					  self->m_readBuffer.resize(used + bytes);
+					  self->onRead(ec, bytes);
+				  });
+}
+
+void HttpConnection::onRead(const boost::system::error_code &ec, std::size_t bytes)
+{
+	m_reading = false;
+	if (ec || bytes == 0)
+	{
+		// peer closed, replies of received requests are still written
+		m_closing = true;
+		endStream(false);
+		if (m_pending.empty())
+			shutdown();
+		return;
+	}
+	// data of a request in progress keep connection alive, body may take longer than idle timeout
+	if (m_pending.empty())
+		armIdleTimer();
+	if (parse())
+		read();
+}
+
+bool HttpConnection::parse()
+{
+	const auto &options = m_server.m_options;
+	if (m_streamBody)
+	{
+		const auto streamed = streamBody();
+		if (streamed < 0)
+		{
+			// reply of handler is written before close
+			endStream(false);
+			m_closing = true;
+		}
+		if (streamed <= 0)
+		{
+			m_readBuffer.erase(0, m_readOffset);
+			m_readOffset = 0;
+			return m_streamBody != nullptr;
+		}
+	}
+	while (!m_closing && m_pending.size() < options.m_maxPipelinedRequests)
+	{
+		auto exchange = std::shared_ptr<HttpExchange>(new HttpExchange());
+		auto &request = exchange->m_request;
+		bool chunked = false;
+		std::size_t contentLength = 0;
+		const auto headerLength = parseHeader(request, chunked, contentLength);
+		if (headerLength < 0)
+		{
+			rejectAndClose(400);
+			return false;
+		}
+		if (headerLength == 0)
+		{
+			if (m_readBuffer.size() - m_readOffset > options.m_maxHeaderBytes)
+			{
+				rejectAndClose(431);
+				return false;
+			}
+			break;
+		}
+		// large body is passed to handler while receiving, instead of buffered in memory
+		const bool stream = (chunked || contentLength > 0) && options.m_streamBody && options.m_streamBody(request);
+		if (!stream && contentLength > options.m_maxBodyBytes)
+		{
+			rejectAndClose(413);
+			return false;
+		}
+
+		// body
+		const auto bodyOffset = m_readOffset + headerLength;
+		std::size_t consumed = 0;
+		if (stream)
+		{
+			consumed = headerLength;
+		}
+		else if (chunked)
+		{
+			const auto chunkedLength = parseChunkedBody(bodyOffset, request.m_body);
+			if (chunkedLength < 0 || request.m_body.size() + m_chunkedBody.size() > options.m_maxBodyBytes)
+			{
+				rejectAndClose(chunkedLength < 0 ? 400 : 413);
+				return false;
+			}
+			if (chunkedLength > 0)
+				consumed = headerLength + chunkedLength;
+		}
+		else if (m_readBuffer.size() - bodyOffset >= contentLength)
+		{
+			request.m_body.assign(m_readBuffer, bodyOffset, contentLength);
+			consumed = headerLength + contentLength;
+		}
+		if (consumed == 0)
+		{
+			sendContinue(request);
+			break;
+		}
+		m_readOffset += consumed;
+		m_continueSent = false;
+
+		// keep-alive: HTTP/1.1 default on, HTTP/1.0 default off
+		auto connection = request.header("Connection");
+		bool keepAlive = request.m_minorVersion == 1 ? !(connection && boost::iequals(*connection, "close")) : (connection && boost::iequals(*connection, "keep-alive"));
+		if (++m_served >= options.m_keepAliveMaxRequests)
+			keepAlive = false;
+		request.m_remoteAddress = remoteAddress(m_socket);
+		request.m_peerUid = m_peerUid;
+		if (stream)
+		{
+			if (m_readBuffer.size() == m_readOffset)
+				sendContinue(request);
+			m_continueSent = false;
+			auto body = std::make_shared<HttpServerBody>(HTTP_SERVER_BODY_BUFFER_BYTES, options.m_keepAliveSeconds);
+			std::weak_ptr<HttpConnection> weakSelf = shared_from_this();
+			body->m_resume = [weakSelf]() {
+				if (auto self = weakSelf.lock())
+				{
+					asio::post(self->m_io, [self]() {
+						if (!self->m_reading && self->parse())
+							self->read();
+					});
+				}
+			};
+			m_server.addBody(body);
+			request.m_bodyStream = body;
+			m_streamBody = body;
+			m_streamChunked = chunked;
+			m_streamRemaining = contentLength;
+		}
+		auto pending = enqueue(exchange, keepAlive);
+		if (!keepAlive)
+		{
+			// requests after "Connection: close" are ignored
+			m_closing = true;
+		}
+		if (stream)
+		{
+			m_streamReply = pending;
+			const auto streamed = streamBody();
+			if (streamed < 0)
+			{
+				endStream(false);
+				m_closing = true;
+			}
+			if (streamed <= 0)
+				break;
+		}
+	}
+	// compact consumed requests
+	if (m_readOffset > 0)
+	{
+		m_readBuffer.erase(0, m_readOffset);
+		m_readOffset = 0;
+	}
+	return !m_closing || m_streamBody != nullptr;
+}
+
+long HttpConnection::parseHeader(HttpServerRequest &request, bool &chunked, std::size_t &contentLength)
+{
+	const auto end = m_readBuffer.find("\r\n\r\n", m_readOffset);
+	if (end == std::string::npos)
+		return 0;
+	// request line: METHOD SP target SP HTTP/1.x
+	auto lineEnd = m_readBuffer.find("\r\n", m_readOffset);
+	const auto methodEnd = m_readBuffer.find(' ', m_readOffset);
+	const auto targetEnd = methodEnd == std::string::npos ? std::string::npos : m_readBuffer.find(' ', methodEnd + 1);
+	if (methodEnd == std::string::npos || targetEnd == std::string::npos || targetEnd > lineEnd ||
+		m_readBuffer.compare(targetEnd + 1, 7, "HTTP/1.") != 0 || lineEnd - targetEnd != 9)
+		return -1;
+	request.m_method.assign(m_readBuffer, m_readOffset, methodEnd - m_readOffset);
+	request.m_target.assign(m_readBuffer, methodEnd + 1, targetEnd - methodEnd - 1);
+	request.m_minorVersion = m_readBuffer[targetEnd + 8] == '0' ? 0 : 1;
+	if (request.m_method.empty() || request.m_target.empty())
+		return -1;
+
+	// header fields
+	bool hasLength = false;
+	while (lineEnd < end)
+	{
+		const auto lineStart = lineEnd + 2;
+		lineEnd = m_readBuffer.find("\r\n", lineStart);
+		const auto colon = m_readBuffer.find(':', lineStart);
+		if (colon == std::string::npos || colon > lineEnd || colon == lineStart)
+			return -1;
+		auto name = m_readBuffer.substr(lineStart, colon - lineStart);
+		auto value = m_readBuffer.substr(colon + 1, lineEnd - colon - 1);
+		boost::trim(value);
+		if (boost::iequals(name, "Content-Length"))
+		{
+			char *numberEnd = nullptr;
+			contentLength = std::strtoull(value.c_str(), &numberEnd, 10);
+			if (value.empty() || *numberEnd != '\0')
+				return -1;
+			hasLength = true;
+		}
+		else if (boost::iequals(name, "Transfer-Encoding"))
+		{
+			chunked = boost::iends_with(value, "chunked");
+		}
+		request.m_headers.emplace_back(std::move(name), std::move(value));
+	}
+	if (chunked && hasLength)
+		contentLength = 0;
+	return end + 4 - m_readOffset;
+}
+
+long HttpConnection::parseChunkedBody(std::size_t offset, std::string &body)
+{
+	// continue from previous read, each received byte is parsed once
+	auto pos = offset + m_chunkedPos;
+	while (true)
+	{
+		if (m_chunkRemaining > 0)
+		{
+			const auto available = std::min<std::size_t>(m_chunkRemaining, m_readBuffer.size() - pos);
+			m_chunkedBody.append(m_readBuffer, pos, available);
+			pos += available;
+			m_chunkRemaining -= available;
+			m_chunkedPos = pos - offset;
+			if (m_chunkRemaining > 0)
+				return 0;
+		}
+		if (m_chunkCrlfPending)
+		{
+			if (m_readBuffer.size() < pos + 2)
+				return 0;
+			pos += 2;
+			m_chunkCrlfPending = false;
+			m_chunkedPos = pos - offset;
+		}
+		const auto lineEnd = m_readBuffer.find("\r\n", pos);
+		if (lineEnd == std::string::npos)
+			return 0;
+		char *sizeEnd = nullptr;
+		const auto size = std::strtoull(m_readBuffer.c_str() + pos, &sizeEnd, 16);
+		if (sizeEnd == m_readBuffer.c_str() + pos || (!m_streamBody && size > m_server.m_options.m_maxBodyBytes))
+			return -1;
+		pos = lineEnd + 2;
+		if (size == 0)
+		{
+			// skip trailer fields until empty line, last chunk line is parsed again when not complete
+			const auto trailerEnd = m_readBuffer.find("\r\n", pos);
+			if (trailerEnd == std::string::npos)
+				return 0;
+			auto end = trailerEnd + 2;
+			if (trailerEnd != pos)
+			{
+				end = m_readBuffer.find("\r\n\r\n", pos);
+				if (end == std::string::npos)
+					return 0;
+				end += 4;
+			}
+			body.swap(m_chunkedBody);
+			m_chunkedBody.clear();
+			m_chunkedPos = 0;
+			return end - offset;
+		}
+		m_chunkRemaining = size;
+		m_chunkCrlfPending = true;
+		m_chunkedPos = pos - offset;
+	}
+}
+
+long HttpConnection::streamBody()
+{
+	if (m_streamChunked)
+	{
+		// decoded data is passed out, each call continue from the undecoded position
+		std::string last;
+		const auto chunkedLength = parseChunkedBody(m_readOffset, last);
+		if (chunkedLength < 0)
+			return -1;
+		if (chunkedLength == 0)
+		{
+			if (m_chunkedBody.size())
+				m_streamBody->write(m_chunkedBody.data(), m_chunkedBody.size());
+			m_chunkedBody.clear();
+			m_readOffset += m_chunkedPos;
+			m_chunkedPos = 0;
+			return 0;
+		}
+		if (last.size())
+			m_streamBody->write(last.data(), last.size());
+		m_readOffset += chunkedLength;
+	}
+	else
+	{
+		const auto bytes = std::min<uint64_t>(m_streamRemaining, m_readBuffer.size() - m_readOffset);
+		if (bytes)
+			m_streamBody->write(&m_readBuffer[m_readOffset], bytes);
+		m_readOffset += bytes;
+		m_streamRemaining -= bytes;
+		if (m_streamRemaining > 0)
+			return 0;
+	}
+	endStream(true);
+	return 1;
+}
+
+void HttpConnection::endStream(bool complete)
+{
+	if (!m_streamBody)
+		return;
+	m_streamBody->finish(complete);
+	m_streamBody.reset();
+	m_streamReply.reset();
+	m_streamRemaining = 0;
+	m_chunkedBody.clear();
+	m_chunkedPos = 0;
+	m_chunkRemaining = 0;
+	m_chunkCrlfPending = false;
+}
+
+void HttpConnection::sendContinue(const HttpServerRequest &request)
+{
+	// wait for body, answer "Expect: 100-continue" once
+	auto expect = request.header("Expect");
+	if (!m_continueSent && expect && boost::iequals(*expect, "100-continue") && request.m_minorVersion == 1)
+	{
+		m_continueSent = true;
+		auto continueReply = std::make_shared<PendingReply>();
+		continueReply->m_data = "HTTP/1.1 100 Continue\r\n\r\n";
+		continueReply->m_ready = true;
+		m_pending.push_back(continueReply);
+		write();
+	}
+}
+
+std::shared_ptr<HttpConnection::PendingReply> HttpConnection::enqueue(const std::shared_ptr<HttpExchange> &exchange, bool keepAlive)
+{
+	auto pending = std::make_shared<PendingReply>();
+	m_pending.push_back(pending);
+	const bool head = exchange->m_request.m_method == "HEAD";
+
+	// reply can be called from any thread, always complete on connection thread,
+	// exchange keeps connection alive until replied
+	auto self = shared_from_this();
+	exchange->m_replyHandler = [self, pending, keepAlive, head](HttpServerResponse &&response) {
+		auto holder = std::make_shared<HttpServerResponse>(std::move(response));
+		asio::post(self->m_io, [self, pending, holder, keepAlive, head]() {
+			self->onReply(pending, std::move(*holder), keepAlive, head);
+		});
+	};
+	if (!m_server.dispatch(exchange))
+	{
+		HttpServerResponse response;
+		response.m_status = 503;
+		response.m_headers.emplace_back("Retry-After", "1");
+		response.m_body = "server busy";
+		exchange->reply(std::move(response));
+	}
+	return pending;
+}
+
+void HttpConnection::rejectAndClose(int status)
+{
+	auto exchange = std::shared_ptr<HttpExchange>(new HttpExchange());
+	m_closing = true;
+	auto pending = std::make_shared<PendingReply>();
+	m_pending.push_back(pending);
+	HttpServerResponse response;
+	response.m_status = status;
+	response.m_body = reasonPhrase(status);
+	exchange->m_replied = true;
+	onReply(pending, std::move(response), false, false);
+}
+
+void HttpConnection::onReply(const std::shared_ptr<PendingReply> &pending, HttpServerResponse &&response, bool keepAlive, bool head)
+{
+	if (m_streamBody && pending == m_streamReply)
+	{
+		// replied before body is received, rest of body is not read
+		endStream(false);
+		m_closing = true;
+		keepAlive = false;
+	}
+	auto &data = pending->m_data;
+	data.reserve(256 + response.m_body.size());
+	data.append("HTTP/1.1 ").append(std::to_string(response.m_status)).append(" ");
+	data.append(response.m_reason.empty() ? reasonPhrase(response.m_status) : response.m_reason).append("\r\n");
+	for (const auto &header : response.m_headers)
+	{
+		// framing headers are generated here
+		if (boost::iequals(header.first, "Content-Length") || boost::iequals(header.first, "Connection") || boost::iequals(header.first, "Transfer-Encoding"))
+			continue;
+		data.append(header.first).append(": ").append(header.second).append("\r\n");
+	}
+	const uint64_t fileLength = response.m_file ? response.m_file->m_length : 0;
+	if (response.m_status >= 200 && response.m_status != 204 && response.m_status != 304)
+		data.append("Content-Length: ").append(std::to_string(response.m_body.size() + fileLength)).append("\r\n");
+	data.append(keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+	if (!head)
+	{
+		data.append(response.m_body);
+		pending->m_file = std::move(response.m_file);
+	}
+	pending->m_ready = true;
+	pending->m_close = !keepAlive;
+	write();
+}
+
+void HttpConnection::write()
+{
+	if (m_writing || m_pending.empty() || !m_pending.front()->m_ready)
+		return;
+	m_writing = true;
+	auto self = shared_from_this();
+	auto front = m_pending.front();
+	asyncWrite(asio::buffer(front->m_data), [self, front](const boost::system::error_code &ec, std::size_t) {
+		if (!ec && front->m_file)
+			self->writeFile(front);
+		else
+			self->onWritten(front, ec);
+	});
+}
+
+void HttpConnection::writeFile(const std::shared_ptr<PendingReply> &pending)
+{
+	auto &file = *pending->m_file;
+	if (file.m_length == 0)
+	{
+		onWritten(pending, boost::system::error_code());
+		return;
+	}
+	auto self = shared_from_this();
+	const auto size = std::min<uint64_t>(file.m_length, HTTP_SERVER_FILE_CHUNK_BYTES);
+	if (m_ssl)
+	{
+		// TLS record is encrypted in user space, file is read to reply buffer
+		pending->m_data.resize(size);
+		const auto bytes = ::pread(file.m_fd, &pending->m_data[0], size, file.m_offset);
+		if (bytes <= 0)
+		{
+			onWritten(pending, bytes < 0 ? boost::system::error_code(errno, boost::system::system_category()) : asio::error::eof);
+			return;
+		}
+		pending->m_data.resize(bytes);
+		file.m_offset += bytes;
+		file.m_length -= bytes;
+		asyncWrite(asio::buffer(pending->m_data), [self, pending](const boost::system::error_code &ec, std::size_t) {
+			if (ec)
+				self->onWritten(pending, ec);
+			else
+				self->writeFile(pending);
+		});
+		return;
+	}
+	// page cache to socket without user space copy, socket is non-blocking;
+	// sendfile() has no MSG_NOSIGNAL, SIGPIPE is ignored by process
+	off_t offset = file.m_offset;
+	const auto sent = ::sendfile(m_socket.native_handle(), file.m_fd, &offset, size);
+	if (sent > 0)
+	{
+		file.m_offset += sent;
+		file.m_length -= sent;
+	}
+	else if (sent == 0)
+	{
+		// file is truncated after Content-Length sent
+		onWritten(pending, asio::error::eof);
+		return;
+	}
+	else if (errno != EAGAIN && errno != EINTR)
+	{
+		onWritten(pending, boost::system::error_code(errno, boost::system::system_category()));
+		return;
+	}
+	// continue when socket is writable, other connections are served meanwhile
+	m_socket.async_wait(GenericSocket::wait_write, [self, pending](const boost::system::error_code &ec) {
+		if (ec)
+			self->onWritten(pending, ec);
+		else
+			self->writeFile(pending);
+	});
+}
+
+void HttpConnection::onWritten(const std::shared_ptr<PendingReply> &pending, const boost::system::error_code &ec)
+{
+	m_writing = false;
+	m_pending.pop_front();
+	pending->m_file.reset();
+	if (ec || pending->m_close)
+	{
+		shutdown();
+		return;
+	}
+	if (m_pending.empty())
+	{
+		if (m_closing)
+		{
+			shutdown();
+			return;
+		}
+		armIdleTimer();
+	}
+	write();
+	// resume reading paused by pipeline limit, buffered requests are parsed first;
+	// read buffer is not parsed while a read is writing into it
+	if (!m_reading && parse())
+		read();
+}
+
+void HttpConnection::armIdleTimer()
+{
+	m_idleTimer.expires_after(std::chrono::seconds(m_server.m_options.m_keepAliveSeconds));
+	std::weak_ptr<HttpConnection> weakSelf = shared_from_this();
+	m_idleTimer.async_wait([weakSelf](const boost::system::error_code &ec) {
+		auto self = weakSelf.lock();
+		// keep connection when request is being handled
+		if (!ec && self && self->m_pending.empty())
+			self->shutdown();
+	});
+}
+
+void HttpConnection::shutdown()
+{
+	m_closing = true;
+	endStream(false);
+	boost::system::error_code ec;
+	m_idleTimer.cancel(ec);
+	m_socket.shutdown(asio::socket_base::shutdown_both, ec);
+	m_socket.close(ec);
+}
+
+HttpServer::HttpServer(const HttpServerOptions &options, Handler handler)
+	: m_options(options), m_handler(handler), m_nextIoContext(0), m_inflight(0), m_queued(0)
+{
+}
+
+HttpServer::~HttpServer()
+{
+	close();
+}
+
+void HttpServer::open()
+{
+	const static char fname[] = "HttpServer::open() ";
+
+	for (std::size_t i = 0; i < std::max<std::size_t>(m_options.m_ioThreads, 1); i++)
+	{
+		m_ioContexts.emplace_back(new asio::io_context(1));
+		m_ioWorks.emplace_back(asio::make_work_guard(*m_ioContexts.back()));
+	}
+	try
+	{
+		m_acceptor.reset(new asio::basic_socket_acceptor<asio::generic::stream_protocol>(*m_ioContexts.front()));
+		if (m_options.m_localSocketPath.length())
+		{
+			// remove socket file left by previous process, other file at the path is kept
+			struct stat st;
+			if (::lstat(m_options.m_localSocketPath.c_str(), &st) == 0)
+			{
+				if (!S_ISSOCK(st.st_mode))
+					throw std::runtime_error(Utility::stringFormat("failed to listen %s, file exists and is not a socket", listenName().c_str()));
+				::unlink(m_options.m_localSocketPath.c_str());
+			}
+			const asio::generic::stream_protocol::endpoint genericEndpoint(asio::local::stream_protocol::endpoint(m_options.m_localSocketPath));
+			m_acceptor->open(genericEndpoint.protocol());
+			{
+				// socket file is created without permission for others, nobody can connect
+				// before chmod; umask is process wide, open() is called when daemon starts
+				boost::system::error_code ec;
+				const auto mask = ::umask(0117);
+				m_acceptor->bind(genericEndpoint, ec);
+				::umask(mask);
+				if (ec)
+					throw boost::system::system_error(ec);
+			}
+			// only owner and group members can connect, request is authorized by peer credential or token
+			if (::chmod(m_options.m_localSocketPath.c_str(), 0660) != 0)
+			{
+				const auto error = std::strerror(errno);
+				::unlink(m_options.m_localSocketPath.c_str());
+				throw std::runtime_error(Utility::stringFormat("failed to listen %s, failed to set socket file mode: %s", listenName().c_str(), error));
+			}
+			if (m_options.m_localSocketGroup.length())
+			{
+				struct group grp;
+				struct group *result = nullptr;
+				char buffer[4096];
+				if (::getgrnam_r(m_options.m_localSocketGroup.c_str(), &grp, buffer, sizeof(buffer), &result) != 0 || result == nullptr ||
+					::chown(m_options.m_localSocketPath.c_str(), -1, grp.gr_gid) != 0)
+				{
+					LOG_WAR << fname << "failed to set group <" << m_options.m_localSocketGroup << "> for socket file <" << m_options.m_localSocketPath << ">";
+				}
+			}
+		}
+		else
+		{
+			boost::system::error_code ec;
+			const auto address = asio::ip::make_address(m_options.m_address.empty() ? "0.0.0.0" : m_options.m_address, ec);
+			asio::ip::tcp::endpoint endpoint;
+			if (ec)
+			{
+				// host name
+				asio::ip::tcp::resolver resolver(*m_ioContexts.front());
+				endpoint = *resolver.resolve(m_options.m_address, std::to_string(m_options.m_port)).begin();
+			}
+			else
+			{
+				endpoint = asio::ip::tcp::endpoint(address, m_options.m_port);
+			}
+			const asio::generic::stream_protocol::endpoint genericEndpoint(endpoint);
+			m_acceptor->open(genericEndpoint.protocol());
+			m_acceptor->set_option(asio::socket_base::reuse_address(true));
+			m_acceptor->bind(genericEndpoint);
+		}
+		m_acceptor->listen(asio::socket_base::max_listen_connections);
+	}
+	catch (const boost::system::system_error &e)
+	{
+		throw std::runtime_error(Utility::stringFormat("failed to listen %s, %s", listenName().c_str(), e.what()));
+	}
+	accept();
+
+	m_handlerContext.reset(new asio::io_context());
+	m_handlerWork.reset(new asio::executor_work_guard<asio::io_context::executor_type>(asio::make_work_guard(*m_handlerContext)));
+	for (auto &io : m_ioContexts)
+	{
+		auto context = io.get();
+		m_threads.emplace_back([context]() { context->run(); });
+	}
+	auto handlerContext = m_handlerContext.get();
+	for (std::size_t i = 0; i < std::max<std::size_t>(m_options.m_handlerThreads, 1); i++)
+	{
+		m_threads.emplace_back([handlerContext]() { handlerContext->run(); });
+	}
+	LOG_INF << fname << "listen " << listenName() << " with " << m_ioContexts.size() << " I/O threads and " << m_options.m_handlerThreads << " handler threads";
+}
+
+void HttpServer::close()
+{
+	if (m_acceptor)
+	{
+		asio::post(m_acceptor->get_executor(), [this]() {
+			boost::system::error_code ec;
+			m_acceptor->close(ec);
+		});
+	}
+	{
+		// handler blocked in reading streamed body return before handler threads are joined
+		std::lock_guard<std::mutex> guard(m_bodiesMutex);
+		for (auto &weakBody : m_bodies)
+		{
+			if (auto body = weakBody.lock())
+				body->finish(false);
+		}
+		m_bodies.clear();
+	}
+	m_ioWorks.clear();
+	m_handlerWork.reset();
+	for (auto &io : m_ioContexts)
+		io->stop();
+	if (m_handlerContext)
+		m_handlerContext->stop();
+	for (auto &thread : m_threads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+	m_threads.clear();
+	struct stat st;
+	if (m_acceptor && m_options.m_localSocketPath.length() && ::lstat(m_options.m_localSocketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+		::unlink(m_options.m_localSocketPath.c_str());
+	m_acceptor.reset();
+	// queued exchanges reply to connections, release them before I/O contexts
+	m_handlerContext.reset();
+	// connections are released with pending handlers
+	m_ioContexts.clear();
+}
+
+int HttpServer::port() const
+{
+	if (m_acceptor && m_options.m_localSocketPath.empty())
+	{
+		boost::system::error_code ec;
+		const auto endpoint = m_acceptor->local_endpoint(ec);
+		if (!ec)
+		{
+			asio::ip::tcp::endpoint tcpEndpoint;
+			std::memcpy(tcpEndpoint.data(), endpoint.data(), endpoint.size());
+			return tcpEndpoint.port();
+		}
+	}
+	return m_options.m_port;
+}
+
+std::string HttpServer::listenName() const
+{
+	if (m_options.m_localSocketPath.length())
+		return m_options.m_localSocketPath;
+	return m_options.m_address + ":" + std::to_string(m_options.m_port);
+}
+
+void HttpServer::accept()
+{
+	// accepted socket is served by I/O threads in turn
+	auto &io = *m_ioContexts[m_nextIoContext++ % m_ioContexts.size()];
+	m_acceptor->async_accept(io, [this, &io](const boost::system::error_code &ec, GenericSocket socket) {
+		if (ec == asio::error::operation_aborted || !m_acceptor->is_open())
+			return;
+		if (!ec)
+		{
+			if (m_options.m_localSocketPath.empty())
+			{
+				int noDelay = 1;
+				::setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+			}
+			auto connection = std::make_shared<HttpConnection>(*this, io, std::move(socket));
+			asio::post(io, [connection]() { connection->start(); });
+		}
+		accept();
+	});
+}
+
+bool HttpServer::dispatch(const std::shared_ptr<HttpExchange> &exchange)
+{
+	if (m_inflight.load() >= m_options.m_maxConcurrentRequests || m_queued.load() >= m_options.m_requestQueueDepth)
+		return false;
+	++m_inflight;
+	++m_queued;
+	// count down inflight when reply is written to connection
+	auto replyHandler = exchange->m_replyHandler;
+	exchange->m_replyHandler = [this, replyHandler](HttpServerResponse &&response) {
+		onReplied();
+		replyHandler(std::move(response));
+	};
+	asio::post(*m_handlerContext, [this, exchange]() {
+		--m_queued;
+		try
+		{
+			m_handler(exchange);
+		}
+		catch (const std::exception &e)
+		{
+			HttpServerResponse response;
+			response.m_status = 500;
+			response.m_body = e.what();
+			exchange->reply(std::move(response));
+		}
+		catch (...)
+		{
+			HttpServerResponse response;
+			response.m_status = 500;
+			exchange->reply(std::move(response));
+		}
+	});
+	return true;
+}
+
+void HttpServer::onReplied()
+{
+	--m_inflight;
+}
+
+void HttpServer::addBody(const std::shared_ptr<HttpServerBody> &body)
+{
+	std::lock_guard<std::mutex> guard(m_bodiesMutex);
+	m_bodies.erase(std::remove_if(m_bodies.begin(), m_bodies.end(), [](const std::weak_ptr<HttpServerBody> &weakBody) { return weakBody.expired(); }), m_bodies.end());
+	m_bodies.push_back(body);
+}
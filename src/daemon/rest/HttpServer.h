@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+struct stat;
+
+//////////////////////////////////////////////////////////////////////////
+/// Request body streamed from connection to handler, connection stop
+/// reading when buffered bytes reach limit and continue after handler read
+//////////////////////////////////////////////////////////////////////////
+class HttpServerBody
+{
+public:
+	HttpServerBody(std::size_t bufferBytes, int timeoutSeconds);
+	/// Block until data received, return 0 at end of body; throw std::runtime_error
+	/// when connection failed before end of body or no data received in timeout
+	std::size_t read(char *buffer, std::size_t size);
+
+private:
+	friend class HttpConnection;
+	friend class HttpServer;
+	/// Append data received by connection, return false when buffer is full
+	bool write(const char *data, std::size_t size);
+	/// End of body when complete, otherwise read() fail
+	void finish(bool complete);
+	bool paused();
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::string m_buffer;
+	std::size_t m_readPos;
+	const std::size_t m_bufferBytes;
+	const std::chrono::seconds m_timeout;
+	bool m_finished;
+	bool m_failed;
+	bool m_paused;
+	// continue reading on connection thread when paused buffer is drained
+	std::function<void()> m_resume;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// HTTP/1.1 request parsed by HttpServer, body is fully received in m_body
+/// or streamed by m_bodyStream
+//////////////////////////////////////////////////////////////////////////
+struct HttpServerRequest
+{
+	std::string m_method;
+	// origin-form request target: /path?query
+	std::string m_target;
+	// 0 for HTTP/1.0, 1 for HTTP/1.1
+	int m_minorVersion = 1;
+	std::vector<std::pair<std::string, std::string>> m_headers;
+	std::string m_body;
+	// not null when body is streamed to handler, m_body is empty
+	std::shared_ptr<HttpServerBody> m_bodyStream;
+	std::string m_remoteAddress;
+	// uid of peer process connected from Unix domain socket, -1 for TCP
+	int m_peerUid = -1;
+
+	/// Case insensitive header lookup, nullptr when not exist
+	const std::string *header(const std::string &name) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// File region sent after response body by sendfile(), fd is owned
+//////////////////////////////////////////////////////////////////////////
+struct HttpServerFile
+{
+	HttpServerFile(int fd, uint64_t offset, uint64_t length);
+	~HttpServerFile();
+	HttpServerFile(const HttpServerFile &) = delete;
+	HttpServerFile &operator=(const HttpServerFile &) = delete;
+
+	const int m_fd;
+	uint64_t m_offset;
+	uint64_t m_length;
+};
+
+struct HttpServerResponse
+{
+	int m_status = 200;
+	std::string m_reason;
+	std::vector<std::pair<std::string, std::string>> m_headers;
+	std::string m_body;
+	// sent after m_body, Content-Length include file length
+	std::shared_ptr<HttpServerFile> m_file;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Byte range of a file response evaluated from Range and If-Range
+//////////////////////////////////////////////////////////////////////////
+struct HttpFileRange
+{
+	// 200 whole file, 206 partial content, 416 range not satisfiable
+	int m_status = 200;
+	uint64_t m_offset = 0;
+	uint64_t m_length = 0;
+	uint64_t m_fileSize = 0;
+
+	/// Only single range is served partially, multiple ranges and invalid
+	/// Range are served as whole file; Range is ignored when If-Range not match
+	static HttpFileRange parse(const std::string *range, const std::string *ifRange, const std::string &etag, uint64_t fileSize);
+	/// Content-Range header value for 206 and 416
+	std::string contentRange() const;
+	/// Strong validator from inode, modify time and size
+	static std::string etag(const struct stat &st);
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// One request and its reply slot, reply() can be called from any thread
+/// and only once; not replied exchange answer 500 when destructed
+//////////////////////////////////////////////////////////////////////////
+class HttpExchange
+{
+public:
+	virtual ~HttpExchange();
+	const HttpServerRequest &request() const { return m_request; }
+	HttpServerRequest &request() { return m_request; }
+	void reply(HttpServerResponse &&response);
+
+private:
+	friend class HttpServer;
+	friend class HttpConnection;
+	HttpExchange();
+
+	HttpServerRequest m_request;
+	std::atomic<bool> m_replied;
+	std::function<void(HttpServerResponse &&)> m_replyHandler;
+};
+
+struct HttpServerOptions
+{
+	std::string m_address;
+	int m_port = 0;
+	// threads accept, read and write sockets
+	std::size_t m_ioThreads = 2;
+	// threads call request handler
+	std::size_t m_handlerThreads = 6;
+	// requests dispatched and not replied
+	std::size_t m_maxConcurrentRequests = 256;
+	// requests wait for a handler thread, beyond this 503 is replied
+	std::size_t m_requestQueueDepth = 128;
+	// idle keep-alive connection is closed after this
+	int m_keepAliveSeconds = 60;
+	// connection is closed after serving this number of requests
+	std::size_t m_keepAliveMaxRequests = 1000;
+	// pipelined requests waiting for reply on one connection, stop reading beyond this
+	std::size_t m_maxPipelinedRequests = 16;
+	std::size_t m_maxHeaderBytes = 64 * 1024;
+	// received body is buffered up to this, beyond this 413 is replied
+	std::size_t m_maxBodyBytes = 4 * 1024 * 1024;
+	// request with body is dispatched after header and body is streamed when return true,
+	// streamed body is not limited by m_maxBodyBytes
+	std::function<bool(const HttpServerRequest &)> m_streamBody;
+	// TLS is enabled when not null
+	std::shared_ptr<boost::asio::ssl::context> m_sslContext;
+	// listen on Unix domain socket file instead of address and port when not empty, TLS is not used
+	std::string m_localSocketPath;
+	// socket file mode is 0660, members of this OS group can connect when not empty
+	std::string m_localSocketGroup;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Asio HTTP/1.1 server: I/O threads each own an io_context and serve the
+/// connections assigned to it (no lock on socket), requests are dispatched
+/// to a separate handler thread pool. Support keep-alive and pipelining,
+/// replies of pipelined requests are written in request order.
+//////////////////////////////////////////////////////////////////////////
+class HttpServer
+{
+public:
+	typedef std::function<void(const std::shared_ptr<HttpExchange> &)> Handler;
+
+	HttpServer(const HttpServerOptions &options, Handler handler);
+	virtual ~HttpServer();
+
+	/// Bind and listen, throw std::runtime_error when failed
+	void open();
+	void close();
+	/// Listening TCP port, port chosen by system when bound to port 0
+	int port() const;
+
+	std::size_t inflightRequests() const { return m_inflight.load(); }
+	std::size_t queuedRequests() const { return m_queued.load(); }
+
+private:
+	friend class HttpConnection;
+	std::string listenName() const;
+	void accept();
+	/// Return false when request should be rejected with 503
+	bool dispatch(const std::shared_ptr<HttpExchange> &exchange);
+	void onReplied();
+	/// Streamed body fail when server is closed, handler blocked in read() return
+	void addBody(const std::shared_ptr<HttpServerBody> &body);
+
+	const HttpServerOptions m_options;
+	const Handler m_handler;
+
+	std::vector<std::unique_ptr<boost::asio::io_context>> m_ioContexts;
+	std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_ioWorks;
+	std::size_t m_nextIoContext;
+	// generic stream acceptor, accepted sockets are generic stream sockets
+	std::unique_ptr<boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol>> m_acceptor;
+	std::unique_ptr<boost::asio::io_context> m_handlerContext;
+	std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_handlerWork;
+	std::vector<std::thread> m_threads;
+
+	std::atomic<std::size_t> m_inflight;
+	std::atomic<std::size_t> m_queued;
+	std::mutex m_bodiesMutex;
+	std::vector<std::weak_ptr<HttpServerBody>> m_bodies;
+};
+
+#define HTTP_SERVER_READ_BUFFER_BYTES 16384
+// streamed request body bytes buffered before pause reading
+#define HTTP_SERVER_BODY_BUFFER_BYTES (1024 * 1024)
+// file bytes sent in one round before yield to other connections
+#define HTTP_SERVER_FILE_CHUNK_BYTES (1024 * 1024)
@@ -1,19 +1,24 @@
 #include <boost/algorithm/string_regex.hpp>
 #include "PrometheusRest.h"
 #include "../../prom_exporter/counter.h"
+#include "../../prom_exporter/gauge.h"
+#include "../../prom_exporter/histogram.h"
 #include "../../prom_exporter/registry.h"
 #include "../../prom_exporter/text_serializer.h"
+#include "../Configuration.h"
+#include "../HostMetrics.h"
 #include "../ResourceCollection.h"
+#include "../../common/AsyncLogAppender.h"
+#include "../../common/Compression.h"
 #include "../../common/Utility.h"
 
 std::shared_ptr<PrometheusRest> PrometheusRest::m_instance;
 
 PrometheusRest::PrometheusRest(std::string ipaddress, int port)
-	: m_promEnabled(false), m_scrapeCounter(0)
+	: m_promEnabled(false), m_scrapeCounter(0), m_logDroppedReported(0)
 {
 	const static char fname[] = "PrometheusRest::PrometheusRest() ";
 	m_promRegistry = std::make_shared<prometheus::Registry>();
-	initMetrics();
 
 	if (port)
 	{
@@ -42,6 +47,15 @@ PrometheusRest::PrometheusRest(std::string ipaddress, int port)
 
 		this->open();
 		m_promEnabled = true;
+		// bound series of each family, app metrics are labeled by app id
+		auto &overflow = prometheus::BuildCounter()
+							 .Name(PROM_METRIC_NAME_appmesh_prom_series_overflow_count)
+							 .Help(PROM_METRIC_HELP_appmesh_prom_series_overflow_count)
+							 .Labels({{"host", MY_HOST_NAME}, {"pid", std::to_string(ResourceCollection::instance()->getPid())}})
+							 .Register(*m_promRegistry);
+		m_promRegistry->SetMaxSeriesPerFamily(PROM_FAMILY_MAX_SERIES, &overflow);
+		initMetrics();
+		m_collectables.push_back(std::make_shared<HostMetrics>(MY_HOST_NAME));
 		LOG_INF << fname << "Listening for requests at:" << uri.to_string();
 	}
 	else
@@ -202,13 +216,57 @@ void PrometheusRest::initMetrics()
 		{});
 	if (m_promGauge)
 		m_promGauge->metric().Set(1);
+	m_logDroppedCounter = createPromCounter(
+		PROM_METRIC_NAME_appmesh_log_dropped_count,
+		PROM_METRIC_HELP_appmesh_log_dropped_count,
+		{});
+
+	m_spawnHistogram = createPromHistogram(
+		PROM_METRIC_NAME_appmesh_process_spawn_duration_seconds,
+		PROM_METRIC_HELP_appmesh_process_spawn_duration_seconds,
+		{});
+	m_configSaveHistogram = createPromHistogram(
+		PROM_METRIC_NAME_appmesh_config_save_duration_seconds,
+		PROM_METRIC_HELP_appmesh_config_save_duration_seconds,
+		{});
+	for (const auto &method : {"GET", "PUT", "POST", "DELETE"})
+	{
+		m_consulHistograms[method] = createPromHistogram(
+			PROM_METRIC_NAME_appmesh_consul_request_duration_seconds,
+			PROM_METRIC_HELP_appmesh_consul_request_duration_seconds,
+			{{"method", method}});
+	}
+}
+
+std::shared_ptr<HistogramPtr> PrometheusRest::spawnHistogram()
+{
+	auto prom = instance();
+	return prom ? prom->m_spawnHistogram : nullptr;
 }
 
-std::shared_ptr<CounterPtr> PrometheusRest::createPromCounter(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels)
+std::shared_ptr<HistogramPtr> PrometheusRest::configSaveHistogram()
+{
+	auto prom = instance();
+	return prom ? prom->m_configSaveHistogram : nullptr;
+}
+
+std::shared_ptr<HistogramPtr> PrometheusRest::consulHistogram(const std::string &method)
+{
+	auto prom = instance();
+	if (prom)
+	{
+		auto histogram = prom->m_consulHistograms.find(method);
+		if (histogram != prom->m_consulHistograms.end())
+			return histogram->second;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<CounterPtr> PrometheusRest::createPromCounter(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels, bool sharded)
 {
 	if (!m_promEnabled)
 		return nullptr;
-	return std::make_shared<CounterPtr>(m_promRegistry, metricName, metricHelp, labels);
+	return std::make_shared<CounterPtr>(m_promRegistry, metricName, metricHelp, labels, sharded);
 }
 
 std::shared_ptr<GaugePtr> PrometheusRest::createPromGauge(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels)
@@ -218,11 +276,71 @@ std::shared_ptr<GaugePtr> PrometheusRest::createPromGauge(const std::string &met
 	return std::make_shared<GaugePtr>(m_promRegistry, metricName, metricHelp, labels);
 }
 
-const std::string PrometheusRest::collectData()
+std::shared_ptr<HistogramPtr> PrometheusRest::createPromHistogram(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels, const std::vector<double> &buckets)
 {
-	// leave a static text serializer here
-	static auto promSerializer = std::unique_ptr<prometheus::Serializer>(new prometheus::TextSerializer());
-	return std::move(promSerializer->Serialize(m_promRegistry->Collect()));
+	// 0.5ms ~ 10s
+	const static std::vector<double> latencyBuckets = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+	if (!m_promEnabled)
+		return nullptr;
+	return std::make_shared<HistogramPtr>(m_promRegistry, metricName, metricHelp, labels, buckets.empty() ? latencyBuckets : buckets);
+}
+
+std::shared_ptr<const std::string> PrometheusRest::collectData(bool gzip)
+{
+	const auto requestTime = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> guard(m_scrapeMutex);
+	const auto cacheTime = std::chrono::milliseconds(Configuration::instance()->getPromScrapeCacheMilliseconds());
+	// render started after this request arrived (single-flight) or still in cache duration
+	const bool fresh = m_scrapeText && (m_scrapeTime >= requestTime || requestTime - m_scrapeTime < cacheTime);
+	if (!fresh)
+	{
+		// stream series into buffer sized by last scrape, avoid building MetricFamily for each scrape
+		auto text = std::make_shared<std::string>();
+		text->reserve(m_scrapeText ? m_scrapeText->size() + m_scrapeText->size() / 8 : 0);
+		m_scrapeTime = std::chrono::steady_clock::now();
+		if (m_logDroppedCounter)
+		{
+			const auto dropped = AsyncLogAppender::droppedLines();
+			m_logDroppedCounter->metric().Increment(dropped - m_logDroppedReported);
+			m_logDroppedReported = dropped;
+		}
+		prometheus::TextStreamSerializer serializer(*text);
+		m_promRegistry->Accept(serializer);
+		for (const auto &collectable : m_collectables)
+		{
+			collectable->Accept(serializer);
+		}
+		m_scrapeText = std::move(text);
+		m_scrapeGzip = nullptr;
+	}
+	if (gzip)
+	{
+		// compress once for each render
+		if (m_scrapeGzip == nullptr)
+			m_scrapeGzip = std::make_shared<const std::string>(Compression::gzip(*m_scrapeText));
+		return m_scrapeGzip;
+	}
+	return m_scrapeText;
+}
+
+void PrometheusRest::replyMetrics(const HttpRequest &message)
+{
+	const static char fname[] = "PrometheusRest::replyMetrics() ";
+
+	bool gzip = false;
+	if (message.headers().has(HTTP_HEADER_KEY_accept_encoding))
+	{
+		gzip = Compression::acceptEncoding(message.headers().find(HTTP_HEADER_KEY_accept_encoding)->second, "gzip");
+	}
+	auto body = collectData(gzip);
+	LOG_DBG << fname << "reply " << body->size() << " bytes" << (gzip ? " gzip" : "");
+
+	http_response response(status_codes::OK);
+	response.set_body(*body, "text/plain; version=0.0.4");
+	if (gzip)
+		response.headers().add(HTTP_HEADER_KEY_content_encoding, "gzip");
+	response.headers().add(HTTP_HEADER_KEY_vary, HTTP_HEADER_KEY_accept_encoding);
+	message.reply(response);
 }
 
 void PrometheusRest::apiMetrics(const HttpRequest &message)
@@ -233,10 +351,10 @@ void PrometheusRest::apiMetrics(const HttpRequest &message)
 	if (m_scrapeCounter)
 		m_scrapeCounter->metric().Increment();
 
-	message.reply(status_codes::OK, collectData(), "text/plain; version=0.0.4");
+	replyMetrics(message);
 }
 
-CounterPtr::CounterPtr(std::shared_ptr<prometheus::Registry> retistry, const std::string &name, const std::string &help, std::map<std::string, std::string> label)
+CounterPtr::CounterPtr(std::shared_ptr<prometheus::Registry> retistry, const std::string &name, const std::string &help, std::map<std::string, std::string> label, bool sharded)
 	: m_metric(nullptr), m_family(nullptr), m_promRegistry(retistry), m_name(name), m_help(help), m_label(label)
 {
 	const static char fname[] = "CounterPtr::CounterPtr() ";
@@ -249,7 +367,7 @@ CounterPtr::CounterPtr(std::shared_ptr<prometheus::Registry> retistry, const std
 					   .Help(help)
 					   .Register(*m_promRegistry);
 	m_family = &family;
-	m_metric = &((family.Add(commonLabels)));
+	m_metric = &((family.Add(commonLabels, sharded)));
 
 	LOG_DBG << fname << "metric " << m_name << " added";
 }
@@ -295,3 +413,49 @@ prometheus::Gauge &GaugePtr::metric()
 {
 	return *m_metric;
 }
+
+HistogramPtr::HistogramPtr(std::shared_ptr<prometheus::Registry> retistry, const std::string &name, const std::string &help, std::map<std::string, std::string> label, const std::vector<double> &buckets)
+	: m_metric(nullptr), m_family(nullptr), m_promRegistry(retistry), m_name(name), m_help(help), m_label(label)
+{
+	const static char fname[] = "HistogramPtr::HistogramPtr() ";
+
+	std::map<std::string, std::string> commonLabels = {{"host", MY_HOST_NAME}, {"pid", std::to_string(ResourceCollection::instance()->getPid())}};
+	commonLabels.insert(label.begin(), label.end());
+
+	auto &family = prometheus::BuildHistogram()
+					   .Name(m_name)
+					   .Help(help)
+					   .Register(*m_promRegistry);
+	m_family = &family;
+	m_metric = &((family.Add(commonLabels, buckets)));
+
+	LOG_DBG << fname << "metric " << m_name << " added";
+}
+
+HistogramPtr::~HistogramPtr()
+{
+	const static char fname[] = "HistogramPtr::~HistogramPtr() ";
+	m_family->Remove(m_metric);
+	LOG_DBG << fname << "metric " << m_name << " removed";
+}
+
+prometheus::Histogram &HistogramPtr::metric()
+{
+	return *m_metric;
+}
+
+void HistogramPtr::observe(const std::chrono::steady_clock::time_point &start)
+{
+	m_metric->Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+HistogramTimer::HistogramTimer(const std::shared_ptr<HistogramPtr> &histogram)
+	: m_histogram(histogram), m_start(std::chrono::steady_clock::now())
+{
+}
+
+HistogramTimer::~HistogramTimer()
+{
+	if (m_histogram)
+		m_histogram->observe(m_start);
+}
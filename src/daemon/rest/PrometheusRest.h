@@ -1,8 +1,12 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <assert.h>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
 #include <cpprest/http_listener.h> // HTTP server
 #include "../../common/HttpRequest.h"
 #include "../../prom_exporter/family.h"
@@ -11,6 +15,7 @@ namespace prometheus
 {
 	class Counter;
 	class Gauge;
+	class Histogram;
 	class Registry;
 }; // namespace prometheus
 
@@ -26,9 +31,10 @@ namespace prometheus
 class CounterPtr
 {
 public:
+	/// Sharded counter for counter incremented by many threads
 	explicit CounterPtr(std::shared_ptr<prometheus::Registry> retistry,
 						const std::string &name, const std::string &help,
-						std::map<std::string, std::string> label);
+						std::map<std::string, std::string> label, bool sharded = false);
 
 	virtual ~CounterPtr();
 
@@ -64,6 +70,42 @@ private:
 	const std::map<std::string, std::string> m_label;
 };
 
+class HistogramPtr
+{
+public:
+	explicit HistogramPtr(std::shared_ptr<prometheus::Registry> retistry,
+						  const std::string &name, const std::string &help,
+						  std::map<std::string, std::string> label, const std::vector<double> &buckets);
+
+	virtual ~HistogramPtr();
+
+	prometheus::Histogram &metric();
+	/// Observe seconds elapsed from start
+	void observe(const std::chrono::steady_clock::time_point &start);
+
+private:
+	prometheus::Histogram *m_metric;
+	prometheus::Family<prometheus::Histogram> *m_family;
+	std::shared_ptr<prometheus::Registry> m_promRegistry;
+	const std::string m_name;
+	const std::string m_help;
+	const std::map<std::string, std::string> m_label;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Observe seconds spent in current scope to histogram when destruct
+//////////////////////////////////////////////////////////////////////////
+class HistogramTimer
+{
+public:
+	explicit HistogramTimer(const std::shared_ptr<HistogramPtr> &histogram);
+	virtual ~HistogramTimer();
+
+private:
+	const std::shared_ptr<HistogramPtr> m_histogram;
+	const std::chrono::steady_clock::time_point m_start;
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// Prometheus Exporter REST service
 //////////////////////////////////////////////////////////////////////////
@@ -73,9 +115,14 @@ public:
 	explicit PrometheusRest(std::string ipaddress, int port);
 	virtual ~PrometheusRest();
 
-	std::shared_ptr<CounterPtr> createPromCounter(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels) noexcept(false);
+	std::shared_ptr<CounterPtr> createPromCounter(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels, bool sharded = false) noexcept(false);
 	std::shared_ptr<GaugePtr> createPromGauge(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels) noexcept(false);
-	const std::string collectData();
+	/// Histogram with latency buckets (seconds) when buckets not specified
+	std::shared_ptr<HistogramPtr> createPromHistogram(const std::string &metricName, const std::string &metricHelp, const std::map<std::string, std::string> &labels, const std::vector<double> &buckets = {}) noexcept(false);
+	/// Rendered text or gzip body, reused within PrometheusScrapeCacheMilliseconds
+	std::shared_ptr<const std::string> collectData(bool gzip = false);
+	/// Reply scrape request, gzip body when client accept it
+	void replyMetrics(const HttpRequest &message);
 
 protected:
 	void open();
@@ -103,29 +150,74 @@ private:
 	std::map<std::string, std::function<void(const HttpRequest &)>> m_restDelFunctions;
 	bool m_promEnabled;
 	std::recursive_mutex m_mutex;
+	// last scrape output, concurrent scrapes wait on mutex and share one render
+	std::shared_ptr<const std::string> m_scrapeText;
+	std::shared_ptr<const std::string> m_scrapeGzip;
+	std::chrono::steady_clock::time_point m_scrapeTime;
+	std::mutex m_scrapeMutex;
 
 	// prometheus
 	std::shared_ptr<prometheus::Registry> m_promRegistry;
+	// collected on scrape besides registry, e.g. host metrics
+	std::vector<std::shared_ptr<prometheus::Collectable>> m_collectables;
 	std::shared_ptr<CounterPtr> m_scrapeCounter;
 	std::shared_ptr<GaugePtr> m_promGauge;
+	// log lines dropped by async logging, synced on render
+	std::shared_ptr<CounterPtr> m_logDroppedCounter;
+	uint64_t m_logDroppedReported;
+	// daemon latency, created with exporter and not changed after
+	std::shared_ptr<HistogramPtr> m_spawnHistogram;
+	std::shared_ptr<HistogramPtr> m_configSaveHistogram;
+	std::map<std::string, std::shared_ptr<HistogramPtr>> m_consulHistograms;
 	static std::shared_ptr<PrometheusRest> m_instance;
 
 public:
 	static std::shared_ptr<PrometheusRest> instance() { return m_instance; }
 	static void instance(std::shared_ptr<PrometheusRest> instance) { m_instance = instance; };
+
+	// daemon latency histograms, nullptr when exporter not enabled
+	static std::shared_ptr<HistogramPtr> spawnHistogram();
+	static std::shared_ptr<HistogramPtr> configSaveHistogram();
+	static std::shared_ptr<HistogramPtr> consulHistogram(const std::string &method);
 };
+// Maximum series of one metric family, new series beyond are not exported
+#define PROM_FAMILY_MAX_SERIES 5000
+// Series rejected by PROM_FAMILY_MAX_SERIES
+#define PROM_METRIC_NAME_appmesh_prom_series_overflow_count "appmesh_prom_series_overflow_count"
+#define PROM_METRIC_HELP_appmesh_prom_series_overflow_count "metric series dropped by family series limit"
 // Prometheus scrap counter
 #define PROM_METRIC_NAME_appmesh_prom_scrape_count "appmesh_prom_scrape_count"
 #define PROM_METRIC_HELP_appmesh_prom_scrape_count "prometheus scrape count"
 // App Mesh alive
+#define PROM_METRIC_NAME_appmesh_log_dropped_count "appmesh_log_dropped_count"
+#define PROM_METRIC_HELP_appmesh_log_dropped_count "log lines dropped when async log ring is full"
 #define PROM_METRIC_NAME_appmesh_prom_scrape_up "appmesh_prom_scrape_up"
 #define PROM_METRIC_HELP_appmesh_prom_scrape_up "prometheus scrape alive"
 // App Mesh HTTP request count
 #define PROM_METRIC_NAME_appmesh_http_request_count "appmesh_http_request_count"
 #define PROM_METRIC_HELP_appmesh_http_request_count "app mesh http request count"
+// App Mesh HTTP request latency
+#define PROM_METRIC_NAME_appmesh_http_request_duration_seconds "appmesh_http_request_duration_seconds"
+#define PROM_METRIC_HELP_appmesh_http_request_duration_seconds "app mesh http request handle seconds"
+// Daemon operation latency
+#define PROM_METRIC_NAME_appmesh_process_spawn_duration_seconds "appmesh_process_spawn_duration_seconds"
+#define PROM_METRIC_HELP_appmesh_process_spawn_duration_seconds "application process spawn seconds"
+#define PROM_METRIC_NAME_appmesh_config_save_duration_seconds "appmesh_config_save_duration_seconds"
+#define PROM_METRIC_HELP_appmesh_config_save_duration_seconds "configuration file save seconds"
+#define PROM_METRIC_NAME_appmesh_consul_request_duration_seconds "appmesh_consul_request_duration_seconds"
+#define PROM_METRIC_HELP_appmesh_consul_request_duration_seconds "consul http request seconds"
 // Application process start count
 #define PROM_METRIC_NAME_appmesh_prom_process_start_count "appmesh_prom_process_start_count"
 #define PROM_METRIC_HELP_appmesh_prom_process_start_count "application process spawn count"
 // Application process memory usage
 #define PROM_METRIC_NAME_appmesh_prom_process_memory_gauge "appmesh_prom_process_memory_gauge"
 #define PROM_METRIC_HELP_appmesh_prom_process_memory_gauge "application process memory bytes"
+// Application process cgroup resource usage
+#define PROM_METRIC_NAME_appmesh_prom_process_cpu_gauge "appmesh_prom_process_cpu_gauge"
+#define PROM_METRIC_HELP_appmesh_prom_process_cpu_gauge "application process cpu usage percentage"
+#define PROM_METRIC_NAME_appmesh_prom_process_io_read_gauge "appmesh_prom_process_io_read_gauge"
+#define PROM_METRIC_HELP_appmesh_prom_process_io_read_gauge "application process io read bytes"
+#define PROM_METRIC_NAME_appmesh_prom_process_io_write_gauge "appmesh_prom_process_io_write_gauge"
+#define PROM_METRIC_HELP_appmesh_prom_process_io_write_gauge "application process io write bytes"
+#define PROM_METRIC_NAME_appmesh_prom_process_pressure_gauge "appmesh_prom_process_pressure_gauge"
+#define PROM_METRIC_HELP_appmesh_prom_process_pressure_gauge "application process pressure stall percentage"
@@ -1,4 +1,5 @@
 #include <chrono>
+#include <sys/stat.h>
 #include <boost/algorithm/string_regex.hpp>
 #include <cpprest/filestream.h>
 #include <cpprest/http_listener.h> // HTTP server
@@ -7,7 +8,10 @@
 #include "../application/Application.h"
 #include "../Configuration.h"
 #include "ConsulConnection.h"
+#include "FileUpload.h"
+#include "HttpServer.h"
 #include "RestHandler.h"
+#include "RestTransport.h"
 #include "PrometheusRest.h"
 #include "../ResourceCollection.h"
 #include "../security/User.h"
@@ -16,6 +20,7 @@
 #include "../../prom_exporter/counter.h"
 #include "../../prom_exporter/gauge.h"
 #include "../../prom_exporter/text_serializer.h"
+#include "../../common/Compression.h"
 #include "../../common/DurationParse.h"
 #include "../../common/HttpRequest.h"
 #include "../../common/Utility.h"
@@ -24,75 +29,12 @@
 #include "../../common/os/chown.hpp"
 
 RestHandler::RestHandler(const std::string &ipaddress, int port)
-	: m_listenAddress(ipaddress.empty() ? std::string("0.0.0.0") : ipaddress)
+	: m_listenAddress(ipaddress.empty() ? std::string("0.0.0.0") : ipaddress),
+	  m_fileUploads(FileUploadManager::instance()), m_latencyEnabled(false)
 {
 	const static char fname[] = "RestHandler::RestHandler() ";
 
-	// Construct URI
-	web::uri_builder uri;
-	uri.set_host(m_listenAddress);
-	uri.set_port(port);
-	uri.set_path("/");
-	if (Configuration::instance()->getSslEnabled())
-	{
-		if (!Utility::isFileExist(Configuration::instance()->getSSLCertificateFile()) ||
-			!Utility::isFileExist(Configuration::instance()->getSSLCertificateKeyFile()))
-		{
-			LOG_ERR << fname << "server.crt and server.key not exist";
-		}
-		// Support SSL
-		uri.set_scheme("https");
-		static bool sslContextCreated = false;
-		static auto server_config = new web::http::experimental::listener::http_listener_config();
-		if (!sslContextCreated)
-		{
-			sslContextCreated = true;
-			server_config->set_ssl_context_callback(
-				[&](boost::asio::ssl::context &ctx) {
-					boost::system::error_code ec;
-
-					ctx.set_options(boost::asio::ssl::context::default_workarounds |
-										boost::asio::ssl::context::no_sslv2 |
-										boost::asio::ssl::context::no_sslv3 |
-										boost::asio::ssl::context::no_tlsv1 |
-										boost::asio::ssl::context::no_tlsv1_1 |
-										boost::asio::ssl::context::single_dh_use,
-									ec);
-					// LOG_DBG << "lambda::set_options " << ec.value() << " " << ec.message();
-
-					ctx.use_certificate_chain_file(Configuration::instance()->getSSLCertificateFile(), ec);
-					// LOG_DBG << "lambda::use_certificate_chain_file " << ec.value() << " " << ec.message();
-
-					ctx.use_private_key_file(Configuration::instance()->getSSLCertificateKeyFile(), boost::asio::ssl::context::pem, ec);
-					// LOG_DBG << "lambda::use_private_key " << ec.value() << " " << ec.message();
-
-					// Enable ECDH cipher
-					if (!SSL_CTX_set_ecdh_auto(ctx.native_handle(), 1))
-					{
-						LOG_WAR << "SSL_CTX_set_ecdh_auto  failed: " << std::strerror(errno);
-					}
-					// auto ciphers = "ALL:!RC4:!SSLv2:+HIGH:!MEDIUM:!LOW";
-					auto ciphers = "HIGH:!aNULL:!eNULL:!kECDH:!aDH:!RC4:!3DES:!CAMELLIA:!MD5:!PSK:!SRP:!KRB5:@STRENGTH";
-					if (!SSL_CTX_set_cipher_list(ctx.native_handle(), ciphers))
-					{
-						LOG_WAR << "SSL_CTX_set_cipher_list failed: " << std::strerror(errno);
-					}
-					SSL_CTX_clear_options(ctx.native_handle(), SSL_OP_ALLOW_UNSAFE_LEGACY_RENEGOTIATION);
-				});
-		}
-		m_listener = std::make_unique<web::http::experimental::listener::http_listener>(uri.to_uri(), *server_config);
-	}
-	else
-	{
-		uri.set_scheme("http");
-		m_listener = std::make_unique<web::http::experimental::listener::http_listener>(uri.to_uri());
-	}
-
-	m_listener->support(methods::GET, std::bind(&RestHandler::handle_get, this, std::placeholders::_1));
-	m_listener->support(methods::PUT, std::bind(&RestHandler::handle_put, this, std::placeholders::_1));
-	m_listener->support(methods::POST, std::bind(&RestHandler::handle_post, this, std::placeholders::_1));
-	m_listener->support(methods::DEL, std::bind(&RestHandler::handle_delete, this, std::placeholders::_1));
-	m_listener->support(methods::OPTIONS, std::bind(&RestHandler::handle_options, this, std::placeholders::_1));
+	m_transport = RestTransport::create(m_listenAddress, port, std::bind(&RestHandler::dispatch, this, std::placeholders::_1));
 
 	// 1. Authentication
 	bindRestMethod(web::http::methods::POST, "/appmesh/login", std::bind(&RestHandler::apiLogin, this, std::placeholders::_1));
@@ -118,6 +60,11 @@ RestHandler::RestHandler(const std::string &ipaddress, int port)
 	// 5. File Management
 	bindRestMethod(web::http::methods::GET, "/appmesh/file/download", std::bind(&RestHandler::apiFileDownload, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::POST, "/appmesh/file/upload", std::bind(&RestHandler::apiFileUpload, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmesh/file/upload/session", std::bind(&RestHandler::apiFileUploadCreate, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::PUT, R"(/appmesh/file/upload/session/([^/\*]+))", std::bind(&RestHandler::apiFileUploadChunk, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, R"(/appmesh/file/upload/session/([^/\*]+))", std::bind(&RestHandler::apiFileUploadStatus, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, R"(/appmesh/file/upload/session/([^/\*]+)/commit)", std::bind(&RestHandler::apiFileUploadCommit, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, R"(/appmesh/file/upload/session/([^/\*]+))", std::bind(&RestHandler::apiFileUploadCancel, this, std::placeholders::_1));
 
 	// 6. Label Management
 	bindRestMethod(web::http::methods::GET, "/appmesh/labels", std::bind(&RestHandler::apiGetLabels, this, std::placeholders::_1));
@@ -148,7 +95,7 @@ RestHandler::RestHandler(const std::string &ipaddress, int port)
 
 	this->open();
 
-	LOG_INF << fname << "Listening for requests at:" << uri.to_string();
+	LOG_INF << fname << "Listening for requests at:" << m_transport->url();
 }
 
 RestHandler::~RestHandler()
@@ -167,55 +114,67 @@ RestHandler::~RestHandler()
 
 void RestHandler::open()
 {
-	m_listener->open().wait();
+	m_transport->open();
 }
 
 void RestHandler::close()
 {
-	m_listener->close(); // .wait();
+	m_transport->close();
+	if (m_localTransport)
+		m_localTransport->close();
+}
+
+void RestHandler::openLocalSocket(const std::string &socketPath)
+{
+	const static char fname[] = "RestHandler::openLocalSocket() ";
+
+	m_localTransport = RestTransport::createLocal(socketPath, std::bind(&RestHandler::dispatch, this, std::placeholders::_1));
+	m_localTransport->open();
+	LOG_INF << fname << "Listening for requests at:" << m_localTransport->url();
+}
+
+void RestHandler::dispatch(const HttpRequest &message)
+{
+	const auto &method = message.method();
+	if (method == methods::GET)
+		handle_get(message);
+	else if (method == methods::PUT)
+		handle_put(message);
+	else if (method == methods::POST)
+		handle_post(message);
+	else if (method == methods::DEL)
+		handle_delete(message);
+	else if (method == methods::OPTIONS)
+		handle_options(message);
+	else
+		message.reply(status_codes::MethodNotAllowed);
 }
 
 void RestHandler::handle_get(const HttpRequest &message)
 {
 	REST_INFO_PRINT;
-	{
-		std::lock_guard<std::recursive_mutex> guard(m_mutex);
-		if (m_restGetCounter)
-			m_restGetCounter->metric().Increment();
-	}
+	increaseCounter(m_restGetCounter);
 	handleRest(message, m_restGetFunctions);
 }
 
 void RestHandler::handle_put(const HttpRequest &message)
 {
 	REST_INFO_PRINT;
-	{
-		std::lock_guard<std::recursive_mutex> guard(m_mutex);
-		if (m_restPutCounter)
-			m_restPutCounter->metric().Increment();
-	}
+	increaseCounter(m_restPutCounter);
 	handleRest(message, m_restPutFunctions);
 }
 
 void RestHandler::handle_post(const HttpRequest &message)
 {
 	REST_INFO_PRINT;
-	{
-		std::lock_guard<std::recursive_mutex> guard(m_mutex);
-		if (m_restPostCounter)
-			m_restPostCounter->metric().Increment();
-	}
+	increaseCounter(m_restPostCounter);
 	handleRest(message, m_restPstFunctions);
 }
 
 void RestHandler::handle_delete(const HttpRequest &message)
 {
 	REST_INFO_PRINT;
-	{
-		std::lock_guard<std::recursive_mutex> guard(m_mutex);
-		if (m_restDelCounter)
-			m_restDelCounter->metric().Increment();
-	}
+	increaseCounter(m_restDelCounter);
 	handleRest(message, m_restDelFunctions);
 }
 
@@ -224,14 +183,15 @@ void RestHandler::handle_options(const HttpRequest &message)
 	message.reply(status_codes::OK);
 }
 
-void RestHandler::handleRest(const http_request &message, const std::map<std::string, std::function<void(const HttpRequest &)>> &restFunctions)
+void RestHandler::handleRest(const HttpRequest &message, const std::map<std::string, std::function<void(const HttpRequest &)>> &restFunctions)
 {
 	static char fname[] = "RestHandler::handle_rest() ";
 
 	std::function<void(const HttpRequest &)> stdFunction;
 	auto path = Utility::stringReplace(GET_STD_STRING(message.relative_uri().path()), "//", "/");
 
-	const auto request = std::move(HttpRequest(message));
+	// copy keep transport capability of request
+	const auto request = message;
 
 	if (path == "/" || path.empty())
 	{
@@ -240,12 +200,14 @@ void RestHandler::handleRest(const http_request &message, const std::map<std::st
 	}
 
 	bool findRest = false;
+	std::string route;
 	for (const auto &kvp : restFunctions)
 	{
 		if (path == kvp.first || boost::regex_match(path, boost::regex(kvp.first)))
 		{
 			findRest = true;
 			stdFunction = kvp.second;
+			route = kvp.first;
 			break;
 		}
 	}
@@ -255,11 +217,17 @@ void RestHandler::handleRest(const http_request &message, const std::map<std::st
 		return;
 	}
 
+	const auto start = std::chrono::steady_clock::now();
 	try
 	{
 		// LOG_DBG << fname << "rest " << path;
 		stdFunction(request);
 	}
+	catch (const AuthenticationError &e)
+	{
+		LOG_WAR << fname << "rest " << path << " unauthorized :" << e.what();
+		request.reply(web::http::status_codes::Unauthorized, e.what());
+	}
 	catch (const std::exception &e)
 	{
 		LOG_WAR << fname << "rest " << path << " failed :" << e.what();
@@ -270,6 +238,7 @@ void RestHandler::handleRest(const http_request &message, const std::map<std::st
 		LOG_WAR << fname << "rest " << path << " failed";
 		request.reply(web::http::status_codes::BadRequest, "unknow exception");
 	}
+	observeLatency(GET_STD_STRING(message.method()), route, request, start);
 }
 
 void RestHandler::bindRestMethod(web::http::method method, std::string path, std::function<void(const HttpRequest &)> func)
@@ -289,6 +258,52 @@ void RestHandler::bindRestMethod(web::http::method method, std::string path, std
 		m_restDelFunctions[path] = func;
 	else
 		LOG_ERR << fname << GET_STD_STRING(method).c_str() << " not supported.";
+
+	// use readable route in metric label: /appmesh/app/{name}/run/output
+	m_routeLatency[GET_STD_STRING(method) + " " + path] = std::make_unique<RouteLatency>(GET_STD_STRING(method), Utility::stringReplace(path, R"(([^/\*]+))", "{name}"));
+}
+
+void RestHandler::observeLatency(const std::string &method, const std::string &path, const HttpRequest &request, const std::chrono::steady_clock::time_point &start)
+{
+	if (!m_latencyEnabled.load(std::memory_order_relaxed))
+		return;
+	auto route = m_routeLatency.find(method + " " + path);
+	if (route == m_routeLatency.end())
+		return;
+
+	const auto status = request.replyStatus();
+	const std::size_t statusClass = (status >= 100 && status < 600) ? status / 100 : 0;
+	auto &slot = route->second->m_histograms[statusClass];
+	auto histogram = slot.load(std::memory_order_acquire);
+	if (histogram == nullptr)
+	{
+		// first request of this route and status
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		histogram = slot.load(std::memory_order_acquire);
+		auto prom = m_prom.lock();
+		if (histogram == nullptr && prom)
+		{
+			auto metric = prom->createPromHistogram(
+				PROM_METRIC_NAME_appmesh_http_request_duration_seconds, PROM_METRIC_HELP_appmesh_http_request_duration_seconds,
+				{{"method", route->second->m_method}, {"route", route->second->m_route},
+				 {"code", statusClass ? std::to_string(statusClass) + "xx" : "async"}, {"listen", m_listenAddress}});
+			if (metric)
+			{
+				m_restHistograms.push_back(metric);
+				histogram = metric.get();
+				slot.store(histogram, std::memory_order_release);
+			}
+		}
+	}
+	if (histogram)
+		histogram->observe(start);
+}
+
+RestHandler::RouteLatency::RouteLatency(const std::string &method, const std::string &route)
+	: m_method(method), m_route(route)
+{
+	for (auto &histogram : m_histograms)
+		histogram.store(nullptr);
 }
 
 void RestHandler::handle_error(pplx::task<void> &t)
@@ -315,30 +330,41 @@ std::string RestHandler::verifyToken(const HttpRequest &message)
 		return "";
 
 	auto token = getTokenStr(message);
-	auto decoded_token = jwt::decode(token);
-	if (decoded_token.has_payload_claim(HTTP_HEADER_JWT_name))
+	if (token.empty())
 	{
-		// get user info
-		auto userName = decoded_token.get_payload_claim(HTTP_HEADER_JWT_name);
-		auto userObj = Configuration::instance()->getUserInfo(userName.as_string());
-		auto userKey = userObj->getKey();
-
-		// check locked
-		if (userObj->locked())
-			throw std::invalid_argument(Utility::stringFormat("User <%s> was locked", userName.as_string().c_str()));
-
-		// check user token
-		auto verifier = jwt::verify()
-							.allow_algorithm(jwt::algorithm::hs256{userKey})
-							.with_issuer(HTTP_HEADER_JWT_ISSUER)
-							.with_claim(HTTP_HEADER_JWT_name, userName);
-		verifier.verify(decoded_token);
-
-		return std::move(userName.as_string());
+		throw AuthenticationError("Authentication token is required");
 	}
-	else
+	try
 	{
-		throw std::invalid_argument("No user info in token");
+		auto decoded_token = jwt::decode(token);
+		if (decoded_token.has_payload_claim(HTTP_HEADER_JWT_name))
+		{
+			// get user info
+			auto userName = decoded_token.get_payload_claim(HTTP_HEADER_JWT_name);
+			auto userObj = Configuration::instance()->getUserInfo(userName.as_string());
+			auto userKey = userObj->getKey();
+
+			// check locked
+			if (userObj->locked())
+				throw std::invalid_argument(Utility::stringFormat("User <%s> was locked", userName.as_string().c_str()));
+
+			// check user token
+			auto verifier = jwt::verify()
+								.allow_algorithm(jwt::algorithm::hs256{userKey})
+								.with_issuer(HTTP_HEADER_JWT_ISSUER)
+								.with_claim(HTTP_HEADER_JWT_name, userName);
+			verifier.verify(decoded_token);
+
+			return std::move(userName.as_string());
+		}
+		else
+		{
+			throw std::invalid_argument("No user info in token");
+		}
+	}
+	catch (const std::exception &e)
+	{
+		throw AuthenticationError(e.what());
 	}
 }
 
@@ -377,7 +403,7 @@ bool RestHandler::permissionCheck(const HttpRequest &message, const std::string
 		else
 		{
 			LOG_WAR << fname << "No such permission " << permission << " for user " << userName;
-			throw std::invalid_argument(Utility::stringFormat("No permission <%s> for user <%s>", permission.c_str(), userName.c_str()));
+			throw AuthenticationError(Utility::stringFormat("No permission <%s> for user <%s>", permission.c_str(), userName.c_str()));
 		}
 	}
 	else
@@ -520,15 +546,47 @@ void RestHandler::apiFileDownload(const HttpRequest &message)
 
 	LOG_DBG << fname << "Downloading file <" << file << ">";
 
+	if (message.sendFileSupported())
+	{
+		// asio transport send file by sendfile() and evaluate Range itself
+		web::http::http_response resp(status_codes::OK);
+		resp.headers().add(HTTP_HEADER_KEY_send_file, file);
+		resp.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(file));
+		resp.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(file));
+		message.reply(resp).then([this](pplx::task<void> t) { this->handle_error(t); });
+		return;
+	}
+
 	concurrency::streams::fstream::open_istream(file, std::ios::in | std::ios::binary).then([=](concurrency::streams::istream fileStream) {
-																						  // Get the content length, which is used to set the
-																						  // Content-Length property
-																						  fileStream.seek(0, std::ios::end);
-																						  auto length = static_cast<std::size_t>(fileStream.tell());
-																						  fileStream.seek(0, std::ios::beg);
-
-																						  web::http::http_response resp(status_codes::OK);
-																						  resp.set_body(fileStream, length);
+																						  struct stat st;
+																						  if (::stat(file.c_str(), &st) != 0)
+																						  {
+																							  fileStream.close();
+																							  throw std::runtime_error("failed to stat file");
+																						  }
+																						  // single byte range for resumed download
+																						  std::string range, ifRange;
+																						  const bool hasRange = message.headers().match(header_names::range, range);
+																						  const bool hasIfRange = message.headers().match(header_names::if_range, ifRange);
+																						  const auto etag = HttpFileRange::etag(st);
+																						  const auto fileRange = HttpFileRange::parse(hasRange ? &range : nullptr, hasIfRange ? &ifRange : nullptr, etag, st.st_size);
+
+																						  web::http::http_response resp(fileRange.m_status);
+																						  if (fileRange.m_status == status_codes::RangeNotSatisfiable)
+																						  {
+																							  fileStream.close();
+																						  }
+																						  else
+																						  {
+																							  fileStream.seek(fileRange.m_offset, std::ios::beg);
+																							  resp.set_body(fileStream, fileRange.m_length);
+																						  }
+																						  if (fileRange.m_status != status_codes::OK)
+																						  {
+																							  resp.headers().add(header_names::content_range, fileRange.contentRange());
+																						  }
+																						  resp.headers().add(header_names::etag, etag);
+																						  resp.headers().add(header_names::accept_ranges, "bytes");
 																						  resp.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(file));
 																						  resp.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(file));
 																						  message.reply(resp).then([this](pplx::task<void> t) { this->handle_error(t); });
@@ -565,33 +623,180 @@ void RestHandler::apiFileUpload(const HttpRequest &message)
 
 	LOG_DBG << fname << "Uploading file <" << file << ">";
 
-	concurrency::streams::file_stream<uint8_t>::open_ostream(file, std::ios::out | std::ios::binary | std::ios::trunc)
-		.then([=](concurrency::streams::ostream os) {
-			message.body().read_to_end(os.streambuf()).then([=](pplx::task<std::size_t> t) {
-				os.close();
-				if (message.headers().has(HTTP_HEADER_KEY_file_mode))
-				{
-					os::fileChmod(file, std::stoi(message.headers().find(HTTP_HEADER_KEY_file_mode)->second));
-				}
-				if (message.headers().has(HTTP_HEADER_KEY_file_user))
-				{
-					os::chown(file, message.headers().find(HTTP_HEADER_KEY_file_user)->second);
-				}
-				message.reply(status_codes::OK, "Success").then([=](pplx::task<void> t) { this->handle_error(t); });
-			});
-		})
-		.then([=](pplx::task<void> t) {
-			try
-			{
-				t.get();
-			}
-			catch (...)
-			{
-				// opening the file (open_istream) failed.
-				// Reply with an error.
-				message.reply(status_codes::InternalError, "Failed to write file in server").then([this](pplx::task<void> t) { this->handle_error(t); });
-			}
-		});
+	if (!message.headers().has(header_names::content_length) && message.headers().has(header_names::transfer_encoding))
+	{
+		message.reply(status_codes::LengthRequired, "Content-Length header required");
+		return;
+	}
+
+	// body is written by pieces to a temporary file and renamed to target, broken upload does not leave partial file
+	FileUpload upload(Utility::createUUID(), getTokenUser(message), file, message.headers().content_length());
+	upload.open(getFileUploadMode(message), getFileUploadUser(message));
+	upload.write(0, getFileUploadReader(message), upload.fileSize(), nullptr);
+	upload.commit();
+	message.reply(status_codes::OK, "Success");
+}
+
+void RestHandler::apiFileUploadCreate(const HttpRequest &message)
+{
+	permissionCheck(message, PERMISSION_KEY_file_upload);
+	if (!message.headers().has(HTTP_HEADER_KEY_file_path) || !message.headers().has(HTTP_HEADER_KEY_file_size))
+	{
+		message.reply(status_codes::BadRequest, "FilePath and FileSize header required");
+		return;
+	}
+	auto file = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_path))->second);
+	auto size = std::stoull(message.headers().find(U(HTTP_HEADER_KEY_file_size))->second);
+	if (Utility::isFileExist(file))
+	{
+		message.reply(status_codes::Forbidden, "file already exist");
+		return;
+	}
+
+	auto upload = m_fileUploads->create(getTokenUser(message), file, size, getFileUploadMode(message), getFileUploadUser(message));
+	auto result = web::json::value::object();
+	result[JSON_KEY_UPLOAD_id] = web::json::value::string(upload->id());
+	result[JSON_KEY_UPLOAD_file_path] = web::json::value::string(upload->filePath());
+	result[JSON_KEY_UPLOAD_file_size] = web::json::value::number(upload->fileSize());
+	message.reply(status_codes::OK, result);
+}
+
+void RestHandler::apiFileUploadChunk(const HttpRequest &message)
+{
+	permissionCheck(message, PERMISSION_KEY_file_upload);
+	auto upload = getFileUpload(message);
+	if (upload == nullptr)
+	{
+		message.reply(status_codes::NotFound, "upload not found");
+		return;
+	}
+	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
+	if (querymap.find(U(HTTP_QUERY_KEY_offset)) == querymap.end() || !message.headers().has(HTTP_HEADER_KEY_chunk_crc32))
+	{
+		message.reply(status_codes::BadRequest, "offset query and ChunkCRC32 header required");
+		return;
+	}
+	if (message.headers().content_length() > FILE_UPLOAD_MAX_CHUNK_BYTES)
+	{
+		message.reply(status_codes::RequestEntityTooLarge, Utility::stringFormat("chunk size exceed <%llu> bytes", FILE_UPLOAD_MAX_CHUNK_BYTES));
+		return;
+	}
+	auto offset = std::stoull(GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_offset))->second));
+	auto crc32 = std::stoul(GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_chunk_crc32))->second), nullptr, 16);
+
+	// Content-Length is not trusted, read bytes are limited
+	const auto chunkCrc32 = static_cast<uint32_t>(crc32);
+	// received ranges are saved even chunk failed, so resume after restart does not trust overwritten bytes
+	std::shared_ptr<FileUploadManager> saveGuard(m_fileUploads.get(), [](FileUploadManager *uploads) { uploads->save(); });
+	try
+	{
+		upload->write(offset, getFileUploadReader(message), FILE_UPLOAD_MAX_CHUNK_BYTES, &chunkCrc32);
+	}
+	catch (const std::length_error &e)
+	{
+		message.reply(status_codes::RequestEntityTooLarge, e.what());
+		return;
+	}
+	message.reply(status_codes::OK);
+}
+
+void RestHandler::apiFileUploadStatus(const HttpRequest &message)
+{
+	permissionCheck(message, PERMISSION_KEY_file_upload);
+	auto upload = getFileUpload(message);
+	if (upload == nullptr)
+	{
+		message.reply(status_codes::NotFound, "upload not found");
+		return;
+	}
+	const auto ranges = upload->receivedRanges();
+	auto result = web::json::value::object();
+	auto rangesJson = web::json::value::array(ranges.size());
+	for (std::size_t i = 0; i < ranges.size(); i++)
+	{
+		// [offset, end)
+		auto range = web::json::value::array(2);
+		range[0] = web::json::value::number(ranges[i].first);
+		range[1] = web::json::value::number(ranges[i].second);
+		rangesJson[i] = range;
+	}
+	result[JSON_KEY_UPLOAD_id] = web::json::value::string(upload->id());
+	result[JSON_KEY_UPLOAD_file_path] = web::json::value::string(upload->filePath());
+	result[JSON_KEY_UPLOAD_file_size] = web::json::value::number(upload->fileSize());
+	result[JSON_KEY_UPLOAD_received] = web::json::value::number(upload->receivedBytes());
+	result[JSON_KEY_UPLOAD_ranges] = rangesJson;
+	message.reply(status_codes::OK, result);
+}
+
+void RestHandler::apiFileUploadCommit(const HttpRequest &message)
+{
+	permissionCheck(message, PERMISSION_KEY_file_upload);
+	auto upload = getFileUpload(message);
+	if (upload == nullptr)
+	{
+		message.reply(status_codes::NotFound, "upload not found");
+		return;
+	}
+	upload->commit();
+	m_fileUploads->remove(upload->id(), upload->user());
+	message.reply(status_codes::OK, "Success");
+}
+
+void RestHandler::apiFileUploadCancel(const HttpRequest &message)
+{
+	permissionCheck(message, PERMISSION_KEY_file_upload);
+	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
+	auto uploadId = Utility::splitString(path, "/").back();
+	if (!m_fileUploads->remove(uploadId, getTokenUser(message)))
+	{
+		message.reply(status_codes::NotFound, "upload not found");
+		return;
+	}
+	message.reply(status_codes::OK);
+}
+
+std::shared_ptr<FileUpload> RestHandler::getFileUpload(const HttpRequest &message)
+{
+	// /appmesh/file/upload/session/<id>[/commit]
+	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
+	auto vec = Utility::splitString(path, "/");
+	const auto pos = std::find(vec.begin(), vec.end(), "session");
+	if (pos == vec.end() || pos + 1 == vec.end())
+	{
+		return nullptr;
+	}
+	return m_fileUploads->get(*(pos + 1), getTokenUser(message));
+}
+
+int RestHandler::getFileUploadMode(const HttpRequest &message) const
+{
+	if (message.headers().has(HTTP_HEADER_KEY_file_mode))
+	{
+		return std::stoi(message.headers().find(HTTP_HEADER_KEY_file_mode)->second);
+	}
+	return 0;
+}
+
+std::string RestHandler::getFileUploadUser(const HttpRequest &message) const
+{
+	if (message.headers().has(HTTP_HEADER_KEY_file_user))
+	{
+		return message.headers().find(HTTP_HEADER_KEY_file_user)->second;
+	}
+	return std::string();
+}
+
+std::function<std::size_t(char *buffer, std::size_t size)> RestHandler::getFileUploadReader(const HttpRequest &message) const
+{
+	// body streamed by transport is not buffered in request
+	if (message.bodyReader())
+		return message.bodyReader();
+	auto body = message.body();
+	return [body](char *buffer, std::size_t size) -> std::size_t {
+		if (!body.is_valid())
+			return 0;
+		return body.streambuf().getn(reinterpret_cast<uint8_t *>(buffer), size).get();
+	};
 }
 
 void RestHandler::apiGetLabels(const HttpRequest &message)
@@ -934,7 +1139,7 @@ void RestHandler::apiHealth(const HttpRequest &message)
 
 void RestHandler::apiMetrics(const HttpRequest &message)
 {
-	message.reply(status_codes::OK, PrometheusRest::instance()->collectData(), "text/plain; version=0.0.4");
+	PrometheusRest::instance()->replyMetrics(message);
 }
 
 void RestHandler::apiLogin(const HttpRequest &message)
@@ -1198,26 +1403,36 @@ void RestHandler::initMetrics(std::shared_ptr<PrometheusRest> prom)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
-	// clean
-	m_restGetCounter = nullptr;
-	m_restPutCounter = nullptr;
-	m_restDelCounter = nullptr;
-	m_restPostCounter = nullptr;
-
-	// update
-	if (prom)
-	{
-		m_restGetCounter = prom->createPromCounter(
-			PROM_METRIC_NAME_appmesh_http_request_count, PROM_METRIC_HELP_appmesh_http_request_count,
-			{{"method", "GET"}, {"listen", m_listenAddress}});
-		m_restPutCounter = prom->createPromCounter(
-			PROM_METRIC_NAME_appmesh_http_request_count, PROM_METRIC_HELP_appmesh_http_request_count,
-			{{"method", "PUT"}, {"listen", m_listenAddress}});
-		m_restDelCounter = prom->createPromCounter(
-			PROM_METRIC_NAME_appmesh_http_request_count, PROM_METRIC_HELP_appmesh_http_request_count,
-			{{"method", "DELETE"}, {"listen", m_listenAddress}});
-		m_restPostCounter = prom->createPromCounter(
-			PROM_METRIC_NAME_appmesh_http_request_count, PROM_METRIC_HELP_appmesh_http_request_count,
-			{{"method", "POST"}, {"listen", m_listenAddress}});
+	// REST threads may still hold the old counters, they are released by the last holder
+	auto publish = [this, &prom](std::shared_ptr<CounterPtr> &counter, const std::string &method) {
+		std::shared_ptr<CounterPtr> metric;
+		if (prom)
+		{
+			// incremented by all REST threads
+			metric = prom->createPromCounter(
+				PROM_METRIC_NAME_appmesh_http_request_count, PROM_METRIC_HELP_appmesh_http_request_count,
+				{{"method", method}, {"listen", m_listenAddress}}, true);
+		}
+		std::atomic_store(&counter, metric);
+	};
+	publish(m_restGetCounter, "GET");
+	publish(m_restPutCounter, "PUT");
+	publish(m_restDelCounter, "DELETE");
+	publish(m_restPostCounter, "POST");
+
+	// latency histograms are re-created with new exporter on next request
+	for (const auto &route : m_routeLatency)
+	{
+		for (auto &histogram : route.second->m_histograms)
+			histogram.store(nullptr, std::memory_order_release);
 	}
+	m_prom = prom;
+	m_latencyEnabled = (std::atomic_load(&m_restGetCounter) != nullptr);
+}
+
+void RestHandler::increaseCounter(const std::shared_ptr<CounterPtr> &counter)
+{
+	const auto metric = std::atomic_load(&counter);
+	if (metric)
+		metric->metric().Increment();
 }
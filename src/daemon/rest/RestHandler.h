@@ -1,14 +1,35 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <functional>
+#include <map>
+#include <stdexcept>
+#include <vector>
 #include <cpprest/http_listener.h> // HTTP server
 #include "../../common/HttpRequest.h"
 
 class CounterPtr;
+class FileUpload;
+class FileUploadManager;
+class HistogramPtr;
 class PrometheusRest;
+class RestTransport;
 class Application;
 class HttpRequest;
+
+//////////////////////////////////////////////////////////////////////////
+/// Token or permission check failed, replied as 401 before handler run,
+/// so client can send the request again with another token
+//////////////////////////////////////////////////////////////////////////
+class AuthenticationError : public std::invalid_argument
+{
+public:
+	explicit AuthenticationError(const std::string &what) : std::invalid_argument(what) {}
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// REST service
 //////////////////////////////////////////////////////////////////////////
@@ -19,13 +40,17 @@ public:
 	virtual ~RestHandler();
 
 	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+	/// Serve REST on Unix domain socket file as well, local peer is authorized by its uid
+	void openLocalSocket(const std::string &socketPath);
+	static std::string createToken(const std::string &uname, const std::string &passwd, int timeoutSeconds);
 
 protected:
 	void open();
 	void close();
 
 private:
-	void handleRest(const http_request &message, const std::map<std::string, std::function<void(const HttpRequest &)>> &restFunctions);
+	void dispatch(const HttpRequest &message);
+	void handleRest(const HttpRequest &message, const std::map<std::string, std::function<void(const HttpRequest &)>> &restFunctions);
 	void bindRestMethod(web::http::method method, std::string path, std::function<void(const HttpRequest &)> func);
 	void handle_get(const HttpRequest &message);
 	void handle_put(const HttpRequest &message);
@@ -33,14 +58,20 @@ private:
 	void handle_delete(const HttpRequest &message);
 	void handle_options(const HttpRequest &message);
 	void handle_error(pplx::task<void> &t);
+	static void increaseCounter(const std::shared_ptr<CounterPtr> &counter);
+	void observeLatency(const std::string &method, const std::string &path, const HttpRequest &request, const std::chrono::steady_clock::time_point &start);
 
 	std::string verifyToken(const HttpRequest &message);
 	std::string getTokenUser(const HttpRequest &message);
 	bool permissionCheck(const HttpRequest &message, const std::string &permission);
 	void checkAppAccessPermission(const HttpRequest &message, const std::string &appName, bool requestWrite);
 	std::string getTokenStr(const HttpRequest &message);
-	std::string createToken(const std::string &uname, const std::string &passwd, int timeoutSeconds);
 	int getHttpQueryValue(const HttpRequest &message, const std::string &key, int defaultValue, int min, int max) const;
+	std::shared_ptr<FileUpload> getFileUpload(const HttpRequest &message);
+	int getFileUploadMode(const HttpRequest &message) const;
+	std::string getFileUploadUser(const HttpRequest &message) const;
+	// FileUpload::Reader of request body, body is read as received
+	std::function<std::size_t(char *buffer, std::size_t size)> getFileUploadReader(const HttpRequest &message) const;
 
 	void apiLogin(const HttpRequest &message);
 	void apiAuth(const HttpRequest &message);
@@ -58,6 +89,11 @@ private:
 	void apiDeleteApp(const HttpRequest &message);
 	void apiFileDownload(const HttpRequest &message);
 	void apiFileUpload(const HttpRequest &message);
+	void apiFileUploadCreate(const HttpRequest &message);
+	void apiFileUploadChunk(const HttpRequest &message);
+	void apiFileUploadStatus(const HttpRequest &message);
+	void apiFileUploadCommit(const HttpRequest &message);
+	void apiFileUploadCancel(const HttpRequest &message);
 	void apiGetLabels(const HttpRequest &message);
 	void apiAddLabel(const HttpRequest &message);
 	void apiDeleteLabel(const HttpRequest &message);
@@ -80,7 +116,8 @@ private:
 
 private:
 	std::string m_listenAddress;
-	std::unique_ptr<web::http::experimental::listener::http_listener> m_listener;
+	std::unique_ptr<RestTransport> m_transport;
+	std::unique_ptr<RestTransport> m_localTransport;
 	// API functions
 	std::map<std::string, std::function<void(const HttpRequest &)>> m_restGetFunctions;
 	std::map<std::string, std::function<void(const HttpRequest &)>> m_restPutFunctions;
@@ -89,10 +126,26 @@ private:
 
 	std::recursive_mutex m_mutex;
 
-	// prometheus
-	std::shared_ptr<CounterPtr> m_promScrapeCounter;
+	// prometheus, request counters are accessed by atomic_load()/atomic_store() without m_mutex,
+	// replaced counter (and its registry) is released after the last request using it
 	std::shared_ptr<CounterPtr> m_restGetCounter;
 	std::shared_ptr<CounterPtr> m_restPutCounter;
 	std::shared_ptr<CounterPtr> m_restDelCounter;
 	std::shared_ptr<CounterPtr> m_restPostCounter;
+	// request latency histograms of each route, indexed by status class (1xx~5xx),
+	// index 0 for request replied after handler return, created on first request
+	struct RouteLatency
+	{
+		explicit RouteLatency(const std::string &method, const std::string &route);
+		const std::string m_method;
+		const std::string m_route;
+		std::array<std::atomic<HistogramPtr *>, 6> m_histograms;
+	};
+	// "METHOD path" -> latency, built when bind REST method and not changed after
+	std::map<std::string, std::unique_ptr<RouteLatency>> m_routeLatency;
+	std::vector<std::shared_ptr<HistogramPtr>> m_restHistograms;
+	std::weak_ptr<PrometheusRest> m_prom;
+	// chunked uploads in progress
+	std::shared_ptr<FileUploadManager> m_fileUploads;
+	std::atomic<bool> m_latencyEnabled;
 };
@@ -0,0 +1,387 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
+#include <cpprest/containerstream.h>
+#include <cpprest/http_listener.h> // HTTP server
+
+#include "../Configuration.h"
+#include "../security/User.h"
+#include "HttpServer.h"
+#include "RestHandler.h"
+#include "RestTransport.h"
+#include "SslTicketKeys.h"
+#include "../../common/HttpRequest.h"
+#include "../../common/Utility.h"
+
+std::unique_ptr<RestTransport> RestTransport::create(const std::string &ipaddress, int port, Handler handler)
+{
+	if (Configuration::instance()->getRest()->m_httpTransport == HTTP_TRANSPORT_ASIO)
+	{
+		return std::unique_ptr<RestTransport>(new AsioTransport(ipaddress, port, handler));
+	}
+	return std::unique_ptr<RestTransport>(new CpprestTransport(ipaddress, port, handler));
+}
+
+std::unique_ptr<RestTransport> RestTransport::createLocal(const std::string &socketPath, Handler handler)
+{
+	return std::unique_ptr<RestTransport>(new AsioTransport(socketPath, handler));
+}
+
+void RestTransport::initSslContext(boost::asio::ssl::context &ctx)
+{
+	boost::system::error_code ec;
+
+	ctx.set_options(boost::asio::ssl::context::default_workarounds |
+						boost::asio::ssl::context::no_sslv2 |
+						boost::asio::ssl::context::no_sslv3 |
+						boost::asio::ssl::context::no_tlsv1 |
+						boost::asio::ssl::context::no_tlsv1_1 |
+						boost::asio::ssl::context::single_dh_use,
+					ec);
+	// LOG_DBG << "lambda::set_options " << ec.value() << " " << ec.message();
+
+	ctx.use_certificate_chain_file(Configuration::instance()->getSSLCertificateFile(), ec);
+	// LOG_DBG << "lambda::use_certificate_chain_file " << ec.value() << " " << ec.message();
+
+	ctx.use_private_key_file(Configuration::instance()->getSSLCertificateKeyFile(), boost::asio::ssl::context::pem, ec);
+	// LOG_DBG << "lambda::use_private_key " << ec.value() << " " << ec.message();
+
+	// Enable ECDH cipher
+	if (!SSL_CTX_set_ecdh_auto(ctx.native_handle(), 1))
+	{
+		LOG_WAR << "SSL_CTX_set_ecdh_auto  failed: " << std::strerror(errno);
+	}
+	// auto ciphers = "ALL:!RC4:!SSLv2:+HIGH:!MEDIUM:!LOW";
+	auto ciphers = "HIGH:!aNULL:!eNULL:!kECDH:!aDH:!RC4:!3DES:!CAMELLIA:!MD5:!PSK:!SRP:!KRB5:@STRENGTH";
+	if (!SSL_CTX_set_cipher_list(ctx.native_handle(), ciphers))
+	{
+		LOG_WAR << "SSL_CTX_set_cipher_list failed: " << std::strerror(errno);
+	}
+	SSL_CTX_clear_options(ctx.native_handle(), SSL_OP_ALLOW_UNSAFE_LEGACY_RENEGOTIATION);
+
+	// Session resumption, reconnecting clients skip full handshake
+	const auto ssl = Configuration::instance()->getRest()->m_ssl;
+	static const unsigned char sessionIdContext[] = "appmesh";
+	SSL_CTX_set_session_id_context(ctx.native_handle(), sessionIdContext, sizeof(sessionIdContext) - 1);
+	SSL_CTX_set_timeout(ctx.native_handle(), ssl->m_sessionTimeoutSeconds);
+	if (ssl->m_sessionCacheSize > 0)
+	{
+		SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_SERVER);
+		SSL_CTX_sess_set_cache_size(ctx.native_handle(), ssl->m_sessionCacheSize);
+	}
+	else
+	{
+		SSL_CTX_set_session_cache_mode(ctx.native_handle(), SSL_SESS_CACHE_OFF);
+	}
+	if (ssl->m_sessionTicketEnabled)
+	{
+		SslTicketKeys::instance(ssl->m_sessionTicketRotateSeconds).install(ctx.native_handle());
+	}
+	else
+	{
+		SSL_CTX_set_options(ctx.native_handle(), SSL_OP_NO_TICKET);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// CpprestTransport
+//////////////////////////////////////////////////////////////////////////
+CpprestTransport::CpprestTransport(const std::string &ipaddress, int port, Handler handler)
+{
+	const static char fname[] = "CpprestTransport::CpprestTransport() ";
+
+	// Construct URI
+	web::uri_builder uri;
+	uri.set_host(ipaddress);
+	uri.set_port(port);
+	uri.set_path("/");
+	if (Configuration::instance()->getSslEnabled())
+	{
+		if (!Utility::isFileExist(Configuration::instance()->getSSLCertificateFile()) ||
+			!Utility::isFileExist(Configuration::instance()->getSSLCertificateKeyFile()))
+		{
+			LOG_ERR << fname << "server.crt and server.key not exist";
+		}
+		// Support SSL
+		uri.set_scheme("https");
+		static bool sslContextCreated = false;
+		static auto server_config = new web::http::experimental::listener::http_listener_config();
+		if (!sslContextCreated)
+		{
+			sslContextCreated = true;
+			server_config->set_ssl_context_callback(&RestTransport::initSslContext);
+		}
+		m_listener = std::make_unique<web::http::experimental::listener::http_listener>(uri.to_uri(), *server_config);
+	}
+	else
+	{
+		uri.set_scheme("http");
+		m_listener = std::make_unique<web::http::experimental::listener::http_listener>(uri.to_uri());
+	}
+	// all methods go to one handler, method is routed by REST handler
+	m_listener->support(handler);
+}
+
+CpprestTransport::~CpprestTransport()
+{
+}
+
+void CpprestTransport::open()
+{
+	m_listener->open().wait();
+}
+
+void CpprestTransport::close()
+{
+	m_listener->close(); // .wait();
+}
+
+std::string CpprestTransport::url() const
+{
+	return GET_STD_STRING(m_listener->uri().to_string());
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// AsioTransport
+//////////////////////////////////////////////////////////////////////////
+AsioTransport::AsioTransport(const std::string &ipaddress, int port, Handler handler)
+	: m_handler(handler)
+{
+	const static char fname[] = "AsioTransport::AsioTransport() ";
+
+	HttpServerOptions options;
+	initOptions(options);
+	options.m_address = ipaddress;
+	options.m_port = port;
+	if (Configuration::instance()->getSslEnabled())
+	{
+		if (!Utility::isFileExist(Configuration::instance()->getSSLCertificateFile()) ||
+			!Utility::isFileExist(Configuration::instance()->getSSLCertificateKeyFile()))
+		{
+			LOG_ERR << fname << "server.crt and server.key not exist";
+		}
+		options.m_sslContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23_server);
+		initSslContext(*options.m_sslContext);
+	}
+	m_url = Utility::stringFormat("%s://%s:%d/", options.m_sslContext ? "https" : "http", ipaddress.c_str(), port);
+	m_server.reset(new HttpServer(options, std::bind(&AsioTransport::handle, this, std::placeholders::_1)));
+}
+
+AsioTransport::AsioTransport(const std::string &socketPath, Handler handler)
+	: m_handler(handler)
+{
+	HttpServerOptions options;
+	initOptions(options);
+	options.m_localSocketPath = socketPath;
+	options.m_localSocketGroup = Configuration::instance()->getRestListenSocketGroup();
+	m_url = "unix://" + socketPath;
+	m_server.reset(new HttpServer(options, std::bind(&AsioTransport::handle, this, std::placeholders::_1)));
+}
+
+AsioTransport::~AsioTransport()
+{
+	close();
+}
+
+void AsioTransport::open()
+{
+	m_server->open();
+}
+
+void AsioTransport::close()
+{
+	m_server->close();
+}
+
+std::string AsioTransport::url() const
+{
+	return m_url;
+}
+
+void AsioTransport::initOptions(HttpServerOptions &options)
+{
+	const auto rest = Configuration::instance()->getRest();
+	options.m_ioThreads = rest->m_httpIoThreads;
+	options.m_handlerThreads = rest->m_httpThreadPoolSize;
+	options.m_maxConcurrentRequests = rest->m_httpMaxConcurrentRequests;
+	options.m_requestQueueDepth = rest->m_httpRequestQueueDepth;
+	options.m_keepAliveSeconds = rest->m_httpKeepAliveSeconds;
+	options.m_keepAliveMaxRequests = rest->m_httpKeepAliveMaxRequests;
+	options.m_maxBodyBytes = rest->m_httpMaxBodyBytes;
+	// file upload is written to file by pieces, its body is not buffered
+	options.m_streamBody = [](const HttpServerRequest &request) {
+		return (request.m_method == web::http::methods::POST || request.m_method == web::http::methods::PUT) &&
+			   boost::starts_with(request.m_target, "/appmesh/file/upload");
+	};
+}
+
+std::string AsioTransport::peerToken(int uid)
+{
+	const static char fname[] = "AsioTransport::peerToken() ";
+
+	// root is admin, other OS users are authorized only by configured uid mapping
+	const auto userName = (uid == 0) ? std::string(JWT_ADMIN_NAME) : Configuration::instance()->getRestListenSocketUser(uid);
+	if (userName.empty())
+		return std::string();
+	try
+	{
+		auto user = Configuration::instance()->getUserInfo(userName);
+		return RestHandler::createToken(userName, user->getKey(), PEER_TOKEN_EXPIRE_SECONDS);
+	}
+	catch (const std::exception &e)
+	{
+		LOG_DBG << fname << "local peer uid <" << uid << "> not mapped: " << e.what();
+	}
+	return std::string();
+}
+
+void AsioTransport::attachFile(const HttpServerRequest &request, HttpServerResponse &response, const std::string &path)
+{
+	const static char fname[] = "AsioTransport::attachFile() ";
+
+	struct stat st;
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		LOG_WAR << fname << "failed to open file <" << path << ">: " << std::strerror(errno);
+		if (fd >= 0)
+			::close(fd);
+		response.m_status = web::http::status_codes::InternalError;
+		response.m_headers.clear();
+		response.m_body = "Failed to open file in server";
+		return;
+	}
+	const auto etag = HttpFileRange::etag(st);
+	const auto range = HttpFileRange::parse(request.header(web::http::header_names::range), request.header(web::http::header_names::if_range), etag, st.st_size);
+	response.m_status = range.m_status;
+	response.m_reason.clear();
+	response.m_headers.emplace_back(web::http::header_names::etag, etag);
+	response.m_headers.emplace_back(web::http::header_names::accept_ranges, "bytes");
+	if (range.m_status != web::http::status_codes::OK)
+	{
+		response.m_headers.emplace_back(web::http::header_names::content_range, range.contentRange());
+	}
+	if (range.m_status == web::http::status_codes::RangeNotSatisfiable)
+	{
+		::close(fd);
+		return;
+	}
+	response.m_file = std::make_shared<HttpServerFile>(fd, range.m_offset, range.m_length);
+}
+
+void AsioTransport::handle(const std::shared_ptr<HttpExchange> &exchange)
+{
+	const static char fname[] = "AsioTransport::handle() ";
+
+	auto &request = exchange->request();
+	web::http::http_request message(web::http::method(request.m_method));
+	try
+	{
+		message.set_request_uri(web::uri(request.m_target));
+	}
+	catch (const std::exception &e)
+	{
+		LOG_WAR << fname << "invalid request target <" << request.m_target << ">: " << e.what();
+		HttpServerResponse response;
+		response.m_status = web::http::status_codes::BadRequest;
+		response.m_body = e.what();
+		exchange->reply(std::move(response));
+		return;
+	}
+	// set_body() add its own Content-Type, so set body before request headers
+	const auto bodySize = request.m_body.size();
+	if (bodySize)
+	{
+		message.set_body(std::move(request.m_body));
+	}
+	message.headers().clear();
+	for (const auto &header : request.m_headers)
+	{
+		// buffered body is de-chunked by server, streamed body keep its framing headers
+		if (!request.m_bodyStream && (boost::iequals(header.first, web::http::header_names::transfer_encoding) || boost::iequals(header.first, web::http::header_names::content_length)))
+			continue;
+		message.headers().add(header.first, header.second);
+	}
+	if (bodySize)
+	{
+		message.headers().set_content_length(bodySize);
+	}
+	message._get_impl()->_set_remote_address(request.m_remoteAddress);
+	// local peer without token is authorized as the App Mesh user mapped from its uid
+	if (request.m_peerUid >= 0 && !message.headers().has(HTTP_HEADER_JWT_Authorization) && Configuration::instance()->getJwtEnabled())
+	{
+		const auto token = peerToken(request.m_peerUid);
+		if (token.length())
+			message.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + token);
+	}
+	// body is fully received, extract_json() and extract_string() wait for this
+	message._get_impl()->_complete(bodySize);
+
+	// REST handler reply synchronously or later from other threads, response is
+	// taken when replied, not replied request is canceled when released
+	message.get_response().then([exchange](pplx::task<web::http::http_response> task) {
+		auto result = std::make_shared<HttpServerResponse>();
+		web::http::http_response response;
+		try
+		{
+			response = task.get();
+		}
+		catch (...)
+		{
+			result->m_status = web::http::status_codes::InternalError;
+			exchange->reply(std::move(*result));
+			return;
+		}
+		result->m_status = response.status_code();
+		result->m_reason = GET_STD_STRING(response.reason_phrase());
+		std::string sendFile;
+		for (const auto &header : response.headers())
+		{
+			if (boost::iequals(header.first, HTTP_HEADER_KEY_send_file))
+				sendFile = GET_STD_STRING(header.second);
+			else
+				result->m_headers.emplace_back(GET_STD_STRING(header.first), GET_STD_STRING(header.second));
+		}
+		if (sendFile.length())
+		{
+			attachFile(exchange->request(), *result, sendFile);
+			exchange->reply(std::move(*result));
+			return;
+		}
+		auto body = response.body();
+		if (!body.is_valid())
+		{
+			exchange->reply(std::move(*result));
+			return;
+		}
+		// body is read to memory, file stream body included
+		concurrency::streams::container_buffer<std::string> buffer;
+		body.read_to_end(buffer).then([exchange, result, buffer](pplx::task<std::size_t> readTask) mutable {
+			try
+			{
+				readTask.get();
+				result->m_body = std::move(buffer.collection());
+			}
+			catch (const std::exception &e)
+			{
+				result->m_status = web::http::status_codes::InternalError;
+				result->m_headers.clear();
+				result->m_body = e.what();
+			}
+			exchange->reply(std::move(*result));
+		});
+	});
+
+	// send file capability is passed out of band, client can not set it by header
+	HttpRequest httpRequest(message);
+	httpRequest.setSendFileSupported(true);
+	if (request.m_bodyStream)
+	{
+		auto bodyStream = request.m_bodyStream;
+		httpRequest.setBodyReader([bodyStream](char *buffer, std::size_t size) { return bodyStream->read(buffer, size); });
+	}
+	m_handler(httpRequest);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio/ssl.hpp>
+#include <cpprest/http_listener.h> // HTTP server
+
+class HttpExchange;
+class HttpRequest;
+class HttpServer;
+struct HttpServerOptions;
+struct HttpServerRequest;
+struct HttpServerResponse;
+//////////////////////////////////////////////////////////////////////////
+/// HTTP server carry REST requests, request is delivered as HttpRequest
+/// so REST handlers are not aware of transport
+//////////////////////////////////////////////////////////////////////////
+class RestTransport
+{
+public:
+	typedef std::function<void(const HttpRequest &)> Handler;
+
+	virtual ~RestTransport() {}
+	virtual void open() = 0;
+	virtual void close() = 0;
+	virtual std::string url() const = 0;
+
+	/// Create transport by REST.HttpTransport configuration
+	static std::unique_ptr<RestTransport> create(const std::string &ipaddress, int port, Handler handler);
+	/// Create Unix domain socket transport, always served by asio server
+	static std::unique_ptr<RestTransport> createLocal(const std::string &socketPath, Handler handler);
+
+protected:
+	/// Apply certificate, key, protocol and cipher configuration
+	static void initSslContext(boost::asio::ssl::context &ctx);
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// cpprest http_listener, handlers run on crossplat::threadpool
+//////////////////////////////////////////////////////////////////////////
+class CpprestTransport : public RestTransport
+{
+public:
+	CpprestTransport(const std::string &ipaddress, int port, Handler handler);
+	virtual ~CpprestTransport();
+
+	virtual void open() override;
+	virtual void close() override;
+	virtual std::string url() const override;
+
+private:
+	std::unique_ptr<web::http::experimental::listener::http_listener> m_listener;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Asio HttpServer, handlers run on dedicated handler threads
+//////////////////////////////////////////////////////////////////////////
+class AsioTransport : public RestTransport
+{
+public:
+	AsioTransport(const std::string &ipaddress, int port, Handler handler);
+	AsioTransport(const std::string &socketPath, Handler handler);
+	virtual ~AsioTransport();
+
+	virtual void open() override;
+	virtual void close() override;
+	virtual std::string url() const override;
+
+private:
+	static void initOptions(HttpServerOptions &options);
+	/// Token of App Mesh user mapped from local peer uid: root is admin,
+	/// others are mapped by RestListenSocketUsers, empty when not mapped
+	static std::string peerToken(int uid);
+	/// Reply file marked by handler with Range, If-Range and ETag, file is sent by sendfile()
+	static void attachFile(const HttpServerRequest &request, HttpServerResponse &response, const std::string &path);
+	void handle(const std::shared_ptr<HttpExchange> &exchange);
+
+	const Handler m_handler;
+	std::string m_url;
+	std::unique_ptr<HttpServer> m_server;
+};
@@ -0,0 +1,139 @@
+#include <cstring>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
+#include "SslTicketKeys.h"
+#include "../../common/Utility.h"
+
+int SslTicketKeys::m_exDataIndex = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+
+SslTicketKeys::SslTicketKeys(int rotateSeconds)
+	: m_rotatePeriod(rotateSeconds), m_hasCurrent(false), m_hasPrevious(false)
+{
+}
+
+SslTicketKeys &SslTicketKeys::instance(int rotateSeconds)
+{
+	static SslTicketKeys keys(rotateSeconds);
+	return keys;
+}
+
+void SslTicketKeys::install(SSL_CTX *ctx)
+{
+	const static char fname[] = "SslTicketKeys::install() ";
+
+	SSL_CTX_set_ex_data(ctx, m_exDataIndex, this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	const auto result = SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, &SslTicketKeys::ticketCallback);
+#else
+	const auto result = SSL_CTX_set_tlsext_ticket_key_cb(ctx, &SslTicketKeys::ticketCallback);
+#endif
+	if (!result)
+	{
+		LOG_WAR << fname << "set session ticket key callback failed";
+	}
+}
+
+bool SslTicketKeys::rotate()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (m_hasCurrent && now - m_current.m_createTime < m_rotatePeriod)
+		return true;
+
+	TicketKey key;
+	if (RAND_bytes(key.m_name, sizeof(key.m_name)) != 1 ||
+		RAND_bytes(key.m_aesKey, sizeof(key.m_aesKey)) != 1 ||
+		RAND_bytes(key.m_hmacKey, sizeof(key.m_hmacKey)) != 1)
+	{
+		return false;
+	}
+	key.m_createTime = now;
+	// keys are rotated on demand, current key idle over two periods is not kept as previous
+	m_hasPrevious = m_hasCurrent && now - m_current.m_createTime < m_rotatePeriod * 2;
+	if (m_hasPrevious)
+	{
+		m_previous = m_current;
+	}
+	m_current = key;
+	m_hasCurrent = true;
+	return true;
+}
+
+bool SslTicketKeys::currentKey(TicketKey &key)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (!rotate())
+		return false;
+	key = m_current;
+	return true;
+}
+
+bool SslTicketKeys::findKey(const unsigned char *name, TicketKey &key, bool &renew)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	rotate();
+	if (m_hasCurrent && std::memcmp(name, m_current.m_name, sizeof(m_current.m_name)) == 0)
+	{
+		key = m_current;
+		renew = false;
+		return true;
+	}
+	// previous key expires at next rotation, ticket is valid for at most two periods
+	if (m_hasPrevious && std::memcmp(name, m_previous.m_name, sizeof(m_previous.m_name)) == 0)
+	{
+		key = m_previous;
+		renew = true;
+		return true;
+	}
+	return false;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int SslTicketKeys::ticketCallback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherCtx, EVP_MAC_CTX *macCtx, int encrypt)
+#else
+int SslTicketKeys::ticketCallback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherCtx, HMAC_CTX *macCtx, int encrypt)
+#endif
+{
+	auto keys = static_cast<SslTicketKeys *>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), m_exDataIndex));
+	if (keys == nullptr)
+		return -1;
+
+	TicketKey key;
+	bool renew = false;
+	if (encrypt)
+	{
+		if (!keys->currentKey(key) || RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+			return -1;
+		std::memcpy(keyName, key.m_name, sizeof(key.m_name));
+	}
+	else if (!keys->findKey(keyName, key, renew))
+	{
+		// unknown or expired key, fall back to full handshake
+		return 0;
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.m_hmacKey, sizeof(key.m_hmacKey)),
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char *>("SHA256"), 0),
+		OSSL_PARAM_construct_end()};
+	if (!EVP_MAC_CTX_set_params(macCtx, params))
+		return -1;
+#else
+	if (!HMAC_Init_ex(macCtx, key.m_hmacKey, sizeof(key.m_hmacKey), EVP_sha256(), nullptr))
+		return -1;
+#endif
+	if (encrypt)
+	{
+		if (!EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key.m_aesKey, iv))
+			return -1;
+		return 1;
+	}
+	if (!EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key.m_aesKey, iv))
+		return -1;
+	return renew ? 2 : 1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <openssl/ssl.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// TLS session ticket keys shared by all server SSL contexts. A new key
+/// is generated every rotate period, tickets encrypted by the previous
+/// key are still accepted and renewed with the current key.
+//////////////////////////////////////////////////////////////////////////
+class SslTicketKeys
+{
+public:
+	explicit SslTicketKeys(int rotateSeconds);
+	static SslTicketKeys &instance(int rotateSeconds);
+
+	/// Install ticket key callback to a server context
+	void install(SSL_CTX *ctx);
+
+private:
+	friend class SslTicketKeysTest;
+
+	struct TicketKey
+	{
+		unsigned char m_name[16];
+		unsigned char m_aesKey[32];
+		unsigned char m_hmacKey[32];
+		std::chrono::steady_clock::time_point m_createTime;
+	};
+	/// Generate new key when current key expired
+	bool rotate();
+	bool currentKey(TicketKey &key);
+	/// Find key by name, renew is set when ticket should be re-issued by current key
+	bool findKey(const unsigned char *name, TicketKey &key, bool &renew);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	static int ticketCallback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherCtx, EVP_MAC_CTX *macCtx, int encrypt);
+#else
+	static int ticketCallback(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherCtx, HMAC_CTX *macCtx, int encrypt);
+#endif
+
+	const std::chrono::seconds m_rotatePeriod;
+	std::mutex m_mutex;
+	TicketKey m_current;
+	TicketKey m_previous;
+	bool m_hasCurrent;
+	bool m_hasPrevious;
+	static int m_exDataIndex;
+};
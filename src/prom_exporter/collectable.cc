@@ -0,0 +1,27 @@
+#include "collectable.h"
+
+#include "detail/utils.h"
+#include "metric_family.h"
+
+namespace prometheus {
+
+void Collectable::Accept(CollectVisitor& visitor) {
+  std::string labels;
+  for (const auto& family : Collect()) {
+    visitor.BeginFamily(family.name, family.help, family.type);
+    for (const auto& metric : family.metric) {
+      labels.clear();
+      for (const auto& label : metric.label) {
+        if (!labels.empty()) {
+          labels.push_back(',');
+        }
+        labels.append(label.name).append("=\"");
+        detail::append_escaped(labels, label.value);
+        labels.push_back('"');
+      }
+      visitor.Visit(labels, metric);
+    }
+  }
+}
+
+}  // namespace prometheus
@@ -1,14 +1,37 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
+#include "metric_type.h"
 
 namespace prometheus {
+struct ClientMetric;
 struct MetricFamily;
 }
 
 namespace prometheus {
 
+/// @brief Receives metrics from Collectable::Accept() one series at a time,
+/// without building MetricFamily objects.
+class CollectVisitor {
+ public:
+  virtual ~CollectVisitor() = default;
+
+  /// \brief Called once before the series of a family.
+  ///
+  /// \param name Referenced by the visitor until the next BeginFamily().
+  virtual void BeginFamily(const std::string& name, const std::string& help,
+                           MetricType type) = 0;
+
+  /// \brief Called for each series of the current family.
+  ///
+  /// \param labels Prerendered label pairs `name="value",...` without braces,
+  /// empty if the series has no label.
+  /// \param metric Sample of the series, its label list is not used.
+  virtual void Visit(const std::string& labels, const ClientMetric& metric) = 0;
+};
+
 /// @brief Interface implemented by anything that can be used by Prometheus to
 /// collect metrics.
 ///
@@ -19,6 +42,11 @@ class Collectable {
 
   /// \brief Returns a list of metrics and their samples.
   virtual std::vector<MetricFamily> Collect() = 0;
+
+  /// \brief Streams metrics and their samples to the visitor.
+  ///
+  /// The default implementation replays the result of Collect().
+  virtual void Accept(CollectVisitor& visitor);
 };
 
 }  // namespace prometheus
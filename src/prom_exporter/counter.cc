@@ -1,12 +1,61 @@
 #include "counter.h"
 
+#include <cstdint>
+#include <new>
+
 namespace prometheus {
 
-void Counter::Increment() { gauge_.Increment(); }
+constexpr std::size_t Counter::kShards;
+constexpr std::size_t Counter::kCacheLineSize;
+
+Counter::Counter(const bool sharded) {
+  if (!sharded) {
+    return;
+  }
+  shard_storage_.reset(new char[sizeof(Shard) * kShards + kCacheLineSize - 1]);
+  const auto address = reinterpret_cast<std::uintptr_t>(shard_storage_.get());
+  auto aligned = reinterpret_cast<char*>((address + kCacheLineSize - 1) &
+                                         ~(kCacheLineSize - 1));
+  shards_ = reinterpret_cast<Shard*>(aligned);
+  for (std::size_t i = 0; i < kShards; i++) {
+    new (&shards_[i]) Shard();
+  }
+}
+
+std::size_t Counter::ShardIndex() {
+  // Threads are assigned to shards round-robin on their first increment.
+  static std::atomic<std::size_t> next_index{0};
+  static thread_local const std::size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kShards;
+  return index;
+}
+
+void Counter::Increment() { Increment(1.0); }
 
-void Counter::Increment(const double val) { gauge_.Increment(val); }
+void Counter::Increment(const double val) {
+  if (val < 0.0) {
+    return;
+  }
+  if (!shards_) {
+    gauge_.Increment(val);
+    return;
+  }
+  auto& value = shards_[ShardIndex()].value;
+  auto current = value.load(std::memory_order_relaxed);
+  while (!value.compare_exchange_weak(current, current + val,
+                                      std::memory_order_relaxed))
+    ;
+}
 
-double Counter::Value() const { return gauge_.Value(); }
+double Counter::Value() const {
+  double sum = gauge_.Value();
+  if (shards_) {
+    for (std::size_t i = 0; i < kShards; i++) {
+      sum += shards_[i].value.load(std::memory_order_relaxed);
+    }
+  }
+  return sum;
+}
 
 ClientMetric Counter::Collect() const {
   ClientMetric metric;
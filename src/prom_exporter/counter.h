@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
 #include "client_metric.h"
 #include "detail/builder.h"
 #include "gauge.h"
@@ -22,6 +26,11 @@ namespace prometheus {
 ///
 /// The class is thread-safe. No concurrent call to any API of this type causes
 /// a data race.
+///
+/// A sharded counter splits the value into cache line aligned shards, each
+/// thread increments the shard assigned to it and Value() sums all shards.
+/// Use it only for counters incremented by many threads, histogram buckets
+/// and other counters keep a single value.
 class Counter {
  public:
   static const MetricType metric_type{MetricType::Counter};
@@ -29,6 +38,10 @@ class Counter {
   /// \brief Create a counter that starts at 0.
   Counter() = default;
 
+  /// \brief Create a counter that starts at 0, increments are spread over
+  /// per-thread shards when sharded is true.
+  explicit Counter(bool sharded);
+
   /// \brief Increment the counter by 1.
   void Increment();
 
@@ -46,7 +59,21 @@ class Counter {
   ClientMetric Collect() const;
 
  private:
+  static constexpr std::size_t kShards = 8;
+  static constexpr std::size_t kCacheLineSize = 64;
+
+  // Aligned to one cache line, so values of two shards never share a line.
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<double> value{0.0};
+  };
+
+  static std::size_t ShardIndex();
+
   Gauge gauge_{0.0};
+  // operator new does not honor extended alignment before C++17, shards are
+  // placed in storage aligned by hand; null for counter not sharded
+  std::unique_ptr<char[]> shard_storage_;
+  Shard* shards_ = nullptr;
 };
 
 /// \brief Return a builder to configure and register a Counter metric.
@@ -1,6 +1,7 @@
 #include "detail/utils.h"
 #include "hash.h"
 
+#include <algorithm>
 #include <numeric>
 
 namespace prometheus {
@@ -16,6 +17,41 @@ std::size_t hash_labels(const std::map<std::string, std::string>& labels) {
   return seed;
 }
 
+void append_escaped(std::string& out, const std::string& value) {
+  for (auto c : value) {
+    switch (c) {
+      case '\n':
+        out.append("\\n", 2);
+        break;
+      case '\\':
+      case '"':
+        out.push_back('\\');
+        out.push_back(c);
+        break;
+      default:
+        out.push_back(c);
+        break;
+    }
+  }
+}
+
+std::string render_labels(
+    const std::map<std::string, std::string>& constant_labels,
+    const std::map<std::string, std::string>& labels) {
+  std::string result;
+  auto append = [&result](const std::pair<const std::string, std::string>& label) {
+    if (!result.empty()) {
+      result.push_back(',');
+    }
+    result.append(label.first).append("=\"");
+    append_escaped(result, label.second);
+    result.push_back('"');
+  };
+  std::for_each(constant_labels.cbegin(), constant_labels.cend(), append);
+  std::for_each(labels.cbegin(), labels.cend(), append);
+  return result;
+}
+
 }  // namespace detail
 
 }  // namespace prometheus
@@ -17,6 +17,17 @@ namespace detail {
 std::size_t hash_labels(
     const std::map<std::string, std::string>& labels);
 
+/// \brief Append a label value escaped for the text exposition format.
+void append_escaped(std::string& out, const std::string& value);
+
+/// \brief Render labels once for streaming serialization.
+///
+/// \returns The label pairs `name="value",...` without braces, empty if there
+/// is no label.
+std::string render_labels(
+    const std::map<std::string, std::string>& constant_labels,
+    const std::map<std::string, std::string>& labels);
+
 }  // namespace detail
 
 }  // namespace prometheus
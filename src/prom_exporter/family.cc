@@ -28,7 +28,16 @@ T& Family<T>::Add(const std::map<std::string, std::string>& labels,
     const auto& old_labels = labels_iter->second;
     assert(labels == old_labels);
 #endif
+    ++ref_counts_[hash];
     return *metrics_iter->second;
+  } else if (max_series_ && metrics_.size() >= max_series_) {
+    if (overflow_) {
+      overflow_->Increment();
+    }
+    if (!detached_) {
+      detached_ = std::move(object);
+    }
+    return *detached_;
   } else {
 #ifndef NDEBUG
     for (auto& label_pair : labels) {
@@ -40,7 +49,9 @@ T& Family<T>::Add(const std::map<std::string, std::string>& labels,
     auto metric = metrics_.insert(std::make_pair(hash, std::move(object)));
     assert(metric.second);
     labels_.insert({hash, labels});
+    rendered_labels_.insert({hash, detail::render_labels(constant_labels_, labels)});
     labels_reverse_lookup_.insert({metric.first->second.get(), hash});
+    ref_counts_[hash] = 1;
     return *(metric.first->second);
   }
 }
@@ -53,11 +64,29 @@ void Family<T>::Remove(T* metric) {
   }
 
   auto hash = labels_reverse_lookup_.at(metric);
+  if (--ref_counts_[hash] > 0) {
+    return;
+  }
+  ref_counts_.erase(hash);
   metrics_.erase(hash);
   labels_.erase(hash);
+  rendered_labels_.erase(hash);
   labels_reverse_lookup_.erase(metric);
 }
 
+template <typename T>
+void Family<T>::SetMaxSeries(std::size_t max_series, Counter* overflow) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  max_series_ = max_series;
+  overflow_ = overflow;
+}
+
+template <typename T>
+std::size_t Family<T>::Size() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return metrics_.size();
+}
+
 template <typename T>
 const std::string& Family<T>::GetName() const {
   return name_;
@@ -81,6 +110,15 @@ std::vector<MetricFamily> Family<T>::Collect() {
   return {family};
 }
 
+template <typename T>
+void Family<T>::Accept(CollectVisitor& visitor) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  visitor.BeginFamily(name_, help_, T::metric_type);
+  for (const auto& m : metrics_) {
+    visitor.Visit(rendered_labels_.at(m.first), m.second->Collect());
+  }
+}
+
 template <typename T>
 ClientMetric Family<T>::CollectMetric(std::size_t hash, T* metric) {
   auto collected = metric->Collect();
@@ -21,6 +21,8 @@
 
 namespace prometheus {
 
+class Counter;
+
 /// \brief A metric of type T with a set of labeled dimensions.
 ///
 /// One of Prometheus main feature is a multi-dimensional data model with time
@@ -105,7 +107,9 @@ class Family : public Collectable {
   /// \param args Arguments are passed to the constructor of metric type T. See
   /// Counter, Gauge, Histogram or Summary for required constructor arguments.
   /// \return Return the newly created dimensional data or - if a same set of
-  /// labels already exists - the already existing dimensional data.
+  /// labels already exists - the already existing dimensional data. When the
+  /// family already holds the maximum number of dimensional data set by
+  /// SetMaxSeries(), a detached metric is returned which is never exported.
   template <typename... Args>
   T& Add(const std::map<std::string, std::string>& labels, Args&&... args) {
     return Add(labels, detail::make_unique<T>(args...));
@@ -113,10 +117,23 @@ class Family : public Collectable {
 
   /// \brief Remove the given dimensional data.
   ///
+  /// Each Add() returning the same dimensional data needs one Remove(), the
+  /// dimensional data is deleted by the last Remove().
+  ///
   /// \param metric Dimensional data to be removed. The function does nothing,
   /// if the given metric was not returned by Add().
   void Remove(T* metric);
 
+  /// \brief Limit the number of dimensional data of this family.
+  ///
+  /// \param max_series Maximum number of dimensional data, 0 means no limit.
+  /// \param overflow Incremented for each Add() rejected by the limit, may be
+  /// nullptr.
+  void SetMaxSeries(std::size_t max_series, Counter* overflow);
+
+  /// \brief Returns the number of dimensional data.
+  std::size_t Size();
+
   /// \brief Returns the name for this family.
   ///
   /// \return The family name.
@@ -134,10 +151,22 @@ class Family : public Collectable {
   /// \return Zero or more samples for each dimensional data.
   std::vector<MetricFamily> Collect() override;
 
+  /// \brief Streams the current value of each dimensional data with its
+  /// prerendered labels.
+  void Accept(CollectVisitor& visitor) override;
+
  private:
   std::unordered_map<std::size_t, std::unique_ptr<T>> metrics_;
   std::unordered_map<std::size_t, std::map<std::string, std::string>> labels_;
   std::unordered_map<T*, std::size_t> labels_reverse_lookup_;
+  // constant labels and labels rendered once in Add()
+  std::unordered_map<std::size_t, std::string> rendered_labels_;
+  // number of Add() not yet removed for each dimensional data
+  std::unordered_map<std::size_t, std::size_t> ref_counts_;
+  std::size_t max_series_{0};
+  Counter* overflow_{nullptr};
+  // returned by Add() beyond max_series_, not exported
+  std::unique_ptr<T> detached_;
 
   const std::string name_;
   const std::string help_;
@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iterator>
+#include <limits>
 #include <numeric>
 
 namespace prometheus {
@@ -14,12 +16,15 @@ Histogram::Histogram(const BucketBoundaries& buckets)
 }
 
 void Histogram::Observe(const double value) {
-  // TODO: determine bucket list size at which binary search would be faster
-  const auto bucket_index = static_cast<std::size_t>(std::distance(
-      bucket_boundaries_.begin(),
-      std::find_if(
-          std::begin(bucket_boundaries_), std::end(bucket_boundaries_),
-          [value](const double boundary) { return boundary >= value; })));
+  // First boundary >= value by binary search on the sorted boundaries, NaN
+  // is not less than any boundary and goes to the +Inf bucket as before.
+  const auto bucket_index =
+      std::isnan(value)
+          ? bucket_boundaries_.size()
+          : static_cast<std::size_t>(std::distance(
+                bucket_boundaries_.begin(),
+                std::lower_bound(std::begin(bucket_boundaries_),
+                                 std::end(bucket_boundaries_), value)));
   sum_.Increment(value);
   bucket_counts_[bucket_index].Increment();
 }
@@ -19,6 +19,13 @@ void CollectAll(std::vector<MetricFamily>& results, const T& families) {
   }
 }
 
+template <typename T>
+void AcceptAll(CollectVisitor& visitor, const T& families) {
+  for (auto&& collectable : families) {
+    collectable->Accept(visitor);
+  }
+}
+
 bool FamilyNameExists(const std::string& /* name */) { return false; }
 
 template <typename T, typename... Args>
@@ -50,6 +57,14 @@ std::vector<MetricFamily> Registry::Collect() {
   return results;
 }
 
+void Registry::Accept(CollectVisitor& visitor) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  AcceptAll(visitor, counters_);
+  AcceptAll(visitor, gauges_);
+  AcceptAll(visitor, histograms_);
+  AcceptAll(visitor, summaries_);
+}
+
 template <>
 std::vector<std::unique_ptr<Family<Counter>>>& Registry::GetFamilies() {
   return counters_;
@@ -130,9 +145,46 @@ Family<T>& Registry::Add(const std::string& name, const std::string& help,
   auto family = detail::make_unique<Family<T>>(name, help, labels);
   auto& ref = *family;
   families.push_back(std::move(family));
+  ApplyMaxSeries(ref);
   return ref;
 }
 
+template <typename T>
+void Registry::ApplyMaxSeries(Family<T>& family) {
+  if (overflow_ == nullptr) {
+    family.SetMaxSeries(max_series_, nullptr);
+    return;
+  }
+  if (static_cast<void*>(&family) == static_cast<void*>(overflow_)) {
+    return;
+  }
+  auto series = overflow_series_.find(&family);
+  if (series == overflow_series_.end()) {
+    series = overflow_series_
+                 .emplace(&family, &overflow_->Add({{"family", family.GetName()}}))
+                 .first;
+  }
+  family.SetMaxSeries(max_series_, series->second);
+}
+
+void Registry::SetMaxSeriesPerFamily(std::size_t max_series,
+                                     Family<Counter>* overflow) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto previous = overflow_;
+  std::unordered_map<const void*, Counter*> previous_series;
+  if (overflow != overflow_) {
+    previous_series.swap(overflow_series_);
+  }
+  max_series_ = max_series;
+  overflow_ = overflow;
+  for (auto& family : counters_) ApplyMaxSeries(*family);
+  for (auto& family : gauges_) ApplyMaxSeries(*family);
+  for (auto& family : histograms_) ApplyMaxSeries(*family);
+  for (auto& family : summaries_) ApplyMaxSeries(*family);
+  // released after no family refer to them
+  for (auto& series : previous_series) previous->Remove(series.second);
+}
+
 template Family<Counter>& Registry::Add(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels);
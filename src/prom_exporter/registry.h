@@ -4,6 +4,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "collectable.h"
@@ -72,6 +73,21 @@ class Registry : public Collectable {
   /// \return Zero or more metrics and their samples.
   std::vector<MetricFamily> Collect() override;
 
+  /// \brief Streams metrics of all families to the visitor.
+  ///
+  /// Unlike Collect(), no MetricFamily or label copy is created.
+  void Accept(CollectVisitor& visitor) override;
+
+  /// \brief Limit the number of dimensional data of every family in this
+  /// registry, including families added later.
+  ///
+  /// \param max_series Maximum number of dimensional data for each family, 0
+  /// means no limit.
+  /// \param overflow Family counting the rejected dimensional data with label
+  /// family="<family name>", may be nullptr. It is not limited itself.
+  void SetMaxSeriesPerFamily(std::size_t max_series,
+                             Family<Counter>* overflow);
+
  private:
   template <typename T>
   friend class detail::Builder;
@@ -86,11 +102,18 @@ class Registry : public Collectable {
   Family<T>& Add(const std::string& name, const std::string& help,
                  const std::map<std::string, std::string>& labels);
 
+  template <typename T>
+  void ApplyMaxSeries(Family<T>& family);
+
   const InsertBehavior insert_behavior_;
   std::vector<std::unique_ptr<Family<Counter>>> counters_;
   std::vector<std::unique_ptr<Family<Gauge>>> gauges_;
   std::vector<std::unique_ptr<Family<Histogram>>> histograms_;
   std::vector<std::unique_ptr<Family<Summary>>> summaries_;
+  std::size_t max_series_{0};
+  Family<Counter>* overflow_{nullptr};
+  // overflow series of each family, added to overflow_ once
+  std::unordered_map<const void*, Counter*> overflow_series_;
   std::mutex mutex_;
 };
 
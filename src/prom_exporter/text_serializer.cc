@@ -1,10 +1,15 @@
 #include "text_serializer.h"
 
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <limits>
 #include <locale>
 #include <ostream>
 
+#include "detail/utils.h"
+
 namespace prometheus {
 
 namespace {
@@ -192,4 +197,167 @@ void TextSerializer::Serialize(std::ostream& out,
   }
   out.imbue(saved_locale);
 }
+
+namespace {
+
+void AppendInteger(std::string& out, std::uint64_t value) {
+  char buffer[24];
+  auto end = buffer + sizeof(buffer);
+  auto begin = end;
+  do {
+    *--begin = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+  out.append(begin, end - begin);
+}
+
+// Shortest form of %.15g and %.17g which round-trips, integral values skip
+// printf as they are the most common (counters, bytes)
+void AppendDouble(std::string& out, double value) {
+  if (std::isnan(value)) {
+    out.append("Nan");
+  } else if (std::isinf(value)) {
+    out.append(value < 0 ? "-Inf" : "+Inf");
+  } else if (value == std::floor(value) &&
+             std::fabs(value) < 9007199254740992.0) {
+    if (value < 0) {
+      out.push_back('-');
+    }
+    AppendInteger(out, static_cast<std::uint64_t>(std::fabs(value)));
+  } else {
+    char buffer[32];
+    auto size = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (std::strtod(buffer, nullptr) != value) {
+      size = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    out.append(buffer, size);
+  }
+}
+
+const char* TypeName(MetricType type) {
+  switch (type) {
+    case MetricType::Counter:
+      return "counter";
+    case MetricType::Gauge:
+      return "gauge";
+    case MetricType::Summary:
+      return "summary";
+    case MetricType::Histogram:
+      return "histogram";
+    case MetricType::Untyped:
+      break;
+  }
+  return "untyped";
+}
+}  // namespace
+
+TextStreamSerializer::TextStreamSerializer(std::string& out)
+    : out_(out), name_(nullptr), type_(MetricType::Untyped) {}
+
+void TextStreamSerializer::BeginFamily(const std::string& name,
+                                       const std::string& help,
+                                       MetricType type) {
+  name_ = &name;
+  type_ = type;
+  if (!help.empty()) {
+    out_.append("# HELP ").append(name).push_back(' ');
+    out_.append(help).push_back('\n');
+  }
+  out_.append("# TYPE ").append(name).push_back(' ');
+  out_.append(TypeName(type)).push_back('\n');
+}
+
+void TextStreamSerializer::Visit(const std::string& labels,
+                                 const ClientMetric& metric) {
+  switch (type_) {
+    case MetricType::Counter:
+      WriteHead(labels, "");
+      AppendDouble(out_, metric.counter.value);
+      WriteTail(metric);
+      break;
+    case MetricType::Gauge:
+      WriteHead(labels, "");
+      AppendDouble(out_, metric.gauge.value);
+      WriteTail(metric);
+      break;
+    case MetricType::Untyped:
+      WriteHead(labels, "");
+      AppendDouble(out_, metric.untyped.value);
+      WriteTail(metric);
+      break;
+    case MetricType::Summary: {
+      const auto& sum = metric.summary;
+      WriteHead(labels, "_count");
+      AppendInteger(out_, sum.sample_count);
+      WriteTail(metric);
+      WriteHead(labels, "_sum");
+      AppendDouble(out_, sum.sample_sum);
+      WriteTail(metric);
+      for (const auto& q : sum.quantile) {
+        WriteHead(labels, "", "quantile", q.quantile);
+        AppendDouble(out_, q.value);
+        WriteTail(metric);
+      }
+      break;
+    }
+    case MetricType::Histogram: {
+      const auto& hist = metric.histogram;
+      WriteHead(labels, "_count");
+      AppendInteger(out_, hist.sample_count);
+      WriteTail(metric);
+      WriteHead(labels, "_sum");
+      AppendDouble(out_, hist.sample_sum);
+      WriteTail(metric);
+      double last = -std::numeric_limits<double>::infinity();
+      for (const auto& b : hist.bucket) {
+        WriteHead(labels, "_bucket", "le", b.upper_bound);
+        last = b.upper_bound;
+        AppendInteger(out_, b.cumulative_count);
+        WriteTail(metric);
+      }
+      if (last != std::numeric_limits<double>::infinity()) {
+        WriteHead(labels, "_bucket", "le",
+                  std::numeric_limits<double>::infinity());
+        AppendInteger(out_, hist.sample_count);
+        WriteTail(metric);
+      }
+      break;
+    }
+  }
+}
+
+void TextStreamSerializer::WriteHead(const std::string& labels,
+                                     const char* suffix) {
+  out_.append(*name_).append(suffix);
+  if (!labels.empty()) {
+    out_.push_back('{');
+    out_.append(labels).push_back('}');
+  }
+  out_.push_back(' ');
+}
+
+void TextStreamSerializer::WriteHead(const std::string& labels,
+                                     const char* suffix,
+                                     const char* extra_name,
+                                     double extra_value) {
+  out_.append(*name_).append(suffix).push_back('{');
+  if (!labels.empty()) {
+    out_.append(labels).push_back(',');
+  }
+  out_.append(extra_name).append("=\"");
+  AppendDouble(out_, extra_value);
+  out_.append("\"} ");
+}
+
+void TextStreamSerializer::WriteTail(const ClientMetric& metric) {
+  if (metric.timestamp_ms != 0) {
+    out_.push_back(' ');
+    if (metric.timestamp_ms < 0) {
+      out_.push_back('-');
+    }
+    AppendInteger(out_, static_cast<std::uint64_t>(std::llabs(metric.timestamp_ms)));
+  }
+  out_.push_back('\n');
+}
+
 }  // namespace prometheus
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "collectable.h"
 #include "metric_family.h"
 #include "serializer.h"
 
@@ -16,4 +17,30 @@ class TextSerializer : public Serializer {
                  const std::vector<MetricFamily>& metrics) const override;
 };
 
+/// \brief Streams the text exposition format into a reusable buffer.
+///
+/// Used with Registry::Accept(), each series is written with its prerendered
+/// labels and no MetricFamily, ClientMetric label or std::ostream is involved.
+/// Values are written in the shortest form that round-trips.
+class TextStreamSerializer : public CollectVisitor {
+ public:
+  /// \param out Text is appended to out, keep the buffer between scrapes to
+  /// reuse its capacity.
+  explicit TextStreamSerializer(std::string& out);
+
+  void BeginFamily(const std::string& name, const std::string& help,
+                   MetricType type) override;
+  void Visit(const std::string& labels, const ClientMetric& metric) override;
+
+ private:
+  void WriteHead(const std::string& labels, const char* suffix);
+  void WriteHead(const std::string& labels, const char* suffix,
+                 const char* extra_name, double extra_value);
+  void WriteTail(const ClientMetric& metric);
+
+  std::string& out_;
+  const std::string* name_;
+  MetricType type_;
+};
+
 }  // namespace prometheus
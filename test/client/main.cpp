@@ -0,0 +1,167 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include "../catch.hpp"
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+#include <cpprest/http_msg.h>
+#include "../../src/cli/RestClient.h"
+
+namespace
+{
+    // HTTP server on loopback port chosen by system, reply each request by script
+    class ScriptServer
+    {
+    public:
+        // return response of request index on connection index, empty response close connection without reply
+        typedef std::function<std::string(int connection, int request)> Responder;
+
+        explicit ScriptServer(const Responder &responder)
+            : m_acceptor(m_io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+              m_port(m_acceptor.local_endpoint().port()), m_responder(responder), m_connections(0), m_stop(false)
+        {
+            m_thread = std::thread(&ScriptServer::serve, this);
+        }
+        ~ScriptServer()
+        {
+            // wake up blocking accept
+            m_stop = true;
+            boost::asio::io_context io;
+            boost::asio::ip::tcp::socket socket(io);
+            boost::system::error_code ec;
+            socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), m_port), ec);
+            m_thread.join();
+        }
+        int port() const { return m_port; }
+        int connections() const { return m_connections; }
+
+    private:
+        void serve()
+        {
+            while (true)
+            {
+                boost::asio::ip::tcp::socket socket(m_io);
+                boost::system::error_code ec;
+                m_acceptor.accept(socket, ec);
+                if (ec || m_stop)
+                    return;
+                const int connection = m_connections++;
+                std::string data;
+                for (int request = 0;; request++)
+                {
+                    // requests in test have no body
+                    std::size_t headEnd;
+                    while ((headEnd = data.find("\r\n\r\n")) == std::string::npos)
+                    {
+                        char buffer[4096];
+                        const auto size = socket.read_some(boost::asio::buffer(buffer), ec);
+                        if (ec)
+                            break;
+                        data.append(buffer, size);
+                    }
+                    if (headEnd == std::string::npos)
+                        break;
+                    data.erase(0, headEnd + 4);
+
+                    // empty response close connection like keep-alive timeout
+                    const auto response = m_responder(connection, request);
+                    if (response.empty())
+                        break;
+                    boost::asio::write(socket, boost::asio::buffer(response), ec);
+                    // body without length is delimited by connection close
+                    if (ec || (response.find("Content-Length:") == std::string::npos && response.find("chunked") == std::string::npos))
+                        break;
+                }
+            }
+        }
+
+        boost::asio::io_context m_io;
+        boost::asio::ip::tcp::acceptor m_acceptor;
+        const int m_port;
+        const Responder m_responder;
+        std::atomic<int> m_connections;
+        std::atomic<bool> m_stop;
+        std::thread m_thread;
+    };
+
+    std::string get(RestClient &client, const std::string &path, const RestClient::BodyWriter &writer = RestClient::BodyWriter())
+    {
+        web::http::http_request request(web::http::methods::GET);
+        request.set_request_uri(path);
+        auto response = client.request(request, 5, writer);
+        REQUIRE(response.status_code() == web::http::status_codes::OK);
+        return response.extract_utf8string(true).get();
+    }
+} // namespace
+
+TEST_CASE("Rest Client Content-Length Test", "[RestClient]")
+{
+    ScriptServer server([](int, int request) {
+        // interim response is skipped
+        return std::string(request ? "HTTP/1.1 100 Continue\r\n\r\n" : "") + "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+    });
+    RestClient client("127.0.0.1", server.port(), false, "");
+    REQUIRE(get(client, "/a") == "hello");
+    REQUIRE(get(client, "/b") == "hello");
+    // keep-alive connection is reused
+    REQUIRE(server.connections() == 1);
+}
+
+TEST_CASE("Rest Client Chunked Test", "[RestClient]")
+{
+    ScriptServer server([](int, int) {
+        return std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n");
+    });
+    RestClient client("127.0.0.1", server.port(), false, "");
+
+    web::http::http_request request(web::http::methods::GET);
+    request.set_request_uri("/a");
+    auto response = client.request(request, 5);
+    REQUIRE(response.extract_utf8string(true).get() == "hello world");
+    REQUIRE_FALSE(response.headers().has(web::http::header_names::transfer_encoding));
+
+    // 2xx body is passed to writer, trailer of last response is consumed
+    std::string written;
+    REQUIRE(get(client, "/b", [&written](const web::http::http_response &, const char *data, std::size_t size) { written.append(data, size); }).empty());
+    REQUIRE(written == "hello world");
+    REQUIRE(server.connections() == 1);
+}
+
+TEST_CASE("Rest Client Close Delimited Test", "[RestClient]")
+{
+    ScriptServer server([](int connection, int) {
+        return "HTTP/1.0 200 OK\r\n\r\nbody of " + std::to_string(connection);
+    });
+    RestClient client("127.0.0.1", server.port(), false, "");
+    REQUIRE(get(client, "/a") == "body of 0");
+    // connection closed by server is opened again
+    REQUIRE(get(client, "/b") == "body of 1");
+    REQUIRE(server.connections() == 2);
+}
+
+TEST_CASE("Rest Client Stale Connection Test", "[RestClient]")
+{
+    // first connection is closed by server before reply second request
+    ScriptServer server([](int connection, int request) {
+        if (connection == 0 && request == 1)
+            return std::string();
+        return "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\n" + std::to_string(connection);
+    });
+    RestClient client("127.0.0.1", server.port(), false, "");
+    REQUIRE(get(client, "/a") == "0");
+    // request is sent again on new connection
+    REQUIRE(get(client, "/b") == "1");
+    REQUIRE(server.connections() == 2);
+}
+
+TEST_CASE("Rest Client Failed Retry Test", "[RestClient]")
+{
+    // new connection is not retried
+    ScriptServer server([](int, int) { return std::string(); });
+    RestClient client("127.0.0.1", server.port(), false, "");
+    web::http::http_request request(web::http::methods::GET);
+    request.set_request_uri("/a");
+    REQUIRE_THROWS_AS(client.request(request, 5), std::runtime_error);
+    REQUIRE(server.connections() == 1);
+}
@@ -0,0 +1,228 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include "../catch.hpp"
+#include <iostream>
+#include <string>
+#include <map>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <ace/Init_ACE.h>
+#include <ace/OS.h>
+#include <cpprest/http_listener.h>
+#include <cpprest/json.h>
+#include <log4cpp/Category.hh>
+#include <log4cpp/Appender.hh>
+#include <log4cpp/Priority.hh>
+#include <log4cpp/PatternLayout.hh>
+#include <log4cpp/OstreamAppender.hh>
+#include "../../src/common/Utility.h"
+#include "../../src/daemon/Configuration.h"
+#include "../../src/daemon/rest/ConsulConnection.h"
+#include "../../src/daemon/rest/RestHandler.h"
+
+#define FAKE_CONSUL_URL "http://127.0.0.1:18500"
+
+// defined in daemon main.cpp
+std::set<std::shared_ptr<RestHandler>> m_restList;
+
+void init()
+{
+    static bool initialized = false;
+    if (!initialized)
+    {
+        initialized = true;
+        ACE::init();
+        using namespace log4cpp;
+        auto consoleLayout = new PatternLayout();
+        consoleLayout->setConversionPattern("%d [%t] %p %c: %m%n");
+        auto consoleAppender = new OstreamAppender("console", &std::cout);
+        consoleAppender->setLayout(consoleLayout);
+        Category &root = Category::getRoot();
+        root.addAppender(consoleAppender);
+        Utility::setLogLevel("DEBUG");
+
+        // point Consul to the fake server
+        auto config = web::json::value::object();
+        config[JSON_KEY_DefaultExecUser] = web::json::value::string("root");
+        auto rest = web::json::value::object();
+        rest[JSON_KEY_RestListenPort] = web::json::value::number(6060);
+        config[JSON_KEY_REST] = rest;
+        auto consul = web::json::value::object();
+        consul[JSON_KEY_CONSUL_URL] = web::json::value::string(FAKE_CONSUL_URL);
+        consul[JSON_KEY_CONSUL_SESSION_TTL] = web::json::value::number(30);
+        config[JSON_KEY_CONSUL] = consul;
+        Configuration::instance(Configuration::FromJson(config.serialize()));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// In-memory Consul KV, supports recurse GET and /v1/txn set/delete
+//////////////////////////////////////////////////////////////////////////
+class FakeConsul
+{
+public:
+    FakeConsul() : m_index(1), m_listener(FAKE_CONSUL_URL)
+    {
+        m_listener.support(web::http::methods::GET, std::bind(&FakeConsul::handleGet, this, std::placeholders::_1));
+        m_listener.support(web::http::methods::PUT, std::bind(&FakeConsul::handlePut, this, std::placeholders::_1));
+        m_listener.open().wait();
+    }
+    ~FakeConsul() { m_listener.close().wait(); }
+    void reset()
+    {
+        std::lock_guard<std::recursive_mutex> guard(m_mutex);
+        m_kv.clear();
+        m_txnSizes.clear();
+    }
+
+    std::map<std::string, std::string> m_kv; // key -> value
+    std::vector<std::size_t> m_txnSizes;     // operation count of each transaction
+    long long m_index;
+    std::recursive_mutex m_mutex;
+
+private:
+    void handleGet(const web::http::http_request &message)
+    {
+        std::lock_guard<std::recursive_mutex> guard(m_mutex);
+        // /v1/kv/appmesh/topology?recurse=true
+        auto prefix = Utility::stringReplace(message.relative_uri().path(), "/v1/kv/", "");
+        auto result = web::json::value::array();
+        std::size_t i = 0;
+        for (const auto &kv : m_kv)
+        {
+            if (Utility::startWith(kv.first, prefix))
+            {
+                auto item = web::json::value::object();
+                item["Key"] = web::json::value::string(kv.first);
+                item["Value"] = web::json::value::string(Utility::encode64(kv.second));
+                item["ModifyIndex"] = web::json::value::number(m_index);
+                result[i++] = item;
+            }
+        }
+        web::http::http_response response(i ? web::http::status_codes::OK : web::http::status_codes::NotFound);
+        response.headers().add("X-Consul-Index", std::to_string(m_index));
+        response.set_body(result);
+        message.reply(response).wait();
+    }
+
+    void handlePut(const web::http::http_request &message)
+    {
+        std::lock_guard<std::recursive_mutex> guard(m_mutex);
+        if (message.relative_uri().path() != "/v1/txn")
+        {
+            message.reply(web::http::status_codes::NotFound).wait();
+            return;
+        }
+        auto operations = const_cast<web::http::http_request &>(message).extract_json(true).get().as_array();
+        if (operations.size() > CONSUL_TXN_MAX_OPERATIONS)
+        {
+            message.reply(web::http::status_codes::RequestEntityTooLarge).wait();
+            return;
+        }
+        m_txnSizes.push_back(operations.size());
+        for (const auto &operation : operations)
+        {
+            auto kv = operation.at("KV");
+            auto key = GET_JSON_STR_VALUE(kv, "Key");
+            if (GET_JSON_STR_VALUE(kv, "Verb") == "set")
+                m_kv[key] = Utility::decode64(GET_JSON_STR_VALUE(kv, "Value"));
+            else if (GET_JSON_STR_VALUE(kv, "Verb") == "delete")
+                m_kv.erase(key);
+        }
+        m_index++;
+        message.reply(web::http::status_codes::OK, "{\"Results\":[],\"Errors\":null}").wait();
+    }
+
+    web::http::experimental::listener::http_listener m_listener;
+};
+
+std::map<std::string, std::shared_ptr<ConsulTopology>> buildTopology(std::size_t hostCount, const std::string &appName)
+{
+    std::map<std::string, std::shared_ptr<ConsulTopology>> topology;
+    for (std::size_t i = 0; i < hostCount; i++)
+    {
+        auto host = std::string("host") + std::to_string(i);
+        auto hostTopology = std::make_shared<ConsulTopology>();
+        hostTopology->m_hostName = host;
+        hostTopology->m_scheduleApps[appName] = 1;
+        topology[host] = hostTopology;
+    }
+    return topology;
+}
+
+// friend of ConsulConnection, expose topology functions to test
+class ConsulConnectionTest
+{
+public:
+    static void compareTopologyAndDispatch(const std::map<std::string, std::shared_ptr<ConsulTopology>> &oldT, const std::map<std::string, std::shared_ptr<ConsulTopology>> &newT)
+    {
+        ConsulConnection::instance()->compareTopologyAndDispatch(oldT, newT);
+    }
+    static std::map<std::string, std::shared_ptr<ConsulTopology>> retrieveTopology(const std::string &host)
+    {
+        return ConsulConnection::instance()->retrieveTopology(host);
+    }
+};
+
+TEST_CASE("Consul Topology Transaction Test", "[Consul]")
+{
+    init();
+    // keep one listener for all sections, Consul connections are kept alive
+    static FakeConsul consul;
+    consul.reset();
+    ConsulConnectionTest connection;
+
+    SECTION("write topology in transactions of max operations")
+    {
+        auto oldTopology = std::map<std::string, std::shared_ptr<ConsulTopology>>();
+        auto newTopology = buildTopology(150, "myapp");
+        connection.compareTopologyAndDispatch(oldTopology, newTopology);
+
+        REQUIRE(consul.m_txnSizes.size() == 3);
+        REQUIRE(consul.m_txnSizes[0] == CONSUL_TXN_MAX_OPERATIONS);
+        REQUIRE(consul.m_txnSizes[1] == CONSUL_TXN_MAX_OPERATIONS);
+        REQUIRE(consul.m_txnSizes[2] == 150 - 2 * CONSUL_TXN_MAX_OPERATIONS);
+        REQUIRE(consul.m_kv.size() == 150);
+
+        auto readTopology = connection.retrieveTopology("");
+        REQUIRE(readTopology.size() == 150);
+        REQUIRE(readTopology["host0"]->m_scheduleApps.count("myapp"));
+    }
+
+    SECTION("only changed hosts are written")
+    {
+        auto oldTopology = buildTopology(100, "myapp");
+        connection.compareTopologyAndDispatch({}, oldTopology);
+        consul.m_txnSizes.clear();
+
+        auto newTopology = buildTopology(90, "myapp");
+        for (std::size_t i = 0; i < 5; i++)
+        {
+            newTopology[std::string("host") + std::to_string(i)]->m_scheduleApps["otherapp"] = 1;
+        }
+        connection.compareTopologyAndDispatch(oldTopology, newTopology);
+
+        // 10 hosts removed and 5 hosts updated in one transaction
+        REQUIRE(consul.m_txnSizes.size() == 1);
+        REQUIRE(consul.m_txnSizes[0] == 15);
+        REQUIRE(consul.m_kv.size() == 90);
+        REQUIRE(connection.retrieveTopology("host0")["host0"]->m_scheduleApps.size() == 2);
+
+        // no change, no request
+        consul.m_txnSizes.clear();
+        connection.compareTopologyAndDispatch(newTopology, newTopology);
+        REQUIRE(consul.m_txnSizes.empty());
+
+        // app index change is written
+        auto indexTopology = buildTopology(90, "myapp");
+        for (std::size_t i = 0; i < 5; i++)
+        {
+            indexTopology[std::string("host") + std::to_string(i)]->m_scheduleApps["otherapp"] = 1;
+        }
+        indexTopology["host10"]->m_scheduleApps["myapp"] = 2;
+        connection.compareTopologyAndDispatch(newTopology, indexTopology);
+        REQUIRE(consul.m_txnSizes.size() == 1);
+        REQUIRE(consul.m_txnSizes[0] == 1);
+        REQUIRE(connection.retrieveTopology("host10")["host10"]->m_scheduleApps["myapp"] == 2);
+    }
+}
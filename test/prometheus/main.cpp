@@ -0,0 +1,282 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include "../catch.hpp"
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/prom_exporter/counter.h"
+#include "../../src/prom_exporter/gauge.h"
+#include "../../src/prom_exporter/histogram.h"
+#include "../../src/prom_exporter/registry.h"
+#include "../../src/prom_exporter/text_serializer.h"
+#include "../../src/daemon/HostMetrics.h"
+
+using namespace prometheus;
+
+std::string streamText(Registry &registry)
+{
+    std::string out;
+    TextStreamSerializer serializer(out);
+    registry.Accept(serializer);
+    return out;
+}
+
+bool hasLine(const std::string &text, const std::string &line)
+{
+    std::istringstream stream(text);
+    std::string current;
+    while (std::getline(stream, current))
+    {
+        if (current == line)
+            return true;
+    }
+    return false;
+}
+
+TEST_CASE("Stream Serializer Test", "[Prometheus]")
+{
+    Registry registry;
+    auto &counter = BuildCounter().Name("appmesh_test_count").Help("test \"count\"").Labels({{"host", "h1"}}).Register(registry);
+    counter.Add({{"app", "a\"b\n"}}).Increment(3);
+    auto &removed = counter.Add({{"app", "removed"}});
+    counter.Add({{"app", "x"}, {"id", "1"}}).Increment(0.1);
+    counter.Remove(&removed);
+    BuildGauge().Name("appmesh_test_gauge").Help("").Register(registry).Add({}).Set(-2.5);
+    BuildHistogram().Name("appmesh_test_hist").Help("hist").Register(registry).Add({{"name", "t"}}, Histogram::BucketBoundaries{0, 1, 2.5}).Observe(1.1);
+
+    auto text = streamText(registry);
+    REQUIRE(hasLine(text, "# HELP appmesh_test_count test \"count\""));
+    REQUIRE(hasLine(text, "# TYPE appmesh_test_count counter"));
+    REQUIRE(hasLine(text, "appmesh_test_count{host=\"h1\",app=\"a\\\"b\\n\"} 3"));
+    REQUIRE(hasLine(text, "appmesh_test_count{host=\"h1\",app=\"x\",id=\"1\"} 0.1"));
+    REQUIRE(text.find("removed") == std::string::npos);
+    REQUIRE(hasLine(text, "# TYPE appmesh_test_gauge gauge"));
+    REQUIRE(hasLine(text, "appmesh_test_gauge -2.5"));
+    REQUIRE(hasLine(text, "appmesh_test_hist_count{name=\"t\"} 1"));
+    REQUIRE(hasLine(text, "appmesh_test_hist_sum{name=\"t\"} 1.1"));
+    REQUIRE(hasLine(text, "appmesh_test_hist_bucket{name=\"t\",le=\"2.5\"} 1"));
+    REQUIRE(hasLine(text, "appmesh_test_hist_bucket{name=\"t\",le=\"+Inf\"} 1"));
+
+    // same series as Collect() path
+    std::size_t collected = 0;
+    for (const auto &family : registry.Collect())
+        collected += family.metric.size();
+    REQUIRE(collected == 4);
+}
+
+TEST_CASE("Sharded Counter Test", "[Prometheus]")
+{
+    // sharded and single value counters count the same
+    for (const bool sharded : {true, false})
+    {
+        Counter counter(sharded);
+        counter.Increment(-1);
+        REQUIRE(counter.Value() == 0);
+
+        const int threadCount = 16;
+        const int increments = 100000;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([&counter]() {
+                for (int j = 0; j < increments; j++)
+                    counter.Increment();
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        REQUIRE(counter.Value() == double(threadCount) * increments);
+        REQUIRE(counter.Collect().counter.value == double(threadCount) * increments);
+    }
+}
+
+TEST_CASE("Histogram Bucket Test", "[Prometheus]")
+{
+    Histogram histogram(Histogram::BucketBoundaries{0.001, 0.01, 0.1, 1, 10});
+    // boundary is inclusive upper bound of its bucket
+    for (auto value : {0.0005, 0.001, 0.002, 0.1, 5.0, 10.0, 11.0, std::numeric_limits<double>::quiet_NaN()})
+        histogram.Observe(value);
+
+    auto metric = histogram.Collect().histogram;
+    REQUIRE(metric.bucket.size() == 6);
+    REQUIRE(metric.bucket[0].cumulative_count == 2);
+    REQUIRE(metric.bucket[1].cumulative_count == 3);
+    REQUIRE(metric.bucket[2].cumulative_count == 4);
+    REQUIRE(metric.bucket[3].cumulative_count == 4);
+    REQUIRE(metric.bucket[4].cumulative_count == 6);
+    // NaN and values above the last boundary go to +Inf
+    REQUIRE(metric.bucket[5].cumulative_count == 8);
+    REQUIRE(metric.sample_count == 8);
+}
+
+TEST_CASE("Family Series Limit Test", "[Prometheus]")
+{
+    Registry registry;
+    auto &overflow = BuildCounter().Name("appmesh_test_overflow_count").Help("").Register(registry);
+    auto &apps = BuildGauge().Name("appmesh_test_app_gauge").Help("").Register(registry);
+    registry.SetMaxSeriesPerFamily(2, &overflow);
+    auto &later = BuildCounter().Name("appmesh_test_later_count").Help("").Register(registry);
+
+    auto &a = apps.Add({{"id", "a"}});
+    auto &b = apps.Add({{"id", "b"}});
+    auto &c = apps.Add({{"id", "c"}});
+    auto &d = apps.Add({{"id", "d"}});
+    later.Add({{"id", "a"}});
+    later.Add({{"id", "b"}});
+    later.Add({{"id", "c"}});
+    c.Set(3);
+    REQUIRE(apps.Size() == 2);
+    REQUIRE(&c == &d);
+
+    auto text = streamText(registry);
+    REQUIRE(text.find("id=\"c\"") == std::string::npos);
+    REQUIRE(hasLine(text, "appmesh_test_overflow_count{family=\"appmesh_test_app_gauge\"} 2"));
+    REQUIRE(hasLine(text, "appmesh_test_overflow_count{family=\"appmesh_test_later_count\"} 1"));
+
+    // detached metric is never removed, removed series release room
+    apps.Remove(&c);
+    apps.Remove(&a);
+    REQUIRE(apps.Size() == 1);
+    auto &e = apps.Add({{"id", "e"}});
+    REQUIRE(&e != &c);
+    REQUIRE(apps.Size() == 2);
+
+    // same labels share one series until the last Remove()
+    auto &b2 = apps.Add({{"id", "b"}});
+    REQUIRE(&b == &b2);
+    apps.Remove(&b);
+    REQUIRE(apps.Size() == 2);
+    apps.Remove(&b2);
+    REQUIRE(apps.Size() == 1);
+
+    // overflow series is added once for each family, released when overflow family changed
+    registry.SetMaxSeriesPerFamily(3, &overflow);
+    REQUIRE(overflow.Size() == 2);
+    registry.SetMaxSeriesPerFamily(3, nullptr);
+    REQUIRE(overflow.Size() == 0);
+}
+
+// run with: test_prometheus [benchmark]
+TEST_CASE("Host Metrics Parser Test", "[HostMetrics]")
+{
+    // captured /proc content
+    const auto cpu = HostMetrics::parseCpu("cpu  4705 356 584 3699 23 23 0 7 0 0\ncpu0 1393 40 191 1025 5 14 0 0 0 0\n", 100);
+    REQUIRE(cpu.size() == 8);
+    REQUIRE(std::string(cpu[0].first) == "user");
+    REQUIRE(cpu[0].second == Approx(47.05));
+    REQUIRE(std::string(cpu[7].first) == "steal");
+    REQUIRE(cpu[7].second == Approx(0.07));
+    REQUIRE(HostMetrics::parseCpu("intr 1 2 3\n", 100).empty());
+
+    const auto load = HostMetrics::parseLoad("0.20 0.18 0.12 1/80 11206\n");
+    REQUIRE(load.size() == 3);
+    REQUIRE(load[0] == Approx(0.20));
+    REQUIRE(load[2] == Approx(0.12));
+
+    const auto memory = HostMetrics::parseMemory("MemTotal:       16318412 kB\nMemFree:         1234 kB\nSwapTotal:             0 kB\nHugePages_Total:       0\n");
+    REQUIRE(memory.at("MemTotal") == 16318412ULL * 1024);
+    REQUIRE(memory.at("MemFree") == 1234ULL * 1024);
+    REQUIRE(memory.at("SwapTotal") == 0);
+    REQUIRE(memory.count("MemAvailable") == 0);
+
+    const auto network = HostMetrics::parseNetwork(
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+        "    lo:  104356     1200    0    0    0     0          0         0   104356     1200    0    0    0     0       0          0\n"
+        "  eth0: 98765432   65432    0    0    0     0          0         0  1234567     8765    0    0    0     0       0          0\n"
+        " bad0: 1 2\n");
+    REQUIRE(network.size() == 2);
+    REQUIRE(network[1].m_name == "eth0");
+    REQUIRE(network[1].m_receiveBytes == 98765432ULL);
+    REQUIRE(network[1].m_receivePackets == 65432ULL);
+    REQUIRE(network[1].m_transmitBytes == 1234567ULL);
+    REQUIRE(network[1].m_transmitPackets == 8765ULL);
+
+    const auto mounts = HostMetrics::parseMounts(
+        "sysfs /sys sysfs rw,nosuid,nodev,noexec,relatime 0 0\n"
+        "/dev/sda1 / ext4 rw,relatime 0 0\n"
+        "tmpfs /run tmpfs rw,nosuid,nodev 0 0\n"
+        "server:/export /mnt/nfs nfs4 rw,relatime,vers=4.2 0 0\n"
+        "//server/share /mnt/smb cifs rw,relatime 0 0\n"
+        "/dev/fuse /mnt/ssh fuse.sshfs rw 0 0\n"
+        "/dev/sdb1 /data\\040disk xfs rw 0 0\n"
+        "/dev/sda1 / ext4 rw,relatime 0 0\n");
+    REQUIRE(mounts.size() == 2);
+    REQUIRE(mounts[0].m_path == "/");
+    REQUIRE(mounts[0].m_device == "/dev/sda1");
+    REQUIRE(mounts[1].m_path == "/data disk");
+}
+
+TEST_CASE("Host Metrics Stream Test", "[HostMetrics]")
+{
+    HostMetrics metrics("h1");
+    std::string text;
+    TextStreamSerializer serializer(text);
+    metrics.Accept(serializer);
+    REQUIRE(hasLine(text, "# TYPE appmesh_host_cpu_seconds_total counter"));
+    REQUIRE(text.find("appmesh_host_cpu_seconds_total{host=\"h1\",mode=\"user\"} ") != std::string::npos);
+    REQUIRE(text.find("appmesh_host_memory_bytes{host=\"h1\",type=\"total\"} ") != std::string::npos);
+    REQUIRE(text.find("appmesh_host_network_receive_bytes_total{host=\"h1\",interface=\"lo\"} ") != std::string::npos);
+
+    // same series as Collect() path
+    std::size_t collected = 0;
+    for (const auto &family : metrics.Collect())
+        collected += family.metric.size();
+    std::size_t streamed = 0;
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line))
+        streamed += (line.length() && line[0] != '#');
+    REQUIRE(collected > 0);
+    REQUIRE(streamed == collected);
+}
+
+TEST_CASE("Scrape Benchmark", "[.][benchmark]")
+{
+    // per-app series similar to Application::initMetrics() for 1k apps
+    Registry registry;
+    auto &starts = BuildCounter().Name("appmesh_prom_process_start_count").Help("application process spawn count").Register(registry);
+    auto &gauges = BuildGauge().Name("appmesh_prom_process_memory_gauge").Help("application process memory bytes").Register(registry);
+    for (int i = 0; i < 1000; i++)
+    {
+        std::map<std::string, std::string> labels{{"application", std::string("app") + std::to_string(i)}, {"id", std::string("0f1c7f3e-1d2b-4c6a-9e8d-") + std::to_string(100000000000 + i)}};
+        starts.Add(labels).Increment(i);
+        for (int k = 0; k < 5; k++)
+        {
+            auto gaugeLabels = labels;
+            gaugeLabels["kind"] = std::to_string(k);
+            gauges.Add(gaugeLabels).Set(i * 1024.0 * 1024 + k * 0.25);
+        }
+    }
+
+    const int rounds = 100;
+    auto elapsed = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::size_t collectBytes = 0;
+    for (int i = 0; i < rounds; i++)
+        collectBytes += TextSerializer().Serialize(registry.Collect()).size();
+    auto collectUs = elapsed(start) / rounds;
+
+    std::string buffer;
+    std::size_t streamBytes = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        buffer.clear();
+        TextStreamSerializer serializer(buffer);
+        registry.Accept(serializer);
+        streamBytes += buffer.size();
+    }
+    auto streamUs = elapsed(start) / rounds;
+
+    std::cout << "series <6000>" << std::endl
+              << "Collect + TextSerializer : " << collectUs << " us/scrape, " << collectBytes / rounds << " bytes" << std::endl
+              << "Accept + stream          : " << streamUs << " us/scrape, " << streamBytes / rounds << " bytes" << std::endl;
+    REQUIRE(streamBytes > 0);
+}
@@ -0,0 +1,533 @@
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this in one cpp file
+#include "../catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <ace/Init_ACE.h>
+#include <ace/OS.h>
+#include <cpprest/json.h>
+#include <log4cpp/Category.hh>
+#include <log4cpp/Appender.hh>
+#include <log4cpp/Priority.hh>
+#include <log4cpp/PatternLayout.hh>
+#include <log4cpp/OstreamAppender.hh>
+#include "../../src/common/Utility.h"
+#include "../../src/daemon/Label.h"
+#include "../../src/daemon/LabelSelector.h"
+#include "../../src/daemon/Scheduler.h"
+#include "../../src/daemon/application/Application.h"
+#include "../../src/daemon/rest/ConsulEntity.h"
+#include "../../src/daemon/rest/RestHandler.h"
+
+// defined in daemon main.cpp
+std::set<std::shared_ptr<RestHandler>> m_restList;
+
+typedef std::map<std::string, std::shared_ptr<ConsulTask>> TaskMap;
+typedef std::map<std::string, std::shared_ptr<ConsulNode>> NodeMap;
+typedef std::map<std::string, std::shared_ptr<ConsulTopology>> TopologyMap;
+
+void init(const std::string &logLevel = "DEBUG")
+{
+    static bool initialized = false;
+    if (!initialized)
+    {
+        initialized = true;
+        ACE::init();
+        using namespace log4cpp;
+        auto consoleLayout = new PatternLayout();
+        consoleLayout->setConversionPattern("%d [%t] %p %c: %m%n");
+        auto consoleAppender = new OstreamAppender("console", &std::cout);
+        consoleAppender->setLayout(consoleLayout);
+        Category &root = Category::getRoot();
+        root.addAppender(consoleAppender);
+    }
+    Utility::setLogLevel(logLevel);
+}
+
+std::shared_ptr<ConsulTask> makeTask(const std::string &name, std::size_t replication, const std::string &zone = "", int memoryMb = 0, int cpuShares = 0)
+{
+    auto task = std::make_shared<ConsulTask>();
+    auto appJson = web::json::value::object();
+    appJson[JSON_KEY_APP_name] = web::json::value::string(name);
+    appJson[JSON_KEY_APP_command] = web::json::value::string("sleep 60");
+    if (memoryMb || cpuShares)
+    {
+        auto limit = web::json::value::object();
+        limit[JSON_KEY_RESOURCE_LIMITATION_memory_mb] = web::json::value::number(memoryMb);
+        limit[JSON_KEY_RESOURCE_LIMITATION_cpu_shares] = web::json::value::number(cpuShares);
+        appJson[JSON_KEY_APP_resource_limit] = limit;
+    }
+    task->m_app = std::make_shared<Application>();
+    Application::FromJson(task->m_app, appJson);
+    task->m_replication = replication;
+    if (zone.length())
+        task->m_condition->addLabel("zone", zone);
+    return task;
+}
+
+std::shared_ptr<ConsulNode> makeNode(const std::string &host, const std::string &zone, std::size_t cores = 0, uint64_t memoryMb = 0)
+{
+    auto node = std::make_shared<ConsulNode>();
+    node->m_hostName = host;
+    node->m_label->addLabel("zone", zone);
+    node->m_cores = cores;
+    node->m_total_bytes = memoryMb * 1024 * 1024;
+    return node;
+}
+
+// task -> hosts
+std::map<std::string, std::set<std::string>> placements(const TopologyMap &topology)
+{
+    std::map<std::string, std::set<std::string>> result;
+    for (const auto &host : topology)
+        for (const auto &app : host.second->m_scheduleApps)
+            result[app.first].insert(host.first);
+    return result;
+}
+
+// host -> placed replica count
+std::map<std::string, std::size_t> loads(const TopologyMap &topology)
+{
+    std::map<std::string, std::size_t> result;
+    for (const auto &host : topology)
+        result[host.first] = host.second->m_scheduleApps.size();
+    return result;
+}
+
+TEST_CASE("Incremental Scheduler Test", "[Scheduler]")
+{
+    init();
+
+    NodeMap nodes;
+    for (int i = 0; i < 4; i++)
+    {
+        auto host = std::string("host") + std::to_string(i);
+        nodes[host] = makeNode(host, i < 2 ? "east" : "west");
+    }
+    TaskMap tasks;
+    tasks["app1"] = makeTask("app1", 2);
+    tasks["app2"] = makeTask("app2", 2);
+    tasks["app3"] = makeTask("app3", 2, "west");
+
+    Scheduler scheduler;
+    auto topology = scheduler.schedule(tasks, nodes, {});
+
+    SECTION("replicas are spread on matched nodes")
+    {
+        std::map<std::string, std::set<std::string>> taskHosts;
+        std::set<int> app1Index;
+        for (const auto &host : topology)
+        {
+            for (const auto &app : host.second->m_scheduleApps)
+                taskHosts[app.first].insert(host.first);
+            if (host.second->m_scheduleApps.count("app1"))
+                app1Index.insert(host.second->m_scheduleApps["app1"]);
+        }
+        REQUIRE(taskHosts["app1"].size() == 2);
+        REQUIRE(taskHosts["app2"].size() == 2);
+        REQUIRE(taskHosts["app3"] == std::set<std::string>({"host2", "host3"}));
+        REQUIRE(app1Index == std::set<int>({1, 2}));
+        auto hostLoads = loads(topology);
+        auto minmax = std::minmax_element(hostLoads.begin(), hostLoads.end(), [](const std::pair<const std::string, std::size_t> &a, const std::pair<const std::string, std::size_t> &b) { return a.second < b.second; });
+        REQUIRE(minmax.second->second - minmax.first->second <= 1);
+    }
+
+    SECTION("unchanged input keeps placement")
+    {
+        auto again = scheduler.schedule(tasks, nodes, topology);
+        REQUIRE(again.size() == topology.size());
+        for (const auto &host : topology)
+            REQUIRE(again[host.first]->m_scheduleApps == host.second->m_scheduleApps);
+    }
+
+    SECTION("node departure only moves its replicas")
+    {
+        auto departed = topology.begin()->first;
+        auto movedApps = topology.begin()->second->m_scheduleApps;
+        nodes.erase(departed);
+        auto newTopology = scheduler.schedule(tasks, nodes, topology);
+        REQUIRE(newTopology.count(departed) == 0);
+        for (const auto &host : topology)
+        {
+            if (host.first == departed)
+                continue;
+            // replicas which were not on departed node stay
+            for (const auto &app : host.second->m_scheduleApps)
+                REQUIRE(newTopology[host.first]->m_scheduleApps.count(app.first));
+        }
+        for (const auto &app : movedApps)
+        {
+            auto placed = std::count_if(newTopology.begin(), newTopology.end(), [&app](const std::pair<const std::string, std::shared_ptr<ConsulTopology>> &host) { return host.second->m_scheduleApps.count(app.first) > 0; });
+            // app3 only have one west node left when a west node departed
+            bool westDeparted = nodes.count("host2") == 0 || nodes.count("host3") == 0;
+            REQUIRE(placed == ((app.first == "app3" && westDeparted) ? 1 : 2));
+        }
+    }
+
+    SECTION("replication decrease and task removal")
+    {
+        tasks["app1"] = makeTask("app1", 1);
+        tasks.erase("app2");
+        auto newTopology = scheduler.schedule(tasks, nodes, topology);
+        std::size_t app1 = 0, app2 = 0;
+        for (const auto &host : newTopology)
+        {
+            app1 += host.second->m_scheduleApps.count("app1");
+            app2 += host.second->m_scheduleApps.count("app2");
+            if (host.second->m_scheduleApps.count("app1"))
+                REQUIRE(host.second->m_scheduleApps["app1"] == 1);
+        }
+        REQUIRE(app1 == 1);
+        REQUIRE(app2 == 0);
+    }
+
+    SECTION("state rebuilt from topology written by others")
+    {
+        Scheduler newLeader;
+        auto newTopology = newLeader.schedule(tasks, nodes, topology);
+        for (const auto &host : topology)
+            REQUIRE(newTopology[host.first]->m_scheduleApps == host.second->m_scheduleApps);
+    }
+}
+
+TEST_CASE("Label Selector Test", "[Scheduler]")
+{
+    init();
+
+    LabelIndex index;
+    std::vector<std::shared_ptr<Label>> labels;
+    for (std::size_t id = 0; id < 10; id++)
+    {
+        auto label = std::make_shared<Label>();
+        label->addLabel("zone", id < 5 ? std::string("east-") + std::to_string(id) : "west");
+        label->addLabel("os_version", "centos7.6");
+        if (id % 2)
+            label->addLabel("gpu", "yes");
+        labels.push_back(label);
+        index.add(id, label);
+    }
+    auto condition = [](const std::map<std::string, std::string> &conditions) {
+        auto label = std::make_shared<Label>();
+        for (const auto &c : conditions)
+            label->addLabel(c.first, c.second);
+        return label;
+    };
+    auto matchedIds = [&index](const std::shared_ptr<Label> &label) {
+        std::size_t count = 0;
+        auto bitmap = index.candidates(LabelSelector(label), count);
+        std::set<std::size_t> ids;
+        for (std::size_t id = 0; id < bitmap.size(); id++)
+            if (bitmap[id])
+                ids.insert(id);
+        REQUIRE(ids.size() == count);
+        return ids;
+    };
+
+    SECTION("index candidates are the same with Label::match")
+    {
+        std::vector<std::shared_ptr<Label>> conditions = {
+            condition({}),
+            condition({{"zone", "west"}}),
+            condition({{"zone", "east-*"}}),
+            condition({{"zone", "east-*"}, {"gpu", "yes"}}),
+            condition({{"os_version", "centos*"}, {"zone", "west"}}),
+            condition({{"zone", "nowhere"}}),
+            condition({{"missing", "*"}})};
+        for (const auto &c : conditions)
+        {
+            std::set<std::size_t> expected;
+            for (std::size_t id = 0; id < labels.size(); id++)
+            {
+                REQUIRE(labels[id]->match(LabelSelector(c)) == labels[id]->match(c));
+                if (labels[id]->match(c))
+                    expected.insert(id);
+            }
+            REQUIRE(matchedIds(c) == expected);
+        }
+    }
+
+    SECTION("removed node is not candidate")
+    {
+        index.remove(9);
+        REQUIRE(matchedIds(condition({{"zone", "west"}, {"gpu", "yes"}})) == std::set<std::size_t>({5, 7}));
+        REQUIRE(matchedIds(nullptr).empty());
+    }
+}
+
+TEST_CASE("Placement Strategy Test", "[Scheduler]")
+{
+    init();
+
+    // a, b: 4 cores 4G, c: 2 cores 2G
+    NodeMap nodes;
+    nodes["a"] = makeNode("a", "east", 4, 4096);
+    nodes["b"] = makeNode("b", "east", 4, 4096);
+    nodes["c"] = makeNode("c", "east", 2, 2048);
+    TaskMap tasks;
+    tasks["big"] = makeTask("big", 2, "", 3000, 1024);
+    tasks["mid"] = makeTask("mid", 1, "", 1500, 512);
+    tasks["small1"] = makeTask("small1", 1, "", 500, 256);
+    tasks["small2"] = makeTask("small2", 1, "", 500, 256);
+    tasks["huge"] = makeTask("huge", 1, "", 9000);
+
+    SECTION("request exceeds capacity is not placed")
+    {
+        for (const auto strategy : {SCHEDULE_STRATEGY_SPREAD, SCHEDULE_STRATEGY_BINPACK, SCHEDULE_STRATEGY_LEAST_REQUESTED})
+        {
+            Scheduler scheduler;
+            scheduler.strategy(strategy);
+            auto taskHosts = placements(scheduler.schedule(tasks, nodes, {}));
+            REQUIRE(taskHosts.count("huge") == 0);
+            REQUIRE(taskHosts["big"] == std::set<std::string>({"a", "b"}));
+            REQUIRE(taskHosts["mid"].size() == 1);
+        }
+    }
+
+    SECTION("binpack fills the fullest node which still fit")
+    {
+        Scheduler scheduler;
+        scheduler.strategy(SCHEDULE_STRATEGY_BINPACK);
+        auto taskHosts = placements(scheduler.schedule(tasks, nodes, {}));
+        REQUIRE(taskHosts["mid"] == std::set<std::string>({"c"}));
+        REQUIRE(taskHosts["small1"] == std::set<std::string>({"c"}));
+        REQUIRE(taskHosts["small2"] == std::set<std::string>({"a"}));
+    }
+
+    SECTION("least requested prefers idle node")
+    {
+        Scheduler scheduler;
+        scheduler.strategy(SCHEDULE_STRATEGY_LEAST_REQUESTED);
+        nodes["d"] = makeNode("d", "east", 8, 8192);
+        auto taskHosts = placements(scheduler.schedule(tasks, nodes, {}));
+        REQUIRE(taskHosts["big"].count("d") == 1);
+    }
+
+    SECTION("unknown strategy is rejected")
+    {
+        Scheduler scheduler;
+        REQUIRE_THROWS(scheduler.strategy("random"));
+    }
+}
+
+TEST_CASE("Priority Scheduling Test", "[Scheduler]")
+{
+    init();
+
+    NodeMap nodes;
+    nodes["a"] = makeNode("a", "east", 4, 4096);
+    nodes["b"] = makeNode("b", "east", 4, 4096);
+    TaskMap tasks;
+    tasks["low1"] = makeTask("low1", 2, "", 2000);
+    tasks["low2"] = makeTask("low2", 2, "", 2000);
+    Scheduler scheduler;
+    auto topology = scheduler.schedule(tasks, nodes, {});
+    REQUIRE(placements(topology)["low1"].size() == 2);
+
+    SECTION("higher priority task is placed first")
+    {
+        Scheduler other;
+        tasks["urgent"] = makeTask("urgent", 2, "", 3000);
+        tasks["urgent"]->m_priority = 10;
+        auto taskHosts = placements(other.schedule(tasks, nodes, {}));
+        REQUIRE(taskHosts["urgent"].size() == 2);
+        REQUIRE(taskHosts.count("low1") == 0);
+    }
+
+    SECTION("higher priority task evicts lower priority replicas")
+    {
+        tasks["urgent"] = makeTask("urgent", 1, "", 3000);
+        tasks["urgent"]->m_priority = 10;
+        auto newTopology = scheduler.schedule(tasks, nodes, topology);
+        auto taskHosts = placements(newTopology);
+        REQUIRE(taskHosts["urgent"].size() == 1);
+        auto host = *taskHosts["urgent"].begin();
+        REQUIRE(newTopology[host]->m_scheduleApps.size() == 1);
+        // replicas on the other node are not moved
+        auto other = host == "a" ? "b" : "a";
+        REQUIRE(newTopology[other]->m_scheduleApps == topology[other]->m_scheduleApps);
+    }
+
+    SECTION("same priority does not preempt")
+    {
+        tasks["peer"] = makeTask("peer", 1, "", 3000);
+        auto newTopology = scheduler.schedule(tasks, nodes, topology);
+        REQUIRE(placements(newTopology).count("peer") == 0);
+    }
+
+    SECTION("evictions are bounded per pass")
+    {
+        NodeMap single;
+        single["x"] = makeNode("x", "east", 4, 4000);
+        TaskMap small;
+        for (int i = 0; i < SCHEDULE_MAX_PREEMPTIONS_PER_PASS + 4; i++)
+        {
+            auto name = std::string("small") + std::to_string(i);
+            small[name] = makeTask(name, 1, "", 200);
+        }
+        Scheduler bounded;
+        auto smallTopology = bounded.schedule(small, single, {});
+        small["urgent"] = makeTask("urgent", 1, "", 4000);
+        small["urgent"]->m_priority = 10;
+        auto newTopology = bounded.schedule(small, single, smallTopology);
+        REQUIRE(newTopology["x"]->m_scheduleApps == smallTopology["x"]->m_scheduleApps);
+    }
+}
+
+// full recompute as scheduled before the incremental Scheduler, baseline of benchmark:
+// every pass match all tasks with all nodes, keep old placements still matched and
+// fill replicas on matched nodes with least assigned apps. Assignment state is kept
+// here instead of ConsulTask and ConsulNode fields used by the old code.
+TopologyMap fullRecompute(const TaskMap &taskMap, const NodeMap &nodes, const TopologyMap &oldTopology)
+{
+    struct NodeState
+    {
+        std::shared_ptr<ConsulNode> m_node;
+        std::map<std::string, std::shared_ptr<Application>> m_assignedApps;
+    };
+    struct TaskState
+    {
+        std::map<std::string, NodeState *> m_matchedHosts;
+        std::set<int> m_taskIndexDic;
+        std::size_t m_replication;
+    };
+    std::map<std::string, NodeState> nodeStates;
+    for (const auto &node : nodes)
+        nodeStates[node.first].m_node = node.second;
+
+    // find matched hosts for each task
+    std::map<std::string, TaskState> taskStates;
+    for (const auto &task : taskMap)
+    {
+        auto &state = taskStates[task.first];
+        state.m_replication = task.second->m_replication;
+        for (std::size_t i = 1; i <= state.m_replication; i++)
+            state.m_taskIndexDic.insert(i);
+        for (auto &node : nodeStates)
+        {
+            if (node.second.m_node->m_label->match(task.second->m_condition))
+                state.m_matchedHosts[node.first] = &node.second;
+        }
+    }
+
+    // keep old placements still matched
+    TopologyMap newTopology;
+    for (const auto &task : taskMap)
+    {
+        const auto &taskName = task.first;
+        auto &state = taskStates[taskName];
+        for (const auto &oldHost : oldTopology)
+        {
+            const auto &oldTaskSet = oldHost.second->m_scheduleApps;
+            auto oldTask = oldTaskSet.find(taskName);
+            if (state.m_replication == 0 || oldTask == oldTaskSet.end() || !state.m_matchedHosts.count(oldHost.first))
+                continue;
+            auto nodeState = state.m_matchedHosts[oldHost.first];
+            state.m_matchedHosts.erase(oldHost.first);
+            state.m_taskIndexDic.erase(oldTask->second);
+            --state.m_replication;
+            if (!newTopology.count(oldHost.first))
+                newTopology[oldHost.first] = std::make_shared<ConsulTopology>();
+            newTopology[oldHost.first]->m_scheduleApps[taskName] = oldTask->second;
+            nodeState->m_assignedApps[task.second->m_app->getName()] = task.second->m_app;
+        }
+    }
+
+    // fill replicas, higher priority task first
+    std::vector<std::pair<std::string, std::shared_ptr<ConsulTask>>> orderedTasks(taskMap.begin(), taskMap.end());
+    std::stable_sort(orderedTasks.begin(), orderedTasks.end(),
+                     [](const std::pair<std::string, std::shared_ptr<ConsulTask>> &a, const std::pair<std::string, std::shared_ptr<ConsulTask>> &b) {
+                         return a.second->m_priority > b.second->m_priority;
+                     });
+    for (const auto &task : orderedTasks)
+    {
+        const auto &taskName = task.first;
+        auto &state = taskStates[taskName];
+        if (state.m_replication == 0)
+            continue;
+        std::vector<NodeState *> hosts;
+        for (const auto &host : state.m_matchedHosts)
+            hosts.push_back(host.second);
+        // assigned memory was always 0, order by assigned app count
+        std::sort(hosts.begin(), hosts.end(), [](const NodeState *left, const NodeState *right) { return left->m_assignedApps.size() < right->m_assignedApps.size(); });
+        for (std::size_t i = 0; i < state.m_replication && i < hosts.size(); i++)
+        {
+            const auto &hostName = hosts[i]->m_node->m_hostName;
+            if (!newTopology.count(hostName))
+                newTopology[hostName] = std::make_shared<ConsulTopology>();
+            int selectedIndex = -1;
+            if (state.m_taskIndexDic.size())
+            {
+                selectedIndex = *(state.m_taskIndexDic.begin());
+                state.m_taskIndexDic.erase(state.m_taskIndexDic.begin());
+            }
+            newTopology[hostName]->m_scheduleApps[taskName] = selectedIndex;
+            hosts[i]->m_assignedApps[task.second->m_app->getName()] = task.second->m_app;
+        }
+    }
+    return newTopology;
+}
+
+std::size_t replicaCount(const TopologyMap &topology)
+{
+    std::size_t count = 0;
+    for (const auto &host : topology)
+        count += host.second->m_scheduleApps.size();
+    return count;
+}
+
+// run with: test_scheduler [benchmark]
+TEST_CASE("Scheduler Benchmark", "[.][benchmark]")
+{
+    init("INFO");
+
+    const std::size_t taskCount = 10000;
+    const std::size_t nodeCount = 1000;
+    NodeMap nodes;
+    for (std::size_t i = 0; i < nodeCount; i++)
+    {
+        auto host = std::string("host") + std::to_string(i);
+        nodes[host] = makeNode(host, std::string("zone") + std::to_string(i % 10));
+    }
+    // half of tasks have zone condition
+    TaskMap tasks;
+    for (std::size_t i = 0; i < taskCount; i++)
+    {
+        auto name = std::string("app") + std::to_string(i);
+        tasks[name] = makeTask(name, 3, (i % 2) ? std::string("zone") + std::to_string(i % 10) : "");
+    }
+    auto elapsed = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // cold pass place all tasks, delta pass follow 1 task added and 1 node departed;
+    // baseline recompute everything in both passes
+    auto start = std::chrono::steady_clock::now();
+    auto fullTopology = fullRecompute(tasks, nodes, {});
+    const auto fullColdMs = elapsed(start);
+    Scheduler scheduler;
+    start = std::chrono::steady_clock::now();
+    auto topology = scheduler.schedule(tasks, nodes, {});
+    const auto incrColdMs = elapsed(start);
+    REQUIRE(replicaCount(fullTopology) == taskCount * 3);
+    REQUIRE(replicaCount(topology) == taskCount * 3);
+
+    tasks["appNew"] = makeTask("appNew", 3);
+    nodes.erase("host0");
+    start = std::chrono::steady_clock::now();
+    fullTopology = fullRecompute(tasks, nodes, fullTopology);
+    const auto fullDeltaMs = elapsed(start);
+    start = std::chrono::steady_clock::now();
+    topology = scheduler.schedule(tasks, nodes, topology);
+    const auto incrDeltaMs = elapsed(start);
+    REQUIRE(replicaCount(fullTopology) == (taskCount + 1) * 3);
+    REQUIRE(replicaCount(topology) == (taskCount + 1) * 3);
+
+    std::cout << "tasks <" << taskCount << "> nodes <" << nodeCount << ">" << std::endl
+              << "cold pass  : full recompute " << fullColdMs << " ms, incremental " << incrColdMs << " ms" << std::endl
+              << "delta pass : full recompute " << fullDeltaMs << " ms, incremental " << incrDeltaMs << " ms (1 task added, 1 node departed)" << std::endl;
+    REQUIRE(topology.size() == nodeCount - 1);
+}
@@ -2,9 +2,15 @@
 #include "../catch.hpp"
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 #include <set>
 #include <fstream>
 #include <ace/Init_ACE.h>
@@ -16,8 +22,17 @@
 #include <log4cpp/PatternLayout.hh>
 #include <log4cpp/RollingFileAppender.hh>
 #include <log4cpp/OstreamAppender.hh>
+#include <zlib.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "../../src/common/AsyncLogAppender.h"
+#include "../../src/common/Compression.h"
 #include "../../src/common/DateTime.h"
+#include "../../src/common/JsonLogLayout.h"
 #include "../../src/common/Utility.h"
+#include "../../src/daemon/rest/FileUpload.h"
+#include "../../src/daemon/rest/HttpServer.h"
+#include "../../src/daemon/rest/SslTicketKeys.h"
 
 void init()
 {
@@ -112,3 +127,696 @@ TEST_CASE("Utility Test", "[Utility]")
 
     // teardown
 }
+
+TEST_CASE("Compression Test", "[Compression]")
+{
+    init();
+
+    SECTION("gzip round trip")
+    {
+        std::string text;
+        for (int i = 0; i < 1000; i++)
+        {
+            text += "appmesh_prom_process_memory_gauge{host=\"myhost\",pid=\"" + std::to_string(i) + "\"} 1024\n";
+        }
+        auto compressed = Compression::gzip(text);
+        REQUIRE(compressed.size() < text.size());
+        // gzip magic number
+        REQUIRE(static_cast<unsigned char>(compressed[0]) == 0x1f);
+        REQUIRE(static_cast<unsigned char>(compressed[1]) == 0x8b);
+
+        z_stream stream{};
+        REQUIRE(inflateInit2(&stream, 15 + 16) == Z_OK);
+        std::string inflated(text.size(), '\0');
+        stream.next_in = reinterpret_cast<Bytef *>(&compressed[0]);
+        stream.avail_in = compressed.size();
+        stream.next_out = reinterpret_cast<Bytef *>(&inflated[0]);
+        stream.avail_out = inflated.size();
+        REQUIRE(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+        inflateEnd(&stream);
+        REQUIRE(inflated == text);
+        REQUIRE(Compression::gzip("").size() > 0);
+    }
+
+    SECTION("Accept-Encoding parse")
+    {
+        REQUIRE(Compression::acceptEncoding("gzip", "gzip"));
+        REQUIRE(Compression::acceptEncoding("deflate, GZIP;q=0.5", "gzip"));
+        REQUIRE_FALSE(Compression::acceptEncoding("gzip;q=0, identity", "gzip"));
+        REQUIRE_FALSE(Compression::acceptEncoding("identity", "gzip"));
+        REQUIRE_FALSE(Compression::acceptEncoding("", "gzip"));
+    }
+
+    SECTION("encoding negotiate and round trip")
+    {
+        REQUIRE(Compression::negotiate("deflate, gzip") == "gzip");
+        REQUIRE(Compression::negotiate("gzip;q=0, identity") == "");
+        REQUIRE(Compression::negotiate("") == "");
+        const auto supported = Compression::supportedEncodings();
+        REQUIRE(Compression::negotiate(supported) == Utility::stdStringTrim(Utility::splitString(supported, ",")[0]));
+
+        std::string text;
+        for (int i = 0; i < 10000; i++)
+        {
+            text += "{\"name\":\"app" + std::to_string(i) + "\",\"status\":1},";
+        }
+        for (const auto &item : Utility::splitString(supported, ","))
+        {
+            const auto encoding = Utility::stdStringTrim(item);
+            auto compressed = Compression::compress(text, encoding);
+            REQUIRE(compressed.size() < text.size() / 4);
+            REQUIRE(Compression::decompress(compressed, encoding) == text);
+            REQUIRE_THROWS(Compression::decompress(compressed.substr(0, compressed.size() / 2), encoding));
+        }
+        REQUIRE_THROWS(Compression::compress(text, "br"));
+    }
+
+    SECTION("crc32 check value")
+    {
+        const std::string text = "123456789";
+        REQUIRE(Compression::crc32(text.data(), text.size()) == 0xCBF43926);
+        REQUIRE(Compression::crc32(text.data() + 4, 5, Compression::crc32(text.data(), 4)) == 0xCBF43926);
+    }
+}
+
+TEST_CASE("Log Level Test", "[Log]")
+{
+    init();
+
+    int evaluated = 0;
+    auto operand = [&evaluated]() { return ++evaluated; };
+    REQUIRE(Utility::setLogLevel("INFO"));
+    REQUIRE(Utility::logPriority() == log4cpp::Priority::INFO);
+    LOG_DBG << "disabled level " << operand();
+    REQUIRE(evaluated == 0);
+    LOG_INF << "enabled level " << operand();
+    REQUIRE(evaluated == 1);
+    REQUIRE(Utility::setLogLevel("DEBUG"));
+    LOG_DBG << "enabled level " << operand();
+    REQUIRE(evaluated == 2);
+}
+
+// downstream appender record messages, optionally slow down consumer
+class RecordAppender : public log4cpp::AppenderSkeleton
+{
+public:
+    explicit RecordAppender(std::vector<std::string> &lines, int delayUs = 0)
+        : log4cpp::AppenderSkeleton("record"), m_lines(lines), m_delayUs(delayUs) {}
+    void close() override {}
+    bool requiresLayout() const override { return false; }
+    void setLayout(log4cpp::Layout *) override {}
+
+protected:
+    void _append(const log4cpp::LoggingEvent &event) override
+    {
+        if (m_delayUs)
+            std::this_thread::sleep_for(std::chrono::microseconds(m_delayUs));
+        m_lines.push_back(event.message);
+    }
+
+private:
+    std::vector<std::string> &m_lines;
+    const int m_delayUs;
+};
+
+TEST_CASE("Async Log Appender Test", "[AsyncLog]")
+{
+    SECTION("blocking priority keep all lines and thread order")
+    {
+        std::vector<std::string> lines;
+        auto appender = std::make_unique<AsyncLogAppender>("async", 16, log4cpp::Priority::WARN);
+        appender->addAppender(new RecordAppender(lines));
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([t, &appender]() {
+                for (int i = 0; i < 2000; i++)
+                {
+                    appender->doAppend(log4cpp::LoggingEvent("", std::to_string(t) + ":" + std::to_string(i), "", log4cpp::Priority::ERROR));
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        appender->flush();
+        REQUIRE(lines.size() == 8000);
+        std::map<int, int> next;
+        for (const auto &line : lines)
+        {
+            auto pos = line.find(':');
+            auto t = std::stoi(line.substr(0, pos));
+            REQUIRE(std::stoi(line.substr(pos + 1)) == next[t]++);
+        }
+    }
+
+    SECTION("full ring drop less severe lines")
+    {
+        std::vector<std::string> lines;
+        const auto droppedBefore = AsyncLogAppender::droppedLines();
+        auto appender = std::make_unique<AsyncLogAppender>("async", 8, log4cpp::Priority::WARN);
+        appender->addAppender(new RecordAppender(lines, 100));
+        for (int i = 0; i < 1000; i++)
+        {
+            appender->doAppend(log4cpp::LoggingEvent("", std::to_string(i), "", log4cpp::Priority::DEBUG));
+        }
+        appender->close();
+        const auto dropped = AsyncLogAppender::droppedLines() - droppedBefore;
+        REQUIRE(dropped > 0);
+        // one extra line report dropped count
+        std::size_t reports = 0;
+        for (const auto &line : lines)
+        {
+            if (line.find("log lines dropped") != std::string::npos)
+                reports++;
+        }
+        REQUIRE(reports > 0);
+        REQUIRE(lines.size() - reports + dropped == 1000);
+    }
+}
+
+TEST_CASE("Json Log Layout Test", "[JsonLog]")
+{
+    JsonLogLayout layout;
+    log4cpp::LoggingEvent event("", "Application::invoke() app \"a\"\tstarted\n", "myapp", log4cpp::Priority::INFO);
+    auto line = layout.format(event);
+    REQUIRE(line.back() == '\n');
+    auto json = web::json::value::parse(line.substr(0, line.length() - 1));
+    REQUIRE(json.at("level").as_string() == "INFO");
+    REQUIRE(json.at("component").as_string() == "Application::invoke");
+    REQUIRE(json.at("app").as_string() == "myapp");
+    REQUIRE(json.at("message").as_string() == "app \"a\"\tstarted\n");
+    REQUIRE(json.at("thread").as_string() == event.threadName);
+    // 2021-01-01T00:00:00.000Z
+    REQUIRE(json.at("timestamp").as_string().length() == 24);
+
+    // message without fname keep whole text
+    log4cpp::LoggingEvent plain("", "Logging process ID:1 \x01", "", log4cpp::Priority::DEBUG);
+    json = web::json::value::parse(layout.format(plain));
+    REQUIRE(json.at("component").as_string() == "");
+    REQUIRE(json.at("message").as_string() == "Logging process ID:1 \x01");
+}
+
+namespace
+{
+    // send raw request text and read until server close connection
+    std::string httpExchange(int port, const std::string &request)
+    {
+        boost::asio::io_context io;
+        boost::asio::ip::tcp::socket socket(io);
+        socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), port));
+        boost::asio::write(socket, boost::asio::buffer(request));
+        std::string response;
+        boost::system::error_code ec;
+        boost::asio::read(socket, boost::asio::dynamic_buffer(response), ec);
+        return response;
+    }
+
+    // handlers are blocked until released, test wait for handlers entered instead of sleep
+    class HandlerGate
+    {
+    public:
+        void enter(bool block)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_entered++;
+            m_cv.notify_all();
+            if (block)
+                m_cv.wait(lock, [this]() { return m_released; });
+        }
+        void waitEntered(int count)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this, count]() { return m_entered >= count; });
+        }
+        void release()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_released = true;
+            m_cv.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        int m_entered = 0;
+        bool m_released = false;
+    };
+
+    std::string bodyPattern(std::size_t size)
+    {
+        std::string body(size, 'a');
+        for (std::size_t i = 0; i < size; i++)
+            body[i] = 'a' + i % 26;
+        return body;
+    }
+} // namespace
+
+TEST_CASE("Http Server Test", "[HttpServer]")
+{
+    init();
+    HttpServerOptions options;
+    options.m_address = "127.0.0.1";
+    // port chosen by system
+    options.m_port = 0;
+    options.m_handlerThreads = 3;
+    options.m_maxConcurrentRequests = 3;
+    options.m_maxBodyBytes = 1024;
+    options.m_streamBody = [](const HttpServerRequest &request) { return request.m_target.compare(0, 7, "/upload") == 0; };
+    HandlerGate gate;
+    HttpServer server(options, [&gate](const std::shared_ptr<HttpExchange> &exchange) {
+        const auto &request = exchange->request();
+        gate.enter(request.m_target == "/slow");
+        HttpServerResponse response;
+        if (request.m_target == "/upload/reject")
+        {
+            // reply without read body
+            response.m_status = 403;
+        }
+        else if (request.m_bodyStream)
+        {
+            std::string body;
+            char buffer[4096];
+            while (const auto size = request.m_bodyStream->read(buffer, sizeof(buffer)))
+                body.append(buffer, size);
+            response.m_body = request.m_method + " " + request.m_target + " " + std::to_string(body.size()) + (body == bodyPattern(body.size()) ? " match" : " mismatch");
+        }
+        else
+        {
+            response.m_body = request.m_method + " " + request.m_target + " " + request.m_body;
+        }
+        exchange->reply(std::move(response));
+    });
+    // blocked handlers return before server is closed when test failed
+    std::shared_ptr<HandlerGate> releaseGuard(&gate, [](HandlerGate *handlerGate) { handlerGate->release(); });
+    server.open();
+    const int port = server.port();
+    REQUIRE(port > 0);
+
+    SECTION("pipelined replies keep request order")
+    {
+        std::string response;
+        std::thread client([&]() {
+            response = httpExchange(port,
+                                    "GET /slow HTTP/1.1\r\n\r\n"
+                                    "POST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nab\r\n1\r\nc\r\n0\r\n\r\n"
+                                    "GET /c HTTP/1.1\r\nConnection: close\r\n\r\n"
+                                    "GET /ignored HTTP/1.1\r\n\r\n");
+        });
+        // later requests are handled before the slow one
+        gate.waitEntered(3);
+        gate.release();
+        client.join();
+        const auto slow = response.find("GET /slow");
+        const auto post = response.find("POST /b abc");
+        const auto close = response.find("Connection: close\r\n\r\nGET /c");
+        REQUIRE(slow != std::string::npos);
+        REQUIRE(post > slow);
+        REQUIRE(close > post);
+        REQUIRE(close != std::string::npos);
+        REQUIRE(response.find("/ignored") == std::string::npos);
+    }
+
+    SECTION("busy server reply 503")
+    {
+        // 3 slow requests fill max concurrent requests
+        std::string slowResponse;
+        std::thread slow([&]() { slowResponse = httpExchange(port, "GET /slow HTTP/1.1\r\n\r\nGET /slow HTTP/1.1\r\n\r\nGET /slow HTTP/1.1\r\nConnection: close\r\n\r\n"); });
+        gate.waitEntered(3);
+        auto response = httpExchange(port, "GET /a HTTP/1.0\r\n\r\n");
+        gate.release();
+        slow.join();
+        REQUIRE(response.find("HTTP/1.1 503 ") == 0);
+        REQUIRE(response.find("Retry-After: 1") != std::string::npos);
+        REQUIRE(slowResponse.find("HTTP/1.1 200 ") == 0);
+        REQUIRE(slowResponse.find("503") == std::string::npos);
+        REQUIRE(server.inflightRequests() == 0);
+        // served again when not busy
+        response = httpExchange(port, "GET /a HTTP/1.0\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 200 ") == 0);
+    }
+
+    SECTION("bad request close connection")
+    {
+        auto response = httpExchange(port, "garbage\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 400 ") == 0);
+    }
+
+    SECTION("buffered body is limited")
+    {
+        auto response = httpExchange(port, "POST /b HTTP/1.1\r\nContent-Length: 1025\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 413 ") == 0);
+        response = httpExchange(port, "POST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n258\r\n" + bodyPattern(600) + "\r\n258\r\n" + bodyPattern(600) + "\r\n0\r\n\r\n");
+        REQUIRE(response.find("HTTP/1.1 413 ") == 0);
+    }
+
+    SECTION("large body is streamed")
+    {
+        // body larger than stream buffer pause and resume reading
+        const std::size_t size = 3 * HTTP_SERVER_BODY_BUFFER_BYTES + 5;
+        auto response = httpExchange(port, "PUT /upload HTTP/1.1\r\nContent-Length: " + std::to_string(size) + "\r\nConnection: close\r\n\r\n" + bodyPattern(size));
+        REQUIRE(response.find("HTTP/1.1 200 ") == 0);
+        REQUIRE(response.find("PUT /upload " + std::to_string(size) + " match") != std::string::npos);
+
+        // chunked body is streamed and following request is served on same connection
+        response = httpExchange(port,
+                                "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nab\r\n801\r\n" + bodyPattern(2051).substr(2) + "\r\n0\r\nX-Trailer: 1\r\n\r\n"
+                                "GET /c HTTP/1.1\r\nConnection: close\r\n\r\n");
+        const auto upload = response.find("POST /upload 2051 match");
+        REQUIRE(upload != std::string::npos);
+        REQUIRE(response.find("GET /c", upload) != std::string::npos);
+
+        // reply before body is read close connection
+        response = httpExchange(port, "POST /upload/reject HTTP/1.1\r\nContent-Length: 100\r\n\r\nabc");
+        REQUIRE(response.find("HTTP/1.1 403 ") == 0);
+        REQUIRE(response.find("Connection: close\r\n") != std::string::npos);
+    }
+    server.close();
+}
+
+TEST_CASE("Http Server Local Socket Test", "[HttpServer]")
+{
+    init();
+    HttpServerOptions options;
+    options.m_localSocketPath = Utility::getSelfDir() + "/test_appmesh.sock";
+    HttpServer server(options, [](const std::shared_ptr<HttpExchange> &exchange) {
+        HttpServerResponse response;
+        response.m_body = std::to_string(exchange->request().m_peerUid);
+        exchange->reply(std::move(response));
+    });
+    server.open();
+
+    boost::asio::io_context io;
+    boost::asio::local::stream_protocol::socket socket(io);
+    socket.connect(boost::asio::local::stream_protocol::endpoint(options.m_localSocketPath));
+    boost::asio::write(socket, boost::asio::buffer(std::string("GET /uid HTTP/1.1\r\nConnection: close\r\n\r\n")));
+    std::string response;
+    boost::system::error_code ec;
+    boost::asio::read(socket, boost::asio::dynamic_buffer(response), ec);
+    // peer credential of this process
+    REQUIRE(response.find("HTTP/1.1 200 ") == 0);
+    REQUIRE(response.substr(response.find("\r\n\r\n") + 4) == std::to_string(::getuid()));
+
+    struct stat st;
+    REQUIRE(::lstat(options.m_localSocketPath.c_str(), &st) == 0);
+    REQUIRE((st.st_mode & 0777) == 0660);
+
+    server.close();
+    // socket file is removed when closed
+    REQUIRE_FALSE(Utility::isFileExist(options.m_localSocketPath));
+
+    // file which is not a socket is not removed
+    std::ofstream(options.m_localSocketPath) << "data";
+    HttpServer fileServer(options, [](const std::shared_ptr<HttpExchange> &) {});
+    REQUIRE_THROWS_AS(fileServer.open(), std::runtime_error);
+    fileServer.close();
+    REQUIRE(Utility::isFileExist(options.m_localSocketPath));
+    ::unlink(options.m_localSocketPath.c_str());
+}
+
+TEST_CASE("Http File Range Test", "[HttpServer]")
+{
+    init();
+    const std::string etag = "\"1-2-3\"";
+    const std::string range = "bytes=10-19", suffix = "bytes=-5", open = "bytes=95-", beyond = "bytes=100-", multiple = "bytes=0-1,5-6";
+    auto result = HttpFileRange::parse(&range, nullptr, etag, 100);
+    REQUIRE(result.m_status == 206);
+    REQUIRE(result.m_offset == 10);
+    REQUIRE(result.m_length == 10);
+    REQUIRE(result.contentRange() == "bytes 10-19/100");
+    result = HttpFileRange::parse(&suffix, &etag, etag, 100);
+    REQUIRE(result.m_status == 206);
+    REQUIRE(result.m_offset == 95);
+    REQUIRE(HttpFileRange::parse(&open, nullptr, etag, 100).m_length == 5);
+    result = HttpFileRange::parse(&beyond, nullptr, etag, 100);
+    REQUIRE(result.m_status == 416);
+    REQUIRE(result.contentRange() == "bytes */100");
+    // whole file for multiple ranges and changed file
+    REQUIRE(HttpFileRange::parse(&multiple, nullptr, etag, 100).m_status == 200);
+    const std::string oldEtag = "\"1-2-0\"";
+    result = HttpFileRange::parse(&range, &oldEtag, etag, 100);
+    REQUIRE(result.m_status == 200);
+    REQUIRE(result.m_length == 100);
+
+    // file region is sent by sendfile() after headers
+    const auto path = Utility::getSelfDir() + "/test_http_file.txt";
+    std::ofstream(path) << "0123456789";
+    HttpServerOptions options;
+    options.m_address = "127.0.0.1";
+    options.m_port = 0;
+    HttpServer server(options, [&path](const std::shared_ptr<HttpExchange> &exchange) {
+        HttpServerResponse response;
+        response.m_status = 206;
+        response.m_file = std::make_shared<HttpServerFile>(::open(path.c_str(), O_RDONLY), 2, 5);
+        exchange->reply(std::move(response));
+    });
+    server.open();
+    auto response = httpExchange(server.port(), "GET /file HTTP/1.1\r\nConnection: close\r\n\r\n");
+    REQUIRE(response.find("HTTP/1.1 206 ") == 0);
+    REQUIRE(response.find("Content-Length: 5\r\n") != std::string::npos);
+    REQUIRE(response.substr(response.find("\r\n\r\n") + 4) == "23456");
+    server.close();
+    ::unlink(path.c_str());
+}
+
+TEST_CASE("File Upload Test", "[FileUpload]")
+{
+    init();
+    const auto path = Utility::getSelfDir() + "/test_file_upload.txt";
+    ::unlink(path.c_str());
+    const std::string text = "0123456789abcdefghij";
+    auto crc = [&text](std::size_t offset, std::size_t size) { return Compression::crc32(text.data() + offset, size); };
+
+    FileUploadManager uploads(2, 3600, "");
+    auto upload = uploads.create("admin", path, text.size(), 0, "");
+    REQUIRE_THROWS(uploads.create("admin", path, text.size(), 0, ""));
+    REQUIRE(uploads.get(upload->id(), "admin") == upload);
+    REQUIRE(uploads.get(upload->id(), "user") == nullptr);
+
+    // chunks in any order, re-sent chunk and overlapped chunk are merged
+    upload->write(10, text.data() + 10, 5, crc(10, 5));
+    upload->write(0, text.data(), 5, crc(0, 5));
+    upload->write(0, text.data(), 5, crc(0, 5));
+    REQUIRE_THROWS(upload->write(5, text.data() + 5, 5, crc(5, 4)));
+    REQUIRE_THROWS(upload->write(15, text.data() + 15, 6, crc(15, 6)));
+    REQUIRE(upload->receivedBytes() == 10);
+    REQUIRE(upload->receivedRanges().size() == 2);
+    REQUIRE_THROWS(upload->commit());
+    upload->write(3, text.data() + 3, 10, crc(3, 10));
+    upload->write(15, text.data() + 15, 5, crc(15, 5));
+    REQUIRE(upload->receivedRanges().size() == 1);
+    REQUIRE_FALSE(Utility::isFileExist(path));
+    upload->commit();
+    REQUIRE(uploads.remove(upload->id(), "admin"));
+    REQUIRE(Utility::readFileCpp(path) == text);
+
+    // target exist, cancelled upload remove temporary file
+    REQUIRE_THROWS(uploads.create("admin", path, text.size(), 0, ""));
+    ::unlink(path.c_str());
+    upload = uploads.create("admin", path, text.size(), 0, "");
+    upload->write(0, text.data(), 5, crc(0, 5));
+    auto tempPath = upload->tempPath();
+    REQUIRE(Utility::isFileExist(tempPath));
+    REQUIRE(uploads.remove(upload->id(), "admin"));
+    upload.reset();
+    REQUIRE_FALSE(Utility::isFileExist(tempPath));
+    REQUIRE_FALSE(Utility::isFileExist(path));
+    REQUIRE(uploads.create("admin", path, 0, 0, "") != nullptr);
+
+    // idle upload is removed with temporary file
+    FileUploadManager idleUploads(1, 0, "");
+    tempPath = idleUploads.create("admin", path + ".idle", text.size(), 0, "")->tempPath();
+    REQUIRE(Utility::isFileExist(tempPath));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    idleUploads.expire();
+    REQUIRE_FALSE(Utility::isFileExist(tempPath));
+
+    // upload is resumed with received ranges after restart
+    const auto statePath = Utility::getSelfDir() + "/test_file_upload.state";
+    const auto resumePath = path + ".resume";
+    ::unlink(statePath.c_str());
+    ::unlink(resumePath.c_str());
+    {
+        FileUploadManager before(1, 3600, statePath);
+        auto saved = before.create("admin", resumePath, text.size(), 0, "");
+        saved->write(0, text.data(), 5, crc(0, 5));
+        before.save();
+        FileUploadManager after(1, 3600, statePath);
+        after.recover();
+        auto resumed = after.get(saved->id(), "admin");
+        REQUIRE(resumed != nullptr);
+        REQUIRE(resumed->receivedBytes() == 5);
+        resumed->write(5, text.data() + 5, 15, crc(5, 15));
+        resumed->commit();
+        REQUIRE(after.remove(saved->id(), "admin"));
+        REQUIRE(Utility::readFileCpp(resumePath) == text);
+        REQUIRE_FALSE(Utility::isFileExist(saved->tempPath()));
+    }
+    ::unlink(statePath.c_str());
+    ::unlink(resumePath.c_str());
+
+    // chunk read by pieces, read bytes are limited, bytes of failed chunk are received again
+    const auto piecePath = Utility::getSelfDir() + "/test_file_upload_piece.txt";
+    ::unlink(piecePath.c_str());
+    auto reader = [&text](std::size_t offset, std::size_t size) {
+        auto pos = std::make_shared<std::size_t>(offset);
+        return [&text, pos, offset, size](char *buffer, std::size_t length) {
+            length = std::min(std::min<std::size_t>(length, 3), offset + size - *pos);
+            std::memcpy(buffer, text.data() + *pos, length);
+            *pos += length;
+            return length;
+        };
+    };
+    upload = uploads.create("admin", piecePath, text.size(), 0, "");
+    auto checksum = crc(0, 10);
+    REQUIRE(upload->write(0, reader(0, 10), 10, &checksum) == 10);
+    REQUIRE_THROWS_AS(upload->write(0, reader(0, 10), 9, nullptr), std::length_error);
+    REQUIRE(upload->receivedBytes() == 1);
+    checksum = crc(0, 9);
+    REQUIRE_THROWS(upload->write(5, reader(5, 10), 64, &checksum));
+    REQUIRE(upload->receivedBytes() == 0);
+    REQUIRE(upload->write(0, reader(0, text.size()), 64, nullptr) == text.size());
+    upload->commit();
+    REQUIRE(Utility::readFileCpp(piecePath) == text);
+    ::unlink(piecePath.c_str());
+}
+
+// friend of SslTicketKeys, move key time back instead of waiting rotate period
+class SslTicketKeysTest
+{
+public:
+    static void age(SslTicketKeys &keys, std::chrono::seconds duration)
+    {
+        keys.m_current.m_createTime -= duration;
+        keys.m_previous.m_createTime -= duration;
+    }
+    static std::string currentName(SslTicketKeys &keys)
+    {
+        SslTicketKeys::TicketKey key;
+        REQUIRE(keys.currentKey(key));
+        return std::string(reinterpret_cast<const char *>(key.m_name), sizeof(key.m_name));
+    }
+    static bool findKey(SslTicketKeys &keys, const std::string &name, bool &renew)
+    {
+        SslTicketKeys::TicketKey key;
+        return keys.findKey(reinterpret_cast<const unsigned char *>(name.data()), key, renew);
+    }
+};
+
+namespace
+{
+    // self-signed server context with ticket keys installed
+    std::shared_ptr<SSL_CTX> ticketServerContext(SslTicketKeys &keys)
+    {
+        std::shared_ptr<SSL_CTX> ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+        std::shared_ptr<EVP_PKEY> pkey(EVP_PKEY_new(), EVP_PKEY_free);
+        std::shared_ptr<EVP_PKEY_CTX> pkeyCtx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+        EVP_PKEY *key = nullptr;
+        REQUIRE(EVP_PKEY_keygen_init(pkeyCtx.get()) == 1);
+        REQUIRE(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pkeyCtx.get(), NID_X9_62_prime256v1) == 1);
+        REQUIRE(EVP_PKEY_keygen(pkeyCtx.get(), &key) == 1);
+        pkey.reset(key, EVP_PKEY_free);
+        std::shared_ptr<X509> cert(X509_new(), X509_free);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert.get()), "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert.get(), X509_get_subject_name(cert.get()));
+        X509_set_pubkey(cert.get(), pkey.get());
+        REQUIRE(X509_sign(cert.get(), pkey.get(), EVP_sha256()) > 0);
+        REQUIRE(SSL_CTX_use_certificate(ctx.get(), cert.get()) == 1);
+        REQUIRE(SSL_CTX_use_PrivateKey(ctx.get(), pkey.get()) == 1);
+        keys.install(ctx.get());
+        return ctx;
+    }
+
+    // handshake through memory BIO pair, return true when session is resumed
+    bool ticketHandshake(SSL_CTX *serverCtx, SSL_CTX *clientCtx, std::shared_ptr<SSL_SESSION> &session)
+    {
+        std::shared_ptr<SSL> server(SSL_new(serverCtx), SSL_free);
+        std::shared_ptr<SSL> client(SSL_new(clientCtx), SSL_free);
+        BIO *serverBio = nullptr, *clientBio = nullptr;
+        REQUIRE(BIO_new_bio_pair(&serverBio, 0, &clientBio, 0) == 1);
+        SSL_set_bio(server.get(), serverBio, serverBio);
+        SSL_set_bio(client.get(), clientBio, clientBio);
+        SSL_set_accept_state(server.get());
+        SSL_set_connect_state(client.get());
+        if (session)
+            SSL_set_session(client.get(), session.get());
+
+        bool serverDone = false, clientDone = false;
+        for (int i = 0; i < 10 && !(serverDone && clientDone); i++)
+        {
+            clientDone = clientDone || SSL_do_handshake(client.get()) == 1;
+            serverDone = serverDone || SSL_do_handshake(server.get()) == 1;
+        }
+        REQUIRE(serverDone);
+        REQUIRE(clientDone);
+        // TLS 1.3 ticket is sent after handshake, read it with application data
+        char data = 0;
+        REQUIRE(SSL_write(server.get(), "x", 1) == 1);
+        REQUIRE(SSL_read(client.get(), &data, 1) == 1);
+        session.reset(SSL_get1_session(client.get()), SSL_SESSION_free);
+        // session of connection freed without shutdown is not resumable
+        SSL_shutdown(client.get());
+        SSL_shutdown(server.get());
+        return SSL_session_reused(client.get()) == 1;
+    }
+} // namespace
+
+TEST_CASE("Ssl Ticket Keys Test", "[SslTicketKeys]")
+{
+    init();
+    const auto period = std::chrono::seconds(60);
+    SslTicketKeys keys(period.count());
+
+    SECTION("rotate and accept previous key")
+    {
+        const auto first = SslTicketKeysTest::currentName(keys);
+        REQUIRE(SslTicketKeysTest::currentName(keys) == first);
+        bool renew = true;
+        REQUIRE(SslTicketKeysTest::findKey(keys, first, renew));
+        REQUIRE_FALSE(renew);
+
+        // previous key decrypt ticket and ask for renew
+        SslTicketKeysTest::age(keys, period);
+        const auto second = SslTicketKeysTest::currentName(keys);
+        REQUIRE(second != first);
+        REQUIRE(SslTicketKeysTest::findKey(keys, first, renew));
+        REQUIRE(renew);
+        REQUIRE(SslTicketKeysTest::findKey(keys, second, renew));
+        REQUIRE_FALSE(renew);
+
+        // key older than two periods is dropped
+        SslTicketKeysTest::age(keys, period);
+        REQUIRE(SslTicketKeysTest::currentName(keys) != second);
+        REQUIRE_FALSE(SslTicketKeysTest::findKey(keys, first, renew));
+        REQUIRE(SslTicketKeysTest::findKey(keys, second, renew));
+        REQUIRE(renew);
+        REQUIRE_FALSE(SslTicketKeysTest::findKey(keys, std::string(16, 'x'), renew));
+
+        // no previous key after idle over two periods
+        const auto third = SslTicketKeysTest::currentName(keys);
+        SslTicketKeysTest::age(keys, period * 2);
+        REQUIRE(SslTicketKeysTest::currentName(keys) != third);
+        REQUIRE_FALSE(SslTicketKeysTest::findKey(keys, third, renew));
+    }
+
+    SECTION("session resumed by ticket")
+    {
+        auto serverCtx = ticketServerContext(keys);
+        std::shared_ptr<SSL_CTX> clientCtx(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+        std::shared_ptr<SSL_SESSION> session;
+        REQUIRE_FALSE(ticketHandshake(serverCtx.get(), clientCtx.get(), session));
+        REQUIRE(ticketHandshake(serverCtx.get(), clientCtx.get(), session));
+
+        // ticket of previous key is accepted and renewed by current key
+        SslTicketKeysTest::age(keys, period);
+        REQUIRE(ticketHandshake(serverCtx.get(), clientCtx.get(), session));
+        SslTicketKeysTest::age(keys, period);
+        REQUIRE(ticketHandshake(serverCtx.get(), clientCtx.get(), session));
+
+        // ticket of dropped key fall back to full handshake
+        SslTicketKeysTest::age(keys, period * 2);
+        REQUIRE_FALSE(ticketHandshake(serverCtx.get(), clientCtx.get(), session));
+    }
+}